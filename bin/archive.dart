@@ -5,6 +5,7 @@ import "package:cryptography_plus/cryptography_plus.dart";
 import "package:desktop_updater/src/app_archive.dart";
 
 import "helper/copy.dart";
+import "helper/pack.dart";
 
 Future<String> getFileHash(File file) async {
   try {
@@ -81,6 +82,44 @@ Future<String?> genFileHashes({required String? path}) async {
   }
 }
 
+/// Release folders of the [window] builds before [current] in dist/ that
+/// have a hashes.json, newest last, to generate patches from.
+Future<List<String>> previousReleaseFolders({
+  required List<FileSystemEntity> folders,
+  required FileSystemEntity current,
+  required String platform,
+  required int window,
+}) async {
+  int? buildOf(FileSystemEntity folder) =>
+      int.tryParse(folder.path.split(Platform.pathSeparator).last);
+
+  final currentBuild = buildOf(current);
+  if (window <= 0 || currentBuild == null) {
+    return [];
+  }
+  final earlier = folders
+      .where((folder) => (buildOf(folder) ?? currentBuild) < currentBuild)
+      .toList()
+    ..sort((a, b) => buildOf(a)!.compareTo(buildOf(b)!));
+
+  final result = <String>[];
+  for (final folder in earlier.reversed) {
+    if (result.length == window) {
+      break;
+    }
+    await for (final entity in Directory(folder.path).list()) {
+      if (entity is Directory &&
+          entity.path.endsWith("-$platform") &&
+          File("${entity.path}${Platform.pathSeparator}hashes.json")
+              .existsSync()) {
+        result.insert(0, entity.path);
+        break;
+      }
+    }
+  }
+  return result;
+}
+
 Future<void> main(List<String> args) async {
   if (args.isEmpty) {
     print("PLATFORM must be specified: macos, windows, linux");
@@ -88,6 +127,30 @@ Future<void> main(List<String> args) async {
   }
 
   final platform = args[0];
+  // --patch-window=N publishes patches from the N previous releases; it
+  // needs the native packer.
+  final patchWindow = int.tryParse(
+        args
+            .skip(1)
+            .firstWhere(
+              (arg) => arg.startsWith("--patch-window="),
+              orElse: () => "=0",
+            )
+            .split("=")
+            .last,
+      ) ??
+      0;
+  // --objects also publishes every file by digest into dist/objects, shared
+  // by all releases; --objects-only leaves just the manifests and patches
+  // in the release folder. Both need the native packer.
+  final objectsOnly = args.contains("--objects-only");
+  final objects = objectsOnly || args.contains("--objects");
+  // --shard-depth=N is passed on to the packer, which then also splits
+  // hashes.json into shards the native updater fetches in parallel.
+  final shardDepth = args.firstWhere(
+    (arg) => arg.startsWith("--shard-depth="),
+    orElse: () => "",
+  );
 
   if (platform != "macos" && platform != "windows" && platform != "linux") {
     print("PLATFORM must be specified: macos, windows, linux");
@@ -155,35 +218,39 @@ Future<void> main(List<String> args) async {
   final appNamePubspec =
       RegExp(r"name: (.+)").firstMatch(pubspecContent)!.group(1);
 
-  if (platform == "windows") {
-    await copyDirectory(
-      Directory(
-        foundDirectory,
-      ),
-      Directory(
-        "${lastBuildNumberFolder.path}${Platform.pathSeparator}$foundVersion+$foundBuildNumber-$platform",
-      ),
-    );
-  } else if (platform == "macos") {
-    await copyDirectory(
-      Directory("$foundDirectory/$appNamePubspec.app/Contents"),
-      Directory(
-        "${lastBuildNumberFolder.path}${Platform.pathSeparator}$foundVersion+$foundBuildNumber-$platform",
-      ),
-    );
-  } else if (platform == "linux") {
-    await copyDirectory(
-      Directory(foundDirectory),
-      Directory(
-        "${lastBuildNumberFolder.path}/$foundVersion+$foundBuildNumber-$platform",
-      ),
-    );
-  }
-
-  await genFileHashes(
-    path:
-        "${lastBuildNumberFolder.path}${Platform.pathSeparator}$foundVersion+$foundBuildNumber-$platform",
+  final source = platform == "macos"
+      ? "$foundDirectory/$appNamePubspec.app/Contents"
+      : foundDirectory;
+  final destination =
+      "${lastBuildNumberFolder.path}${Platform.pathSeparator}$foundVersion+$foundBuildNumber-$platform";
+
+  final previous = await previousReleaseFolders(
+    folders: folders,
+    current: lastBuildNumberFolder,
+    platform: platform,
+    window: patchWindow,
   );
 
+  // Both trees live in dist/ and are never rebuilt in place, so the
+  // release folder can share their inodes.
+  if (!await packWithNativePacker(
+    source: source,
+    destination: destination,
+    arguments: [
+      "--stage=hardlink",
+      for (final folder in previous) "--previous=$folder",
+      if (objects) "--objects=${distDir.path}${Platform.pathSeparator}objects",
+      if (objectsOnly) "--objects-only",
+      if (shardDepth.isNotEmpty) shardDepth,
+    ],
+  )) {
+    if (previous.isNotEmpty || objects) {
+      print("desktop_updater_pack not found, publishing without patches or "
+          "objects");
+    }
+    await copyDirectory(Directory(source), Directory(destination));
+    await genFileHashes(path: destination);
+  }
+
   return;
 }
@@ -0,0 +1,32 @@
+import "dart:io";
+
+/// Runs the native packer from tools/pack on [source] and [destination].
+/// It copies, or reflinks or hard links, every file and writes hashes.json
+/// and hashes.bin in one parallel pass; see `desktop_updater_pack --help`
+/// for [arguments]. It is looked up as DESKTOP_UPDATER_PACK or as
+/// desktop_updater_pack on the PATH.
+///
+/// Returns false when the packer cannot be started, so the caller falls
+/// back to its Dart implementation.
+Future<bool> packWithNativePacker({
+  required String source,
+  required String destination,
+  List<String> arguments = const [],
+}) async {
+  final packer =
+      Platform.environment["DESKTOP_UPDATER_PACK"] ?? "desktop_updater_pack";
+  final ProcessResult result;
+  try {
+    result = await Process.run(packer, [...arguments, source, destination]);
+  } on ProcessException {
+    return false;
+  }
+  stdout.write(result.stdout);
+  stderr.write(result.stderr);
+  if (result.exitCode != 0) {
+    throw Exception(
+      "Desktop Updater: $packer failed with exit code ${result.exitCode}",
+    );
+  }
+  return true;
+}
@@ -4,6 +4,8 @@ import "dart:io";
 import "package:path/path.dart" as path;
 import "package:pubspec_parse/pubspec_parse.dart";
 
+import "helper/pack.dart";
+
 Future<void> main(List<String> args) async {
   if (args.isEmpty) {
     print("PLATFORM must be specified: macos, windows, linux");
@@ -139,8 +141,15 @@ Future<void> main(List<String> args) async {
     distDir.deleteSync(recursive: true);
   }
 
-  // Copy buildDir to distPath
-  await copyDirectory(buildDir, Directory(distPath));
+  // Copy buildDir to distPath. The next build rewrites buildDir in place,
+  // so the native packer may reflink but must not hard link.
+  if (!await packWithNativePacker(
+    source: buildDir.path,
+    destination: distPath,
+    arguments: ["--no-manifest"],
+  )) {
+    await copyDirectory(buildDir, Directory(distPath));
+  }
 
   print("Archive created at $distPath");
 }
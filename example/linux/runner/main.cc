@@ -1,6 +1,11 @@
+#include <desktop_updater/desktop_updater_plugin.h>
+
 #include "my_application.h"
 
 int main(int argc, char** argv) {
+  // Swap in a downloaded update before anything of the old one is loaded.
+  desktop_updater_apply_pending();
+
   g_autoptr(MyApplication) app = my_application_new();
   return g_application_run(G_APPLICATION(app), argc, argv);
 }
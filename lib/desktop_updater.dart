@@ -3,11 +3,14 @@ import "package:desktop_updater/src/app_archive.dart";
 import "package:desktop_updater/src/file_hash.dart";
 import "package:desktop_updater/src/prepare.dart";
 import "package:desktop_updater/src/update.dart";
+import "package:desktop_updater/src/update_metrics.dart";
 import "package:desktop_updater/src/update_progress.dart";
 import "package:desktop_updater/src/version_check.dart";
 
 export "package:desktop_updater/src/app_archive.dart";
+export "package:desktop_updater/src/app_version_info.dart";
 export "package:desktop_updater/src/localization.dart";
+export "package:desktop_updater/src/update_metrics.dart";
 export "package:desktop_updater/src/update_progress.dart";
 export "package:desktop_updater/widget/update_dialog.dart";
 export "package:desktop_updater/widget/update_direct_card.dart";
@@ -26,8 +29,18 @@ class DesktopUpdater {
   }
 
   /// Uygulamayı kapatır ve yeniden başlatır
-  Future<void> restartApp() {
-    return DesktopUpdaterPlatform.instance.restartApp();
+  ///
+  /// With [handoff] the old window stays up until the updated app has
+  /// rendered its first frame (Linux). [removedFiles] are the paths of the
+  /// version check's removedFiles, which the update deletes (Windows).
+  Future<void> restartApp({
+    bool handoff = false,
+    List<String> removedFiles = const [],
+  }) {
+    return DesktopUpdaterPlatform.instance.restartApp(
+      handoff: handoff,
+      removedFiles: removedFiles,
+    );
   }
 
   Future<String?> getExecutablePath() {
@@ -45,13 +58,18 @@ class DesktopUpdater {
     return genFileHashes(path: path);
   }
 
+  /// Downloads [changedFiles] into the update folder.
+  ///
+  /// Progress events are coalesced to at most [progressHz] per second.
   Future<Stream<UpdateProgress>> updateApp({
     required String remoteUpdateFolder,
     required List<FileHashModel?> changedFiles,
+    double progressHz = 10,
   }) {
     return updateAppFunction(
       remoteUpdateFolder: remoteUpdateFolder,
       changes: changedFiles,
+      progressHz: progressHz,
     );
   }
 
@@ -65,6 +83,45 @@ class DesktopUpdater {
     return DesktopUpdaterPlatform.instance.getCurrentVersion();
   }
 
+  /// Version, pre-release label and build number of the running app.
+  Future<AppVersionInfo?> getVersionInfo() {
+    return DesktopUpdaterPlatform.instance.getVersionInfo();
+  }
+
+  /// How long the handoff restart that started this process took, up to
+  /// its first frame. Null unless started by one.
+  Future<Duration?> getHandoffDuration() {
+    return DesktopUpdaterPlatform.instance.getHandoffDuration();
+  }
+
+  /// Bytes and files processed by the native engine and how long each
+  /// update phase took, since the app started. Cheap enough to poll.
+  Future<UpdateMetrics?> getUpdateMetrics() {
+    return DesktopUpdaterPlatform.instance.getUpdateMetrics();
+  }
+
+  /// Adds CPU cycles, instructions, cache misses and page faults to each
+  /// phase in [getUpdateMetrics], using Linux `perf_event_open`. Counters
+  /// the kernel refuses are left out rather than failing; returns false
+  /// only when none could be opened, see
+  /// [UpdateMetrics.perfCountersError]. Also enabled by starting the app
+  /// with `DESKTOP_UPDATER_PERF=1`.
+  Future<bool> setPerfCountersEnabled(bool enabled) {
+    return DesktopUpdaterPlatform.instance.setPerfCountersEnabled(enabled);
+  }
+
+  /// Records how long each native update phase takes. Tracing also starts
+  /// when the app is launched with DESKTOP_UPDATER_TRACE set.
+  Future<void> setTraceEnabled(bool enabled) {
+    return DesktopUpdaterPlatform.instance.setTraceEnabled(enabled);
+  }
+
+  /// Writes the recorded trace, for chrome://tracing or ui.perfetto.dev,
+  /// and returns its path.
+  Future<String?> dumpTrace({String? path}) {
+    return DesktopUpdaterPlatform.instance.dumpTrace(path: path);
+  }
+
   Future<ItemModel?> versionCheck({
     required String appArchiveUrl,
   }) {
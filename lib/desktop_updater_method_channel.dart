@@ -1,4 +1,11 @@
+import "dart:async";
+import "dart:convert";
+
 import "package:desktop_updater/desktop_updater_platform_interface.dart";
+import "package:desktop_updater/src/app_archive.dart";
+import "package:desktop_updater/src/app_version_info.dart";
+import "package:desktop_updater/src/update_metrics.dart";
+import "package:desktop_updater/src/update_progress.dart";
 import "package:flutter/foundation.dart";
 import "package:flutter/services.dart";
 
@@ -8,6 +15,10 @@ class MethodChannelDesktopUpdater extends DesktopUpdaterPlatform {
   @visibleForTesting
   final methodChannel = const MethodChannel("desktop_updater");
 
+  /// The event channel carrying coalesced native download progress.
+  @visibleForTesting
+  final progressChannel = const EventChannel("desktop_updater/progress");
+
   @override
   Future<String?> getPlatformVersion() async {
     final version =
@@ -16,8 +27,14 @@ class MethodChannelDesktopUpdater extends DesktopUpdaterPlatform {
   }
 
   @override
-  Future<void> restartApp() async {
-    await methodChannel.invokeMethod<void>("restartApp");
+  Future<void> restartApp({
+    bool handoff = false,
+    List<String> removedFiles = const [],
+  }) async {
+    await methodChannel.invokeMethod<void>("restartApp", {
+      "handoff": handoff,
+      "removedFiles": removedFiles,
+    });
   }
 
   @override
@@ -39,4 +56,125 @@ class MethodChannelDesktopUpdater extends DesktopUpdaterPlatform {
   Future<String?> getCurrentVersion() async {
     return methodChannel.invokeMethod<String>("getCurrentVersion");
   }
+
+  @override
+  Future<AppVersionInfo?> getVersionInfo() async {
+    final result = await methodChannel.invokeMapMethod<String, dynamic>(
+      "getVersionInfo",
+    );
+    return result == null ? null : AppVersionInfo.fromMap(result);
+  }
+
+  @override
+  Future<Duration?> getHandoffDuration() async {
+    final micros = await methodChannel.invokeMethod<int>("getHandoffDuration");
+    return micros == null ? null : Duration(microseconds: micros);
+  }
+
+  @override
+  Future<UpdateMetrics?> getUpdateMetrics() async {
+    final result = await methodChannel.invokeMapMethod<String, dynamic>(
+      "getUpdateMetrics",
+    );
+    return result == null ? null : UpdateMetrics.fromMap(result);
+  }
+
+  @override
+  Future<bool> setPerfCountersEnabled(bool enabled) async {
+    final result = await methodChannel.invokeMethod<bool>(
+      "setPerfCountersEnabled",
+      {"enabled": enabled},
+    );
+    return result ?? false;
+  }
+
+  @override
+  Future<void> setTraceEnabled(bool enabled) {
+    return methodChannel.invokeMethod<void>(
+      "setTraceEnabled",
+      {"enabled": enabled},
+    );
+  }
+
+  @override
+  Future<String?> dumpTrace({String? path}) {
+    return methodChannel.invokeMethod<String>(
+      "dumpTrace",
+      {if (path != null) "path": path},
+    );
+  }
+
+  @override
+  Future<ItemModel?> checkAndPrepare({required String appArchiveUrl}) async {
+    final result = await methodChannel.invokeMapMethod<String, dynamic>(
+      "checkAndPrepare",
+      {"appArchiveUrl": appArchiveUrl},
+    );
+    if (result == null) {
+      return null;
+    }
+
+    List<FileHashModel?> files(Object? list) => [
+          for (final file in list! as List<dynamic>)
+            FileHashModel.fromJson(
+              Map<String, dynamic>.from(file as Map<dynamic, dynamic>),
+            ),
+        ];
+
+    return ItemModel.fromJson(
+      jsonDecode(result["item"] as String) as Map<String, dynamic>,
+    ).copyWith(
+      appName: result["appName"] as String?,
+      changedFiles: files(result["changedFiles"]),
+      removedFiles: files(result["removedFiles"]),
+      totalBytes: result["totalBytes"] as int?,
+      expectedBytes: result["expectedBytes"] as int?,
+    );
+  }
+
+  @override
+  Stream<UpdateProgress> downloadUpdate({
+    required String remoteUpdateFolder,
+    required List<FileHashModel?> files,
+    double progressHz = 10,
+  }) {
+    late final StreamController<UpdateProgress> controller;
+    StreamSubscription<dynamic>? subscription;
+
+    controller = StreamController<UpdateProgress>(
+      onListen: () {
+        subscription = progressChannel.receiveBroadcastStream().listen(
+          (event) {
+            controller.add(
+              UpdateProgress.fromMap(event as Map<dynamic, dynamic>),
+            );
+          },
+          onError: controller.addError,
+        );
+
+        methodChannel.invokeMethod<void>("downloadUpdate", {
+          "remoteUpdateFolder": remoteUpdateFolder,
+          "progressHz": progressHz,
+          "files": [
+            for (final file in files)
+              if (file != null)
+                {
+                  "path": file.filePath,
+                  "length": file.length,
+                  "calculatedHash": file.calculatedHash,
+                  if (file.object != null) "object": file.object,
+                },
+          ],
+        }).catchError((Object error) {
+          controller.addError(error);
+        }).whenComplete(() async {
+          await subscription?.cancel();
+          await controller.close();
+        });
+      },
+      onCancel: () => subscription?.cancel(),
+    );
+
+    return controller.stream;
+  }
 }
@@ -1,5 +1,8 @@
 import "package:desktop_updater/desktop_updater_method_channel.dart";
 import "package:desktop_updater/src/app_archive.dart";
+import "package:desktop_updater/src/app_version_info.dart";
+import "package:desktop_updater/src/update_metrics.dart";
+import "package:desktop_updater/src/update_progress.dart";
 import "package:plugin_platform_interface/plugin_platform_interface.dart";
 
 abstract class DesktopUpdaterPlatform extends PlatformInterface {
@@ -27,7 +30,17 @@ abstract class DesktopUpdaterPlatform extends PlatformInterface {
     throw UnimplementedError("platformVersion() has not been implemented.");
   }
 
-  Future<void> restartApp() {
+  /// Restarts the app on the downloaded update.
+  ///
+  /// With [handoff], the updated app is started next to the running one,
+  /// which only exits once the new window has rendered its first frame.
+  ///
+  /// [removedFiles] lists the installed files the new release no longer
+  /// has; the Windows update script moves them away with the replaced files.
+  Future<void> restartApp({
+    bool handoff = false,
+    List<String> removedFiles = const [],
+  }) {
     throw UnimplementedError("restartApp() has not been implemented.");
   }
 
@@ -54,13 +67,71 @@ abstract class DesktopUpdaterPlatform extends PlatformInterface {
     throw UnimplementedError("updateApp() has not been implemented.");
   }
 
+  /// Downloads [files] from [remoteUpdateFolder] into the update folder on
+  /// native worker threads.
+  ///
+  /// Progress is coalesced natively and delivered at most [progressHz] times
+  /// per second.
+  Stream<UpdateProgress> downloadUpdate({
+    required String remoteUpdateFolder,
+    required List<FileHashModel?> files,
+    double progressHz = 10,
+  }) {
+    throw UnimplementedError("downloadUpdate() has not been implemented.");
+  }
+
   Future<List<FileHashModel?>> prepareUpdateApp({
     required String remoteUpdateFolder,
   }) {
     throw UnimplementedError("prepareUpdateApp() has not been implemented.");
   }
 
+  /// Checks [appArchiveUrl] for a newer release and diffs its hashes.json
+  /// against the installed bundle in a single native call.
+  ///
+  /// Returns null when the running build is up to date.
+  Future<ItemModel?> checkAndPrepare({required String appArchiveUrl}) {
+    throw UnimplementedError("checkAndPrepare() has not been implemented.");
+  }
+
   Future<String?> getCurrentVersion() {
     throw UnimplementedError("getCurrentVersion() has not been implemented.");
   }
+
+  /// Returns the full version of the running app. Parsed once natively when
+  /// the plugin registers.
+  Future<AppVersionInfo?> getVersionInfo() {
+    throw UnimplementedError("getVersionInfo() has not been implemented.");
+  }
+
+  /// Time from the previous version starting this process to its first
+  /// frame, if it was started by a handoff restart.
+  Future<Duration?> getHandoffDuration() {
+    throw UnimplementedError("getHandoffDuration() has not been implemented.");
+  }
+
+  /// Returns the native engine's counters and phase latencies.
+  Future<UpdateMetrics?> getUpdateMetrics() {
+    throw UnimplementedError("getUpdateMetrics() has not been implemented.");
+  }
+
+  /// Collects per-phase CPU performance counters. Returns whether counting
+  /// is on.
+  Future<bool> setPerfCountersEnabled(bool enabled) {
+    throw UnimplementedError(
+      "setPerfCountersEnabled() has not been implemented.",
+    );
+  }
+
+  /// Turns recording of the native trace spans (scan, hash, fetch, stage,
+  /// apply, ...) on or off.
+  Future<void> setTraceEnabled(bool enabled) {
+    throw UnimplementedError("setTraceEnabled() has not been implemented.");
+  }
+
+  /// Writes the recorded spans as Chrome trace JSON to [path], or to a file
+  /// in the temp directory, and returns the path written.
+  Future<String?> dumpTrace({String? path}) {
+    throw UnimplementedError("dumpTrace() has not been implemented.");
+  }
 }
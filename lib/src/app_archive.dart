@@ -38,6 +38,9 @@ class ItemModel {
     required this.url,
     required this.platform,
     this.changedFiles,
+    this.removedFiles,
+    this.totalBytes,
+    this.expectedBytes,
     this.appName,
   });
 
@@ -62,6 +65,16 @@ class ItemModel {
   final String url;
   final String platform;
   final List<FileHashModel?>? changedFiles;
+
+  /// Installed files the release no longer contains, when known.
+  final List<FileHashModel?>? removedFiles;
+
+  /// Sum of [changedFiles] lengths in bytes, when known.
+  final int? totalBytes;
+
+  /// Bytes the planned update transfers, which is less than [totalBytes]
+  /// when published patches are used.
+  final int? expectedBytes;
   final String? appName;
 
   Map<String, dynamic> toJson() {
@@ -85,6 +98,9 @@ class ItemModel {
     String? url,
     String? platform,
     List<FileHashModel?>? changedFiles,
+    List<FileHashModel?>? removedFiles,
+    int? totalBytes,
+    int? expectedBytes,
     String? appName,
   }) {
     return ItemModel(
@@ -96,6 +112,9 @@ class ItemModel {
       url: url ?? this.url,
       platform: platform ?? this.platform,
       changedFiles: changedFiles ?? changedFiles,
+      removedFiles: removedFiles ?? this.removedFiles,
+      totalBytes: totalBytes ?? this.totalBytes,
+      expectedBytes: expectedBytes ?? this.expectedBytes,
       appName: appName ?? this.appName,
     );
   }
@@ -120,6 +139,7 @@ class FileHashModel {
     required this.filePath,
     required this.calculatedHash,
     required this.length,
+    this.object,
   });
 
   factory FileHashModel.fromJson(Map<String, dynamic> json) {
@@ -127,17 +147,23 @@ class FileHashModel {
       filePath: json["path"],
       calculatedHash: json["calculatedHash"],
       length: json["length"],
+      object: json["object"],
     );
   }
   final String filePath;
   final String calculatedHash;
   final int length;
 
+  /// Where desktop_updater_pack --objects published the file by digest,
+  /// relative to the release folder, e.g. "../objects/<hex>".
+  final String? object;
+
   Map<String, dynamic> toJson() {
     return {
       "path": filePath,
       "calculatedHash": calculatedHash,
       "length": length,
+      if (object != null) "object": object,
     };
   }
 }
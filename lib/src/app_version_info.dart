@@ -0,0 +1,42 @@
+/// Build metadata of the running app, parsed natively from pubspec's
+/// `version: 1.2.3-beta+4`.
+class AppVersionInfo {
+  AppVersionInfo({
+    required this.version,
+    required this.major,
+    required this.minor,
+    required this.patch,
+    required this.preRelease,
+    required this.buildNumber,
+    this.appName,
+  });
+
+  factory AppVersionInfo.fromMap(Map<dynamic, dynamic> map) {
+    final appName = map["appName"] as String?;
+    return AppVersionInfo(
+      version: map["version"] as String,
+      major: map["major"] as int,
+      minor: map["minor"] as int,
+      patch: map["patch"] as int,
+      preRelease: map["preRelease"] as String,
+      buildNumber: map["buildNumber"] as String,
+      appName: appName == null || appName.isEmpty ? null : appName,
+    );
+  }
+
+  /// Version without the build number, e.g. `1.2.3-beta`.
+  final String version;
+  final int major;
+  final int minor;
+  final int patch;
+
+  /// Pre-release label, empty for releases.
+  final String preRelease;
+
+  /// Build number, compared against `shortVersion` in app-archive.json.
+  final String buildNumber;
+  final String? appName;
+
+  @override
+  String toString() => "$version+$buildNumber";
+}
@@ -5,16 +5,21 @@ import "package:path/path.dart" as path;
 
 /// Modified downloadFile to report progress based on HTTP reception only.
 /// [progressCallback] receives two doubles: receivedKB and totalKB.
+/// With [object], the file's content-addressed location relative to [host],
+/// the file is fetched from there and saved as [filePath].
 Future<void> downloadFile(
   String? host,
   String filePath,
   String savePath,
-  void Function(double receivedKB, double totalKB)? progressCallback,
-) async {
+  void Function(double receivedKB, double totalKB)? progressCallback, {
+  String? object,
+}) async {
   if (host == null) return;
 
   final client = http.Client();
-  final url = "$host/$filePath";
+  final url = object == null
+      ? "$host/$filePath"
+      : Uri.parse("$host/").resolve(object).toString();
   final request = http.Request("GET", Uri.parse(url));
   final response = await client.send(request);
 
@@ -5,6 +5,7 @@ import "dart:io";
 import "package:cryptography_plus/cryptography_plus.dart";
 import "package:desktop_updater/desktop_updater.dart";
 import "package:desktop_updater/src/app_archive.dart";
+import "package:desktop_updater/src/native_core.dart";
 
 Future<String> getFileHash(File file) async {
   try {
@@ -41,6 +42,24 @@ Future<List<FileHashModel?>> verifyFileHashes(
   final oldString = await oldFile.readAsString();
   final newString = await newFile.readAsString();
 
+  if (NativeCore.instance != null) {
+    final records = await NativeCore.diffManifests(oldString, newString);
+    final objects = _objectsByPath(newString);
+    return records
+        .where((record) => record.kind == nativeRecordChanged)
+        .map<FileHashModel?>(
+          (record) => objects.isEmpty
+              ? record.model
+              : FileHashModel(
+                  filePath: record.model.filePath,
+                  calculatedHash: record.model.calculatedHash,
+                  length: record.model.length,
+                  object: objects[record.model.filePath],
+                ),
+        )
+        .toList();
+  }
+
   // Decode as List<FileHashModel?>
   final oldHashes = (jsonDecode(oldString) as List<dynamic>)
       .map<FileHashModel?>(
@@ -67,6 +86,7 @@ Future<List<FileHashModel?>> verifyFileHashes(
           filePath: newHash?.filePath ?? "",
           calculatedHash: newHash?.calculatedHash ?? "",
           length: newHash?.length ?? 0,
+          object: newHash?.object,
         ),
       );
     }
@@ -75,6 +95,20 @@ Future<List<FileHashModel?>> verifyFileHashes(
   return changes;
 }
 
+/// The "object" of every entry of a packed manifest; the native diff only
+/// returns paths and digests.
+Map<String, String> _objectsByPath(String manifest) {
+  if (!manifest.contains("\"object\"")) {
+    return const {};
+  }
+  return {
+    for (final entry in (jsonDecode(manifest) as List<dynamic>)
+        .cast<Map<String, dynamic>>())
+      if (entry["object"] is String)
+        entry["path"] as String: entry["object"] as String,
+  };
+}
+
 // Dizin içindeki tüm dosyaların hash'lerini alıp bir dosyaya yazan fonksiyon
 Future<String> genFileHashes({String? path}) async {
   path ??= Platform.resolvedExecutable;
@@ -104,6 +138,14 @@ Future<String> genFileHashes({String? path}) async {
     // ignore: prefer_final_locals
     var hashList = <FileHashModel>[];
 
+    if (NativeCore.instance != null) {
+      // Native core hashes on worker threads off the UI isolate.
+      hashList = await NativeCore.hashTree(dir.path);
+      sink.write(jsonEncode(hashList));
+      await sink.close();
+      return outputFile.path;
+    }
+
     // Dizin içindeki tüm dosyaları döngüyle okuyoruz
     await for (final entity in dir.list(recursive: true, followLinks: false)) {
       if (entity is File) {
@@ -0,0 +1,203 @@
+import "dart:convert";
+import "dart:ffi";
+import "dart:io";
+import "dart:isolate";
+import "dart:typed_data";
+
+import "package:desktop_updater/src/app_archive.dart";
+import "package:ffi/ffi.dart";
+
+/// Must match DU_RECORDS_VERSION in src/desktop_updater_core.h.
+const int _recordsVersion = 1;
+const int _digestSize = 64;
+const int _recordHeaderSize = 16;
+
+/// Record kinds, see du_record_kind.
+const int nativeRecordFile = 0;
+const int nativeRecordChanged = 1;
+const int nativeRecordRemoved = 2;
+
+final class _DuResult extends Struct {
+  @Int32()
+  external int status;
+
+  external Pointer<Uint8> data;
+
+  @Uint64()
+  external int size;
+
+  external Pointer<Utf8> error;
+}
+
+typedef _HashTreeNative = Pointer<_DuResult> Function(Pointer<Utf8>, Int32);
+typedef _HashTree = Pointer<_DuResult> Function(Pointer<Utf8>, int);
+typedef _DiffNative = Pointer<_DuResult> Function(
+  Pointer<Utf8>,
+  Uint64,
+  Pointer<Utf8>,
+  Uint64,
+);
+typedef _Diff = Pointer<_DuResult> Function(
+  Pointer<Utf8>,
+  int,
+  Pointer<Utf8>,
+  int,
+);
+typedef _ResultFreeNative = Void Function(Pointer<_DuResult>);
+typedef _ResultFree = void Function(Pointer<_DuResult>);
+typedef _CoreVersionNative = Int32 Function();
+typedef _CoreVersion = int Function();
+
+/// A manifest record decoded from the native record buffer.
+class NativeRecord {
+  NativeRecord(this.kind, this.model);
+
+  final int kind;
+  final FileHashModel model;
+}
+
+/// Bindings to the C ABI exported by the plugin library.
+///
+/// Calls block, so [NativeCore.hashTree] and [NativeCore.diffManifests] run
+/// them on a background isolate. Each isolate opens the library on its own.
+class NativeCore {
+  NativeCore._(DynamicLibrary library)
+      : _hashTree =
+            library.lookupFunction<_HashTreeNative, _HashTree>("du_hash_tree"),
+        _diffManifests =
+            library.lookupFunction<_DiffNative, _Diff>("du_diff_manifests"),
+        _resultFree = library
+            .lookupFunction<_ResultFreeNative, _ResultFree>("du_result_free");
+
+  final _HashTree _hashTree;
+  final _Diff _diffManifests;
+  final _ResultFree _resultFree;
+
+  static NativeCore? _instance;
+  static bool _loaded = false;
+
+  /// Returns the bindings, or null when the running platform has no native
+  /// core (macOS) or an incompatible library is loaded.
+  static NativeCore? get instance {
+    if (!_loaded) {
+      _loaded = true;
+      _instance = _open();
+    }
+    return _instance;
+  }
+
+  static NativeCore? _open() {
+    final String name;
+    if (Platform.isLinux) {
+      name = "libdesktop_updater_plugin.so";
+    } else if (Platform.isWindows) {
+      name = "desktop_updater_plugin.dll";
+    } else {
+      return null;
+    }
+    try {
+      final library = DynamicLibrary.open(name);
+      final version = library
+          .lookupFunction<_CoreVersionNative, _CoreVersion>("du_core_version");
+      if (version() != _recordsVersion) {
+        return null;
+      }
+      return NativeCore._(library);
+    } on Object {
+      // Not running inside the Flutter app (e.g. the CLI tools).
+      return null;
+    }
+  }
+
+  /// Hashes every file below [root] in native worker threads.
+  static Future<List<FileHashModel>> hashTree(String root) {
+    return Isolate.run(() {
+      final core = instance!;
+      final path = root.toNativeUtf8();
+      try {
+        return core
+            ._consume(core._hashTree(path, 0))
+            .map((record) => record.model)
+            .toList();
+      } finally {
+        malloc.free(path);
+      }
+    });
+  }
+
+  /// Diffs two hashes.json documents. Returns changed and removed records.
+  static Future<List<NativeRecord>> diffManifests(
+    String installedJson,
+    String targetJson,
+  ) {
+    return Isolate.run(() {
+      final core = instance!;
+      final installed = utf8.encode(installedJson);
+      final target = utf8.encode(targetJson);
+      final installedPtr = _copy(installed);
+      final targetPtr = _copy(target);
+      try {
+        return core._consume(
+          core._diffManifests(
+            installedPtr,
+            installed.length,
+            targetPtr,
+            target.length,
+          ),
+        );
+      } finally {
+        malloc
+          ..free(installedPtr)
+          ..free(targetPtr);
+      }
+    });
+  }
+
+  static Pointer<Utf8> _copy(Uint8List bytes) {
+    final pointer = malloc<Uint8>(bytes.isEmpty ? 1 : bytes.length);
+    pointer.asTypedList(bytes.length).setAll(0, bytes);
+    return pointer.cast<Utf8>();
+  }
+
+  List<NativeRecord> _consume(Pointer<_DuResult> result) {
+    try {
+      final ref = result.ref;
+      if (ref.status != 0) {
+        throw Exception("Desktop Updater: ${ref.error.toDartString()}");
+      }
+      return _decode(ref.data.asTypedList(ref.size));
+    } finally {
+      _resultFree(result);
+    }
+  }
+
+  static List<NativeRecord> _decode(Uint8List buffer) {
+    final view = ByteData.sublistView(buffer);
+    final count = view.getUint32(4, Endian.little);
+    final records = <NativeRecord>[];
+    var offset = 8;
+    for (var i = 0; i < count; i++) {
+      final length = view.getUint64(offset, Endian.little);
+      final pathLength = view.getUint32(offset + 8, Endian.little);
+      final kind = buffer[offset + 12];
+      final digestStart = offset + _recordHeaderSize;
+      final pathStart = digestStart + _digestSize;
+      records.add(
+        NativeRecord(
+          kind,
+          FileHashModel(
+            filePath: utf8.decode(
+              Uint8List.sublistView(buffer, pathStart, pathStart + pathLength),
+            ),
+            calculatedHash: base64.encode(
+              Uint8List.sublistView(buffer, digestStart, pathStart),
+            ),
+            length: length,
+          ),
+        ),
+      );
+      offset = pathStart + pathLength;
+    }
+    return records;
+  }
+}
@@ -1,15 +1,29 @@
 import "dart:async";
 import "dart:io";
+import "dart:math" as math;
 
 import "package:desktop_updater/desktop_updater.dart";
+import "package:desktop_updater/desktop_updater_platform_interface.dart";
 import "package:desktop_updater/src/download.dart";
 
 /// Modified updateAppFunction to return a stream of UpdateProgress.
 /// The stream emits total kilobytes, received kilobytes, and the currently downloading file's name.
+///
+/// Progress is coalesced to at most [progressHz] events per second. On Linux
+/// the download runs on native worker threads, elsewhere in Dart.
 Future<Stream<UpdateProgress>> updateAppFunction({
   required String remoteUpdateFolder,
   required List<FileHashModel?> changes,
+  double progressHz = 10,
 }) async {
+  if (Platform.isLinux) {
+    return DesktopUpdaterPlatform.instance.downloadUpdate(
+      remoteUpdateFolder: remoteUpdateFolder,
+      files: changes,
+      progressHz: progressHz,
+    );
+  }
+
   final executablePath = Platform.resolvedExecutable;
 
   final directoryPath = executablePath.substring(
@@ -33,10 +47,6 @@ Future<Stream<UpdateProgress>> updateAppFunction({
         return responseStream.stream;
       }
 
-      var receivedBytes = 0.0;
-      final totalFiles = changes.length;
-      var completedFiles = 0;
-
       // Calculate total length in KB
       final totalLengthKB = changes.fold<double>(
         0,
@@ -44,6 +54,13 @@ Future<Stream<UpdateProgress>> updateAppFunction({
             previousValue + ((element?.length ?? 0) / 1024.0),
       );
 
+      final progress = _ProgressCoalescer(
+        sink: responseStream,
+        totalKB: totalLengthKB,
+        totalFiles: changes.length,
+        progressHz: progressHz,
+      );
+
       final changesFutureList = <Future<dynamic>>[];
 
       for (final file in changes) {
@@ -54,29 +71,11 @@ Future<Stream<UpdateProgress>> updateAppFunction({
               file.filePath,
               dir.path,
               (received, total) {
-                receivedBytes += received;
-                responseStream.add(
-                  UpdateProgress(
-                    totalBytes: totalLengthKB,
-                    receivedBytes: receivedBytes,
-                    currentFile: file.filePath,
-                    totalFiles: totalFiles,
-                    completedFiles: completedFiles,
-                  ),
-                );
+                progress.addReceived(received, file.filePath);
               },
+              object: file.object,
             ).then((_) {
-              completedFiles += 1;
-
-              responseStream.add(
-                UpdateProgress(
-                  totalBytes: totalLengthKB,
-                  receivedBytes: receivedBytes,
-                  currentFile: file.filePath,
-                  totalFiles: totalFiles,
-                  completedFiles: completedFiles,
-                ),
-              );
+              progress.completeFile(file.filePath);
               print("Completed: ${file.filePath}");
             }).catchError((error) {
               responseStream.addError(error);
@@ -101,3 +100,76 @@ Future<Stream<UpdateProgress>> updateAppFunction({
 
   return responseStream.stream;
 }
+
+/// Rate-limits per-chunk progress from concurrent Dart downloads and derives
+/// throughput and ETA the same way the native ProgressEmitter does, so
+/// listeners rebuild at most [progressHz] times per second.
+class _ProgressCoalescer {
+  _ProgressCoalescer({
+    required this.sink,
+    required this.totalKB,
+    required this.totalFiles,
+    required double progressHz,
+  }) : _interval = Duration(
+          microseconds: (1000000 / (progressHz > 0 ? progressHz : 10)).round(),
+        );
+
+  /// Time constant of the throughput moving average, in seconds.
+  static const _rateTimeConstant = 2.0;
+
+  final StreamController<UpdateProgress> sink;
+  final double totalKB;
+  final int totalFiles;
+  final Duration _interval;
+
+  final _clock = Stopwatch()..start();
+  var _receivedKB = 0.0;
+  var _completedFiles = 0;
+  var _lastEmitMicros = 0;
+  var _lastEmitKB = 0.0;
+  var _bytesPerSecond = 0.0;
+
+  void addReceived(double kilobytes, String currentFile) {
+    _receivedKB += kilobytes;
+    if (_clock.elapsedMicroseconds - _lastEmitMicros >=
+        _interval.inMicroseconds) {
+      _emit(currentFile);
+    }
+  }
+
+  void completeFile(String currentFile) {
+    _completedFiles += 1;
+    _emit(currentFile);
+  }
+
+  void _emit(String currentFile) {
+    final now = _clock.elapsedMicroseconds;
+    final elapsed = (now - _lastEmitMicros) / 1000000.0;
+    if (elapsed > 0) {
+      final instant = (_receivedKB - _lastEmitKB) * 1024 / elapsed;
+      final alpha = 1 - math.exp(-elapsed / _rateTimeConstant);
+      _bytesPerSecond = _bytesPerSecond == 0
+          ? instant
+          : _bytesPerSecond + alpha * (instant - _bytesPerSecond);
+    }
+    _lastEmitMicros = now;
+    _lastEmitKB = _receivedKB;
+
+    final remainingBytes = math.max(0, totalKB - _receivedKB) * 1024;
+    sink.add(
+      UpdateProgress(
+        totalBytes: totalKB,
+        receivedBytes: _receivedKB,
+        currentFile: currentFile,
+        totalFiles: totalFiles,
+        completedFiles: _completedFiles,
+        bytesPerSecond: _bytesPerSecond,
+        etaSeconds: remainingBytes == 0
+            ? 0
+            : _bytesPerSecond > 0
+                ? remainingBytes / _bytesPerSecond
+                : null,
+      ),
+    );
+  }
+}
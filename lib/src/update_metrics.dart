@@ -0,0 +1,130 @@
+/// Latency of one native update phase, from a log-linear histogram.
+/// Percentiles are accurate to within about 6%.
+class PhaseMetrics {
+  PhaseMetrics({
+    required this.count,
+    required this.total,
+    required this.max,
+    required this.p50,
+    required this.p90,
+    required this.p99,
+    this.allocatedBytes = 0,
+    this.peakAllocatedBytes = 0,
+    this.maxRssBytes = 0,
+    this.maxPssBytes = 0,
+    this.hardwareCounters = const {},
+  });
+
+  factory PhaseMetrics.fromMap(Map<dynamic, dynamic> map) {
+    Duration micros(String key) =>
+        Duration(microseconds: (map[key] as int?) ?? 0);
+    return PhaseMetrics(
+      count: (map["count"] as int?) ?? 0,
+      total: micros("totalMicros"),
+      max: micros("maxMicros"),
+      p50: micros("p50Micros"),
+      p90: micros("p90Micros"),
+      p99: micros("p99Micros"),
+      allocatedBytes: (map["allocatedBytes"] as int?) ?? 0,
+      peakAllocatedBytes: (map["peakAllocatedBytes"] as int?) ?? 0,
+      maxRssBytes: (map["maxRssBytes"] as int?) ?? 0,
+      maxPssBytes: (map["maxPssBytes"] as int?) ?? 0,
+      hardwareCounters: {
+        for (final name in _hardwareCounterNames)
+          if (map[name] is int) name: map[name] as int,
+      },
+    );
+  }
+
+  /// Number of times the phase ran.
+  final int count;
+  final Duration total;
+  final Duration max;
+  final Duration p50;
+  final Duration p90;
+  final Duration p99;
+
+  /// Bytes the engine allocated for buffers, manifests and JSON while
+  /// working on the phase.
+  final int allocatedBytes;
+
+  /// Most engine-allocated bytes live at once while the phase ran.
+  final int peakAllocatedBytes;
+
+  /// Largest process RSS and PSS seen when the phase started or ended;
+  /// 0 where the platform does not report them.
+  final int maxRssBytes;
+  final int maxPssBytes;
+
+  /// `cycles`, `instructions`, `cacheMisses` and `pageFaults` summed over
+  /// the threads that worked on the phase, for the events the kernel allowed.
+  /// Empty unless [DesktopUpdater.setPerfCountersEnabled] succeeded.
+  final Map<String, int> hardwareCounters;
+
+  static const _hardwareCounterNames = [
+    "cycles",
+    "instructions",
+    "cacheMisses",
+    "pageFaults",
+  ];
+}
+
+/// Counters and per-phase latencies of the native update engine since the
+/// app started, see [DesktopUpdater.getUpdateMetrics].
+class UpdateMetrics {
+  UpdateMetrics({
+    required this.counters,
+    required this.phases,
+    this.perfCountersEnabled = false,
+    this.perfCountersError,
+    this.liveAllocatedBytes = 0,
+    this.peakAllocatedBytes = 0,
+  });
+
+  factory UpdateMetrics.fromMap(Map<dynamic, dynamic> map) {
+    final counters = (map["counters"] as Map<dynamic, dynamic>?) ?? {};
+    final phases = (map["phases"] as Map<dynamic, dynamic>?) ?? {};
+    return UpdateMetrics(
+      counters: counters.map(
+        (key, value) => MapEntry(key as String, value as int),
+      ),
+      phases: phases.map(
+        (key, value) => MapEntry(
+          key as String,
+          PhaseMetrics.fromMap(value as Map<dynamic, dynamic>),
+        ),
+      ),
+      perfCountersEnabled: (map["perfEnabled"] as bool?) ?? false,
+      perfCountersError: map["perfError"] as String?,
+      liveAllocatedBytes: (map["liveAllocatedBytes"] as int?) ?? 0,
+      peakAllocatedBytes: (map["peakAllocatedBytes"] as int?) ?? 0,
+    );
+  }
+
+  /// E.g. `bytesHashed`, `bytesDownloaded`, `filesApplied`,
+  /// `hashCacheHits`.
+  final Map<String, int> counters;
+
+  /// Keyed by phase: `check`, `scan`, `hash`, `diff`, `fetch`, `fetchFile`,
+  /// `stage`, `apply` and `verifyInstalled`.
+  final Map<String, PhaseMetrics> phases;
+
+  /// Whether performance counters are being collected.
+  final bool perfCountersEnabled;
+
+  /// Why the kernel refused a performance counter, e.g. because of
+  /// `perf_event_paranoid` or a VM without a PMU.
+  final String? perfCountersError;
+
+  /// Bytes the engine currently holds, and the most it held at once.
+  final int liveAllocatedBytes;
+  final int peakAllocatedBytes;
+
+  /// Share of post-apply checks answered by the hash cache, or null if
+  /// none ran.
+  double? get hashCacheHitRate {
+    final hits = counters["hashCacheHits"] ?? 0;
+    final total = hits + (counters["hashCacheMisses"] ?? 0);
+    return total == 0 ? null : hits / total;
+  }
+}
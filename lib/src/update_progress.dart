@@ -6,10 +6,37 @@ class UpdateProgress {
     required this.currentFile,
     required this.totalFiles,
     required this.completedFiles,
+    this.bytesPerSecond = 0,
+    this.etaSeconds,
   });
+
+  /// Creates an [UpdateProgress] from a native progress event, which counts
+  /// bytes rather than kilobytes.
+  factory UpdateProgress.fromMap(Map<dynamic, dynamic> map) {
+    final eta = (map["etaSeconds"] as num?)?.toDouble();
+    return UpdateProgress(
+      totalBytes: ((map["totalBytes"] as num?) ?? 0) / 1024.0,
+      receivedBytes: ((map["receivedBytes"] as num?) ?? 0) / 1024.0,
+      currentFile: map["currentFile"] as String? ?? "",
+      totalFiles: map["totalFiles"] as int? ?? 0,
+      completedFiles: map["completedFiles"] as int? ?? 0,
+      bytesPerSecond: (map["bytesPerSecond"] as num?)?.toDouble() ?? 0,
+      etaSeconds: eta == null || eta < 0 ? null : eta,
+    );
+  }
+
+  /// Total size of the update in kilobytes.
   final double totalBytes;
+
+  /// Kilobytes received so far.
   final double receivedBytes;
   final String currentFile;
   final int totalFiles;
   final int completedFiles;
+
+  /// Smoothed transfer rate in bytes per second.
+  final double bytesPerSecond;
+
+  /// Estimated seconds until the download completes, null while unknown.
+  final double? etaSeconds;
 }
@@ -2,13 +2,20 @@ import "dart:convert";
 import "dart:io";
 
 import "package:desktop_updater/desktop_updater.dart";
+import "package:desktop_updater/desktop_updater_platform_interface.dart";
 import "package:desktop_updater/src/file_hash.dart";
 import "package:http/http.dart" as http;
-import "package:path/path.dart" as path;
 
 Future<ItemModel?> versionCheckFunction({
   required String appArchiveUrl,
 }) async {
+  if (Platform.isLinux) {
+    // Fetch, scan and diff natively in one call, without temp files.
+    return DesktopUpdaterPlatform.instance.checkAndPrepare(
+      appArchiveUrl: appArchiveUrl,
+    );
+  }
+
   final executablePath = Platform.resolvedExecutable;
 
   final directoryPath = executablePath.substring(
@@ -84,31 +91,15 @@ Future<ItemModel?> versionCheckFunction({
 
     print("Latest version: ${latestVersion.shortVersion}");
 
-    late String? currentVersion;
-
-    if (Platform.isLinux) {
-      final exePath = await File("/proc/self/exe").resolveSymbolicLinks();
-      final appPath = path.dirname(exePath);
-      final assetPath = path.join(appPath, "data", "flutter_assets");
-      final versionPath = path.join(assetPath, "version.json");
-      final versionJson = jsonDecode(await File(versionPath).readAsString());
-
-      print("Current version: ${versionJson['build_number']}");
-      currentVersion = versionJson["build_number"];
-    } else {
-      await DesktopUpdater().getCurrentVersion().then(
-        (value) {
-          print("Current version: $value");
-          currentVersion = value;
-        },
-      );
-    }
+    // Parsed once natively and cached by the plugin.
+    final currentVersion = await DesktopUpdater().getCurrentVersion();
+    print("Current version: $currentVersion");
 
     if (currentVersion == null) {
       throw Exception("Desktop Updater: Current version is null");
     }
 
-    if (latestVersion.shortVersion > int.parse(currentVersion!)) {
+    if (latestVersion.shortVersion > int.parse(currentVersion)) {
       print("New version found: ${latestVersion.version}");
 
       // calculate totalSize
@@ -5,6 +5,7 @@ class DesktopUpdaterController extends ChangeNotifier {
   DesktopUpdaterController({
     required Uri? appArchiveUrl,
     this.localization,
+    this.handoffRestart = false,
   }) {
     if (appArchiveUrl != null) {
       init(appArchiveUrl);
@@ -14,6 +15,10 @@ class DesktopUpdaterController extends ChangeNotifier {
   DesktopUpdateLocalization? localization;
   DesktopUpdateLocalization? get getLocalization => localization;
 
+  /// Keeps the current window up until the updated app has rendered, see
+  /// [DesktopUpdater.restartApp].
+  final bool handoffRestart;
+
   String? _appName;
   String? get appName => _appName;
 
@@ -50,6 +55,7 @@ class DesktopUpdaterController extends ChangeNotifier {
   double get downloadedSize => _downloadedSize;
 
   List<FileHashModel?>? _changedFiles;
+  List<FileHashModel?>? _removedFiles;
 
   List<ChangeModel?>? _releaseNotes;
   List<ChangeModel?>? get releaseNotes => _releaseNotes;
@@ -97,6 +103,7 @@ class DesktopUpdaterController extends ChangeNotifier {
 
       // Get changed files liste
       _changedFiles = versionResponse?.changedFiles;
+      _removedFiles = versionResponse?.removedFiles;
       _releaseNotes = versionResponse?.changes;
       _appName = versionResponse?.appName;
       _appVersion = versionResponse?.version;
@@ -153,6 +160,12 @@ class DesktopUpdaterController extends ChangeNotifier {
   }
 
   void restartApp() {
-    _plugin.restartApp();
+    _plugin.restartApp(
+      handoff: handoffRestart,
+      removedFiles: [
+        for (final file in _removedFiles ?? <FileHashModel?>[])
+          if (file != null) file.filePath,
+      ],
+    );
   }
 }
@@ -0,0 +1,549 @@
+// Microbenchmarks of the update hot paths. Writes JSON results to
+// desktop_updater_bench.json unless --benchmark_out is given.
+//
+// Bundles of up to DESKTOP_UPDATER_BENCH_MAX_FILES files (default 100000,
+// up to 1000000) are generated once in the temp directory and reused. The
+// download pipeline is measured against an in-process loopback server.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "batch_script.h"
+#include "blake2b.h"
+#include "curl_fetcher.h"
+#include "download_engine.h"
+#include "file_hash.h"
+#include "file_util.h"
+#include "loopback_server.h"
+#include "manifest.h"
+#include "startup_warmup.h"
+#include "synthetic_bundle.h"
+#include "update_applier.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+namespace bench {
+
+namespace {
+
+const int64_t kBundleSizes[] = {1000, 10000, 100000, 1000000};
+
+int64_t MaxBundleFiles() {
+  const char* value = getenv("DESKTOP_UPDATER_BENCH_MAX_FILES");
+  return value != nullptr ? atoll(value) : 100000;
+}
+
+// A manifest whose every 10th file changed, plus a few added and removed.
+Manifest ChangedManifest(const Manifest& base) {
+  Manifest target;
+  target.reserve(base.size());
+  for (size_t i = 0; i < base.size(); i++) {
+    if (i % 97 == 0) {
+      continue;
+    }
+    FileEntry entry = base[i];
+    if (i % 10 == 0) {
+      entry.digest[0] ^= 0xFF;
+    }
+    target.push_back(std::move(entry));
+  }
+  for (size_t i = 0; i < base.size() / 100; i++) {
+    FileEntry entry;
+    entry.path = "data/flutter_assets/new/" + std::to_string(i);
+    target.push_back(std::move(entry));
+  }
+  return target;
+}
+
+std::string BenchFile(const std::string& name, size_t size) {
+  const std::string path =
+      (fs::temp_directory_path() / ("desktop_updater_bench_" + name)).string();
+  std::vector<uint8_t> data(size);
+  FillRandom(data.data(), data.size(), size);
+  std::string error;
+  WriteFileBytes(path, data.data(), data.size(), &error);
+  return path;
+}
+
+// --- Hashing ---
+
+void BM_Blake2b(benchmark::State& state) {
+  std::vector<uint8_t> data(static_cast<size_t>(state.range(0)));
+  FillRandom(data.data(), data.size(), 1);
+  uint8_t digest[64];
+  for (auto _ : state) {
+    Blake2b hash;
+    hash.Update(data.data(), data.size());
+    hash.Final(digest);
+    benchmark::DoNotOptimize(digest);
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(data.size()));
+}
+
+void BM_HashFile(benchmark::State& state) {
+  const std::string path =
+      BenchFile("hash", static_cast<size_t>(state.range(0)));
+  Digest digest;
+  uint64_t length = 0;
+  std::string error;
+  for (auto _ : state) {
+    if (!HashFile(path, &digest, &length, &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+  fs::remove(path);
+}
+
+// --- Tree scan and hash ---
+
+void BM_ScanTree(benchmark::State& state) {
+  const std::string root =
+      CachedSyntheticBundle(static_cast<size_t>(state.range(0)));
+  std::vector<ScannedFile> files;
+  std::string error;
+  for (auto _ : state) {
+    if (!ScanTree(root, ScanOptions(), &files, &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(files.size()));
+}
+
+void BM_HashTree(benchmark::State& state) {
+  const std::string root =
+      CachedSyntheticBundle(static_cast<size_t>(state.range(0)));
+  const unsigned threads = static_cast<unsigned>(state.range(1));
+  Manifest manifest;
+  std::string error;
+  for (auto _ : state) {
+    if (!HashTree(root, ScanOptions(), threads, &manifest, &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  uint64_t bytes = 0;
+  for (const FileEntry& entry : manifest) {
+    bytes += entry.length;
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(manifest.size()));
+}
+
+// --- Manifests ---
+
+void BM_DiffManifests(benchmark::State& state) {
+  const Manifest installed =
+      SyntheticManifest(static_cast<size_t>(state.range(0)), 1);
+  const Manifest target = ChangedManifest(installed);
+  for (auto _ : state) {
+    ManifestDiff diff = DiffManifests(installed, target);
+    benchmark::DoNotOptimize(diff);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(target.size()));
+}
+
+void BM_ParseManifest(benchmark::State& state) {
+  const std::string json = SerializeManifest(
+      SyntheticManifest(static_cast<size_t>(state.range(0)), 1));
+  Manifest manifest;
+  std::string error;
+  for (auto _ : state) {
+    if (!ParseManifest(json.data(), json.size(), &manifest, &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(json.size()));
+}
+
+void BM_SerializeManifest(benchmark::State& state) {
+  const Manifest manifest =
+      SyntheticManifest(static_cast<size_t>(state.range(0)), 1);
+  for (auto _ : state) {
+    std::string json = SerializeManifest(manifest);
+    benchmark::DoNotOptimize(json);
+  }
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(manifest.size()));
+}
+
+// --- Copy strategies for staging and applying ---
+
+enum CopyStrategy { kStdio, kCopyFile, kCopyFileRange, kRename };
+
+bool CopyWithStdio(const std::string& from, const std::string& to) {
+  FILE* in = OpenFile(from, "rb");
+  FILE* out = OpenFile(to, "wb");
+  bool ok = in != nullptr && out != nullptr;
+  std::vector<char> buffer(64 * 1024);
+  size_t size;
+  while (ok && (size = fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+    ok = fwrite(buffer.data(), 1, size, out) == size;
+  }
+  if (in != nullptr) {
+    fclose(in);
+  }
+  if (out != nullptr) {
+    ok = fclose(out) == 0 && ok;
+  }
+  return ok;
+}
+
+bool CopyWithCopyFileRange(const std::string& from, const std::string& to) {
+  const int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  const int out =
+      open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  bool ok = in >= 0 && out >= 0;
+  while (ok) {
+    const ssize_t copied =
+        copy_file_range(in, nullptr, out, nullptr, 1 << 30, 0);
+    if (copied <= 0) {
+      ok = copied == 0;
+      break;
+    }
+  }
+  if (in >= 0) {
+    close(in);
+  }
+  if (out >= 0) {
+    close(out);
+  }
+  return ok;
+}
+
+void BM_Copy(benchmark::State& state) {
+  const CopyStrategy strategy = static_cast<CopyStrategy>(state.range(0));
+  const size_t size = static_cast<size_t>(state.range(1));
+  const std::string from = BenchFile("copy_from", size);
+  const std::string to = from + ".to";
+  for (auto _ : state) {
+    bool ok = false;
+    std::error_code ec;
+    switch (strategy) {
+      case kStdio:
+        ok = CopyWithStdio(from, to);
+        break;
+      case kCopyFile:
+        ok = fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+        break;
+      case kCopyFileRange:
+        ok = CopyWithCopyFileRange(from, to);
+        break;
+      case kRename:
+        // What the native applier does: only metadata moves.
+        fs::rename(from, to, ec);
+        ok = !ec;
+        fs::rename(to, from, ec);
+        break;
+    }
+    if (!ok) {
+      state.SkipWithError("copy failed");
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(size));
+  std::error_code ec;
+  fs::remove(from, ec);
+  fs::remove(to, ec);
+}
+
+// --- Fetch, verify and stage over loopback HTTP ---
+
+void BM_FetchVerifyStage(benchmark::State& state) {
+  const std::string root =
+      CachedSyntheticBundle(static_cast<size_t>(state.range(0)));
+  Manifest files;
+  std::string error;
+  if (!HashTree(root, ScanOptions(), 0, &files, &error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  std::vector<DownloadItem> items;
+  uint64_t bytes = 0;
+  for (const FileEntry& entry : files) {
+    items.push_back({entry.path, entry.length, entry.object, {}});
+    bytes += entry.length;
+  }
+
+  test::LoopbackServerOptions options;
+  options.latency_ms = static_cast<int>(state.range(1));
+  test::LoopbackServer server(root, options);
+  if (!server.Start(&error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  const std::string staging =
+      (fs::temp_directory_path() / "desktop_updater_bench_staging").string();
+  CurlFetcher fetcher;
+  ProgressTracker tracker;
+  DownloadEngine engine(&fetcher, &tracker);
+  for (auto _ : state) {
+    std::error_code ec;
+    fs::remove_all(staging, ec);
+    if (!engine.Run(server.url(), items, staging, DownloadOptions(), &error) ||
+        !VerifyAndStage(staging, files, 0, &error)) {
+      state.SkipWithError(error.c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<int64_t>(files.size()));
+  std::error_code ec;
+  fs::remove_all(staging, ec);
+}
+
+// --- Windows update script ---
+
+void BM_GenerateBatchScript(benchmark::State& state) {
+  const Manifest installed =
+      SyntheticManifest(static_cast<size_t>(state.range(0)), 1);
+  const ManifestDiff diff = DiffManifests(installed, ChangedManifest(installed));
+  std::set<std::string> installed_paths;
+  for (const FileEntry& entry : installed) {
+    installed_paths.insert(entry.path);
+  }
+  BatchPlan plan;
+  for (const FileEntry& entry : diff.changed) {
+    (installed_paths.count(entry.path) != 0 ? plan.changed : plan.added)
+        .push_back(NormalizeRelativePath(entry.path));
+  }
+  for (const FileEntry& entry : diff.removed) {
+    plan.removed.push_back(NormalizeRelativePath(entry.path));
+  }
+  BatchScriptOptions options;
+  options.executable_path = "C:\\Apps\\Example\\example.exe";
+  size_t bytes = 0;
+  for (auto _ : state) {
+    const std::string script = GenerateBatchScript(plan, options);
+    bytes = script.size();
+    benchmark::DoNotOptimize(script.data());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+  state.SetItemsProcessed(
+      state.iterations() *
+      static_cast<int64_t>(plan.changed.size() + plan.added.size() +
+                           plan.removed.size()));
+}
+
+// --- Page cache warmup before a restart ---
+
+// Writes |path| back and drops it from the page cache, like a file the
+// update has just moved into place and that was evicted since.
+bool EvictFromPageCache(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  const bool ok = fdatasync(fd) == 0 &&
+                  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+  close(fd);
+  return ok;
+}
+
+// Faults in every page of |path| through a read-only mapping, in the
+// scattered order in which the engine touches code and data.
+bool TouchMapped(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  const off_t size = lseek(fd, 0, SEEK_END);
+  void* data = size > 0 ? mmap(nullptr, static_cast<size_t>(size), PROT_READ,
+                               MAP_PRIVATE, fd, 0)
+                        : MAP_FAILED;
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t pages = (static_cast<size_t>(size) + page - 1) / page;
+  const volatile uint8_t* bytes = static_cast<const uint8_t*>(data);
+  uint8_t sum = 0;
+  for (size_t i = 0; i < pages; i++) {
+    // 7919 is prime, so this visits every page once.
+    sum += bytes[(i * 7919 % pages) * page];
+  }
+  benchmark::DoNotOptimize(sum);
+  munmap(data, static_cast<size_t>(size));
+  return true;
+}
+
+// Time to the last page of the startup files after they were evicted,
+// without and with WarmFiles() issued |lead_ms| before the first read: the
+// time the old process takes to exit and the new one to reach the engine.
+// "resident" is the share of the files cached when reading starts.
+constexpr size_t kStartupFileSize = 16 << 20;
+
+void BM_StartupRead(benchmark::State& state) {
+  const bool warm = state.range(0) != 0;
+  const int lead_ms = static_cast<int>(state.range(1));
+  const std::string root =
+      (fs::temp_directory_path() / "desktop_updater_bench_startup").string();
+  const std::vector<std::string> paths = StartupPathFiles({});
+  std::vector<std::string> files;
+  uint64_t bytes = 0;
+  for (const std::string& path : paths) {
+    const std::string file = JoinPath(root, path);
+    std::error_code ec;
+    if (fs::file_size(file, ec) != kStartupFileSize) {
+      std::vector<uint8_t> data(kStartupFileSize);
+      FillRandom(data.data(), data.size(), files.size());
+      std::string error;
+      if (!CreateParentDirectories(file, &error) ||
+          !WriteFileBytes(file, data.data(), data.size(), &error)) {
+        state.SkipWithError(error.c_str());
+        return;
+      }
+    }
+    files.push_back(file);
+    bytes += kStartupFileSize;
+  }
+
+  uint64_t resident_total = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (const std::string& file : files) {
+      if (!EvictFromPageCache(file)) {
+        state.SkipWithError("cannot evict startup files");
+        return;
+      }
+    }
+    if (warm) {
+      WarmupStats stats;
+      WarmFiles(root, paths, &stats);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(lead_ms));
+    for (const std::string& file : files) {
+      uint64_t resident = 0;
+      uint64_t length = 0;
+      ResidentBytes(file, &resident, &length);
+      resident_total += resident;
+    }
+    state.ResumeTiming();
+
+    for (const std::string& file : files) {
+      if (!TouchMapped(file)) {
+        state.SkipWithError("cannot map startup files");
+        return;
+      }
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+  state.counters["resident"] =
+      state.iterations() == 0
+          ? 0
+          : static_cast<double>(resident_total) /
+                static_cast<double>(state.iterations() * bytes);
+}
+
+void RegisterBenchmarks() {
+  for (const int64_t size : {4 << 10, 64 << 10, 1 << 20, 16 << 20}) {
+    benchmark::RegisterBenchmark("BM_Blake2b", BM_Blake2b)->Arg(size);
+  }
+  benchmark::RegisterBenchmark("BM_HashFile", BM_HashFile)->Arg(64 << 20);
+
+  const int64_t max_files = MaxBundleFiles();
+  const int64_t cpus = static_cast<int64_t>(
+      std::max(1u, std::thread::hardware_concurrency()));
+  for (const int64_t files : kBundleSizes) {
+    benchmark::RegisterBenchmark("BM_DiffManifests", BM_DiffManifests)
+        ->Arg(files);
+    benchmark::RegisterBenchmark("BM_ParseManifest", BM_ParseManifest)
+        ->Arg(files);
+    benchmark::RegisterBenchmark("BM_SerializeManifest", BM_SerializeManifest)
+        ->Arg(files);
+    benchmark::RegisterBenchmark("BM_GenerateBatchScript",
+                                 BM_GenerateBatchScript)
+        ->Arg(files);
+    if (files > max_files) {
+      continue;
+    }
+    benchmark::RegisterBenchmark("BM_ScanTree", BM_ScanTree)
+        ->Arg(files)
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("BM_HashTree", BM_HashTree)
+        ->Args({files, 1})
+        ->Args({files, cpus})
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+    if (files <= 10000) {
+      // Without and with a typical CDN round trip per request.
+      benchmark::RegisterBenchmark("BM_FetchVerifyStage", BM_FetchVerifyStage)
+          ->Args({files, 0})
+          ->Args({files, 20})
+          ->ArgNames({"files", "latency_ms"})
+          ->Unit(benchmark::kMillisecond)
+          ->UseRealTime();
+    }
+  }
+
+  // Cold and warmed, read right away and after a typical restart gap.
+  benchmark::RegisterBenchmark("BM_StartupRead", BM_StartupRead)
+      ->Args({0, 0})
+      ->Args({1, 0})
+      ->Args({0, 50})
+      ->Args({1, 50})
+      ->ArgNames({"warm", "lead_ms"})
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+
+  for (const int64_t strategy : {kStdio, kCopyFile, kCopyFileRange, kRename}) {
+    benchmark::RegisterBenchmark("BM_Copy", BM_Copy)
+        ->Args({strategy, 1 << 20})
+        ->Args({strategy, 64 << 20})
+        ->ArgNames({"strategy", "bytes"});
+  }
+}
+
+}  // namespace
+
+}  // namespace bench
+}  // namespace desktop_updater
+
+int main(int argc, char** argv) {
+  std::vector<char*> args(argv, argv + argc);
+  bool has_out = false;
+  for (int i = 1; i < argc; i++) {
+    has_out = has_out || strncmp(argv[i], "--benchmark_out=", 16) == 0;
+  }
+  static char out_arg[] = "--benchmark_out=desktop_updater_bench.json";
+  static char format_arg[] = "--benchmark_out_format=json";
+  if (!has_out) {
+    args.push_back(out_arg);
+    args.push_back(format_arg);
+  }
+  int count = static_cast<int>(args.size());
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+    return 1;
+  }
+  desktop_updater::bench::RegisterBenchmarks();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include "synthetic_bundle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <system_error>
+
+#include "file_util.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+namespace bench {
+
+namespace {
+
+// Sizes of a Flutter 3.x release bundle for x64 Linux.
+const SyntheticFile kFixedFiles[] = {
+    {"example", 24 * 1024},
+    {"lib/libflutter_linux_gtk.so", 38 * 1024 * 1024},
+    {"lib/libapp.so", 9 * 1024 * 1024},
+    {"data/icudtl.dat", 798 * 1024},
+    {"data/flutter_assets/AssetManifest.bin", 4 * 1024},
+    {"data/flutter_assets/FontManifest.json", 1024},
+    {"data/flutter_assets/NOTICES.Z", 110 * 1024},
+    {"data/flutter_assets/fonts/MaterialIcons-Regular.otf", 1600 * 1024},
+    {"data/flutter_assets/shaders/ink_sparkle.frag", 8 * 1024},
+};
+constexpr size_t kFilesPerDirectory = 256;
+constexpr uint64_t kMaxAssetSize = 4 * 1024 * 1024;
+
+uint64_t SplitMix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+}  // namespace
+
+void FillRandom(uint8_t* data, size_t size, uint64_t seed) {
+  uint64_t state = seed;
+  size_t offset = 0;
+  while (offset < size) {
+    const uint64_t value = SplitMix64(&state);
+    const size_t count = std::min<size_t>(sizeof(value), size - offset);
+    for (size_t i = 0; i < count; i++) {
+      data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    offset += count;
+  }
+}
+
+std::vector<SyntheticFile> PlanSyntheticBundle(size_t file_count,
+                                               uint64_t seed) {
+  std::vector<SyntheticFile> files;
+  files.reserve(file_count);
+  for (const SyntheticFile& file : kFixedFiles) {
+    if (files.size() == file_count) {
+      return files;
+    }
+    files.push_back(file);
+  }
+
+  std::mt19937_64 random(seed);
+  // One plugin library per ~1000 files, as in larger apps.
+  const size_t plugins = std::max<size_t>(1, file_count / 1000);
+  std::lognormal_distribution<double> plugin_size(std::log(120.0 * 1024), 0.8);
+  for (size_t i = 0; i < plugins && files.size() < file_count; i++) {
+    files.push_back({"lib/libplugin_" + std::to_string(i) + "_plugin.so",
+                     static_cast<uint64_t>(plugin_size(random))});
+  }
+
+  std::lognormal_distribution<double> asset_size(std::log(1500.0), 1.2);
+  static const char* const kExtensions[] = {".png", ".json", ".svg", ".ttf",
+                                            ".webp"};
+  size_t index = 0;
+  while (files.size() < file_count) {
+    const uint64_t length = std::min<uint64_t>(
+        kMaxAssetSize, static_cast<uint64_t>(asset_size(random)));
+    files.push_back({"data/flutter_assets/assets/d" +
+                         std::to_string(index / kFilesPerDirectory) + "/f" +
+                         std::to_string(index) + kExtensions[index % 5],
+                     length});
+    index++;
+  }
+  return files;
+}
+
+bool WriteSyntheticBundle(const std::string& root,
+                          const std::vector<SyntheticFile>& files,
+                          uint64_t seed,
+                          std::string* error) {
+  std::vector<uint8_t> buffer;
+  for (size_t i = 0; i < files.size(); i++) {
+    const std::string path = JoinPath(root, files[i].path);
+    if (!CreateParentDirectories(path, error)) {
+      return false;
+    }
+    buffer.resize(static_cast<size_t>(files[i].length));
+    FillRandom(buffer.data(), buffer.size(), seed * 1000003 + i);
+    if (!WriteFileBytes(path, buffer.data(), buffer.size(), error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string CachedSyntheticBundle(size_t file_count, uint64_t seed) {
+  const fs::path root = fs::temp_directory_path() /
+                        ("desktop_updater_bench_" + std::to_string(file_count) +
+                         "_" + std::to_string(seed));
+  const fs::path marker = root / ".complete";
+  std::error_code ec;
+  if (fs::exists(marker, ec)) {
+    return (root / "bundle").string();
+  }
+  fs::remove_all(root, ec);
+  std::string error;
+  if (!WriteSyntheticBundle((root / "bundle").string(),
+                            PlanSyntheticBundle(file_count, seed), seed,
+                            &error)) {
+    fprintf(stderr, "Failed to generate bundle: %s\n", error.c_str());
+    return std::string();
+  }
+  WriteFileBytes(marker.string(), nullptr, 0, &error);
+  return (root / "bundle").string();
+}
+
+Manifest SyntheticManifest(size_t file_count, uint64_t seed) {
+  Manifest manifest;
+  manifest.reserve(file_count);
+  size_t i = 0;
+  for (const SyntheticFile& file : PlanSyntheticBundle(file_count, seed)) {
+    FileEntry entry;
+    entry.path = file.path;
+    entry.length = file.length;
+    FillRandom(entry.digest.data(), entry.digest.size(), seed + i++);
+    manifest.push_back(std::move(entry));
+  }
+  return manifest;
+}
+
+}  // namespace bench
+}  // namespace desktop_updater
@@ -0,0 +1,51 @@
+#ifndef DESKTOP_UPDATER_BENCH_SYNTHETIC_BUNDLE_H_
+#define DESKTOP_UPDATER_BENCH_SYNTHETIC_BUNDLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+namespace bench {
+
+struct SyntheticFile {
+  std::string path;
+  uint64_t length = 0;
+};
+
+/**
+ * @brief Lays out a bundle shaped like `flutter build linux` output.
+ *
+ * The engine, AOT snapshot and ICU data keep their real sizes, plugins get
+ * a library each, and the remaining files are assets whose sizes follow a
+ * log-normal distribution (median ~1.5 KiB, capped at 4 MiB) spread over
+ * directories of ~256 entries. Deterministic for a given |seed|.
+ */
+std::vector<SyntheticFile> PlanSyntheticBundle(size_t file_count,
+                                               uint64_t seed);
+
+// Writes |files| below |root| with pseudo-random contents.
+bool WriteSyntheticBundle(const std::string& root,
+                          const std::vector<SyntheticFile>& files,
+                          uint64_t seed,
+                          std::string* error);
+
+/**
+ * @brief Returns a generated bundle of |file_count| files in the temp
+ *        directory, writing it on first use and reusing it afterwards.
+ */
+std::string CachedSyntheticBundle(size_t file_count, uint64_t seed = 1);
+
+// A manifest of the same shape with pseudo-random digests, without
+// touching the disk.
+Manifest SyntheticManifest(size_t file_count, uint64_t seed);
+
+// Fills |size| bytes at |data| with pseudo-random contents.
+void FillRandom(uint8_t* data, size_t size, uint64_t seed);
+
+}  // namespace bench
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_BENCH_SYNTHETIC_BUNDLE_H_
@@ -0,0 +1,101 @@
+#include "curl_fetcher.h"
+
+#include <curl/curl.h>
+
+#include <mutex>
+
+namespace desktop_updater {
+
+namespace {
+
+// Owns the easy handle of one thread for the lifetime of that thread.
+struct ThreadHandle {
+  CURL* curl = nullptr;
+  ~ThreadHandle() {
+    if (curl) {
+      curl_easy_cleanup(curl);
+    }
+  }
+};
+
+struct WriteContext {
+  const HttpFetcher::BodyCallback* on_body;
+  long status;
+  CURL* curl;
+  bool aborted;
+};
+
+size_t WriteCallback(char* data, size_t size, size_t count, void* user_data) {
+  auto* context = static_cast<WriteContext*>(user_data);
+  if (context->status == 0) {
+    curl_easy_getinfo(context->curl, CURLINFO_RESPONSE_CODE,
+                      &context->status);
+  }
+  // Do not hand error pages to the caller as file content.
+  if (context->status < 200 || context->status >= 300) {
+    return 0;
+  }
+  const size_t bytes = size * count;
+  if (!(*context->on_body)(reinterpret_cast<const uint8_t*>(data), bytes)) {
+    context->aborted = true;
+    return 0;
+  }
+  return bytes;
+}
+
+}  // namespace
+
+CurlFetcher::CurlFetcher() {
+  static std::once_flag init_once;
+  std::call_once(init_once, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+bool CurlFetcher::Get(const std::string& url,
+                      const BodyCallback& on_body,
+                      std::string* error) {
+  thread_local ThreadHandle handle;
+  if (handle.curl == nullptr) {
+    handle.curl = curl_easy_init();
+    if (handle.curl == nullptr) {
+      *error = "Failed to initialize libcurl";
+      return false;
+    }
+  }
+  CURL* curl = handle.curl;
+  curl_easy_reset(curl);
+
+  WriteContext context{&on_body, 0, curl, false};
+  char error_buffer[CURL_ERROR_SIZE] = {};
+
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 30L);
+  // Abort stalled transfers: less than 1 byte/s for a minute.
+  curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+  curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 60L);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error_buffer);
+
+  const CURLcode code = curl_easy_perform(curl);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &context.status);
+
+  if (context.aborted) {
+    *error = "Transfer aborted: " + url;
+    return false;
+  }
+  if (context.status < 200 || context.status >= 300) {
+    *error = "HTTP " + std::to_string(context.status) + " for " + url;
+    return false;
+  }
+  if (code != CURLE_OK) {
+    *error = std::string(error_buffer[0] ? error_buffer
+                                         : curl_easy_strerror(code)) +
+             ": " + url;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace desktop_updater
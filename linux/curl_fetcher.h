@@ -0,0 +1,25 @@
+#ifndef DESKTOP_UPDATER_CURL_FETCHER_H_
+#define DESKTOP_UPDATER_CURL_FETCHER_H_
+
+#include "http_fetcher.h"
+
+namespace desktop_updater {
+
+/**
+ * @brief HttpFetcher backed by libcurl.
+ *
+ * Each calling thread keeps its own easy handle so consecutive requests from
+ * a download worker reuse the same connection.
+ */
+class CurlFetcher : public HttpFetcher {
+ public:
+  CurlFetcher();
+
+  bool Get(const std::string& url,
+           const BodyCallback& on_body,
+           std::string* error) override;
+};
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_CURL_FETCHER_H_
@@ -5,16 +5,139 @@
 #include <sys/utsname.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include <libgen.h>
+#include <algorithm>
+#include <cerrno>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <linux/limits.h>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "curl_fetcher.h"
+#include "disk_space.h"
+#include "download_engine.h"
+#include "file_util.h"
+#include "handoff.h"
+#include "json.h"
+#include "metrics.h"
+#include "progress_tracker.h"
+#include "relaunch.h"
+#include "startup_warmup.h"
+#include "trace.h"
+#include "update_applier.h"
+#include "update_check.h"
+#include "version_info.h"
 
 // Forward declarations
 FlMethodResponse *get_platform_version();
 
+// Returns the directory containing the running executable, or an empty
+// string if it cannot be resolved.
+static std::string get_executable_dir()
+{
+  char executable_path[PATH_MAX];
+  ssize_t len = readlink("/proc/self/exe", executable_path, sizeof(executable_path) - 1);
+  if (len == -1)
+  {
+    return std::string();
+  }
+  executable_path[len] = '\0';
+  return std::string(dirname(executable_path));
+}
+
+// Returns the path of the running executable as it was when the process
+// started, before an update may have replaced it.
+static std::string get_executable_path()
+{
+  char executable_path[PATH_MAX];
+  ssize_t len = readlink("/proc/self/exe", executable_path, sizeof(executable_path) - 1);
+  if (len == -1)
+  {
+    return std::string();
+  }
+  executable_path[len] = '\0';
+  return std::string(executable_path);
+}
+
+// Replaces the process with a fresh start of |executable_path|, keeping the
+// original arguments. Only returns on failure.
+static void exec_self(const std::string &executable_path)
+{
+  // exec() skips exit handlers, so write the trace now.
+  desktop_updater::FlushTraceToEnvironmentPath();
+  std::string error;
+  if (!desktop_updater::ExecSelf(executable_path, &error))
+  {
+    g_warning("Failed to restart: %s", error.c_str());
+  }
+}
+
+// Returns true if |replaced| holds files the running process has already
+// mapped: the executable itself and the libraries it links. lib/libapp.so
+// is only loaded once the engine starts.
+static bool replaced_loaded_files(const std::string &executable_path,
+                                  const std::vector<std::string> &replaced)
+{
+  char *temp_path = strdup(executable_path.c_str());
+  const std::string base_name = basename(temp_path);
+  free(temp_path);
+  for (const std::string &path : replaced)
+  {
+    if (path == base_name)
+    {
+      return true;
+    }
+    if (path.compare(0, 4, "lib/") == 0 && path != "lib/libapp.so")
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Applies a verified staged update next to |executable_path| and warms the
+// page cache for the new startup files. Returns true if one was applied.
+static bool apply_pending_update(const std::string &executable_path,
+                                 std::vector<std::string> *replaced)
+{
+  char *temp_path = strdup(executable_path.c_str());
+  const std::string app_dir = dirname(temp_path);
+  free(temp_path);
+
+  std::string error;
+  switch (desktop_updater::ApplyPendingUpdate(app_dir, executable_path,
+                                              replaced, &error))
+  {
+  case desktop_updater::ApplyResult::kNothingPending:
+    return false;
+  case desktop_updater::ApplyResult::kFailed:
+    g_warning("Failed to apply the pending update: %s", error.c_str());
+    return false;
+  case desktop_updater::ApplyResult::kApplied:
+    break;
+  }
+  g_message("Applied pending update (%zu files).", replaced->size());
+
+  // The new libapp.so, engine and ICU data were written through the staging
+  // folder; have the kernel read them in while the process restarts.
+  desktop_updater::WarmupStats warmup;
+  if (desktop_updater::WarmFiles(
+          app_dir, desktop_updater::StartupPathFiles(*replaced), &warmup))
+  {
+    g_message("Warming %zu startup files: %llu of %llu bytes were cached.",
+              warmup.files,
+              static_cast<unsigned long long>(warmup.resident_before),
+              static_cast<unsigned long long>(warmup.bytes));
+  }
+  return true;
+}
+
 // Function to copy file from source to destination
 bool copy_file(const char *source, const char *destination)
 {
@@ -103,13 +226,806 @@ FlMethodResponse *get_platform_version()
   (G_TYPE_CHECK_INSTANCE_CAST((obj), desktop_updater_plugin_get_type(), \
                               DesktopUpdaterPlugin))
 
+// State of an in-flight downloadUpdate call. Owned by the plugin and only
+// touched from the main thread, except for the members the worker thread
+// uses while it runs.
+struct DownloadSession
+{
+  desktop_updater::CurlFetcher fetcher;
+  desktop_updater::ProgressTracker tracker;
+  std::unique_ptr<desktop_updater::DownloadEngine> engine;
+  std::vector<desktop_updater::DownloadItem> items;
+  std::string base_url;
+  std::string staging_dir;
+  std::string base_dir;
+  // Expected contents of the downloaded files, verified before the update
+  // is marked as ready to apply. Empty if the caller sent no hashes.
+  desktop_updater::Manifest staged;
+  double progress_hz = desktop_updater::ProgressEmitter::kDefaultHz;
+  unsigned workers = 0;
+  FlMethodCall *method_call = nullptr;
+  std::thread thread;
+};
+
+// Plan of the last successful checkAndPrepare, used by the following
+// downloadUpdate of the same release.
+struct PreparedPlan
+{
+  std::string release_url;
+  std::unordered_map<std::string, desktop_updater::FilePlan> files;
+};
+
+// Build metadata of the running app, read once at registration.
+struct CachedVersion
+{
+  bool ok = false;
+  desktop_updater::VersionInfo info;
+  std::string error;
+};
+
+// Set when this process was started by a handoff restart of the previous
+// version, which waits for our first frame on |socket_path|.
+struct HandoffState
+{
+  std::string socket_path;
+  int64_t start_us = 0;
+  // From the old process starting this one to the first frame, or -1 until
+  // it is rendered.
+  int64_t duration_us = -1;
+};
+
 struct _DesktopUpdaterPlugin
 {
   GObject parent_instance;
+
+  CachedVersion *version;
+  HandoffState *handoff;
+  gboolean handing_off;
+
+  FlEventChannel *progress_channel;
+  gboolean progress_listening;
+  DownloadSession *download;
+  PreparedPlan *plan;
 };
 
 G_DEFINE_TYPE(DesktopUpdaterPlugin, desktop_updater_plugin, g_object_get_type())
 
+// Progress snapshot queued from the emitter thread to the main loop.
+struct ProgressEvent
+{
+  DesktopUpdaterPlugin *plugin;
+  desktop_updater::ProgressSnapshot snapshot;
+  std::string current_file;
+};
+
+static void progress_event_free(gpointer data)
+{
+  ProgressEvent *event = static_cast<ProgressEvent *>(data);
+  g_object_unref(event->plugin);
+  delete event;
+}
+
+static gboolean progress_event_send_cb(gpointer data)
+{
+  ProgressEvent *event = static_cast<ProgressEvent *>(data);
+  DesktopUpdaterPlugin *self = event->plugin;
+  if (!self->progress_listening || self->progress_channel == nullptr)
+  {
+    return G_SOURCE_REMOVE;
+  }
+
+  const desktop_updater::ProgressSnapshot &snapshot = event->snapshot;
+  g_autoptr(FlValue) value = fl_value_new_map();
+  fl_value_set_string_take(value, "receivedBytes",
+                           fl_value_new_int(static_cast<int64_t>(snapshot.received_bytes)));
+  fl_value_set_string_take(value, "totalBytes",
+                           fl_value_new_int(static_cast<int64_t>(snapshot.total_bytes)));
+  fl_value_set_string_take(value, "completedFiles",
+                           fl_value_new_int(snapshot.completed_files));
+  fl_value_set_string_take(value, "totalFiles",
+                           fl_value_new_int(snapshot.total_files));
+  fl_value_set_string_take(value, "currentFile",
+                           fl_value_new_string(event->current_file.c_str()));
+  fl_value_set_string_take(value, "bytesPerSecond",
+                           fl_value_new_float(snapshot.bytes_per_second));
+  fl_value_set_string_take(value, "etaSeconds",
+                           fl_value_new_float(snapshot.eta_seconds));
+  fl_value_set_string_take(value, "done", fl_value_new_bool(snapshot.done));
+
+  g_autoptr(GError) error = nullptr;
+  if (!fl_event_channel_send(self->progress_channel, value, nullptr, &error))
+  {
+    g_warning("Failed to send progress event: %s", error->message);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// Result of a finished download, queued from the worker to the main loop.
+struct DownloadResult
+{
+  DesktopUpdaterPlugin *plugin;
+  bool ok;
+  std::string error;
+};
+
+static gboolean download_finished_cb(gpointer data)
+{
+  DownloadResult *result = static_cast<DownloadResult *>(data);
+  DesktopUpdaterPlugin *self = result->plugin;
+  DownloadSession *session = self->download;
+
+  session->thread.join();
+  self->download = nullptr;
+
+  if (result->ok)
+  {
+    fl_method_call_respond_success(session->method_call, nullptr, nullptr);
+  }
+  else
+  {
+    fl_method_call_respond_error(session->method_call, "DownloadError",
+                                 result->error.c_str(), nullptr, nullptr);
+  }
+  g_object_unref(session->method_call);
+  delete session;
+
+  g_object_unref(self);
+  delete result;
+  return G_SOURCE_REMOVE;
+}
+
+static void download_thread(DesktopUpdaterPlugin *self, DownloadSession *session)
+{
+  desktop_updater::ProgressEmitter emitter(
+      &session->tracker, session->progress_hz,
+      [self, session](const desktop_updater::ProgressSnapshot &snapshot)
+      {
+        ProgressEvent *event = new ProgressEvent();
+        event->plugin = DESKTOP_UPDATER_PLUGIN(g_object_ref(self));
+        event->snapshot = snapshot;
+        if (snapshot.current_item >= 0 &&
+            static_cast<size_t>(snapshot.current_item) < session->items.size())
+        {
+          event->current_file = session->items[snapshot.current_item].path;
+        }
+        g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT,
+                                   progress_event_send_cb, event,
+                                   progress_event_free);
+      });
+  emitter.Start();
+
+  desktop_updater::DownloadOptions options;
+  options.workers = session->workers;
+  options.base_dir = session->base_dir;
+  DownloadResult *result = new DownloadResult();
+  result->plugin = self;
+  result->ok = session->engine->Run(session->base_url, session->items,
+                                    session->staging_dir, options,
+                                    &result->error);
+  if (result->ok && !session->staged.empty())
+  {
+    result->ok = desktop_updater::VerifyAndStage(
+        session->staging_dir, session->staged, session->workers,
+        &result->error);
+  }
+  // Queues the final snapshot ahead of the method response.
+  emitter.Stop();
+
+  g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT,
+                             download_finished_cb, result, nullptr);
+}
+
+// Starts downloading the files listed in the call arguments into the
+// "update" folder next to the executable. Returns an error response on
+// invalid arguments, or nullptr when the response is deferred until the
+// download finishes.
+static FlMethodResponse *start_download(DesktopUpdaterPlugin *self,
+                                        FlMethodCall *method_call)
+{
+  if (self->download != nullptr)
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "DownloadError", "A download is already in progress.", nullptr));
+  }
+
+  FlValue *args = fl_method_call_get_args(method_call);
+  FlValue *folder = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                        ? fl_value_lookup_string(args, "remoteUpdateFolder")
+                        : nullptr;
+  FlValue *files = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                       ? fl_value_lookup_string(args, "files")
+                       : nullptr;
+  if (folder == nullptr || fl_value_get_type(folder) != FL_VALUE_TYPE_STRING ||
+      files == nullptr || fl_value_get_type(files) != FL_VALUE_TYPE_LIST)
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "InvalidArguments", "Expected remoteUpdateFolder and files.", nullptr));
+  }
+
+  const std::string app_dir = get_executable_dir();
+  if (app_dir.empty())
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "DownloadError", "Unable to resolve the executable directory.", nullptr));
+  }
+
+  DownloadSession *session = new DownloadSession();
+  session->base_url = fl_value_get_string(folder);
+  session->staging_dir = app_dir + "/update";
+  session->base_dir = app_dir;
+  const PreparedPlan *plan =
+      self->plan != nullptr && self->plan->release_url == session->base_url
+          ? self->plan
+          : nullptr;
+  // Final files of the update, for the space check and verification.
+  desktop_updater::Manifest targets;
+  bool all_hashed = true;
+
+  for (size_t i = 0; i < fl_value_get_length(files); i++)
+  {
+    FlValue *file = fl_value_get_list_value(files, i);
+    if (fl_value_get_type(file) != FL_VALUE_TYPE_MAP)
+    {
+      continue;
+    }
+    FlValue *path = fl_value_lookup_string(file, "path");
+    FlValue *length = fl_value_lookup_string(file, "length");
+    FlValue *hash = fl_value_lookup_string(file, "calculatedHash");
+    FlValue *object = fl_value_lookup_string(file, "object");
+    if (path == nullptr || fl_value_get_type(path) != FL_VALUE_TYPE_STRING)
+    {
+      continue;
+    }
+    desktop_updater::DownloadItem item;
+    item.path = fl_value_get_string(path);
+    if (length != nullptr && fl_value_get_type(length) == FL_VALUE_TYPE_INT)
+    {
+      item.length = static_cast<uint64_t>(fl_value_get_int(length));
+    }
+    if (object != nullptr && fl_value_get_type(object) == FL_VALUE_TYPE_STRING)
+    {
+      item.object = fl_value_get_string(object);
+    }
+    desktop_updater::FileEntry entry;
+    entry.path = item.path;
+    entry.length = item.length;
+    std::vector<uint8_t> digest;
+    if (hash != nullptr && fl_value_get_type(hash) == FL_VALUE_TYPE_STRING &&
+        desktop_updater::Base64Decode(fl_value_get_string(hash), &digest) &&
+        digest.size() == entry.digest.size())
+    {
+      std::copy(digest.begin(), digest.end(), entry.digest.begin());
+    }
+    else
+    {
+      all_hashed = false;
+    }
+    targets.push_back(entry);
+    if (plan != nullptr)
+    {
+      auto planned = plan->files.find(
+          desktop_updater::NormalizeRelativePath(item.path));
+      if (planned != plan->files.end())
+      {
+        item.length = planned->second.bytes;
+        item.steps = planned->second.steps;
+      }
+    }
+    session->items.push_back(item);
+  }
+  // Without every hash the update cannot be verified, so it is left to the
+  // update script on restart.
+  if (all_hashed)
+  {
+    session->staged = targets;
+  }
+
+  // Refuse to start rather than fill the disk halfway through.
+  desktop_updater::SpaceEstimate space;
+  std::string space_error;
+  if (!desktop_updater::CheckUpdateSpace(app_dir, targets, &space, &space_error))
+  {
+    delete session;
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "InsufficientDiskSpace", space_error.c_str(), nullptr));
+  }
+
+  FlValue *hz = fl_value_lookup_string(args, "progressHz");
+  if (hz != nullptr && fl_value_get_type(hz) == FL_VALUE_TYPE_FLOAT)
+  {
+    session->progress_hz = fl_value_get_float(hz);
+  }
+  FlValue *workers = fl_value_lookup_string(args, "workers");
+  if (workers != nullptr && fl_value_get_type(workers) == FL_VALUE_TYPE_INT)
+  {
+    session->workers = static_cast<unsigned>(fl_value_get_int(workers));
+  }
+
+  session->engine = std::make_unique<desktop_updater::DownloadEngine>(
+      &session->fetcher, &session->tracker);
+  session->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+  self->download = session;
+
+  g_object_ref(self);
+  session->thread = std::thread(download_thread, self, session);
+  return nullptr;
+}
+
+// State of a checkAndPrepare call, handed from the main thread to a worker
+// thread and back.
+struct CheckTask
+{
+  DesktopUpdaterPlugin *plugin;
+  FlMethodCall *method_call;
+  desktop_updater::UpdateCheckRequest request;
+  desktop_updater::UpdateCheckResult result;
+  bool ok = false;
+  std::string error;
+};
+
+static FlValue *file_entries_to_fl_value(
+    const desktop_updater::Manifest &entries)
+{
+  FlValue *list = fl_value_new_list();
+  for (const desktop_updater::FileEntry &entry : entries)
+  {
+    FlValue *file = fl_value_new_map();
+    fl_value_set_string_take(file, "path", fl_value_new_string(entry.path.c_str()));
+    fl_value_set_string_take(
+        file, "calculatedHash",
+        fl_value_new_string(desktop_updater::Base64Encode(
+                                entry.digest.data(), entry.digest.size())
+                                .c_str()));
+    fl_value_set_string_take(file, "length",
+                             fl_value_new_int(static_cast<int64_t>(entry.length)));
+    if (!entry.object.empty())
+    {
+      fl_value_set_string_take(file, "object",
+                               fl_value_new_string(entry.object.c_str()));
+    }
+    fl_value_append_take(list, file);
+  }
+  return list;
+}
+
+static gboolean check_finished_cb(gpointer data)
+{
+  CheckTask *task = static_cast<CheckTask *>(data);
+  if (!task->ok)
+  {
+    fl_method_call_respond_error(task->method_call, "UpdateCheckError",
+                                 task->error.c_str(), nullptr, nullptr);
+  }
+  else if (!task->result.update_available)
+  {
+    fl_method_call_respond_success(task->method_call, nullptr, nullptr);
+  }
+  else
+  {
+    const desktop_updater::UpdateCheckResult &result = task->result;
+    desktop_updater::JsonWriter item;
+    item.Value(result.latest.json);
+
+    g_autoptr(FlValue) value = fl_value_new_map();
+    fl_value_set_string_take(value, "appName",
+                             fl_value_new_string(result.app_name.c_str()));
+    fl_value_set_string_take(value, "item", fl_value_new_string(item.str().c_str()));
+    fl_value_set_string_take(value, "changedFiles",
+                             file_entries_to_fl_value(result.diff.changed));
+    fl_value_set_string_take(value, "removedFiles",
+                             file_entries_to_fl_value(result.diff.removed));
+    fl_value_set_string_take(value, "totalBytes",
+                             fl_value_new_int(static_cast<int64_t>(result.total_bytes)));
+    fl_value_set_string_take(
+        value, "expectedBytes",
+        fl_value_new_int(static_cast<int64_t>(result.plan.expected_bytes)));
+
+    PreparedPlan *plan = new PreparedPlan();
+    plan->release_url = result.latest.url;
+    for (const desktop_updater::FilePlan &file : result.plan.files)
+    {
+      plan->files.emplace(desktop_updater::NormalizeRelativePath(file.path), file);
+    }
+    delete task->plugin->plan;
+    task->plugin->plan = plan;
+
+    fl_method_call_respond_success(task->method_call, value, nullptr);
+  }
+
+  g_object_unref(task->method_call);
+  g_object_unref(task->plugin);
+  delete task;
+  return G_SOURCE_REMOVE;
+}
+
+static void check_thread(CheckTask *task)
+{
+  desktop_updater::CurlFetcher fetcher;
+  task->ok = desktop_updater::CheckForUpdate(&fetcher, task->request,
+                                             &task->result, &task->error);
+  g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT, check_finished_cb,
+                             task, nullptr);
+}
+
+// Runs the whole update check (app archive, hashes.json, local hashes and
+// diff) on a worker thread. Returns an error response on invalid arguments,
+// or nullptr when the response is deferred until the check finishes.
+static FlMethodResponse *start_check(DesktopUpdaterPlugin *self,
+                                     FlMethodCall *method_call)
+{
+  FlValue *args = fl_method_call_get_args(method_call);
+  FlValue *url = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                     ? fl_value_lookup_string(args, "appArchiveUrl")
+                     : nullptr;
+  if (url == nullptr || fl_value_get_type(url) != FL_VALUE_TYPE_STRING)
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "InvalidArguments", "Expected appArchiveUrl.", nullptr));
+  }
+
+  const std::string app_dir = get_executable_dir();
+  const int64_t build_number =
+      self->version->ok ? desktop_updater::BuildNumberOf(self->version->info) : -1;
+  if (app_dir.empty() || build_number < 0)
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "UpdateCheckError", "Unable to read the current version.", nullptr));
+  }
+
+  CheckTask *task = new CheckTask();
+  task->plugin = DESKTOP_UPDATER_PLUGIN(g_object_ref(self));
+  task->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+  task->request.app_archive_url = fl_value_get_string(url);
+  task->request.platform = "linux";
+  task->request.current_version = build_number;
+  task->request.install_dir = app_dir;
+  // Files staged by a previous download are not part of the install.
+  task->request.scan.exclude.push_back("update");
+
+  std::thread(check_thread, task).detach();
+  return nullptr;
+}
+
+static FlMethodResponse *get_current_version(DesktopUpdaterPlugin *self)
+{
+  if (!self->version->ok)
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "VersionError", self->version->error.c_str(), nullptr));
+  }
+  g_autoptr(FlValue) result =
+      fl_value_new_string(self->version->info.build_number.c_str());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+static FlMethodResponse *get_version_info(DesktopUpdaterPlugin *self)
+{
+  if (!self->version->ok)
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "VersionError", self->version->error.c_str(), nullptr));
+  }
+  const desktop_updater::VersionInfo &info = self->version->info;
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "version", fl_value_new_string(info.version.c_str()));
+  fl_value_set_string_take(result, "major", fl_value_new_int(info.major));
+  fl_value_set_string_take(result, "minor", fl_value_new_int(info.minor));
+  fl_value_set_string_take(result, "patch", fl_value_new_int(info.patch));
+  fl_value_set_string_take(result, "preRelease",
+                           fl_value_new_string(info.pre_release.c_str()));
+  fl_value_set_string_take(result, "buildNumber",
+                           fl_value_new_string(info.build_number.c_str()));
+  fl_value_set_string_take(result, "appName",
+                           fl_value_new_string(info.app_name.c_str()));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// A handoff restart in progress: the updated app runs next to this one,
+// which exits once the new app has rendered its first frame.
+struct HandoffTask
+{
+  DesktopUpdaterPlugin *plugin;
+  FlMethodCall *method_call;
+  desktop_updater::HandoffListener listener;
+  std::string executable_path;
+  pid_t pid = -1;
+  int64_t start_us = 0;
+  bool ok = false;
+  std::string message;
+  std::string error;
+  std::thread thread;
+};
+
+// Includes a cold start of the engine and the first frame of the app.
+constexpr int kHandoffTimeoutMs = 30000;
+
+static gboolean handoff_finished_cb(gpointer data)
+{
+  HandoffTask *task = static_cast<HandoffTask *>(data);
+  task->thread.join();
+
+  if (task->ok)
+  {
+    const double handoff_ms =
+        (desktop_updater::MonotonicMicros() - task->start_us) / 1000.0;
+    const double first_frame_ms =
+        g_ascii_strtoll(task->message.c_str(), nullptr, 10) / 1000.0;
+    g_message("Handed over to pid %d after %.1f ms (first frame after %.1f ms).",
+              static_cast<int>(task->pid), handoff_ms, first_frame_ms);
+    // exit() skips destructors; the listener removes its socket file.
+    delete task;
+    exit(0);
+  }
+
+  g_warning("Handoff failed: %s", task->error.c_str());
+  if (task->pid > 0 && waitpid(task->pid, nullptr, WNOHANG) == 0)
+  {
+    kill(task->pid, SIGKILL);
+    waitpid(task->pid, nullptr, 0);
+  }
+  // The update is already in place, so restart the usual way.
+  exec_self(task->executable_path);
+
+  task->plugin->handing_off = FALSE;
+  fl_method_call_respond_error(task->method_call, "RestartError",
+                               task->error.c_str(), nullptr, nullptr);
+  g_object_unref(task->method_call);
+  g_object_unref(task->plugin);
+  delete task;
+  return G_SOURCE_REMOVE;
+}
+
+static void handoff_thread(HandoffTask *task)
+{
+  desktop_updater::TraceSpan span("handoff_wait");
+  const int64_t deadline = task->start_us + int64_t{kHandoffTimeoutMs} * 1000;
+  while (desktop_updater::MonotonicMicros() < deadline)
+  {
+    // Short slices so a crashing new app is noticed quickly.
+    if (task->listener.WaitForReady(100, &task->message, &task->error))
+    {
+      task->ok = true;
+      break;
+    }
+    if (!task->error.empty())
+    {
+      break;
+    }
+    if (waitpid(task->pid, nullptr, WNOHANG) == task->pid)
+    {
+      task->pid = -1;
+      task->error = "The updated app exited before its first frame.";
+      break;
+    }
+  }
+  if (!task->ok && task->error.empty())
+  {
+    task->error = "Timed out waiting for the updated app.";
+  }
+  g_main_context_invoke_full(nullptr, G_PRIORITY_DEFAULT,
+                             handoff_finished_cb, task, nullptr);
+}
+
+// Starts |executable_path| with the handoff socket in its environment and
+// waits for its first frame on a worker thread. Returns false if it could
+// not be started.
+static bool start_handoff(DesktopUpdaterPlugin *self,
+                          FlMethodCall *method_call,
+                          const std::string &executable_path)
+{
+  HandoffTask *task = new HandoffTask();
+  std::string error;
+  if (!task->listener.Listen(desktop_updater::HandoffSocketPath(getpid()),
+                             &error))
+  {
+    g_warning("Handoff unavailable: %s", error.c_str());
+    delete task;
+    return false;
+  }
+  task->start_us = desktop_updater::MonotonicMicros();
+
+  const std::vector<std::string> env = {
+      std::string(desktop_updater::kHandoffSocketEnv) + "=" +
+          task->listener.path(),
+      std::string(desktop_updater::kHandoffStartEnv) + "=" +
+          std::to_string(task->start_us),
+  };
+  int pid = -1;
+  if (!desktop_updater::SpawnSelf(executable_path, env,
+                                  desktop_updater::kHandoffSocketEnv, &pid,
+                                  &error))
+  {
+    g_warning("Handoff unavailable: %s", error.c_str());
+    delete task;
+    return false;
+  }
+  task->pid = static_cast<pid_t>(pid);
+
+  task->plugin = DESKTOP_UPDATER_PLUGIN(g_object_ref(self));
+  task->method_call = FL_METHOD_CALL(g_object_ref(method_call));
+  task->executable_path = executable_path;
+  self->handing_off = TRUE;
+  task->thread = std::thread(handoff_thread, task);
+  return true;
+}
+
+// Tells the previous version that started this process that our first
+// frame is on screen.
+static void signal_handoff_ready(DesktopUpdaterPlugin *self)
+{
+  HandoffState *handoff = self->handoff;
+  if (handoff == nullptr || handoff->duration_us >= 0)
+  {
+    return;
+  }
+  handoff->duration_us = desktop_updater::MonotonicMicros() - handoff->start_us;
+  std::string error;
+  if (!desktop_updater::SignalHandoffReady(
+          handoff->socket_path, std::to_string(handoff->duration_us), &error))
+  {
+    g_warning("Failed to signal the previous instance: %s", error.c_str());
+  }
+}
+
+static void first_frame_cb(FlView *view, gpointer user_data)
+{
+  signal_handoff_ready(DESKTOP_UPDATER_PLUGIN(user_data));
+}
+
+static FlMethodResponse *get_handoff_duration(DesktopUpdaterPlugin *self)
+{
+  if (self->handoff == nullptr || self->handoff->duration_us < 0)
+  {
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_int(self->handoff->duration_us);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Counters and per-phase latency percentiles since the process started.
+static FlMethodResponse *get_update_metrics()
+{
+  const desktop_updater::MetricsSnapshot snapshot =
+      desktop_updater::SnapshotMetrics();
+  FlValue *counters = fl_value_new_map();
+  for (size_t i = 0; i < desktop_updater::kCounterCount; i++)
+  {
+    fl_value_set_string_take(
+        counters,
+        desktop_updater::CounterName(static_cast<desktop_updater::Counter>(i)),
+        fl_value_new_int(static_cast<int64_t>(snapshot.counters[i])));
+  }
+  FlValue *phases = fl_value_new_map();
+  for (size_t i = 0; i < desktop_updater::kPhaseCount; i++)
+  {
+    const desktop_updater::PhaseSummary &summary = snapshot.phases[i];
+    FlValue *phase = fl_value_new_map();
+    fl_value_set_string_take(phase, "count",
+                             fl_value_new_int(static_cast<int64_t>(summary.count)));
+    fl_value_set_string_take(phase, "totalMicros",
+                             fl_value_new_int(static_cast<int64_t>(summary.total_us)));
+    fl_value_set_string_take(phase, "maxMicros",
+                             fl_value_new_int(static_cast<int64_t>(summary.max_us)));
+    fl_value_set_string_take(phase, "p50Micros",
+                             fl_value_new_int(static_cast<int64_t>(summary.p50_us)));
+    fl_value_set_string_take(phase, "p90Micros",
+                             fl_value_new_int(static_cast<int64_t>(summary.p90_us)));
+    fl_value_set_string_take(phase, "p99Micros",
+                             fl_value_new_int(static_cast<int64_t>(summary.p99_us)));
+    fl_value_set_string_take(
+        phase, "allocatedBytes",
+        fl_value_new_int(static_cast<int64_t>(summary.allocated_bytes)));
+    fl_value_set_string_take(
+        phase, "peakAllocatedBytes",
+        fl_value_new_int(static_cast<int64_t>(summary.peak_allocated_bytes)));
+    fl_value_set_string_take(
+        phase, "maxRssBytes",
+        fl_value_new_int(static_cast<int64_t>(summary.max_rss_bytes)));
+    fl_value_set_string_take(
+        phase, "maxPssBytes",
+        fl_value_new_int(static_cast<int64_t>(summary.max_pss_bytes)));
+    for (size_t j = 0; j < desktop_updater::kPerfEventCount; j++)
+    {
+      if ((snapshot.perf_events & (1u << j)) != 0)
+      {
+        fl_value_set_string_take(
+            phase,
+            desktop_updater::PerfEventName(
+                static_cast<desktop_updater::PerfEvent>(j)),
+            fl_value_new_int(static_cast<int64_t>(summary.perf[j])));
+      }
+    }
+    fl_value_set_string_take(
+        phases,
+        desktop_updater::PhaseName(static_cast<desktop_updater::Phase>(i)),
+        phase);
+  }
+  g_autoptr(FlValue) result = fl_value_new_map();
+  fl_value_set_string_take(result, "counters", counters);
+  fl_value_set_string_take(result, "phases", phases);
+  fl_value_set_string_take(
+      result, "liveAllocatedBytes",
+      fl_value_new_int(static_cast<int64_t>(snapshot.live_allocated_bytes)));
+  fl_value_set_string_take(
+      result, "peakAllocatedBytes",
+      fl_value_new_int(static_cast<int64_t>(snapshot.peak_allocated_bytes)));
+  fl_value_set_string_take(result, "perfEnabled",
+                           fl_value_new_bool(snapshot.perf_enabled));
+  if (!snapshot.perf_error.empty())
+  {
+    fl_value_set_string_take(result, "perfError",
+                             fl_value_new_string(snapshot.perf_error.c_str()));
+  }
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Turns per-phase performance counters on or off. Returns whether counting
+// is on; when the kernel refuses every counter the reason is reported as
+// "perfError" by getUpdateMetrics.
+static FlMethodResponse *set_perf_counters_enabled(FlMethodCall *method_call)
+{
+  FlValue *args = fl_method_call_get_args(method_call);
+  FlValue *enabled = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                         ? fl_value_lookup_string(args, "enabled")
+                         : nullptr;
+  std::string error;
+  const bool on =
+      desktop_updater::SetPerfCountersEnabled(
+          enabled != nullptr &&
+              fl_value_get_type(enabled) == FL_VALUE_TYPE_BOOL &&
+              fl_value_get_bool(enabled),
+          &error) &&
+      desktop_updater::PerfCountersEnabled();
+  if (!error.empty())
+  {
+    g_warning("Performance counters unavailable: %s", error.c_str());
+  }
+  g_autoptr(FlValue) result = fl_value_new_bool(on);
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
+// Turns span recording on or off. Spans cost next to nothing while off.
+static FlMethodResponse *set_trace_enabled(FlMethodCall *method_call)
+{
+  FlValue *args = fl_method_call_get_args(method_call);
+  FlValue *enabled = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                         ? fl_value_lookup_string(args, "enabled")
+                         : nullptr;
+  desktop_updater::SetTraceEnabled(
+      enabled != nullptr && fl_value_get_type(enabled) == FL_VALUE_TYPE_BOOL &&
+      fl_value_get_bool(enabled));
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+}
+
+// Writes the recorded spans as Chrome trace JSON to the "path" argument, or
+// to a file in the temp directory, and returns the path.
+static FlMethodResponse *dump_trace(FlMethodCall *method_call)
+{
+  FlValue *args = fl_method_call_get_args(method_call);
+  FlValue *path_value = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                            ? fl_value_lookup_string(args, "path")
+                            : nullptr;
+  std::string path;
+  if (path_value != nullptr &&
+      fl_value_get_type(path_value) == FL_VALUE_TYPE_STRING)
+  {
+    path = fl_value_get_string(path_value);
+  }
+  else
+  {
+    path = std::string(g_get_tmp_dir()) + "/desktop_updater_trace_" +
+           std::to_string(getpid()) + ".json";
+  }
+  std::string error;
+  if (!desktop_updater::WriteTrace(path, &error))
+  {
+    return FL_METHOD_RESPONSE(fl_method_error_response_new(
+        "TraceError", error.c_str(), nullptr));
+  }
+  g_autoptr(FlValue) result = fl_value_new_string(path.c_str());
+  return FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+}
+
 // Called when a method call is received from Flutter.
 static void desktop_updater_plugin_handle_method_call(
     DesktopUpdaterPlugin *self,
@@ -123,18 +1039,94 @@ static void desktop_updater_plugin_handle_method_call(
   {
     response = get_platform_version();
   }
+  else if (strcmp(method, "downloadUpdate") == 0)
+  {
+    response = start_download(self, method_call);
+    if (response == nullptr)
+    {
+      // Responded from download_finished_cb.
+      return;
+    }
+  }
+  else if (strcmp(method, "getCurrentVersion") == 0)
+  {
+    response = get_current_version(self);
+  }
+  else if (strcmp(method, "getHandoffDuration") == 0)
+  {
+    response = get_handoff_duration(self);
+  }
+  else if (strcmp(method, "getUpdateMetrics") == 0)
+  {
+    response = get_update_metrics();
+  }
+  else if (strcmp(method, "setPerfCountersEnabled") == 0)
+  {
+    response = set_perf_counters_enabled(method_call);
+  }
+  else if (strcmp(method, "setTraceEnabled") == 0)
+  {
+    response = set_trace_enabled(method_call);
+  }
+  else if (strcmp(method, "dumpTrace") == 0)
+  {
+    response = dump_trace(method_call);
+  }
+  else if (strcmp(method, "getVersionInfo") == 0)
+  {
+    response = get_version_info(self);
+  }
+  else if (strcmp(method, "checkAndPrepare") == 0)
+  {
+    response = start_check(self, method_call);
+    if (response == nullptr)
+    {
+      // Responded from check_finished_cb.
+      return;
+    }
+  }
   else if (strcmp(method, "restartApp") == 0)
   {
+    if (self->handing_off)
+    {
+      fl_method_call_respond_error(method_call, "RestartError",
+                                   "A restart is already in progress.",
+                                   nullptr, nullptr);
+      return;
+    }
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *handoff = args && fl_value_get_type(args) == FL_VALUE_TYPE_MAP
+                           ? fl_value_lookup_string(args, "handoff")
+                           : nullptr;
+    const bool use_handoff = handoff != nullptr &&
+                             fl_value_get_type(handoff) == FL_VALUE_TYPE_BOOL &&
+                             fl_value_get_bool(handoff);
+
     printf("Restarting the application...\n");
+    desktop_updater::RecordRestartPhase("requested");
 
-    char executable_path[PATH_MAX];
-    ssize_t len = readlink("/proc/self/exe", executable_path, sizeof(executable_path) - 1);
-    if (len != -1)
+    const std::string executable_path = get_executable_path();
+    if (!executable_path.empty())
     {
-      executable_path[len] = '\0';
-      printf("Executable path: %s\n", executable_path);
+      printf("Executable path: %s\n", executable_path.c_str());
+
+      // A verified update is swapped in by renames and the new executable
+      // started in place of this process; no helper process is involved.
+      if (desktop_updater::HasPendingUpdate(get_executable_dir()))
+      {
+        std::vector<std::string> replaced;
+        apply_pending_update(executable_path, &replaced);
+        desktop_updater::RecordRestartPhase("applied");
+        // In handoff mode the new app starts next to this one; responded
+        // from handoff_finished_cb only if that fails.
+        if (use_handoff && start_handoff(self, method_call, executable_path))
+        {
+          return;
+        }
+        exec_self(executable_path);
+      }
 
-      createUpdateScript(executable_path);
+      createUpdateScript(executable_path.c_str());
       runUpdateScript();
 
       // Exit current process
@@ -151,6 +1143,14 @@ static void desktop_updater_plugin_handle_method_call(
 
 static void desktop_updater_plugin_dispose(GObject *object)
 {
+  DesktopUpdaterPlugin *self = DESKTOP_UPDATER_PLUGIN(object);
+  g_clear_object(&self->progress_channel);
+  delete self->plan;
+  self->plan = nullptr;
+  delete self->version;
+  self->version = nullptr;
+  delete self->handoff;
+  self->handoff = nullptr;
   G_OBJECT_CLASS(desktop_updater_plugin_parent_class)->dispose(object);
 }
 
@@ -159,7 +1159,16 @@ static void desktop_updater_plugin_class_init(DesktopUpdaterPluginClass *klass)
   G_OBJECT_CLASS(klass)->dispose = desktop_updater_plugin_dispose;
 }
 
-static void desktop_updater_plugin_init(DesktopUpdaterPlugin *self) {}
+static void desktop_updater_plugin_init(DesktopUpdaterPlugin *self)
+{
+  self->progress_channel = nullptr;
+  self->progress_listening = FALSE;
+  self->download = nullptr;
+  self->plan = nullptr;
+  self->version = nullptr;
+  self->handoff = nullptr;
+  self->handing_off = FALSE;
+}
 
 static void method_call_cb(FlMethodChannel *channel, FlMethodCall *method_call,
                            gpointer user_data)
@@ -168,11 +1177,68 @@ static void method_call_cb(FlMethodChannel *channel, FlMethodCall *method_call,
   desktop_updater_plugin_handle_method_call(plugin, method_call);
 }
 
+static FlMethodErrorResponse *progress_listen_cb(FlEventChannel *channel,
+                                                 FlValue *args,
+                                                 gpointer user_data)
+{
+  DESKTOP_UPDATER_PLUGIN(user_data)->progress_listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse *progress_cancel_cb(FlEventChannel *channel,
+                                                 FlValue *args,
+                                                 gpointer user_data)
+{
+  DESKTOP_UPDATER_PLUGIN(user_data)->progress_listening = FALSE;
+  return nullptr;
+}
+
 void desktop_updater_plugin_register_with_registrar(FlPluginRegistrar *registrar)
 {
+  desktop_updater::InitTraceFromEnvironment();
+  desktop_updater::InitPerfCountersFromEnvironment();
   DesktopUpdaterPlugin *plugin = DESKTOP_UPDATER_PLUGIN(
       g_object_new(desktop_updater_plugin_get_type(), nullptr));
 
+  // The bundle cannot change while the app runs, so parse its version once.
+  plugin->version = new CachedVersion();
+  const std::string app_dir = get_executable_dir();
+  plugin->version->ok =
+      !app_dir.empty() &&
+      desktop_updater::ReadFlutterVersionFile(app_dir, &plugin->version->info,
+                                              &plugin->version->error);
+  if (app_dir.empty())
+  {
+    plugin->version->error = "Unable to resolve the executable directory.";
+  }
+
+  // Started by a handoff restart: tell the previous version once this one
+  // has rendered, so it can close its window.
+  const char *handoff_socket = getenv(desktop_updater::kHandoffSocketEnv);
+  if (handoff_socket != nullptr)
+  {
+    plugin->handoff = new HandoffState();
+    plugin->handoff->socket_path = handoff_socket;
+    const char *start = getenv(desktop_updater::kHandoffStartEnv);
+    plugin->handoff->start_us = start != nullptr
+                                    ? g_ascii_strtoll(start, nullptr, 10)
+                                    : desktop_updater::MonotonicMicros();
+    // Not meant for the processes the app starts itself.
+    unsetenv(desktop_updater::kHandoffSocketEnv);
+    unsetenv(desktop_updater::kHandoffStartEnv);
+
+    FlView *view = fl_plugin_registrar_get_view(registrar);
+    if (view != nullptr)
+    {
+      g_signal_connect_object(view, "first-frame", G_CALLBACK(first_frame_cb),
+                              plugin, static_cast<GConnectFlags>(0));
+    }
+    else
+    {
+      signal_handoff_ready(plugin);
+    }
+  }
+
   g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
   g_autoptr(FlMethodChannel) channel =
       fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
@@ -182,5 +1248,35 @@ void desktop_updater_plugin_register_with_registrar(FlPluginRegistrar *registrar
                                             g_object_ref(plugin),
                                             g_object_unref);
 
+  // Coalesced download progress, see ProgressEmitter. The plugin owns the
+  // channel, so the handlers borrow the plugin instead of referencing it.
+  plugin->progress_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           "desktop_updater/progress",
+                           FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->progress_channel,
+                                       progress_listen_cb, progress_cancel_cb,
+                                       plugin, nullptr);
+
   g_object_unref(plugin);
 }
+
+gboolean desktop_updater_apply_pending(void)
+{
+  desktop_updater::RecordRestartPhase("main");
+  desktop_updater::InitTraceFromEnvironment();
+  desktop_updater::InitPerfCountersFromEnvironment();
+  const std::string executable_path = get_executable_path();
+  std::vector<std::string> replaced;
+  if (executable_path.empty() || !apply_pending_update(executable_path, &replaced))
+  {
+    return FALSE;
+  }
+  // The old executable and libraries stay mapped after the rename, so
+  // start over on the new ones.
+  if (replaced_loaded_files(executable_path, replaced))
+  {
+    exec_self(executable_path);
+  }
+  return TRUE;
+}
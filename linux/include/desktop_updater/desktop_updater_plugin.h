@@ -21,6 +21,14 @@ FLUTTER_PLUGIN_EXPORT GType desktop_updater_plugin_get_type();
 FLUTTER_PLUGIN_EXPORT void desktop_updater_plugin_register_with_registrar(
     FlPluginRegistrar* registrar);
 
+// Applies an update staged by a previous run, if one was downloaded and
+// verified. Call it at the top of main(), before the Flutter engine starts.
+// If the executable or one of its libraries was replaced, the process
+// restarts itself with the same arguments and this does not return.
+//
+// Returns TRUE if an update was applied.
+FLUTTER_PLUGIN_EXPORT gboolean desktop_updater_apply_pending(void);
+
 G_END_DECLS
 
 #endif  // FLUTTER_PLUGIN_DESKTOP_UPDATER_PLUGIN_H_
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "batch_script.h"
+#include "manifest.h"
+#include "test_util.h"
+#include "update_applier.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+bool Contains(const std::string& script, const std::string& line) {
+  return script.find(line + "\n") != std::string::npos;
+}
+
+size_t Count(const std::string& script, const std::string& text) {
+  size_t count = 0;
+  for (size_t at = script.find(text); at != std::string::npos;
+       at = script.find(text, at + text.size())) {
+    count++;
+  }
+  return count;
+}
+
+class BatchScriptTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    app_ = TestTempDir("desktop_updater_batch");
+    fs::remove_all(app_);
+    staging_ = app_ / kStagingDirName;
+
+    WriteFile(app_ / "example.exe", "old binary");
+    WriteFile(app_ / "data" / "app.so", "old code");
+    WriteFile(app_ / "data" / "old.bin", "dropped");
+    WriteFile(app_ / "data" / "icudtl.dat", "unchanged");
+    WriteFile(staging_ / "data" / "app.so", "new code");
+    WriteFile(staging_ / "plugins" / "new.dll", "new plugin");
+  }
+
+  void TearDown() override { fs::remove_all(app_); }
+
+  fs::path app_;
+  fs::path staging_;
+};
+
+}  // namespace
+
+TEST_F(BatchScriptTest, PlansOnlyTheFilesTheUpdateTouches) {
+  // Left over by the verification of the staged files.
+  WriteFile(staging_ / ".desktop_updater" / "hash_cache", "");
+
+  BatchPlan plan;
+  std::string error;
+  ASSERT_TRUE(PlanBatchUpdate(app_.string(), staging_.string(),
+                              {"data\\old.bin", "gone.txt", "data/app.so"},
+                              &plan, &error))
+      << error;
+  EXPECT_EQ(plan.changed, std::vector<std::string>{"data/app.so"});
+  EXPECT_EQ(plan.added, std::vector<std::string>{"plugins/new.dll"});
+  // Not installed, or staged again: nothing to remove.
+  EXPECT_EQ(plan.removed, std::vector<std::string>{"data/old.bin"});
+
+  EXPECT_FALSE(PlanBatchUpdate(app_.string(), staging_.string(),
+                               {"../outside.txt"}, &plan, &error));
+}
+
+TEST_F(BatchScriptTest, PrefersTheStagedReceipt) {
+  Manifest staged(1);
+  staged[0].path = "data\\app.so";
+  const std::string receipt = SerializeManifest(staged);
+  WriteFile(staging_ / kStagedReceiptPath, receipt);
+
+  BatchPlan plan;
+  std::string error;
+  ASSERT_TRUE(
+      PlanBatchUpdate(app_.string(), staging_.string(), {}, &plan, &error))
+      << error;
+  EXPECT_EQ(plan.changed, std::vector<std::string>{"data/app.so"});
+  EXPECT_TRUE(plan.added.empty());
+}
+
+TEST_F(BatchScriptTest, MovesOnlyThePlannedFiles) {
+  BatchPlan plan;
+  plan.changed = {"data/app.so"};
+  plan.added = {"plugins/new.dll", "100%.txt"};
+  plan.removed = {"data/old.bin"};
+  BatchScriptOptions options;
+  options.executable_path = "C:\\Apps\\Example\\example.exe";
+  const std::string script = GenerateBatchScript(plan, options);
+
+  EXPECT_EQ(script.find("xcopy"), std::string::npos);
+  EXPECT_EQ(script.find("icudtl"), std::string::npos);
+  EXPECT_TRUE(Contains(script,
+                       "if not exist \"backup\\data\\\" mkdir "
+                       "\"backup\\data\" >NUL 2>&1"));
+  EXPECT_TRUE(Contains(script,
+                       "if exist \"data\\old.bin\" (move /Y \"data\\old.bin\" "
+                       "\"backup\\data\\old.bin\" >NUL 2>&1 || set FAILED=1)"));
+  EXPECT_TRUE(Contains(script,
+                       "if not exist \"plugins\\\" mkdir \"plugins\" "
+                       ">NUL 2>&1"));
+  EXPECT_TRUE(Contains(script,
+                       "if exist \"update\\data\\app.so\" (move /Y "
+                       "\"update\\data\\app.so\" \"data\\app.so\" >NUL 2>&1 "
+                       "|| set FAILED=1)"));
+  EXPECT_TRUE(Contains(script,
+                       "if exist \"update\\100%%.txt\" (move /Y "
+                       "\"update\\100%%.txt\" \"100%%.txt\" >NUL 2>&1 || "
+                       "set FAILED=1)"));
+  // Rolling back deletes what was added and puts the backup back.
+  EXPECT_TRUE(Contains(script,
+                       "if exist \"plugins\\new.dll\" (del /F /Q "
+                       "\"plugins\\new.dll\" >NUL 2>&1 || set FAILED=1)"));
+  EXPECT_TRUE(Contains(script,
+                       "if exist \"backup\\data\\old.bin\" (move /Y "
+                       "\"backup\\data\\old.bin\" \"data\\old.bin\" >NUL 2>&1 "
+                       "|| set FAILED=1)"));
+  EXPECT_TRUE(Contains(script,
+                       "taskkill /F /IM \"example.exe\" >NUL 2>&1"));
+  EXPECT_TRUE(Contains(script,
+                       "start /MAX \"\" \"C:\\Apps\\Example\\example.exe\""));
+}
+
+TEST_F(BatchScriptTest, CreatesEachFolderOfLargePlansOnce) {
+  BatchPlan plan;
+  for (int i = 0; i < 2000; i++) {
+    const std::string path =
+        "data/flutter_assets/assets/" + std::to_string(i % 100) + "/" +
+        std::to_string(i) + ".png";
+    (i % 4 == 0 ? plan.added : plan.changed).push_back(path);
+  }
+  plan.removed = {"data/old.bin"};
+  BatchScriptOptions options;
+  options.executable_path = "C:\\Apps\\Example\\example.exe";
+  const std::string script = GenerateBatchScript(plan, options);
+
+  // Added files need their folder; replaced ones their backup folder.
+  const std::string make_added =
+      "if not exist \"data\\flutter_assets\\assets\\96\\\" mkdir "
+      "\"data\\flutter_assets\\assets\\96\" >NUL 2>&1\n";
+  const std::string make_backup =
+      "if not exist \"backup\\data\\flutter_assets\\assets\\97\\\" "
+      "mkdir \"backup\\data\\flutter_assets\\assets\\97\" >NUL 2>&1\n";
+  EXPECT_EQ(Count(script, make_added), 1u);
+  EXPECT_EQ(Count(script, make_backup), 1u);
+  // Every staged file is moved in exactly once, every replaced one out.
+  EXPECT_EQ(Count(script, "(move /Y \"update\\"), 2000u);
+  EXPECT_EQ(Count(script, "(move /Y \"backup\\"), 1501u);
+  EXPECT_EQ(Count(script, "(del /F /Q "), 500u);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "delta.h"
+#include "delta_farm.h"
+#include "file_util.h"
+#include "release_packer.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+std::string RandomString(size_t size, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::string out(size, '\0');
+  for (char& c : out) {
+    c = static_cast<char>(random());
+  }
+  return out;
+}
+
+class DeltaFarmTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = TestTempDir("desktop_updater_delta_farm");
+    fs::remove_all(root_);
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  // Packs |files| as the release folder of build |build|.
+  std::string Release(int build,
+                      const std::vector<std::pair<std::string, std::string>>&
+                          files,
+                      const PackOptions& options = PackOptions()) {
+    const fs::path source = root_ / ("app-" + std::to_string(build));
+    for (const auto& file : files) {
+      WriteFile(source / file.first, file.second);
+    }
+    const fs::path output = root_ / std::to_string(build);
+    Manifest manifest;
+    PackStats stats;
+    std::string error;
+    EXPECT_TRUE(PackRelease(source.string(), output.string(), options,
+                            &manifest, &stats, &error))
+        << error;
+    stats_ = stats;
+    return output.string();
+  }
+
+  fs::path root_;
+  PackStats stats_;
+};
+
+}  // namespace
+
+TEST_F(DeltaFarmTest, PublishesVerifiedPatchesFromAWindowOfReleases) {
+  const std::string v1 = RandomString(1 << 20, 1);
+  std::string v2 = v1;
+  v2.insert(4096, RandomString(3000, 2));
+  std::string v3 = v2;
+  for (size_t i = 0; i < v3.size(); i += 1024) {
+    v3[i] = static_cast<char>(v3[i] ^ 0x40);
+  }
+  const std::string unrelated = RandomString(64 << 10, 3);
+
+  const std::string r1 =
+      Release(1, {{"lib/libapp.so", v1}, {"data/icudtl.dat", unrelated},
+                  {"app", "1"}});
+  const std::string r2 =
+      Release(2, {{"lib/libapp.so", v2}, {"data/icudtl.dat", unrelated},
+                  {"app", "2"}});
+
+  PackOptions options;
+  options.threads = 4;
+  options.previous_releases = {r1, r2};
+  const std::string r3 = Release(
+      3,
+      {{"lib/libapp.so", v3},
+       {"data/icudtl.dat", unrelated},
+       {"app", RandomString(100, 4)}},
+      options);
+  const DeltaFarmStats& delta = stats_.delta;
+  // libapp.so from 1 and 2, app from 1 and 2; icudtl.dat is unchanged.
+  EXPECT_EQ(delta.candidates, 4u);
+  EXPECT_EQ(delta.patches, 2u);
+  EXPECT_EQ(delta.skipped_ratio, 2u);
+  EXPECT_LT(delta.patch_bytes, v3.size() / 4);
+
+  PreviousRelease published;
+  std::string error;
+  ASSERT_TRUE(LoadPreviousRelease(r3, &published, &error)) << error;
+  ASSERT_EQ(published.manifest.size(), 3u);
+  const FileEntry& libapp = published.manifest[2];
+  ASSERT_EQ(libapp.path, "lib" + std::string(1, kPathSeparator) + "libapp.so");
+  ASSERT_EQ(libapp.patches.size(), 2u);
+  EXPECT_TRUE(published.manifest[0].patches.empty());
+  EXPECT_TRUE(published.manifest[1].patches.empty());
+
+  // Each published patch turns its base into the new file.
+  for (const PatchRef& patch : libapp.patches) {
+    EXPECT_EQ(patch.path.rfind("patches/lib/libapp.so.", 0), 0u);
+    ByteBuffer base;
+    ByteBuffer body;
+    ByteBuffer out;
+    ASSERT_TRUE(ReadFileBytes(JoinPath(r3, patch.path), &body, &error));
+    EXPECT_EQ(body.size(), patch.length);
+    bool applied = false;
+    for (const std::string& dir : {r1, r2}) {
+      ASSERT_TRUE(ReadFileBytes(JoinPath(dir, "lib/libapp.so"), &base,
+                                &error));
+      if (ApplyDelta(base, body, &out, &error) &&
+          std::string(out.begin(), out.end()) == v3) {
+        applied = true;
+      }
+    }
+    EXPECT_TRUE(applied) << patch.path;
+  }
+}
+
+TEST_F(DeltaFarmTest, SkipsPairsOverTheMemoryBudget) {
+  const std::string v1 = RandomString(256 << 10, 5);
+  const std::string r1 = Release(1, {{"lib/libapp.so", v1}});
+
+  PackOptions options;
+  options.previous_releases = {r1};
+  options.delta.worker_memory_budget = 64 << 10;
+  std::string v2 = v1;
+  v2[100] = 'x';
+  const std::string r2 = Release(2, {{"lib/libapp.so", v2}}, options);
+  EXPECT_EQ(stats_.delta.candidates, 1u);
+  EXPECT_EQ(stats_.delta.skipped_budget, 1u);
+  EXPECT_EQ(stats_.delta.patches, 0u);
+  EXPECT_FALSE(fs::exists(fs::path(r2) / kPatchDirName));
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <sys/stat.h>
+
+#include "disk_space.h"
+#include "file_util.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+FileEntry Entry(const std::string& path, uint64_t length) {
+  FileEntry entry;
+  entry.path = path;
+  entry.length = length;
+  return entry;
+}
+
+class DiskSpaceTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    app_ = TestTempDir("desktop_updater_space");
+    fs::remove_all(app_);
+    fs::create_directories(app_);
+  }
+
+  void TearDown() override { fs::remove_all(app_); }
+
+  fs::path app_;
+};
+
+}  // namespace
+
+TEST_F(DiskSpaceTest, RoundsFilesToBlocksAndCountsMetadata) {
+  const Manifest files = {Entry("lib/libapp.so", 1), Entry("data/a", 0),
+                          Entry("example", 10000)};
+  SpaceEstimate space;
+  std::string error;
+  ASSERT_TRUE(EstimateUpdateSpace(app_.string(), files, &space, &error))
+      << error;
+  const uint64_t block = space.block_size;
+  ASSERT_GT(block, 0u);
+  EXPECT_EQ(space.staging_bytes, block + (10000 + block - 1) / block * block);
+  // Receipt, hash cache and journal each take at least a block.
+  EXPECT_GE(space.metadata_bytes, 3 * block);
+  EXPECT_GT(space.available_bytes, 0u);
+}
+
+TEST_F(DiskSpaceTest, CreditsPartiallyDownloadedFiles) {
+  const Manifest files = {Entry("big", 1 << 20)};
+  SpaceEstimate before;
+  std::string error;
+  ASSERT_TRUE(EstimateUpdateSpace(app_.string(), files, &before, &error));
+
+  fs::create_directories(app_ / "update");
+  std::ofstream(app_ / "update" / "big", std::ios::binary)
+      << std::string(1 << 19, 'x');
+  SpaceEstimate after;
+  ASSERT_TRUE(EstimateUpdateSpace(app_.string(), files, &after, &error));
+  EXPECT_LT(after.staging_bytes, before.staging_bytes);
+}
+
+TEST_F(DiskSpaceTest, RefusesUpdatesLargerThanTheDisk) {
+  const Manifest files = {Entry("huge", uint64_t{1} << 60)};
+  SpaceEstimate space;
+  std::string error;
+  EXPECT_FALSE(CheckUpdateSpace(app_.string(), files, &space, &error));
+  EXPECT_NE(error.find("Not enough disk space"), std::string::npos) << error;
+}
+
+TEST_F(DiskSpaceTest, PreallocationKeepsFileSize) {
+  const std::string path = (app_ / "reserved").string();
+  FILE* file = OpenFile(path, "wb");
+  ASSERT_NE(file, nullptr);
+  EXPECT_TRUE(PreallocateFile(file, 1 << 20));
+  fputs("abc", file);
+  fclose(file);
+  EXPECT_EQ(fs::file_size(path), 3u);
+
+  // Asking for more than the disk holds fails instead of being ignored.
+  file = OpenFile(path, "ab");
+  ASSERT_NE(file, nullptr);
+  EXPECT_FALSE(PreallocateFile(file, uint64_t{1} << 60));
+  fclose(file);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "blake2b.h"
+#include "delta.h"
+#include "download_engine.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Serves bodies from memory in small chunks, like a network stack would.
+class FakeFetcher : public HttpFetcher {
+ public:
+  std::map<std::string, std::string> bodies;
+
+  bool Get(const std::string& url,
+           const BodyCallback& on_body,
+           std::string* error) override {
+    auto it = bodies.find(url);
+    if (it == bodies.end()) {
+      *error = "HTTP 404 for " + url;
+      return false;
+    }
+    const std::string& body = it->second;
+    for (size_t offset = 0; offset < body.size(); offset += 7) {
+      const size_t size = std::min<size_t>(7, body.size() - offset);
+      if (!on_body(reinterpret_cast<const uint8_t*>(body.data() + offset),
+                   size)) {
+        *error = "aborted";
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+class DownloadEngineTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    staging_ = TestTempDir("desktop_updater_download");
+    fs::remove_all(staging_);
+  }
+
+  void TearDown() override { fs::remove_all(staging_); }
+
+  fs::path staging_;
+};
+
+}  // namespace
+
+TEST_F(DownloadEngineTest, DownloadsAllItems) {
+  FakeFetcher fetcher;
+  fetcher.bodies["https://host/v2/lib/libapp.so"] = std::string(100, 'a');
+  fetcher.bodies["https://host/v2/data/icudtl.dat"] = "icu";
+  fetcher.bodies["https://host/v2/data/flutter_assets/a%20b.txt"] = "space";
+
+  ProgressTracker tracker;
+  DownloadEngine engine(&fetcher, &tracker);
+  std::string error;
+  ASSERT_TRUE(engine.Run("https://host/v2/",
+                         {{"lib/libapp.so", 100, "", {}},
+                          {"data\\icudtl.dat", 3, "", {}},
+                          {"data/flutter_assets/a b.txt", 5, "", {}}},
+                         staging_.string(), DownloadOptions(), &error))
+      << error;
+
+  EXPECT_EQ(ReadFile(staging_ / "lib/libapp.so"), std::string(100, 'a'));
+  EXPECT_EQ(ReadFile(staging_ / "data/icudtl.dat"), "icu");
+  EXPECT_EQ(ReadFile(staging_ / "data/flutter_assets/a b.txt"), "space");
+
+  const ProgressSnapshot snapshot =
+      tracker.Sample(std::chrono::steady_clock::now());
+  EXPECT_TRUE(snapshot.done);
+  EXPECT_EQ(snapshot.received_bytes, 108u);
+  EXPECT_EQ(snapshot.total_bytes, 108u);
+  EXPECT_EQ(snapshot.completed_files, 3u);
+}
+
+TEST_F(DownloadEngineTest, ReportsFirstFailure) {
+  FakeFetcher fetcher;
+  fetcher.bodies["https://host/a"] = "a";
+
+  ProgressTracker tracker;
+  DownloadEngine engine(&fetcher, &tracker);
+  std::string error;
+  EXPECT_FALSE(engine.Run("https://host", {{"a", 1, "", {}}, {"missing", 1, "", {}}},
+                          staging_.string(), DownloadOptions(), &error));
+  EXPECT_NE(error.find("404"), std::string::npos);
+  EXPECT_TRUE(tracker.IsDone());
+}
+
+TEST_F(DownloadEngineTest, RejectsPathsOutsideStaging) {
+  FakeFetcher fetcher;
+  ProgressTracker tracker;
+  DownloadEngine engine(&fetcher, &tracker);
+  std::string error;
+  EXPECT_FALSE(engine.Run("https://host", {{"../evil", 1, "", {}}},
+                          staging_.string(), DownloadOptions(), &error));
+  EXPECT_FALSE(fs::exists(staging_.parent_path() / "evil"));
+}
+
+TEST_F(DownloadEngineTest, AppliesPlannedPatches) {
+  const fs::path base = staging_ / "installed";
+  fs::create_directories(base / "lib");
+  std::ofstream(base / "lib" / "libapp.so", std::ios::binary)
+      << "hello brave world";
+
+  const std::string insert = "new ";
+  DeltaWriter delta(15);
+  delta.Copy(0, 6);
+  delta.Insert(reinterpret_cast<const uint8_t*>(insert.data()), insert.size());
+  delta.Copy(12, 5);
+
+  FakeFetcher fetcher;
+  fetcher.bodies["https://host/3/p/libapp.so"] =
+      std::string(delta.data().begin(), delta.data().end());
+
+  const std::string expected = "hello new world";
+  PlanStep step;
+  step.kind = PlanStep::Kind::kPatch;
+  step.url = "https://host/3/p/libapp.so";
+  step.length = delta.data().size();
+  Blake2b hash;
+  hash.Update(reinterpret_cast<const uint8_t*>(expected.data()),
+              expected.size());
+  hash.Final(step.result.data());
+
+  DownloadItem item;
+  item.path = "lib/libapp.so";
+  item.length = step.length;
+  item.steps.push_back(step);
+  DownloadOptions options;
+  options.base_dir = base.string();
+
+  ProgressTracker tracker;
+  DownloadEngine engine(&fetcher, &tracker);
+  std::string error;
+  ASSERT_TRUE(engine.Run("https://host/3", {item},
+                         (staging_ / "update").string(), options, &error))
+      << error;
+  EXPECT_EQ(ReadFile(staging_ / "update" / "lib" / "libapp.so"), expected);
+
+  // A patch producing anything else is rejected.
+  item.steps[0].result.fill(0);
+  EXPECT_FALSE(engine.Run("https://host/3", {item},
+                          (staging_ / "update").string(), options, &error));
+  EXPECT_NE(error.find("Hash mismatch"), std::string::npos);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
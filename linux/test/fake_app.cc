@@ -0,0 +1,72 @@
+// A stand-in for a Flutter app bundle, used by restart_latency_test.cc.
+//
+// Runs the same startup and restart steps as the plugin (apply a staged
+// update, exec the new executable) without GTK or the engine, and prints
+// the contents of data/version.txt next to the executable. With --restart
+// and an update pending it applies it and restarts itself first.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <limits.h>
+#include <unistd.h>
+
+#include "file_util.h"
+#include "relaunch.h"
+#include "update_applier.h"
+
+namespace {
+
+std::string ExecutablePath() {
+  char path[PATH_MAX];
+  const ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (length <= 0) {
+    return std::string();
+  }
+  return std::string(path, static_cast<size_t>(length));
+}
+
+std::string DirName(const std::string& path) {
+  const size_t slash = path.rfind('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  desktop_updater::RecordRestartPhase("main");
+  // Resolved before applying: /proc/self/exe follows the old executable
+  // into the backup directory.
+  const std::string executable_path = ExecutablePath();
+  const std::string app_dir = DirName(executable_path);
+
+  const bool restart = argc > 1 && strcmp(argv[1], "--restart") == 0;
+  if (restart && desktop_updater::HasPendingUpdate(app_dir)) {
+    desktop_updater::RecordRestartPhase("requested");
+    std::vector<std::string> replaced;
+    std::string error;
+    if (desktop_updater::ApplyPendingUpdate(app_dir, executable_path,
+                                            &replaced, &error) !=
+        desktop_updater::ApplyResult::kApplied) {
+      fprintf(stderr, "Failed to apply: %s\n", error.c_str());
+      return 1;
+    }
+    desktop_updater::RecordRestartPhase("applied");
+    desktop_updater::ExecSelf(executable_path, &error);
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  std::vector<uint8_t> version;
+  std::string error;
+  if (!desktop_updater::ReadFileBytes(
+          desktop_updater::JoinPath(app_dir, "data/version.txt"), &version,
+          &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  fwrite(version.data(), 1, version.size(), stdout);
+  return 0;
+}
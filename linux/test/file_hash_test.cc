@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "blake2b.h"
+#include "file_hash.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+std::string ToHex(const uint8_t* data, size_t size) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string out;
+  for (size_t i = 0; i < size; i++) {
+    out.push_back(kHex[data[i] >> 4]);
+    out.push_back(kHex[data[i] & 0x0F]);
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(Blake2b, MatchesRfc7693Vector) {
+  Blake2b hash;
+  const uint8_t abc[] = {'a', 'b', 'c'};
+  hash.Update(abc, sizeof(abc));
+  uint8_t digest[64];
+  hash.Final(digest);
+  EXPECT_EQ(ToHex(digest, sizeof(digest)),
+            "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d1"
+            "7d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923");
+}
+
+TEST(Blake2b, IncrementalUpdatesMatchOneShot) {
+  const std::string data(1000, 'x');
+  uint8_t one_shot[64];
+  uint8_t pieces[64];
+
+  Blake2b a;
+  a.Update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  a.Final(one_shot);
+
+  // Split across block boundaries in uneven pieces.
+  Blake2b b;
+  size_t offset = 0;
+  for (size_t step : {1u, 127u, 128u, 129u, 300u}) {
+    b.Update(reinterpret_cast<const uint8_t*>(data.data()) + offset, step);
+    offset += step;
+  }
+  b.Update(reinterpret_cast<const uint8_t*>(data.data()) + offset,
+           data.size() - offset);
+  b.Final(pieces);
+
+  EXPECT_EQ(ToHex(one_shot, 64), ToHex(pieces, 64));
+}
+
+TEST(FileHash, HashTreeMatchesDartManifestFormat) {
+  const fs::path root = TestTempDir("desktop_updater_hash_tree");
+  fs::remove_all(root);
+  WriteFile(root / "lib" / "libapp.so", std::string(300, 'a'));
+  WriteFile(root / "app", "binary");
+  WriteFile(root / "update" / "lib" / "libapp.so", "staged");
+  fs::create_symlink(root / "app", root / "app_link");
+
+  ScanOptions options;
+  options.separator = '/';
+  options.exclude.push_back("update");
+  Manifest manifest;
+  std::string error;
+  ASSERT_TRUE(HashTree(root.string(), options, 2, &manifest, &error)) << error;
+
+  ASSERT_EQ(manifest.size(), 2u);
+  EXPECT_EQ(manifest[0].path, "app");
+  EXPECT_EQ(manifest[1].path, "lib/libapp.so");
+  EXPECT_EQ(manifest[1].length, 300u);
+  // Same value package:cryptography's Blake2b() produces.
+  EXPECT_EQ(Base64Encode(manifest[1].digest.data(), manifest[1].digest.size()),
+            "ov8wQO2kBbkpwvwv2T6K3WrDu1Nptnm64XCsaVaGPKAGKF8TKoaAAPw/"
+            "rlvGluXRf+P937SjQodsQEURhHQphg==");
+
+  fs::remove_all(root);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "handoff.h"
+
+namespace desktop_updater {
+namespace test {
+
+TEST(Handoff, ListenerReceivesReadyMessage) {
+  const std::string path = HandoffSocketPath(getpid());
+  HandoffListener listener;
+  std::string error;
+  ASSERT_TRUE(listener.Listen(path, &error)) << error;
+
+  std::thread sender([&path]() {
+    std::string send_error;
+    EXPECT_TRUE(SignalHandoffReady(path, "1234", &send_error)) << send_error;
+  });
+  std::string message;
+  EXPECT_TRUE(listener.WaitForReady(5000, &message, &error)) << error;
+  sender.join();
+  EXPECT_EQ(message, "1234");
+}
+
+TEST(Handoff, TimesOutWithoutError) {
+  HandoffListener listener;
+  std::string error;
+  ASSERT_TRUE(listener.Listen(HandoffSocketPath(getpid()) + ".t", &error))
+      << error;
+  const int64_t start = MonotonicMicros();
+  std::string message;
+  EXPECT_FALSE(listener.WaitForReady(50, &message, &error));
+  EXPECT_TRUE(error.empty()) << error;
+  EXPECT_GE(MonotonicMicros() - start, 40000);
+}
+
+TEST(Handoff, SignalFailsWithoutListener) {
+  std::string error;
+  EXPECT_FALSE(SignalHandoffReady("/nonexistent/desktop_updater.sock", "x",
+                                  &error));
+  EXPECT_FALSE(error.empty());
+}
+
+}  // namespace test
+}  // namespace desktop_updater
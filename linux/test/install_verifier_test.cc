@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "file_hash.h"
+#include "install_verifier.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class InstallVerifierTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = TestTempDir("desktop_updater_verify");
+    fs::remove_all(root_);
+    for (int i = 0; i < 32; i++) {
+      WriteFile(root_ / "data" / ("file" + std::to_string(i)),
+                std::string(1000 + i, static_cast<char>('a' + i % 26)));
+    }
+    std::string error;
+    ASSERT_TRUE(HashTree(root_.string(), ScanOptions(), 1, &manifest_, &error))
+        << error;
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  HashCache CacheOf(const Manifest& manifest) {
+    HashCache cache;
+    for (const FileEntry& entry : manifest) {
+      FileIdentity identity;
+      EXPECT_TRUE(GetFileIdentity((root_ / entry.path).string(), &identity));
+      cache.Put(identity, entry.digest);
+    }
+    return cache;
+  }
+
+  fs::path root_;
+  Manifest manifest_;
+};
+
+}  // namespace
+
+TEST_F(InstallVerifierTest, VerifiesByHashingWithoutCache) {
+  VerifyStats stats;
+  std::string error;
+  ASSERT_TRUE(VerifyInstalledFiles(root_.string(), manifest_, nullptr, 4,
+                                   &stats, &error))
+      << error;
+  EXPECT_EQ(stats.files, manifest_.size());
+  EXPECT_EQ(stats.cache_hits, 0u);
+  EXPECT_GT(stats.hashed_bytes, 32000u);
+}
+
+TEST_F(InstallVerifierTest, ReusesCachedDigestsAcrossRenames) {
+  HashCache cache;
+  std::string error;
+  ASSERT_TRUE(cache.Parse(CacheOf(manifest_).Serialize(), &error)) << error;
+  EXPECT_EQ(cache.size(), manifest_.size());
+
+  fs::rename(root_ / "data", root_ / "moved");
+  for (FileEntry& entry : manifest_) {
+    entry.path.replace(0, 4, "moved");
+  }
+  VerifyStats stats;
+  ASSERT_TRUE(VerifyInstalledFiles(root_.string(), manifest_, &cache, 4,
+                                   &stats, &error))
+      << error;
+  EXPECT_EQ(stats.cache_hits, manifest_.size());
+  EXPECT_EQ(stats.hashed_bytes, 0u);
+}
+
+TEST_F(InstallVerifierTest, StopsAtFirstMismatch) {
+  const HashCache cache = CacheOf(manifest_);
+  // Rewritten in place: same inode, new mtime, so the file is hashed again.
+  WriteFile(root_ / manifest_[5].path,
+            std::string(manifest_[5].length, 'z'));
+  // File timestamps are coarse; make sure the rewrite is visible.
+  fs::last_write_time(root_ / manifest_[5].path,
+                      fs::last_write_time(root_ / manifest_[5].path) +
+                          std::chrono::seconds(1));
+
+  VerifyStats stats;
+  std::string error;
+  EXPECT_FALSE(VerifyInstalledFiles(root_.string(), manifest_, &cache, 1,
+                                    &stats, &error));
+  EXPECT_NE(error.find(manifest_[5].path), std::string::npos) << error;
+  // Single worker: nothing after the mismatch was looked at.
+  EXPECT_EQ(stats.files, 5u);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
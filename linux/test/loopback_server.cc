@@ -0,0 +1,492 @@
+#include "loopback_server.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+constexpr size_t kChunkBytes = 64 * 1024;
+
+struct Request {
+  std::string method;
+  std::string target;
+  std::string version;
+  // Lower-cased names.
+  std::map<std::string, std::string> headers;
+
+  std::string Header(const std::string& name) const {
+    auto it = headers.find(name);
+    return it == headers.end() ? std::string() : it->second;
+  }
+};
+
+bool ParseRequest(const std::string& text, Request* request) {
+  size_t line_end = text.find("\r\n");
+  const std::string line = text.substr(0, line_end);
+  const size_t first = line.find(' ');
+  const size_t second = line.find(' ', first + 1);
+  if (first == std::string::npos || second == std::string::npos) {
+    return false;
+  }
+  request->method = line.substr(0, first);
+  request->target = line.substr(first + 1, second - first - 1);
+  request->version = line.substr(second + 1);
+
+  while (line_end != std::string::npos && line_end + 2 < text.size()) {
+    const size_t start = line_end + 2;
+    line_end = text.find("\r\n", start);
+    const std::string header = text.substr(start, line_end - start);
+    const size_t colon = header.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string name = header.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    size_t value_start = colon + 1;
+    while (value_start < header.size() && header[value_start] == ' ') {
+      value_start++;
+    }
+    request->headers[name] = header.substr(value_start);
+  }
+  return true;
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Maps a request target to a path relative to the served root.
+bool DecodeTarget(const std::string& target, std::string* path) {
+  const std::string raw = target.substr(0, target.find('?'));
+  if (raw.empty() || raw[0] != '/') {
+    return false;
+  }
+  path->clear();
+  for (size_t i = 1; i < raw.size(); i++) {
+    if (raw[i] != '%') {
+      path->push_back(raw[i]);
+      continue;
+    }
+    if (i + 2 >= raw.size() || HexValue(raw[i + 1]) < 0 ||
+        HexValue(raw[i + 2]) < 0) {
+      return false;
+    }
+    path->push_back(
+        static_cast<char>(HexValue(raw[i + 1]) * 16 + HexValue(raw[i + 2])));
+    i += 2;
+  }
+  return IsSafeRelativePath(*path);
+}
+
+enum class RangeResult { kWhole, kPartial, kUnsatisfiable };
+
+// Parses a single "bytes=" range of a |size| byte body. Multiple ranges are
+// served as the whole body.
+RangeResult ParseRange(const std::string& header,
+                       uint64_t size,
+                       uint64_t* offset,
+                       uint64_t* length) {
+  static const char kPrefix[] = "bytes=";
+  if (header.compare(0, sizeof(kPrefix) - 1, kPrefix) != 0 ||
+      header.find(',') != std::string::npos) {
+    return RangeResult::kWhole;
+  }
+  const std::string spec = header.substr(sizeof(kPrefix) - 1);
+  const size_t dash = spec.find('-');
+  if (dash == std::string::npos) {
+    return RangeResult::kWhole;
+  }
+  const std::string first = spec.substr(0, dash);
+  const std::string last = spec.substr(dash + 1);
+  auto is_number = [](const std::string& value) {
+    return !value.empty() &&
+           std::all_of(value.begin(), value.end(),
+                       [](unsigned char c) { return std::isdigit(c); });
+  };
+  if (first.empty()) {
+    // Suffix range: the last N bytes.
+    if (!is_number(last)) {
+      return RangeResult::kWhole;
+    }
+    const uint64_t suffix = std::stoull(last);
+    if (suffix == 0 || size == 0) {
+      return RangeResult::kUnsatisfiable;
+    }
+    *length = std::min(suffix, size);
+    *offset = size - *length;
+    return RangeResult::kPartial;
+  }
+  if (!is_number(first) || (!last.empty() && !is_number(last))) {
+    return RangeResult::kWhole;
+  }
+  const uint64_t start = std::stoull(first);
+  if (start >= size) {
+    return RangeResult::kUnsatisfiable;
+  }
+  uint64_t end = last.empty() ? size - 1 : std::stoull(last);
+  if (end < start) {
+    return RangeResult::kWhole;
+  }
+  end = std::min(end, size - 1);
+  *offset = start;
+  *length = end - start + 1;
+  return RangeResult::kPartial;
+}
+
+bool SendAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    const ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    data += sent;
+    size -= static_cast<size_t>(sent);
+  }
+  return true;
+}
+
+const char* StatusText(int status) {
+  switch (status) {
+    case 200:
+      return "OK";
+    case 206:
+      return "Partial Content";
+    case 304:
+      return "Not Modified";
+    case 404:
+      return "Not Found";
+    case 405:
+      return "Method Not Allowed";
+    case 416:
+      return "Range Not Satisfiable";
+    default:
+      return "Bad Request";
+  }
+}
+
+std::string StatusLine(int status) {
+  return "HTTP/1.1 " + std::to_string(status) + " " + StatusText(status) +
+         "\r\n";
+}
+
+}  // namespace
+
+LoopbackServer::LoopbackServer(const std::string& root,
+                               const LoopbackServerOptions& options)
+    : root_(root), options_(options), resets_left_(options.resets) {}
+
+LoopbackServer::~LoopbackServer() { Stop(); }
+
+bool LoopbackServer::Start(std::string* error) {
+  const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    *error = std::string("socket: ") + strerror(errno);
+    return false;
+  }
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  socklen_t address_size = sizeof(address);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(fd, SOMAXCONN) != 0 ||
+      getsockname(fd, reinterpret_cast<sockaddr*>(&address), &address_size) !=
+          0) {
+    *error = std::string("Cannot listen on 127.0.0.1: ") + strerror(errno);
+    close(fd);
+    return false;
+  }
+  listen_fd_ = fd;
+  port_ = ntohs(address.sin_port);
+  stopping_.store(false);
+  accept_thread_ = std::thread(&LoopbackServer::AcceptLoop, this);
+  return true;
+}
+
+void LoopbackServer::Stop() {
+  if (listen_fd_ < 0) {
+    return;
+  }
+  stopping_.store(true);
+  // Wakes up accept().
+  shutdown(listen_fd_, SHUT_RDWR);
+  accept_thread_.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const int fd : connections_) {
+      shutdown(fd, SHUT_RDWR);
+    }
+    threads.swap(threads_);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+std::string LoopbackServer::url() const {
+  return "http://127.0.0.1:" + std::to_string(port_);
+}
+
+LoopbackServerStats LoopbackServer::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+std::string LoopbackServer::ETagFor(const std::string& path) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return std::string();
+  }
+  const uint64_t mtime_ns =
+      static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000ull +
+      static_cast<uint64_t>(info.st_mtim.tv_nsec);
+  char etag[64];
+  snprintf(etag, sizeof(etag), "\"%llx-%llx\"",
+           static_cast<unsigned long long>(info.st_size),
+           static_cast<unsigned long long>(mtime_ns));
+  return etag;
+}
+
+void LoopbackServer::AcceptLoop() {
+  while (true) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_.load()) {
+      close(fd);
+      return;
+    }
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    connections_.push_back(fd);
+    threads_.emplace_back(&LoopbackServer::Serve, this, fd);
+  }
+}
+
+void LoopbackServer::Serve(int fd) {
+  std::string buffer;
+  char chunk[4096];
+  bool keep_open = true;
+  while (keep_open && !stopping_.load()) {
+    const size_t header_end = buffer.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+      if (buffer.size() > kMaxHeaderBytes) {
+        break;
+      }
+      const ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+      if (received < 0 && errno == EINTR) {
+        continue;
+      }
+      if (received <= 0) {
+        break;
+      }
+      buffer.append(chunk, static_cast<size_t>(received));
+      continue;
+    }
+    // Requests have no body, so the next one starts after the headers.
+    keep_open = Respond(fd, buffer.substr(0, header_end + 2));
+    buffer.erase(0, header_end + 4);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  connections_.erase(
+      std::find(connections_.begin(), connections_.end(), fd));
+  close(fd);
+}
+
+bool LoopbackServer::Respond(int fd, const std::string& text) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.requests++;
+  }
+  if (options_.latency_ms > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(options_.latency_ms));
+  }
+
+  Request request;
+  std::string path;
+  int status = 200;
+  if (!ParseRequest(text, &request)) {
+    status = 400;
+  } else if (request.method != "GET" && request.method != "HEAD") {
+    status = 405;
+  } else if (!DecodeTarget(request.target, &path)) {
+    status = 404;
+  }
+  const bool keep_alive = request.version == "HTTP/1.1" &&
+                          request.Header("connection") != "close";
+  const std::string connection =
+      keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+
+  const std::string file_path = JoinPath(root_, path);
+  int file = -1;
+  struct stat info;
+  if (status == 200) {
+    file = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0 || fstat(file, &info) != 0 || !S_ISREG(info.st_mode)) {
+      status = 404;
+    }
+  }
+  if (status != 200) {
+    if (file >= 0) {
+      close(file);
+    }
+    // Errors close the connection, like most servers do.
+    const std::string body = std::string(StatusText(status)) + "\n";
+    const std::string response =
+        StatusLine(status) + "Content-Type: text/plain\r\nContent-Length: " +
+        std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" +
+        (request.method == "HEAD" ? std::string() : body);
+    SendAll(fd, response.data(), response.size());
+    return false;
+  }
+
+  const uint64_t size = static_cast<uint64_t>(info.st_size);
+  const std::string etag = ETagFor(file_path);
+  uint64_t offset = 0;
+  uint64_t length = size;
+  std::string headers = "Accept-Ranges: bytes\r\nETag: " + etag + "\r\n";
+
+  const std::string if_none_match = request.Header("if-none-match");
+  const std::string if_range = request.Header("if-range");
+  const std::string range = request.Header("range");
+  if (!if_none_match.empty() &&
+      (if_none_match == "*" || if_none_match.find(etag) != std::string::npos)) {
+    status = 304;
+    length = 0;
+  } else if (!range.empty() && (if_range.empty() || if_range == etag)) {
+    switch (ParseRange(range, size, &offset, &length)) {
+      case RangeResult::kWhole:
+        break;
+      case RangeResult::kPartial:
+        status = 206;
+        headers += "Content-Range: bytes " + std::to_string(offset) + "-" +
+                   std::to_string(offset + length - 1) + "/" +
+                   std::to_string(size) + "\r\n";
+        break;
+      case RangeResult::kUnsatisfiable:
+        status = 416;
+        length = 0;
+        headers += "Content-Range: bytes */" + std::to_string(size) + "\r\n";
+        break;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.partial_responses += status == 206 ? 1 : 0;
+    stats_.not_modified += status == 304 ? 1 : 0;
+  }
+
+  const std::string response =
+      StatusLine(status) + headers +
+      (status == 304 ? std::string()
+                     : "Content-Type: application/octet-stream\r\n"
+                       "Content-Length: " +
+                           std::to_string(length) + "\r\n") +
+      connection + "\r\n";
+  bool ok = SendAll(fd, response.data(), response.size());
+  if (ok && request.method == "GET" && length > 0) {
+    ok = SendBody(fd, file, offset, length);
+  }
+  close(file);
+  return ok && keep_alive;
+}
+
+bool LoopbackServer::SendBody(int fd, int file, uint64_t offset,
+                              uint64_t length) {
+  uint64_t limit = length;
+  bool reset = false;
+  if (options_.reset_after_bytes > 0 && length > options_.reset_after_bytes) {
+    int left = resets_left_.load();
+    while (left != 0 && !resets_left_.compare_exchange_weak(
+                            left, left > 0 ? left - 1 : left)) {
+    }
+    reset = left != 0;
+    if (reset) {
+      limit = options_.reset_after_bytes;
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<char> buffer(kChunkBytes);
+  uint64_t sent = 0;
+  bool ok = true;
+  while (ok && sent < limit) {
+    size_t size = static_cast<size_t>(std::min<uint64_t>(kChunkBytes,
+                                                         limit - sent));
+    if (options_.bytes_per_second > 0) {
+      // Small chunks keep the rate smooth at low limits.
+      size = static_cast<size_t>(std::min<uint64_t>(
+          size, std::max<uint64_t>(options_.bytes_per_second / 20, 1)));
+    }
+    const ssize_t read_size =
+        pread(file, buffer.data(), size, static_cast<off_t>(offset + sent));
+    if (read_size <= 0) {
+      ok = false;
+      break;
+    }
+    ok = SendAll(fd, buffer.data(), static_cast<size_t>(read_size));
+    sent += static_cast<uint64_t>(read_size);
+    if (options_.bytes_per_second > 0) {
+      std::this_thread::sleep_until(
+          start + std::chrono::microseconds(sent * 1000000 /
+                                            options_.bytes_per_second));
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.body_bytes += sent;
+    stats_.resets += reset ? 1 : 0;
+  }
+  if (reset) {
+    // Closing with a zero linger time sends RST instead of FIN.
+    const linger abort = {1, 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    return false;
+  }
+  return ok;
+}
+
+}  // namespace test
+}  // namespace desktop_updater
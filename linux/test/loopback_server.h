@@ -0,0 +1,90 @@
+#ifndef DESKTOP_UPDATER_TEST_LOOPBACK_SERVER_H_
+#define DESKTOP_UPDATER_TEST_LOOPBACK_SERVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace desktop_updater {
+namespace test {
+
+struct LoopbackServerOptions {
+  // Delay before each response is sent.
+  int latency_ms = 0;
+  // Per-connection body rate; 0 means unlimited.
+  uint64_t bytes_per_second = 0;
+  // When non-zero, the connection is reset after sending this many bytes of
+  // a body, for the first |resets| responses that are that long (-1: all).
+  uint64_t reset_after_bytes = 0;
+  int resets = -1;
+};
+
+struct LoopbackServerStats {
+  uint64_t requests = 0;
+  uint64_t body_bytes = 0;
+  uint64_t partial_responses = 0;
+  uint64_t not_modified = 0;
+  uint64_t resets = 0;
+};
+
+/**
+ * @brief In-process HTTP/1.1 server on 127.0.0.1 that serves the files
+ *        below a directory, standing in for the release host in tests and
+ *        benchmarks.
+ *
+ * Supports GET and HEAD with keep-alive, single byte ranges (Range and
+ * If-Range) and ETags (If-None-Match). Latency, bandwidth limits and
+ * connection resets in the middle of a body can be injected through
+ * LoopbackServerOptions. Each connection is served by its own thread.
+ */
+class LoopbackServer {
+ public:
+  explicit LoopbackServer(const std::string& root,
+                          const LoopbackServerOptions& options = {});
+  ~LoopbackServer();
+
+  LoopbackServer(const LoopbackServer&) = delete;
+  LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+  // Listens on an ephemeral loopback port.
+  bool Start(std::string* error);
+  // Closes the listening socket and every open connection. Called by the
+  // destructor.
+  void Stop();
+
+  // "http://127.0.0.1:<port>", without a trailing slash.
+  std::string url() const;
+  uint16_t port() const { return port_; }
+  LoopbackServerStats stats() const;
+
+  // The ETag the server sends for the file at |path|, or an empty string.
+  static std::string ETagFor(const std::string& path);
+
+ private:
+  void AcceptLoop();
+  void Serve(int fd);
+  // Handles one request. Returns false when the connection must close.
+  bool Respond(int fd, const std::string& request);
+  bool SendBody(int fd, int file, uint64_t offset, uint64_t length);
+
+  const std::string root_;
+  const LoopbackServerOptions options_;
+  int listen_fd_ = -1;
+  uint16_t port_ = 0;
+  std::thread accept_thread_;
+  std::atomic<bool> stopping_{false};
+  std::atomic<int> resets_left_;
+
+  mutable std::mutex mutex_;
+  std::vector<int> connections_;
+  std::vector<std::thread> threads_;
+  LoopbackServerStats stats_;
+};
+
+}  // namespace test
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_TEST_LOOPBACK_SERVER_H_
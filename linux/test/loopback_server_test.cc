@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "curl_fetcher.h"
+#include "download_engine.h"
+#include "file_hash.h"
+#include "loopback_server.h"
+#include "test_util.h"
+#include "update_applier.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// Sends |request| on a new connection and returns everything received
+// until the server closes it.
+std::string RawRequest(uint16_t port, const std::string& request) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  std::string response;
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+          0 &&
+      send(fd, request.data(), request.size(), MSG_NOSIGNAL) ==
+          static_cast<ssize_t>(request.size())) {
+    char buffer[4096];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+      response.append(buffer, static_cast<size_t>(received));
+    }
+  }
+  close(fd);
+  return response;
+}
+
+std::string Get(uint16_t port,
+                const std::string& path,
+                const std::string& headers = std::string()) {
+  return RawRequest(port, "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n" +
+                              headers + "Connection: close\r\n\r\n");
+}
+
+std::string Body(const std::string& response) {
+  const size_t end = response.find("\r\n\r\n");
+  return end == std::string::npos ? std::string() : response.substr(end + 4);
+}
+
+class LoopbackServerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = TestTempDir("desktop_updater_server");
+    fs::remove_all(root_);
+    WriteFile(root_ / "release" / "data" / "app file.bin", "0123456789");
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  fs::path root_;
+};
+
+}  // namespace
+
+TEST_F(LoopbackServerTest, ServesFilesWithETag) {
+  LoopbackServer server(root_.string());
+  std::string error;
+  ASSERT_TRUE(server.Start(&error)) << error;
+
+  const std::string response =
+      Get(server.port(), "/release/data/app%20file.bin");
+  EXPECT_EQ(response.compare(0, 15, "HTTP/1.1 200 OK"), 0) << response;
+  const std::string etag =
+      LoopbackServer::ETagFor((root_ / "release/data/app file.bin").string());
+  ASSERT_FALSE(etag.empty());
+  EXPECT_NE(response.find("ETag: " + etag + "\r\n"), std::string::npos);
+  EXPECT_EQ(Body(response), "0123456789");
+
+  const std::string cached = Get(server.port(), "/release/data/app%20file.bin",
+                                 "If-None-Match: " + etag + "\r\n");
+  EXPECT_EQ(cached.compare(0, 25, "HTTP/1.1 304 Not Modified"), 0) << cached;
+  EXPECT_EQ(Body(cached), "");
+  EXPECT_EQ(server.stats().not_modified, 1u);
+}
+
+TEST_F(LoopbackServerTest, ServesByteRanges) {
+  LoopbackServer server(root_.string());
+  std::string error;
+  ASSERT_TRUE(server.Start(&error)) << error;
+  const std::string path = "/release/data/app%20file.bin";
+
+  std::string response = Get(server.port(), path, "Range: bytes=2-5\r\n");
+  EXPECT_EQ(response.compare(0, 12, "HTTP/1.1 206"), 0) << response;
+  EXPECT_NE(response.find("Content-Range: bytes 2-5/10\r\n"),
+            std::string::npos);
+  EXPECT_EQ(Body(response), "2345");
+
+  EXPECT_EQ(Body(Get(server.port(), path, "Range: bytes=7-\r\n")), "789");
+  EXPECT_EQ(Body(Get(server.port(), path, "Range: bytes=-3\r\n")), "789");
+
+  response = Get(server.port(), path, "Range: bytes=10-\r\n");
+  EXPECT_EQ(response.compare(0, 12, "HTTP/1.1 416"), 0) << response;
+  EXPECT_NE(response.find("Content-Range: bytes */10\r\n"), std::string::npos);
+
+  // A stale If-Range validator gets the whole, current file.
+  response = Get(server.port(), path,
+                 "Range: bytes=2-5\r\nIf-Range: \"stale\"\r\n");
+  EXPECT_EQ(response.compare(0, 12, "HTTP/1.1 200"), 0) << response;
+  EXPECT_EQ(Body(response), "0123456789");
+}
+
+TEST_F(LoopbackServerTest, RejectsMissingAndEscapingPaths) {
+  LoopbackServer server(root_.string());
+  std::string error;
+  ASSERT_TRUE(server.Start(&error)) << error;
+
+  EXPECT_EQ(Get(server.port(), "/release/missing").compare(0, 12,
+                                                            "HTTP/1.1 404"),
+            0);
+  EXPECT_EQ(Get(server.port(), "/release/%2e%2e/%2e%2e/etc/passwd")
+                .compare(0, 12, "HTTP/1.1 404"),
+            0);
+  EXPECT_EQ(RawRequest(server.port(), "DELETE /release HTTP/1.1\r\n\r\n")
+                .compare(0, 12, "HTTP/1.1 405"),
+            0);
+}
+
+TEST_F(LoopbackServerTest, InjectsLatencyAndBandwidthLimits) {
+  WriteFile(root_ / "release" / "big.bin", std::string(64 * 1024, 'x'));
+  LoopbackServerOptions options;
+  options.latency_ms = 50;
+  options.bytes_per_second = 512 * 1024;
+  LoopbackServer server(root_.string(), options);
+  std::string error;
+  ASSERT_TRUE(server.Start(&error)) << error;
+
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(Body(Get(server.port(), "/release/big.bin")).size(), 64u * 1024);
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  // 50 ms of latency plus 125 ms of transfer.
+  EXPECT_GE(elapsed, std::chrono::milliseconds(170));
+}
+
+TEST_F(LoopbackServerTest, ResetsConnectionMidBody) {
+  WriteFile(root_ / "release" / "big.bin", std::string(64 * 1024, 'x'));
+  LoopbackServerOptions options;
+  options.reset_after_bytes = 1000;
+  options.resets = 1;
+  LoopbackServer server(root_.string(), options);
+  std::string error;
+  ASSERT_TRUE(server.Start(&error)) << error;
+
+  EXPECT_LE(Body(Get(server.port(), "/release/big.bin")).size(), 1000u);
+  // Only the first response is cut short.
+  EXPECT_EQ(Body(Get(server.port(), "/release/big.bin")).size(), 64u * 1024);
+  EXPECT_EQ(server.stats().resets, 1u);
+}
+
+// Fetch -> verify -> stage over real HTTP, as the plugin does it.
+TEST_F(LoopbackServerTest, DownloadsAndStagesRelease) {
+  const fs::path release = root_ / "release";
+  WriteFile(release / "example", std::string(300 * 1024, 'e'));
+  WriteFile(release / "lib" / "libapp.so", std::string(2 * 1024 * 1024, 'l'));
+  Manifest files;
+  std::string error;
+  ASSERT_TRUE(HashTree(release.string(), ScanOptions(), 2, &files, &error))
+      << error;
+
+  LoopbackServer server(root_.string());
+  ASSERT_TRUE(server.Start(&error)) << error;
+  CurlFetcher fetcher;
+  ProgressTracker tracker;
+  DownloadEngine engine(&fetcher, &tracker);
+  std::vector<DownloadItem> items;
+  for (const FileEntry& entry : files) {
+    items.push_back({entry.path, entry.length, entry.object, {}});
+  }
+  const fs::path staging = root_ / "app" / kStagingDirName;
+  ASSERT_TRUE(engine.Run(server.url() + "/release", items, staging.string(),
+                         DownloadOptions(), &error))
+      << error;
+  ASSERT_TRUE(VerifyAndStage(staging.string(), files, 2, &error)) << error;
+  EXPECT_TRUE(HasPendingUpdate((root_ / "app").string()));
+  EXPECT_EQ(ReadFile(staging / "data" / "app file.bin"), "0123456789");
+}
+
+TEST_F(LoopbackServerTest, DownloadFailsOnConnectionReset) {
+  WriteFile(root_ / "release" / "big.bin", std::string(256 * 1024, 'x'));
+  LoopbackServerOptions options;
+  options.reset_after_bytes = 64 * 1024;
+  LoopbackServer server(root_.string(), options);
+  std::string error;
+  ASSERT_TRUE(server.Start(&error)) << error;
+
+  CurlFetcher fetcher;
+  ProgressTracker tracker;
+  DownloadEngine engine(&fetcher, &tracker);
+  EXPECT_FALSE(engine.Run(server.url() + "/release",
+                          {{"big.bin", 256 * 1024, "", {}}},
+                          (root_ / "staging").string(), DownloadOptions(),
+                          &error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_EQ(tracker.Sample(std::chrono::steady_clock::now()).received_bytes,
+            0u);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,237 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include "desktop_updater_core.h"
+#include "json.h"
+#include "manifest.h"
+#include "manifest_index.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+std::string HashOf(char fill) {
+  const std::string raw(64, fill);
+  return Base64Encode(reinterpret_cast<const uint8_t*>(raw.data()),
+                      raw.size());
+}
+
+std::string Entry(const std::string& path, char fill, int length) {
+  return "{\"path\":\"" + path + "\",\"calculatedHash\":\"" + HashOf(fill) +
+         "\",\"length\":" + std::to_string(length) + "}";
+}
+
+uint32_t ReadU32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+}  // namespace
+
+TEST(Json, ParsesNestedDocument) {
+  const std::string text =
+      "{\"appName\":\"A \\u00e9\\ud83d\\ude00\",\"items\":[{\"shortVersion\":"
+      "9,\"mandatory\":true,\"ratio\":1.5e2}],\"none\":null}";
+  JsonValue root;
+  std::string error;
+  ASSERT_TRUE(JsonValue::Parse(text.data(), text.size(), &root, &error))
+      << error;
+  EXPECT_EQ(root.GetString("appName"), "A \xc3\xa9\xf0\x9f\x98\x80");
+  const JsonValue* items = root.Find("items");
+  ASSERT_NE(items, nullptr);
+  ASSERT_EQ(items->array_items().size(), 1u);
+  EXPECT_EQ(items->array_items()[0].GetInt("shortVersion"), 9);
+  EXPECT_TRUE(items->array_items()[0].GetBool("mandatory"));
+  EXPECT_DOUBLE_EQ(items->array_items()[0].Find("ratio")->number_value(), 150);
+  EXPECT_TRUE(root.Find("none")->is_null());
+}
+
+TEST(Json, RejectsMalformedInput) {
+  JsonValue root;
+  std::string error;
+  for (const char* text : {"{", "[1,]", "{\"a\" 1}", "\"\\x\"", "[] x"}) {
+    EXPECT_FALSE(JsonValue::Parse(text, strlen(text), &root, &error)) << text;
+  }
+}
+
+TEST(Json, WriterEscapesStrings) {
+  JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("path");
+  writer.String("a\"b\\c\n");
+  writer.Key("list");
+  writer.BeginArray();
+  writer.Int(-1);
+  writer.Bool(false);
+  writer.EndArray();
+  writer.EndObject();
+  EXPECT_EQ(writer.str(), "{\"path\":\"a\\\"b\\\\c\\n\",\"list\":[-1,false]}");
+}
+
+TEST(Manifest, RoundTrips) {
+  const std::string text = "[" + Entry("lib/libapp.so", 'a', 10) + "]";
+  Manifest manifest;
+  std::string error;
+  ASSERT_TRUE(ParseManifest(text.data(), text.size(), &manifest, &error))
+      << error;
+  ASSERT_EQ(manifest.size(), 1u);
+  EXPECT_EQ(manifest[0].length, 10u);
+  EXPECT_EQ(SerializeManifest(manifest), text);
+}
+
+TEST(Manifest, RoundTripsPatches) {
+  const std::string text =
+      "[{\"path\":\"app\",\"calculatedHash\":\"" + HashOf('b') +
+      "\",\"length\":5,\"patches\":[{\"from\":\"" + HashOf('a') +
+      "\",\"path\":\"patches/app.1\",\"length\":2}]}]";
+  Manifest manifest;
+  std::string error;
+  ASSERT_TRUE(ParseManifest(text.data(), text.size(), &manifest, &error))
+      << error;
+  ASSERT_EQ(manifest[0].patches.size(), 1u);
+  EXPECT_EQ(manifest[0].patches[0].path, "patches/app.1");
+  EXPECT_EQ(manifest[0].patches[0].from[0], 'a');
+  EXPECT_EQ(SerializeManifest(manifest), text);
+}
+
+TEST(Manifest, BinaryFormatRoundTrips) {
+  const std::string text =
+      "[" + Entry("lib/libapp.so", 'a', 10) + "," +
+      "{\"path\":\"app\",\"calculatedHash\":\"" + HashOf('b') +
+      "\",\"length\":300,\"object\":\"../objects/bb\",\"patches\":[{"
+      "\"from\":\"" + HashOf('a') +
+      "\",\"path\":\"patches/app.1\",\"length\":2}]}]";
+  Manifest manifest;
+  std::string error;
+  ASSERT_TRUE(ParseManifest(text.data(), text.size(), &manifest, &error))
+      << error;
+
+  const std::string binary = SerializeBinaryManifest(manifest);
+  EXPECT_EQ(binary.compare(0, kBinaryManifestMagicSize, kBinaryManifestMagic),
+            0);
+  Manifest parsed;
+  ASSERT_TRUE(ParseBinaryManifest(binary.data(), binary.size(), &parsed,
+                                  &error))
+      << error;
+  EXPECT_EQ(SerializeManifest(parsed), text);
+
+  // Every truncation is rejected rather than read past the end.
+  for (size_t size = 0; size < binary.size(); size++) {
+    EXPECT_FALSE(ParseBinaryManifest(binary.data(), size, &parsed, &error))
+        << size;
+  }
+}
+
+TEST(Manifest, DiffFindsChangedAddedAndRemoved) {
+  const std::string installed_text = "[" + Entry("data\\\\icudtl.dat", 'a', 1) +
+                                     "," + Entry("lib/old.so", 'b', 2) + "," +
+                                     Entry("app", 'c', 3) + "]";
+  const std::string target_text = "[" + Entry("data/icudtl.dat", 'a', 1) +
+                                  "," + Entry("app", 'd', 3) + "," +
+                                  Entry("lib/new.so", 'e', 4) + "]";
+  Manifest installed;
+  Manifest target;
+  std::string error;
+  ASSERT_TRUE(ParseManifest(installed_text.data(), installed_text.size(),
+                            &installed, &error));
+  ASSERT_TRUE(
+      ParseManifest(target_text.data(), target_text.size(), &target, &error));
+
+  const ManifestDiff diff = DiffManifests(installed, target);
+  ASSERT_EQ(diff.changed.size(), 2u);
+  EXPECT_EQ(diff.changed[0].path, "app");
+  EXPECT_EQ(diff.changed[1].path, "lib/new.so");
+  ASSERT_EQ(diff.removed.size(), 1u);
+  EXPECT_EQ(diff.removed[0].path, "lib/old.so");
+}
+
+TEST(Manifest, ShardsDiffLikeTheWholeManifest) {
+  const std::string installed_text =
+      "[" + Entry("app", 'a', 1) + "," + Entry("lib/old.so", 'b', 2) + "," +
+      Entry("data/flutter_assets/a.png", 'c', 3) + "]";
+  const std::string target_text =
+      "[" + Entry("app", 'a', 1) + "," +
+      Entry("data\\\\flutter_assets\\\\a.png", 'd', 3) + "," +
+      Entry("data/icudtl.dat", 'e', 4) + "," + Entry("lib/new.so", 'f', 5) +
+      "]";
+  Manifest installed;
+  Manifest target;
+  std::string error;
+  ASSERT_TRUE(ParseManifest(installed_text.data(), installed_text.size(),
+                            &installed, &error));
+  ASSERT_TRUE(
+      ParseManifest(target_text.data(), target_text.size(), &target, &error));
+
+  ManifestIndex index;
+  std::vector<Manifest> shards;
+  ShardManifest(target, 2, &index, &shards);
+  ASSERT_EQ(index.size(), 4u);
+  EXPECT_EQ(index[0].dir, "");
+  EXPECT_EQ(index[1].dir, "data");
+  EXPECT_EQ(index[2].dir, "data/flutter_assets");
+  EXPECT_EQ(index[3].dir, "lib");
+  EXPECT_EQ(index[2].entries, 1u);
+  EXPECT_EQ(shards[2][0].path, "data\\flutter_assets\\a.png");
+
+  ManifestDiffer differ(installed);
+  for (const Manifest& shard : shards) {
+    differ.Add(shard);
+  }
+  const ManifestDiff sharded = differ.Finish();
+  const ManifestDiff whole = DiffManifests(installed, target);
+  ASSERT_EQ(sharded.changed.size(), 3u);
+  EXPECT_EQ(sharded.changed.size(), whole.changed.size());
+  ASSERT_EQ(sharded.removed.size(), 1u);
+  EXPECT_EQ(sharded.removed[0].path, "lib/old.so");
+
+  for (size_t i = 0; i < index.size(); i++) {
+    index[i].path = "shards/" + std::to_string(i) + ".json";
+    index[i].length = 40 + i;
+    index[i].digest.fill(static_cast<uint8_t>(i));
+  }
+  const std::string text = SerializeManifestIndex(index);
+  ManifestIndex parsed;
+  ASSERT_TRUE(ParseManifestIndex(text.data(), text.size(), &parsed, &error))
+      << error;
+  EXPECT_EQ(SerializeManifestIndex(parsed), text);
+  const std::string no_path = "{\"shards\":[{\"dir\":\"lib\"}]}";
+  EXPECT_FALSE(
+      ParseManifestIndex(no_path.data(), no_path.size(), &parsed, &error));
+}
+
+TEST(CoreAbi, DiffReturnsPackedRecords) {
+  const std::string installed = "[" + Entry("a", 'a', 1) + "]";
+  const std::string target = "[" + Entry("b", 'b', 7) + "]";
+  du_result* result = du_diff_manifests(installed.data(), installed.size(),
+                                        target.data(), target.size());
+  ASSERT_NE(result, nullptr);
+  ASSERT_EQ(result->status, DU_OK) << result->error;
+
+  const uint8_t* p = result->data;
+  EXPECT_EQ(ReadU32(p), static_cast<uint32_t>(DU_RECORDS_VERSION));
+  EXPECT_EQ(ReadU32(p + 4), 2u);
+  p += 8;
+  EXPECT_EQ(p[0], 7);  // length, low byte
+  EXPECT_EQ(ReadU32(p + 8), 1u);
+  EXPECT_EQ(p[12], DU_RECORD_CHANGED);
+  EXPECT_EQ(p[16], 'b');
+  EXPECT_EQ(p[16 + DU_DIGEST_SIZE], 'b');
+  p += 16 + DU_DIGEST_SIZE + 1;
+  EXPECT_EQ(p[12], DU_RECORD_REMOVED);
+  EXPECT_EQ(p + 16 + DU_DIGEST_SIZE + 1, result->data + result->size);
+  du_result_free(result);
+}
+
+TEST(CoreAbi, ReportsParseErrors) {
+  du_result* result = du_parse_manifest("{", 1);
+  ASSERT_NE(result, nullptr);
+  EXPECT_EQ(result->status, DU_ERROR_PARSE);
+  EXPECT_EQ(result->data, nullptr);
+  EXPECT_GT(strlen(result->error), 0u);
+  du_result_free(result);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "counting_allocator.h"
+#include "file_hash.h"
+#include "file_util.h"
+#include "metrics.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+uint64_t CounterValue(const MetricsSnapshot& snapshot, Counter counter) {
+  return snapshot.counters[static_cast<size_t>(counter)];
+}
+
+const PhaseSummary& PhaseValue(const MetricsSnapshot& snapshot, Phase phase) {
+  return snapshot.phases[static_cast<size_t>(phase)];
+}
+
+}  // namespace
+
+TEST(LatencyHistogramTest, BucketsBoundRelativeError) {
+  for (uint64_t value : {0ull, 1ull, 15ull, 16ull, 17ull, 1000ull, 123456ull,
+                         (1ull << 40) + 12345, ~0ull}) {
+    const size_t index = LatencyHistogram::BucketIndex(value);
+    ASSERT_LT(index, LatencyHistogram::kBucketCount) << value;
+    const uint64_t upper = LatencyHistogram::BucketUpperBound(index);
+    EXPECT_GE(upper, value);
+    EXPECT_LE(static_cast<double>(upper - value),
+              static_cast<double>(value) / 16.0)
+        << value;
+  }
+}
+
+TEST(LatencyHistogramTest, ReportsPercentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.ValueAtPercentile(50), 0u);
+  for (uint64_t value = 1; value <= 1000; value++) {
+    histogram.Record(value);
+  }
+  EXPECT_EQ(histogram.count(), 1000u);
+  EXPECT_EQ(histogram.sum(), 500500u);
+  EXPECT_EQ(histogram.max(), 1000u);
+  EXPECT_NEAR(static_cast<double>(histogram.ValueAtPercentile(50)), 500,
+              500 / 16.0);
+  EXPECT_NEAR(static_cast<double>(histogram.ValueAtPercentile(99)), 990,
+              990 / 16.0);
+  EXPECT_EQ(histogram.ValueAtPercentile(100), 1000u);
+
+  histogram.Reset();
+  EXPECT_EQ(histogram.count(), 0u);
+  EXPECT_EQ(histogram.ValueAtPercentile(50), 0u);
+}
+
+TEST(MetricsTest, CountsScannedAndHashedFiles) {
+  const fs::path root = TestTempDir("desktop_updater_metrics");
+  fs::remove_all(root);
+  fs::create_directories(root);
+  std::string error;
+  const std::vector<uint8_t> data(1000, 'x');
+  ASSERT_TRUE(WriteFileBytes((root / "a.bin").string(), data.data(),
+                             data.size(), &error))
+      << error;
+  ASSERT_TRUE(WriteFileBytes((root / "b.bin").string(), data.data(), 10,
+                             &error))
+      << error;
+
+  ResetMetrics();
+  Manifest manifest;
+  ASSERT_TRUE(HashTree(root.string(), ScanOptions(), 2, &manifest, &error))
+      << error;
+  fs::remove_all(root);
+
+  const MetricsSnapshot snapshot = SnapshotMetrics();
+  EXPECT_EQ(CounterValue(snapshot, Counter::kFilesScanned), 2u);
+  EXPECT_EQ(CounterValue(snapshot, Counter::kFilesHashed), 2u);
+  EXPECT_EQ(CounterValue(snapshot, Counter::kBytesHashed), 1010u);
+  EXPECT_EQ(PhaseValue(snapshot, Phase::kScan).count, 1u);
+  EXPECT_EQ(PhaseValue(snapshot, Phase::kHash).count, 1u);
+  EXPECT_EQ(PhaseValue(snapshot, Phase::kApply).count, 0u);
+
+  ResetMetrics();
+  const MetricsSnapshot cleared = SnapshotMetrics();
+  EXPECT_EQ(CounterValue(cleared, Counter::kBytesHashed), 0u);
+  EXPECT_EQ(PhaseValue(cleared, Phase::kScan).count, 0u);
+}
+
+TEST(MetricsTest, AttributesAllocationsToOpenPhases) {
+  ResetMetrics();
+  constexpr size_t kSize = 1 << 20;
+  {
+    PhaseScope scope(Phase::kDiff);
+    ByteBuffer buffer(kSize);
+    // Nested phases see the allocation too.
+    PhaseScope nested(Phase::kCheck);
+    ByteBuffer more(kSize);
+  }
+  ByteBuffer outside(kSize);
+
+  const MetricsSnapshot snapshot = SnapshotMetrics();
+  const PhaseSummary& diff = PhaseValue(snapshot, Phase::kDiff);
+  const PhaseSummary& check = PhaseValue(snapshot, Phase::kCheck);
+  EXPECT_EQ(diff.allocated_bytes, 2 * kSize);
+  EXPECT_GE(diff.peak_allocated_bytes, 2 * kSize);
+  EXPECT_EQ(check.allocated_bytes, kSize);
+  EXPECT_EQ(PhaseValue(snapshot, Phase::kHash).allocated_bytes, 0u);
+  EXPECT_GE(CounterValue(snapshot, Counter::kBytesAllocated), 3 * kSize);
+  EXPECT_GE(snapshot.live_allocated_bytes, kSize);
+  EXPECT_GE(snapshot.peak_allocated_bytes, 2 * kSize);
+}
+
+TEST(MetricsTest, SamplesProcessMemoryAtPhaseBoundaries) {
+  ResetMetrics();
+  { PhaseTimer timer(Phase::kScan); }
+  { PhaseTimer timer(Phase::kFetchFile); }
+  const MetricsSnapshot snapshot = SnapshotMetrics();
+  EXPECT_GT(PhaseValue(snapshot, Phase::kScan).max_rss_bytes, 0u);
+  // Per-file phases are not sampled.
+  EXPECT_EQ(PhaseValue(snapshot, Phase::kFetchFile).max_rss_bytes, 0u);
+}
+
+TEST(MetricsTest, NamesEveryCounterAndPhase) {
+  for (size_t i = 0; i < kCounterCount; i++) {
+    EXPECT_STRNE(CounterName(static_cast<Counter>(i)), "");
+  }
+  for (size_t i = 0; i < kPhaseCount; i++) {
+    EXPECT_STRNE(PhaseName(static_cast<Phase>(i)), "");
+  }
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+#include "perf_counters.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+constexpr size_t kPageFaults = static_cast<size_t>(PerfEvent::kPageFaults);
+
+class PerfCountersTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ResetMetrics(); }
+
+  void TearDown() override {
+    std::string error;
+    SetPerfCountersEnabled(false, &error);
+    ResetMetrics();
+  }
+};
+
+// Touches fresh pages, which the page fault counter always sees.
+void TouchMemory() {
+  constexpr size_t kSize = 8 << 20;
+  std::unique_ptr<char[]> memory(new char[kSize]);
+  for (size_t i = 0; i < kSize; i += 4096) {
+    memory[i] = static_cast<char>(i);
+  }
+  volatile char sink = memory[kSize / 2];
+  (void)sink;
+}
+
+uint64_t ScanPageFaults() {
+  return SnapshotMetrics()
+      .phases[static_cast<size_t>(Phase::kScan)]
+      .perf[kPageFaults];
+}
+
+}  // namespace
+
+TEST_F(PerfCountersTest, CountsNothingWhileDisabled) {
+  {
+    PhaseScope scope(Phase::kScan);
+    TouchMemory();
+  }
+  EXPECT_EQ(ScanPageFaults(), 0u);
+  EXPECT_FALSE(SnapshotMetrics().perf_enabled);
+}
+
+TEST_F(PerfCountersTest, AttributesCountersToPhases) {
+  std::string error;
+  if (!SetPerfCountersEnabled(true, &error)) {
+    // Sandboxes may refuse perf_event_open altogether; that must be
+    // explained rather than fail the update.
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(PerfCountersEnabled());
+    GTEST_SKIP() << error;
+  }
+  if ((AvailablePerfEvents() & (1u << kPageFaults)) == 0) {
+    GTEST_SKIP() << "page fault counter unavailable: " << PerfCountersError();
+  }
+
+  {
+    PhaseScope scope(Phase::kScan);
+    TouchMemory();
+    // Already counted by the enclosing scope.
+    PhaseScope nested(Phase::kScan);
+  }
+  const uint64_t single_thread = ScanPageFaults();
+  EXPECT_GE(single_thread, 1000u);
+
+  // Worker threads add their own counts to the phase.
+  std::thread worker([]() {
+    PhaseScope scope(Phase::kScan);
+    TouchMemory();
+  });
+  worker.join();
+  EXPECT_GE(ScanPageFaults(), single_thread + 1000);
+
+  const MetricsSnapshot snapshot = SnapshotMetrics();
+  EXPECT_TRUE(snapshot.perf_enabled);
+  EXPECT_NE(snapshot.perf_events & (1u << kPageFaults), 0u);
+  EXPECT_EQ(snapshot.phases[static_cast<size_t>(Phase::kHash)]
+                .perf[kPageFaults],
+            0u);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "progress_tracker.h"
+
+namespace desktop_updater {
+namespace test {
+
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+TEST(ProgressTracker, EstimatesRateAndEta) {
+  ProgressTracker tracker;
+  tracker.Reset(10000, 2);
+  const steady_clock::time_point start = steady_clock::now();
+
+  tracker.Sample(start);
+  tracker.AddBytes(1000);
+  ProgressSnapshot snapshot = tracker.Sample(start + milliseconds(1000));
+
+  EXPECT_EQ(snapshot.received_bytes, 1000u);
+  EXPECT_DOUBLE_EQ(snapshot.bytes_per_second, 1000.0);
+  EXPECT_DOUBLE_EQ(snapshot.eta_seconds, 9.0);
+
+  // A burst only moves the average part of the way.
+  tracker.AddBytes(4000);
+  snapshot = tracker.Sample(start + milliseconds(2000));
+  EXPECT_GT(snapshot.bytes_per_second, 1000.0);
+  EXPECT_LT(snapshot.bytes_per_second, 4000.0);
+}
+
+TEST(ProgressTracker, EtaUnknownUntilRateIsKnown) {
+  ProgressTracker tracker;
+  tracker.Reset(100, 1);
+  const ProgressSnapshot snapshot = tracker.Sample(steady_clock::now());
+  EXPECT_LT(snapshot.eta_seconds, 0);
+  EXPECT_FALSE(snapshot.done);
+}
+
+TEST(ProgressEmitter, CoalescesUpdates) {
+  ProgressTracker tracker;
+  tracker.Reset(1000000, 1);
+
+  std::mutex mutex;
+  std::vector<ProgressSnapshot> events;
+  ProgressEmitter emitter(&tracker, 20, [&](const ProgressSnapshot& snapshot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(snapshot);
+  });
+  emitter.Start();
+
+  // Thousands of chunk reports over ~200ms.
+  const steady_clock::time_point end = steady_clock::now() + milliseconds(200);
+  while (steady_clock::now() < end) {
+    tracker.AddBytes(1);
+    std::this_thread::yield();
+  }
+  tracker.CompleteFile();
+  tracker.MarkDone();
+  emitter.Stop();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  ASSERT_FALSE(events.empty());
+  // 20 Hz over 200ms plus the final snapshot, with slack for scheduling.
+  EXPECT_LE(events.size(), 8u);
+  EXPECT_TRUE(events.back().done);
+  EXPECT_EQ(events.back().completed_files, 1u);
+}
+
+TEST(ProgressEmitter, SkipsIdleTicks) {
+  ProgressTracker tracker;
+  tracker.Reset(10, 1);
+
+  int count = 0;
+  ProgressEmitter emitter(&tracker, 100,
+                          [&](const ProgressSnapshot&) { count++; });
+  emitter.Start();
+  std::this_thread::sleep_for(milliseconds(100));
+  emitter.Stop();
+
+  // One emission for the initial state and one final snapshot.
+  EXPECT_LE(count, 2);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,291 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "file_clone.h"
+#include "file_hash.h"
+#include "file_util.h"
+#include "manifest_index.h"
+#include "release_packer.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class ReleasePackerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = TestTempDir("desktop_updater_release_packer");
+    fs::remove_all(root_);
+    source_ = root_ / "app-1.0.1+2-linux";
+    output_ = root_ / "1.0.1+2-linux";
+    WriteFile(source_ / "app", "binary");
+    fs::permissions(source_ / "app", fs::perms::owner_exec,
+                    fs::perm_options::add);
+    WriteFile(source_ / "lib" / "libapp.so", std::string(3 << 20, 'a'));
+    WriteFile(source_ / "data" / "flutter_assets" / "AssetManifest.json",
+              "{}");
+    WriteFile(source_ / "data" / ".DS_Store", "finder");
+    // Left over from an earlier archive run.
+    WriteFile(source_ / "hashes.json", "[]");
+    fs::create_symlink("libapp.so", source_ / "lib" / "libapp_link.so");
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  fs::path root_;
+  fs::path source_;
+  fs::path output_;
+};
+
+}  // namespace
+
+TEST_F(ReleasePackerTest, CopiesAndHashesInOnePass) {
+  PackOptions options;
+  options.threads = 3;
+  options.separator = '/';
+  Manifest manifest;
+  PackStats stats;
+  std::string error;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+
+  ASSERT_EQ(manifest.size(), 3u);
+  EXPECT_EQ(manifest[0].path, "app");
+  EXPECT_EQ(manifest[1].path, "data/flutter_assets/AssetManifest.json");
+  EXPECT_EQ(manifest[2].path, "lib/libapp.so");
+  EXPECT_EQ(stats.files, 3u);
+  EXPECT_EQ(stats.bytes, 6u + 2u + (3u << 20));
+  EXPECT_EQ(stats.symlinks, 1u);
+
+  // The copy hashes to what the packer recorded while writing it.
+  ScanOptions scan;
+  scan.separator = '/';
+  scan.exclude = {kHashesJsonName, kHashesBinName};
+  Manifest copied;
+  ASSERT_TRUE(HashTree(output_.string(), scan, 1, &copied, &error)) << error;
+  EXPECT_EQ(SerializeManifest(copied), SerializeManifest(manifest));
+
+  EXPECT_FALSE(fs::exists(output_ / "data" / ".DS_Store"));
+  EXPECT_TRUE(fs::is_symlink(output_ / "lib" / "libapp_link.so"));
+  EXPECT_EQ(fs::read_symlink(output_ / "lib" / "libapp_link.so"),
+            "libapp.so");
+  EXPECT_NE(fs::status(output_ / "app").permissions() & fs::perms::owner_exec,
+            fs::perms::none);
+
+  EXPECT_EQ(ReadFile(output_ / kHashesJsonName), SerializeManifest(manifest));
+  const std::string binary = ReadFile(output_ / kHashesBinName);
+  Manifest parsed;
+  ASSERT_TRUE(
+      ParseBinaryManifest(binary.data(), binary.size(), &parsed, &error))
+      << error;
+  EXPECT_EQ(SerializeManifest(parsed), SerializeManifest(manifest));
+}
+
+TEST_F(ReleasePackerTest, OutputIsDeterministic) {
+  PackOptions options;
+  options.threads = 1;
+  Manifest manifest;
+  PackStats stats;
+  std::string error;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+  const std::string json = ReadFile(output_ / kHashesJsonName);
+  const std::string binary = ReadFile(output_ / kHashesBinName);
+
+  fs::remove_all(output_);
+  options.threads = 8;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+  EXPECT_EQ(ReadFile(output_ / kHashesJsonName), json);
+  EXPECT_EQ(ReadFile(output_ / kHashesBinName), binary);
+}
+
+TEST_F(ReleasePackerTest, HashesInPlace) {
+  PackOptions options;
+  Manifest manifest;
+  PackStats stats;
+  std::string error;
+  ASSERT_TRUE(PackRelease(source_.string(), source_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+  EXPECT_EQ(manifest.size(), 3u);
+  // The stale manifest is replaced, not listed.
+  EXPECT_EQ(ReadFile(source_ / kHashesJsonName), SerializeManifest(manifest));
+}
+
+TEST_F(ReleasePackerTest, HardLinkModeSharesInodes) {
+  PackOptions options;
+  options.stage = StageMode::kHardLink;
+  Manifest manifest;
+  PackStats stats;
+  std::string error;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+  EXPECT_EQ(stats.hard_linked, 3u);
+  EXPECT_EQ(stats.verified_shared, 3u);
+  EXPECT_EQ(CheckSharedStorage((source_ / "lib" / "libapp.so").string(),
+                               (output_ / "lib" / "libapp.so").string()),
+            SharedStorage::kShared);
+
+  // Copying over the linked tree replaces the links instead of writing
+  // through them into the source.
+  WriteFile(source_ / "app", "rebuilt");
+  options.stage = StageMode::kCopy;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+  EXPECT_EQ(stats.copied, 3u);
+  EXPECT_EQ(stats.verified_shared, 0u);
+  EXPECT_NE(CheckSharedStorage((source_ / "app").string(),
+                               (output_ / "app").string()),
+            SharedStorage::kShared);
+  EXPECT_EQ(ReadFile(source_ / "app"), "rebuilt");
+  EXPECT_EQ(ReadFile(output_ / "app"), "rebuilt");
+}
+
+TEST_F(ReleasePackerTest, AutoModeFallsBackToCopies) {
+  PackOptions options;
+  options.write_manifests = false;
+  Manifest manifest;
+  PackStats stats;
+  std::string error;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+  // Whatever the filesystem offers, every file is staged exactly once and
+  // never as a hard link.
+  EXPECT_EQ(stats.reflinked + stats.copy_ranged + stats.copied, 3u);
+  EXPECT_EQ(stats.hard_linked, 0u);
+  EXPECT_EQ(ReadFile(output_ / "lib" / "libapp.so"),
+            ReadFile(source_ / "lib" / "libapp.so"));
+  EXPECT_FALSE(fs::equivalent(source_ / "app", output_ / "app"));
+  EXPECT_FALSE(fs::exists(output_ / kHashesJsonName));
+}
+
+TEST_F(ReleasePackerTest, SharesObjectsAcrossReleases) {
+  const fs::path objects = root_ / "objects";
+  PackOptions options;
+  options.separator = '/';
+  options.objects_dir = objects.string();
+  Manifest first;
+  PackStats stats;
+  std::string error;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options, &first,
+                          &stats, &error))
+      << error;
+  EXPECT_EQ(stats.objects_published, 3u);
+  EXPECT_EQ(stats.objects_reused, 0u);
+  ASSERT_EQ(first.size(), 3u);
+  EXPECT_EQ(first[0].object, "../objects/" + ObjectName(first[0].digest));
+  EXPECT_EQ(ReadFile(objects / ObjectName(first[0].digest)), "binary");
+
+  // The next release only adds what changed, and keeps nothing but its
+  // manifests.
+  WriteFile(source_ / "app", "rebuilt");
+  const fs::path next = root_ / "1.0.2+3-linux";
+  options.objects_only = true;
+  Manifest second;
+  ASSERT_TRUE(PackRelease(source_.string(), next.string(), options, &second,
+                          &stats, &error))
+      << error;
+  EXPECT_EQ(stats.objects_published, 1u);
+  EXPECT_EQ(stats.objects_reused, 2u);
+  EXPECT_NE(second[0].object, first[0].object);
+  EXPECT_EQ(second[2].object, first[2].object);
+  EXPECT_EQ(ReadFile(objects / ObjectName(second[0].digest)), "rebuilt");
+  EXPECT_FALSE(fs::exists(next / "app"));
+  EXPECT_FALSE(fs::exists(next / "lib" / "libapp.so"));
+  EXPECT_EQ(ReadFile(next / kHashesJsonName), SerializeManifest(second));
+
+  options.objects_dir = (output_ / "objects").string();
+  EXPECT_FALSE(PackRelease(source_.string(), output_.string(), options,
+                           &second, &stats, &error));
+}
+
+TEST_F(ReleasePackerTest, ObjectsDoNotShareTheBuildInPlace) {
+  for (const StageMode stage : {StageMode::kAuto, StageMode::kHardLink}) {
+    const fs::path objects = root_ / "objects";
+    fs::remove_all(objects);
+    WriteFile(source_ / "app", "binary");
+    PackOptions options;
+    options.stage = stage;
+    options.objects_dir = objects.string();
+    Manifest manifest;
+    PackStats stats;
+    std::string error;
+    ASSERT_TRUE(PackRelease(source_.string(), source_.string(), options,
+                            &manifest, &stats, &error))
+        << error;
+    ASSERT_EQ(manifest.size(), 3u);
+
+    // The next build writes through the same inode.
+    WriteFile(source_ / "app", "relink");
+    const fs::path object = objects / ObjectName(manifest[0].digest);
+    Digest digest;
+    uint64_t length = 0;
+    ASSERT_TRUE(HashFile(object.string(), &digest, &length, &error)) << error;
+    EXPECT_EQ(digest, manifest[0].digest);
+    EXPECT_EQ(ReadFile(object), "binary");
+  }
+}
+
+TEST_F(ReleasePackerTest, WritesManifestShards) {
+  PackOptions options;
+  options.shard_depth = 1;
+  Manifest manifest;
+  PackStats stats;
+  std::string error;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error))
+      << error;
+  EXPECT_EQ(stats.shards, 3u);
+  const std::string text = ReadFile(output_ / kManifestIndexName);
+  ManifestIndex index;
+  ASSERT_TRUE(ParseManifestIndex(text.data(), text.size(), &index, &error))
+      << error;
+  ASSERT_EQ(index.size(), 3u);
+  EXPECT_EQ(index[1].dir, "data");
+  const std::string shard = ReadFile(output_ / index[1].path);
+  EXPECT_EQ(shard.size(), index[1].length);
+  Manifest parsed;
+  ASSERT_TRUE(ParseManifest(shard.data(), shard.size(), &parsed, &error));
+  ASSERT_EQ(parsed.size(), 1u);
+  EXPECT_EQ(NormalizeRelativePath(parsed[0].path),
+            "data/flutter_assets/AssetManifest.json");
+
+  // Repacking unsharded removes the index and its shards, and neither is
+  // ever listed in the manifest.
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error));
+  EXPECT_EQ(manifest.size(), 3u);
+  options.shard_depth = 0;
+  ASSERT_TRUE(PackRelease(source_.string(), output_.string(), options,
+                          &manifest, &stats, &error));
+  EXPECT_FALSE(fs::exists(output_ / kManifestIndexName));
+  EXPECT_FALSE(fs::exists(output_ / kManifestShardDirName));
+}
+
+TEST_F(ReleasePackerTest, RejectsOutputInsideSource) {
+  PackOptions options;
+  Manifest manifest;
+  PackStats stats;
+  std::string error;
+  EXPECT_FALSE(PackRelease(source_.string(), (source_ / "release").string(),
+                           options, &manifest, &stats, &error));
+  EXPECT_FALSE(fs::exists(source_ / "release"));
+  EXPECT_FALSE(PackRelease((root_ / "missing").string(), output_.string(),
+                           options, &manifest, &stats, &error));
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,314 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "delta.h"
+#include "elf_delta.h"
+#include "release_planner.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+ByteBuffer Bytes(const std::string& text) {
+  return ByteBuffer(text.begin(), text.end());
+}
+
+Digest DigestOf(char fill) {
+  Digest digest;
+  digest.fill(static_cast<uint8_t>(fill));
+  return digest;
+}
+
+FileEntry Entry(const std::string& path, char fill, uint64_t length) {
+  FileEntry entry;
+  entry.path = path;
+  entry.digest = DigestOf(fill);
+  entry.length = length;
+  return entry;
+}
+
+PatchRef Patch(char from, const std::string& path, uint64_t length) {
+  PatchRef patch;
+  patch.from = DigestOf(from);
+  patch.path = path;
+  patch.length = length;
+  return patch;
+}
+
+ReleaseManifest Release(int64_t version, Manifest manifest) {
+  ReleaseManifest release;
+  release.short_version = version;
+  release.url = "https://host/" + std::to_string(version);
+  release.manifest = std::move(manifest);
+  return release;
+}
+
+ByteBuffer RandomBytes(size_t size, uint32_t seed) {
+  std::mt19937 random(seed);
+  ByteBuffer bytes(size);
+  for (uint8_t& byte : bytes) {
+    byte = static_cast<uint8_t>(random());
+  }
+  return bytes;
+}
+
+ByteBuffer RoundTrip(const ByteBuffer& base, const ByteBuffer& target) {
+  const ByteBuffer delta = CreateDelta(base, target);
+  ByteBuffer out;
+  std::string error;
+  EXPECT_TRUE(ApplyDelta(base, delta, &out, &error)) << error;
+  EXPECT_TRUE(out == target);
+  return delta;
+}
+
+// An x86-64 ELF file with one code section of 256-byte functions, laid out
+// in the order of |layout|, that call functions 0 to |callees| - 1. Every
+// function has the same bytes wherever it is, apart from its calls.
+ByteBuffer FakeElf(const std::vector<int>& layout, int callees) {
+  constexpr size_t kCodeOffset = 64;
+  constexpr size_t kFunctionSize = 256;
+  std::vector<size_t> start(layout.size() * 2);
+  for (size_t i = 0; i < layout.size(); i++) {
+    start[static_cast<size_t>(layout[i])] = kCodeOffset + i * kFunctionSize;
+  }
+
+  ByteBuffer elf(kCodeOffset, 0);
+  const uint8_t ident[] = {0x7F, 'E', 'L', 'F', 2, 1, 1};
+  std::copy(std::begin(ident), std::end(ident), elf.begin());
+  elf[18] = 62;
+  for (const int function : layout) {
+    std::mt19937 random(static_cast<uint32_t>(function));
+    for (size_t i = 0; i < kFunctionSize; i += 16) {
+      for (int j = 0; j < 11; j++) {
+        elf.push_back(static_cast<uint8_t>(random()));
+      }
+      const size_t callee = start[random() % static_cast<uint32_t>(callees)];
+      const uint32_t rel = static_cast<uint32_t>(callee - (elf.size() + 5));
+      elf.push_back(0xE8);
+      for (int j = 0; j < 4; j++) {
+        elf.push_back(static_cast<uint8_t>(rel >> (8 * j)));
+      }
+    }
+  }
+
+  // Section headers: the null section and the code.
+  const uint64_t code_size = elf.size() - kCodeOffset;
+  const uint64_t shoff = elf.size();
+  elf.resize(elf.size() + 128, 0);
+  uint8_t* text = elf.data() + shoff + 64;
+  text[4] = 1;     // SHT_PROGBITS
+  text[8] = 0x6;   // SHF_ALLOC | SHF_EXECINSTR
+  for (int j = 0; j < 8; j++) {
+    text[0x18 + j] = static_cast<uint8_t>(kCodeOffset >> (8 * j));
+    text[0x20 + j] = static_cast<uint8_t>(code_size >> (8 * j));
+    elf[0x28 + j] = static_cast<uint8_t>(shoff >> (8 * j));
+  }
+  elf[0x3A] = 64;
+  elf[0x3C] = 2;
+  return elf;
+}
+
+PlannerOptions NoOverhead() {
+  PlannerOptions options;
+  options.request_overhead_bytes = 0;
+  return options;
+}
+
+}  // namespace
+
+TEST(Delta, AppliesCopiesAndInserts) {
+  const ByteBuffer base = Bytes("hello brave world");
+  const ByteBuffer insert = Bytes("new ");
+  DeltaWriter writer(15);
+  writer.Copy(0, 6);
+  writer.Insert(insert.data(), insert.size());
+  writer.Copy(12, 5);
+
+  ByteBuffer out;
+  std::string error;
+  ASSERT_TRUE(ApplyDelta(base, writer.data(), &out, &error)) << error;
+  EXPECT_EQ(std::string(out.begin(), out.end()), "hello new world");
+}
+
+TEST(Delta, RejectsOutOfRangeAndTruncatedDeltas) {
+  const ByteBuffer base = Bytes("abc");
+  ByteBuffer out;
+  std::string error;
+
+  DeltaWriter past_end(4);
+  past_end.Copy(1, 4);
+  EXPECT_FALSE(ApplyDelta(base, past_end.data(), &out, &error));
+
+  DeltaWriter truncated(10);
+  truncated.Copy(0, 3);
+  EXPECT_FALSE(ApplyDelta(base, truncated.data(), &out, &error));
+
+  EXPECT_FALSE(ApplyDelta(base, Bytes("DUDELTA0\x01"), &out, &error));
+}
+
+TEST(Delta, CreatesSmallDeltasForEditedFiles) {
+  const ByteBuffer base = RandomBytes(1 << 20, 1);
+
+  EXPECT_LT(RoundTrip(base, base).size(), 32u);
+
+  // A code-like edit: an inserted block, a deleted block and a 4-byte
+  // "address" changed every 256 bytes throughout.
+  ByteBuffer target = base;
+  const ByteBuffer inserted = RandomBytes(5000, 2);
+  target.insert(target.begin() + 100000, inserted.begin(), inserted.end());
+  target.erase(target.begin() + 600000, target.begin() + 620000);
+  for (size_t i = 0; i + 4 <= target.size(); i += 256) {
+    target[i] ^= 0x5A;
+    target[i + 3] ^= 0xA5;
+  }
+  const ByteBuffer delta = RoundTrip(base, target);
+  EXPECT_LT(delta.size(), target.size() / 8);
+}
+
+TEST(Delta, ElfDeltasFollowMovedCode) {
+  std::vector<int> layout;
+  for (int i = 0; i < 1000; i++) {
+    layout.push_back(i);
+  }
+  const ByteBuffer base = FakeElf(layout, 1000);
+  // A new function early on moves most of the code, and with it the
+  // displacement of every call across it.
+  layout.insert(layout.begin() + 300, 1000);
+  layout.erase(layout.begin() + 800);
+  const ByteBuffer target = FakeElf(layout, 1000);
+
+  std::vector<CodeRange> ranges;
+  EXPECT_EQ(FindElfCode(base, &ranges), ElfBranchArch::kX86_64);
+  ASSERT_EQ(ranges.size(), 1u);
+  EXPECT_EQ(ranges[0].offset, 64u);
+
+  const ByteBuffer plain = RoundTrip(base, target);
+  const ByteBuffer elf = CreateElfDelta(base, target);
+  ASSERT_TRUE(IsElfDelta(elf));
+  EXPECT_LT(elf.size() * 10, plain.size());
+  ByteBuffer out;
+  std::string error;
+  ASSERT_TRUE(ApplyDelta(base, elf, &out, &error)) << error;
+  EXPECT_TRUE(out == target);
+
+  for (size_t size = 0; size < elf.size(); size += 7) {
+    const ByteBuffer truncated(elf.begin(),
+                               elf.begin() + static_cast<ptrdiff_t>(size));
+    EXPECT_FALSE(ApplyDelta(base, truncated, &out, &error)) << size;
+  }
+  // Anything else is left to CreateDelta().
+  EXPECT_TRUE(CreateElfDelta(RandomBytes(4096, 7), target).empty());
+}
+
+TEST(Delta, FallsBackToInsertsForUnrelatedData) {
+  const ByteBuffer base = RandomBytes(100000, 3);
+  const ByteBuffer target = RandomBytes(50000, 4);
+  EXPECT_LT(RoundTrip(base, target).size(), target.size() + 64);
+
+  RoundTrip(ByteBuffer(), target);
+  RoundTrip(base, ByteBuffer());
+  RoundTrip(Bytes("short"), Bytes("shorter"));
+  EXPECT_GE(EstimateDeltaMemory(base.size(), target.size()),
+            base.size() + target.size());
+}
+
+TEST(ReleasePlanner, ChainsPatchesAcrossReleases) {
+  // Installed 'a'; release 2 has 'b' with a patch a->b, release 3 has 'c'
+  // with a patch b->c.
+  FileEntry v2 = Entry("lib/libapp.so", 'b', 1000);
+  v2.patches.push_back(Patch('a', "patches/libapp.so.a", 40));
+  FileEntry v3 = Entry("lib/libapp.so", 'c', 1000);
+  v3.patches.push_back(Patch('b', "patches/libapp.so.b", 60));
+
+  const Manifest installed = {Entry("lib/libapp.so", 'a', 1000)};
+  const std::vector<ReleaseManifest> releases = {Release(2, {v2}),
+                                                 Release(3, {v3})};
+  const UpdatePlan plan = PlanUpdate(installed, releases, {v3}, NoOverhead());
+
+  ASSERT_EQ(plan.files.size(), 1u);
+  const FilePlan& file = plan.files[0];
+  ASSERT_EQ(file.steps.size(), 2u);
+  EXPECT_EQ(file.steps[0].kind, PlanStep::Kind::kPatch);
+  EXPECT_EQ(file.steps[0].url, "https://host/2/patches/libapp.so.a");
+  EXPECT_EQ(file.steps[0].result, DigestOf('b'));
+  EXPECT_EQ(file.steps[1].url, "https://host/3/patches/libapp.so.b");
+  EXPECT_EQ(file.steps[1].result, DigestOf('c'));
+  EXPECT_EQ(plan.expected_bytes, 100u);
+  EXPECT_EQ(plan.full_bytes, 1000u);
+}
+
+TEST(ReleasePlanner, MixesFullFilesAndPatchesPerFile) {
+  FileEntry lib = Entry("lib/libapp.so", 'c', 1000);
+  lib.patches.push_back(Patch('a', "patches/libapp.so", 100));
+  // A patch bigger than the file itself is never worth it.
+  FileEntry icu = Entry("data/icudtl.dat", 'y', 50);
+  icu.patches.push_back(Patch('x', "patches/icudtl.dat", 80));
+  const FileEntry added = Entry("lib/new.so", 'n', 30);
+
+  const Manifest installed = {Entry("lib/libapp.so", 'a', 1000),
+                              Entry("data\\icudtl.dat", 'x', 50)};
+  const std::vector<ReleaseManifest> releases = {
+      Release(5, {lib, icu, added})};
+  const UpdatePlan plan =
+      PlanUpdate(installed, releases, {lib, icu, added}, NoOverhead());
+
+  ASSERT_EQ(plan.files.size(), 3u);
+  EXPECT_EQ(plan.files[0].steps[0].kind, PlanStep::Kind::kPatch);
+  EXPECT_EQ(plan.files[1].steps[0].kind, PlanStep::Kind::kFull);
+  EXPECT_EQ(plan.files[1].steps[0].url, "https://host/5/data/icudtl.dat");
+  EXPECT_EQ(plan.files[2].steps[0].kind, PlanStep::Kind::kFull);
+  EXPECT_EQ(plan.expected_bytes, 100u + 50u + 30u);
+}
+
+TEST(ReleasePlanner, FetchesPublishedObjectsByDigest) {
+  FileEntry lib = Entry("lib/libapp.so", 'c', 1000);
+  lib.object = "../objects/cc";
+  const FileEntry app = Entry("app", 'd', 10);
+
+  const std::vector<ReleaseManifest> releases = {Release(5, {lib, app})};
+  const UpdatePlan plan = PlanUpdate({}, releases, {lib, app}, NoOverhead());
+
+  ASSERT_EQ(plan.files.size(), 2u);
+  EXPECT_EQ(plan.files[0].steps[0].url, "https://host/objects/cc");
+  EXPECT_EQ(plan.files[1].steps[0].url, "https://host/5/app");
+}
+
+TEST(ReleasePlanner, OverheadFavorsFewerRequests) {
+  FileEntry v2 = Entry("app", 'b', 100);
+  v2.patches.push_back(Patch('a', "p/a", 30));
+  FileEntry v3 = Entry("app", 'c', 100);
+  v3.patches.push_back(Patch('b', "p/b", 30));
+
+  const Manifest installed = {Entry("app", 'a', 100)};
+  const std::vector<ReleaseManifest> releases = {Release(2, {v2}),
+                                                 Release(3, {v3})};
+  PlannerOptions options;
+  options.request_overhead_bytes = 50;
+  const UpdatePlan plan = PlanUpdate(installed, releases, {v3}, options);
+
+  // 2 * (30 + 50) > 100 + 50, so one full download wins.
+  ASSERT_EQ(plan.files[0].steps.size(), 1u);
+  EXPECT_EQ(plan.files[0].steps[0].kind, PlanStep::Kind::kFull);
+  EXPECT_EQ(plan.expected_bytes, 100u);
+}
+
+TEST(ReleasePlanner, FallsBackToFullDownloadWithoutMatchingBase) {
+  FileEntry v3 = Entry("app", 'c', 100);
+  v3.patches.push_back(Patch('b', "p/b", 10));
+
+  // The installed copy is 'z', which no patch starts from.
+  const Manifest installed = {Entry("app", 'z', 100)};
+  const UpdatePlan plan =
+      PlanUpdate(installed, {Release(3, {v3})}, {v3}, NoOverhead());
+  ASSERT_EQ(plan.files[0].steps.size(), 1u);
+  EXPECT_EQ(plan.files[0].steps[0].kind, PlanStep::Kind::kFull);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
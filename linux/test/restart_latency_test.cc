@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "file_hash.h"
+#include "relaunch.h"
+#include "test_util.h"
+#include "update_applier.h"
+
+namespace desktop_updater {
+namespace test {
+
+// The fake app's path is passed in by the build, see CMakeLists.txt.
+#ifdef DESKTOP_UPDATER_FAKE_APP
+
+namespace {
+
+namespace fs = std::filesystem;
+
+// End to end budget from the restart request to the new version's main(),
+// overridable with $DESKTOP_UPDATER_RESTART_BUDGET_MS.
+constexpr int64_t kDefaultBudgetMs = 1000;
+
+struct Phase {
+  std::string name;
+  int64_t time_us = 0;
+  long pid = 0;
+};
+
+std::vector<Phase> ReadPhases(const fs::path& path) {
+  std::vector<Phase> phases;
+  std::ifstream in(path);
+  Phase phase;
+  while (in >> phase.name >> phase.time_us >> phase.pid) {
+    phases.push_back(phase);
+  }
+  return phases;
+}
+
+int64_t BudgetMs() {
+  const char* value = getenv("DESKTOP_UPDATER_RESTART_BUDGET_MS");
+  return value != nullptr && value[0] != '\0' ? atoll(value)
+                                              : kDefaultBudgetMs;
+}
+
+// Runs |command| and returns what it printed.
+std::string RunCommand(const std::string& command, int* status) {
+  FILE* pipe = popen(command.c_str(), "r");
+  std::string output;
+  char buffer[256];
+  size_t size;
+  while (pipe != nullptr &&
+         (size = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+    output.append(buffer, size);
+  }
+  *status = pipe != nullptr ? pclose(pipe) : -1;
+  return output;
+}
+
+}  // namespace
+
+// Installs the fake app, stages a new version of it and times a restart
+// through apply and exec until the new version is running.
+TEST(RestartLatency, RestartRunsStagedVersionWithinBudget) {
+  const fs::path app = TestTempDir("desktop_updater_restart");
+  const fs::path staging = app / kStagingDirName;
+  const fs::path log = app.string() + ".log";
+  fs::remove_all(app);
+  fs::remove(log);
+
+  fs::create_directories(staging);
+  fs::copy_file(DESKTOP_UPDATER_FAKE_APP, app / "example");
+  WriteFile(app / "data" / "version.txt", "1.0.0");
+  WriteFile(app / "lib" / "libapp.so", std::string(1 << 20, 'a'));
+  fs::copy_file(DESKTOP_UPDATER_FAKE_APP, staging / "example");
+  WriteFile(staging / "data" / "version.txt", "1.0.1");
+  WriteFile(staging / "lib" / "libapp.so", std::string(1 << 20, 'b'));
+
+  Manifest files;
+  std::string error;
+  ASSERT_TRUE(HashTree(staging.string(), ScanOptions(), 2, &files, &error))
+      << error;
+  ASSERT_TRUE(VerifyAndStage(staging.string(), files, 2, &error)) << error;
+
+  setenv(kRestartLogEnv, log.c_str(), 1);
+  int status = 0;
+  const std::string output =
+      RunCommand("'" + (app / "example").string() + "' --restart", &status);
+  unsetenv(kRestartLogEnv);
+  EXPECT_EQ(status, 0);
+  EXPECT_EQ(output, "1.0.1");
+
+  std::map<std::string, Phase> by_name;
+  std::vector<std::string> order;
+  for (const Phase& phase : ReadPhases(log)) {
+    order.push_back(phase.name);
+    by_name[phase.name] = phase;  // The last "main" is the new version's.
+  }
+  ASSERT_EQ(order, (std::vector<std::string>{"main", "requested", "applied",
+                                              "exec", "main"}));
+  // exec() keeps the process; the new version starts in place of the old.
+  EXPECT_EQ(by_name["main"].pid, by_name["requested"].pid);
+
+  const int64_t apply_us =
+      by_name["applied"].time_us - by_name["requested"].time_us;
+  const int64_t exec_us = by_name["exec"].time_us - by_name["applied"].time_us;
+  const int64_t relaunch_us =
+      by_name["main"].time_us - by_name["exec"].time_us;
+  const int64_t total_us =
+      by_name["main"].time_us - by_name["requested"].time_us;
+  RecordProperty("apply_us", std::to_string(apply_us));
+  RecordProperty("exec_us", std::to_string(exec_us));
+  RecordProperty("relaunch_us", std::to_string(relaunch_us));
+  RecordProperty("total_us", std::to_string(total_us));
+  printf("restart: apply %lld us, exit %lld us, relaunch %lld us, "
+         "total %lld us\n",
+         static_cast<long long>(apply_us), static_cast<long long>(exec_us),
+         static_cast<long long>(relaunch_us),
+         static_cast<long long>(total_us));
+  EXPECT_LE(total_us, BudgetMs() * 1000)
+      << "Restart took longer than the budget; set "
+         "DESKTOP_UPDATER_RESTART_BUDGET_MS to change it.";
+
+  fs::remove_all(app);
+  fs::remove(log);
+}
+
+#endif  // DESKTOP_UPDATER_FAKE_APP
+
+}  // namespace test
+}  // namespace desktop_updater
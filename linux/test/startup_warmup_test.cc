@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+
+#include "startup_warmup.h"
+#include "test_util.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+bool Contains(const std::vector<std::string>& list, const std::string& item) {
+  return std::find(list.begin(), list.end(), item) != list.end();
+}
+
+}  // namespace
+
+TEST(StartupWarmup, ListsEngineFilesAndReplacedLibraries) {
+  const std::vector<std::string> files = StartupPathFiles(
+      {"lib\\libfoo_plugin.so", "lib/libapp.so", "data/flutter_assets/a.png",
+       "example"});
+  EXPECT_TRUE(Contains(files, "lib/libapp.so"));
+  EXPECT_TRUE(Contains(files, "lib/libflutter_linux_gtk.so"));
+  EXPECT_TRUE(Contains(files, "data/icudtl.dat"));
+  EXPECT_TRUE(Contains(files, "lib/libfoo_plugin.so"));
+  EXPECT_FALSE(Contains(files, "data/flutter_assets/a.png"));
+  EXPECT_EQ(std::count(files.begin(), files.end(), "lib/libapp.so"), 1);
+}
+
+TEST(StartupWarmup, WarmsExistingFilesOnly) {
+  const fs::path root = TestTempDir("desktop_updater_warmup");
+  fs::remove_all(root);
+  WriteFile(root / "lib" / "libapp.so", std::string(1 << 20, 'a'));
+  WriteFile(root / "data" / "icudtl.dat", std::string(4096, 'i'));
+
+  WarmupStats stats;
+  ASSERT_TRUE(WarmFiles(root.string(), StartupPathFiles({}), &stats));
+  EXPECT_EQ(stats.files, 2u);
+  EXPECT_EQ(stats.bytes, (1u << 20) + 4096u);
+  EXPECT_LE(stats.resident_before, stats.bytes);
+  EXPECT_LE(stats.resident_after, stats.bytes);
+
+  uint64_t resident = 0;
+  uint64_t length = 0;
+  ASSERT_TRUE(ResidentBytes((root / "data" / "icudtl.dat").string(), &resident,
+                            &length));
+  EXPECT_EQ(length, 4096u);
+  EXPECT_LE(resident, length);
+  fs::remove_all(root);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
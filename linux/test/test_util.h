@@ -0,0 +1,47 @@
+#ifndef DESKTOP_UPDATER_TEST_TEST_UTIL_H_
+#define DESKTOP_UPDATER_TEST_TEST_UTIL_H_
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace desktop_updater {
+namespace test {
+
+// Writes |contents| to |path|, creating its parent directories.
+inline void WriteFile(const std::filesystem::path& path,
+                      const std::string& contents) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path, std::ios::binary) << contents;
+}
+
+// Returns the contents of |path|, or an empty string if it cannot be read.
+inline std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+// A path below the system temp directory named after |prefix|, the running
+// test and the process. ctest runs every test in a process of its own, in
+// parallel with -j, so fixtures must not share a directory. Not created.
+inline std::filesystem::path TestTempDir(const std::string& prefix) {
+  std::string name = prefix;
+  const ::testing::TestInfo* info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  if (info != nullptr) {
+    name += std::string("_") + info->test_suite_name() + "_" + info->name();
+  }
+  name += "_" + std::to_string(getpid());
+  return std::filesystem::temp_directory_path() / name;
+}
+
+}  // namespace test
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_TEST_TEST_UTIL_H_
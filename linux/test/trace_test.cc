@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "file_util.h"
+#include "json.h"
+#include "trace.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class TraceTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ClearTrace(); }
+
+  void TearDown() override {
+    SetTraceEnabled(false);
+    ClearTrace();
+  }
+};
+
+JsonValue ReadTrace(const std::string& path) {
+  std::vector<uint8_t> data;
+  std::string error;
+  JsonValue trace;
+  EXPECT_TRUE(ReadFileBytes(path, &data, &error)) << error;
+  EXPECT_TRUE(JsonValue::Parse(reinterpret_cast<const char*>(data.data()),
+                               data.size(), &trace, &error))
+      << error;
+  return trace;
+}
+
+}  // namespace
+
+TEST_F(TraceTest, RecordsNothingWhileDisabled) {
+  { TraceSpan span("scan"); }
+  EXPECT_EQ(TraceEventCount(), 0u);
+}
+
+TEST_F(TraceTest, WritesChromeTraceJson) {
+  SetTraceEnabled(true);
+  {
+    TraceSpan outer("fetch");
+    outer.SetArg("files", 2);
+    std::thread worker([]() { TraceSpan span("fetch_file"); });
+    worker.join();
+  }
+  EXPECT_EQ(TraceEventCount(), 2u);
+
+  const std::string path =
+      (fs::temp_directory_path() / "desktop_updater_trace_test.json").string();
+  std::string error;
+  ASSERT_TRUE(WriteTrace(path, &error)) << error;
+  const JsonValue trace = ReadTrace(path);
+  fs::remove(path);
+
+  const JsonValue* events = trace.Find("traceEvents");
+  ASSERT_NE(events, nullptr);
+  ASSERT_EQ(events->array_items().size(), 2u);
+  const JsonValue* fetch = nullptr;
+  const JsonValue* fetch_file = nullptr;
+  for (const JsonValue& event : events->array_items()) {
+    EXPECT_EQ(event.GetString("ph"), "X");
+    EXPECT_GE(event.Find("dur")->number_value(), 0);
+    if (event.GetString("name") == "fetch") {
+      fetch = &event;
+    } else if (event.GetString("name") == "fetch_file") {
+      fetch_file = &event;
+    }
+  }
+  ASSERT_NE(fetch, nullptr);
+  ASSERT_NE(fetch_file, nullptr);
+  EXPECT_NE(fetch->GetInt("tid"), fetch_file->GetInt("tid"));
+  EXPECT_EQ(fetch->Find("args")->GetInt("files"), 2);
+  // The worker's span lies within the enclosing one.
+  EXPECT_GE(fetch_file->Find("ts")->number_value(),
+            fetch->Find("ts")->number_value());
+}
+
+TEST_F(TraceTest, WritesCounterSamples) {
+  TraceCounter("rss", "bytes", 1);
+  EXPECT_EQ(TraceEventCount(), 0u);
+  SetTraceEnabled(true);
+  TraceCounter("rss", "bytes", 4096);
+
+  const std::string path =
+      (fs::temp_directory_path() / "desktop_updater_trace_counter.json")
+          .string();
+  std::string error;
+  ASSERT_TRUE(WriteTrace(path, &error)) << error;
+  const JsonValue trace = ReadTrace(path);
+  fs::remove(path);
+
+  const JsonValue* events = trace.Find("traceEvents");
+  ASSERT_NE(events, nullptr);
+  ASSERT_EQ(events->array_items().size(), 1u);
+  const JsonValue& counter = events->array_items()[0];
+  EXPECT_EQ(counter.GetString("name"), "rss");
+  EXPECT_EQ(counter.GetString("ph"), "C");
+  EXPECT_EQ(counter.Find("dur"), nullptr);
+  EXPECT_EQ(counter.Find("args")->GetInt("bytes"), 4096);
+}
+
+TEST_F(TraceTest, RingKeepsNewestEvents) {
+  SetTraceEnabled(true);
+  std::thread worker([]() {
+    for (size_t i = 0; i < kTraceRingSize + 10; i++) {
+      TraceSpan span("hash");
+    }
+  });
+  worker.join();
+  EXPECT_EQ(TraceEventCount(), kTraceRingSize);
+  ClearTrace();
+  EXPECT_EQ(TraceEventCount(), 0u);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
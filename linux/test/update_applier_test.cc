@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "file_hash.h"
+#include "test_util.h"
+#include "update_applier.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class UpdateApplierTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    app_ = TestTempDir("desktop_updater_apply");
+    fs::remove_all(app_);
+    staging_ = app_ / kStagingDirName;
+
+    WriteFile(app_ / "example", "old binary");
+    fs::permissions(app_ / "example", fs::perms::owner_all);
+    WriteFile(app_ / "lib" / "libapp.so", "old aot");
+    WriteFile(app_ / "data" / "icudtl.dat", "icu");
+
+    WriteFile(staging_ / "example", "new binary");
+    WriteFile(staging_ / "lib" / "libapp.so", "new aot");
+    WriteFile(staging_ / "data" / "flutter_assets" / "new.png", "png");
+  }
+
+  void TearDown() override { fs::remove_all(app_); }
+
+  Manifest StagedFiles() {
+    Manifest manifest;
+    std::string error;
+    EXPECT_TRUE(HashTree(staging_.string(), ScanOptions(), 1, &manifest,
+                         &error))
+        << error;
+    return manifest;
+  }
+
+  ApplyResult Apply(std::vector<std::string>* replaced, std::string* error) {
+    return ApplyPendingUpdate(app_.string(), (app_ / "example").string(),
+                              replaced, error);
+  }
+
+  fs::path app_;
+  fs::path staging_;
+};
+
+}  // namespace
+
+TEST_F(UpdateApplierTest, NothingPendingWithoutReceipt) {
+  std::vector<std::string> replaced;
+  std::string error;
+  EXPECT_FALSE(HasPendingUpdate(app_.string()));
+  EXPECT_EQ(Apply(&replaced, &error), ApplyResult::kNothingPending);
+  EXPECT_EQ(ReadFile(app_ / "example"), "old binary");
+}
+
+TEST_F(UpdateApplierTest, AppliesVerifiedUpdate) {
+  std::string error;
+  ASSERT_TRUE(VerifyAndStage(staging_.string(), StagedFiles(), 2, &error))
+      << error;
+  ASSERT_TRUE(HasPendingUpdate(app_.string()));
+
+  std::vector<std::string> replaced;
+  ASSERT_EQ(Apply(&replaced, &error), ApplyResult::kApplied) << error;
+  EXPECT_EQ(replaced.size(), 3u);
+  EXPECT_EQ(ReadFile(app_ / "example"), "new binary");
+  EXPECT_EQ(ReadFile(app_ / "lib" / "libapp.so"), "new aot");
+  EXPECT_EQ(ReadFile(app_ / "data" / "flutter_assets" / "new.png"), "png");
+  EXPECT_EQ(ReadFile(app_ / "data" / "icudtl.dat"), "icu");
+  // The executable keeps the permissions of the file it replaced.
+  EXPECT_EQ(fs::status(app_ / "example").permissions(), fs::perms::owner_all);
+  EXPECT_FALSE(fs::exists(staging_));
+  EXPECT_FALSE(fs::exists(app_ / kBackupDirName));
+}
+
+TEST_F(UpdateApplierTest, AddedExecutablesGetTheAppsPermissions) {
+  WriteFile(staging_ / "helper", "new helper");
+  WriteFile(staging_ / "lib" / "libnew_plugin.so", "new plugin");
+  fs::permissions(staging_ / "helper",
+                  fs::perms::owner_read | fs::perms::owner_write);
+  std::string error;
+  ASSERT_TRUE(VerifyAndStage(staging_.string(), StagedFiles(), 1, &error))
+      << error;
+
+  std::vector<std::string> replaced;
+  ASSERT_EQ(Apply(&replaced, &error), ApplyResult::kApplied) << error;
+  EXPECT_EQ(fs::status(app_ / "helper").permissions(), fs::perms::owner_all);
+  EXPECT_EQ(fs::status(app_ / "lib" / "libnew_plugin.so").permissions(),
+            fs::perms::owner_all);
+  // Data is not code.
+  EXPECT_EQ(fs::status(app_ / "data" / "flutter_assets" / "new.png")
+                    .permissions() &
+                fs::perms::owner_exec,
+            fs::perms::none);
+}
+
+TEST_F(UpdateApplierTest, RefusesTamperedStagingFiles) {
+  Manifest files = StagedFiles();
+  WriteFile(staging_ / "example", "evil binary");
+  std::string error;
+  EXPECT_FALSE(VerifyAndStage(staging_.string(), files, 1, &error));
+  EXPECT_FALSE(HasPendingUpdate(app_.string()));
+
+  // Truncated after verification: nothing is touched.
+  ASSERT_TRUE(VerifyAndStage(staging_.string(), StagedFiles(), 1, &error));
+  WriteFile(staging_ / "lib" / "libapp.so", "new");
+  std::vector<std::string> replaced;
+  EXPECT_EQ(Apply(&replaced, &error), ApplyResult::kFailed);
+  EXPECT_EQ(ReadFile(app_ / "example"), "old binary");
+}
+
+TEST_F(UpdateApplierTest, RollsBackWhenAppliedFilesDoNotMatch) {
+  std::string error;
+  ASSERT_TRUE(VerifyAndStage(staging_.string(), StagedFiles(), 1, &error));
+  // Same size, so only the post-apply hash check can notice.
+  WriteFile(staging_ / "lib" / "libapp.so", "bad aot");
+  fs::last_write_time(staging_ / "lib" / "libapp.so",
+                      fs::last_write_time(staging_ / "lib" / "libapp.so") +
+                          std::chrono::seconds(1));
+
+  std::vector<std::string> replaced;
+  EXPECT_EQ(Apply(&replaced, &error), ApplyResult::kFailed);
+  EXPECT_NE(error.find("lib/libapp.so"), std::string::npos) << error;
+  EXPECT_EQ(ReadFile(app_ / "example"), "old binary");
+  EXPECT_EQ(ReadFile(app_ / "lib" / "libapp.so"), "old aot");
+  EXPECT_FALSE(fs::exists(app_ / "data" / "flutter_assets" / "new.png"));
+  EXPECT_EQ(ReadFile(staging_ / "example"), "new binary");
+  EXPECT_FALSE(fs::exists(app_ / kBackupDirName));
+}
+
+TEST_F(UpdateApplierTest, RollsBackInterruptedApply) {
+  std::string error;
+  ASSERT_TRUE(VerifyAndStage(staging_.string(), StagedFiles(), 1, &error));
+
+  // Simulate a crash after "data/flutter_assets/new.png" was moved in and
+  // "example" was moved aside, but before its replacement was.
+  const fs::path backup = app_ / kBackupDirName;
+  WriteFile(backup / "journal", "data/flutter_assets/new.png\nexample\nlib");
+  fs::create_directories(app_ / "data" / "flutter_assets");
+  fs::rename(staging_ / "data" / "flutter_assets" / "new.png",
+             app_ / "data" / "flutter_assets" / "new.png");
+  fs::rename(app_ / "example", backup / "example");
+
+  std::vector<std::string> replaced;
+  ASSERT_EQ(Apply(&replaced, &error), ApplyResult::kApplied) << error;
+  EXPECT_EQ(ReadFile(app_ / "example"), "new binary");
+  EXPECT_EQ(fs::status(app_ / "example").permissions(), fs::perms::owner_all);
+  EXPECT_EQ(ReadFile(app_ / "data" / "flutter_assets" / "new.png"), "png");
+  EXPECT_EQ(ReadFile(app_ / "lib" / "libapp.so"), "new aot");
+}
+
+TEST_F(UpdateApplierTest, RollBackSkipsPathsThatWereNeverSwapped) {
+  std::string error;
+  ASSERT_TRUE(VerifyAndStage(staging_.string(), StagedFiles(), 1, &error));
+
+  // Simulate a crash right after the journal was written: it lists every
+  // path, but no swap has started.
+  const fs::path backup = app_ / kBackupDirName;
+  WriteFile(backup / "journal",
+            "data/flutter_assets/new.png\nexample\nlib/libapp.so\n");
+  // Truncated after verification, so the apply stops after the rollback.
+  WriteFile(staging_ / "lib" / "libapp.so", "new");
+
+  std::vector<std::string> replaced;
+  EXPECT_EQ(Apply(&replaced, &error), ApplyResult::kFailed);
+  EXPECT_EQ(ReadFile(app_ / "example"), "old binary");
+  EXPECT_EQ(ReadFile(app_ / "lib" / "libapp.so"), "old aot");
+  EXPECT_FALSE(fs::exists(app_ / "data" / "flutter_assets" / "new.png"));
+  EXPECT_EQ(ReadFile(staging_ / "example"), "new binary");
+  EXPECT_EQ(ReadFile(staging_ / "data" / "flutter_assets" / "new.png"),
+            "png");
+  EXPECT_FALSE(fs::exists(backup));
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,241 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include "blake2b.h"
+#include "manifest_index.h"
+#include "test_util.h"
+#include "update_check.h"
+
+namespace desktop_updater {
+namespace test {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+class FakeFetcher : public HttpFetcher {
+ public:
+  std::map<std::string, std::string> bodies;
+
+  bool Get(const std::string& url,
+           const BodyCallback& on_body,
+           std::string* error) override {
+    auto it = bodies.find(url);
+    if (it == bodies.end()) {
+      *error = "HTTP 404 for " + url;
+      return false;
+    }
+    return on_body(reinterpret_cast<const uint8_t*>(it->second.data()),
+                   it->second.size());
+  }
+};
+
+Digest DigestOf(const std::string& data) {
+  Digest digest;
+  Blake2b hash;
+  hash.Update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  hash.Final(digest.data());
+  return digest;
+}
+
+// Publishes |manifest| as shards/<i>.json and hashes.index.json below
+// |release_url|, split by the first directory. Returns the shard count.
+size_t PublishSharded(const std::string& release_url,
+                      const Manifest& manifest,
+                      FakeFetcher* fetcher) {
+  ManifestIndex index;
+  std::vector<Manifest> shards;
+  ShardManifest(manifest, 1, &index, &shards);
+  for (size_t i = 0; i < index.size(); i++) {
+    const std::string body = SerializeManifest(shards[i]);
+    index[i].digest = DigestOf(body);
+    index[i].path = "shards/" + std::to_string(i) + ".json";
+    fetcher->bodies[release_url + "/" + index[i].path] = body;
+  }
+  fetcher->bodies[release_url + "/hashes.index.json"] =
+      SerializeManifestIndex(index);
+  return index.size();
+}
+
+const char kArchive[] = R"({
+  "appName": "Example",
+  "description": "",
+  "items": [
+    {"version": "1.0.1", "shortVersion": 2, "changes": [], "date": "",
+     "mandatory": false, "url": "https://host/linux-2", "platform": "linux"},
+    {"version": "1.0.2", "shortVersion": 3,
+     "changes": [{"type": "feat", "message": "New"}], "date": "2024-01-02",
+     "mandatory": true, "url": "https://host/linux-3", "platform": "linux"},
+    {"version": "9.0.0", "shortVersion": 9, "changes": [], "date": "",
+     "mandatory": false, "url": "https://host/win-9", "platform": "windows"}
+  ]
+})";
+
+class UpdateCheckTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root_ = TestTempDir("desktop_updater_check");
+    fs::remove_all(root_);
+    install_ = root_ / "install";
+    release_ = root_ / "release";
+
+    WriteFile(install_ / "app", "binary");
+    WriteFile(install_ / "lib" / "old.so", "old");
+    WriteFile(install_ / "data" / "icudtl.dat", "icu-1");
+    WriteFile(install_ / "update" / "stale", "ignored");
+
+    WriteFile(release_ / "app", "binary");
+    WriteFile(release_ / "lib" / "new.so", "new library");
+    WriteFile(release_ / "data" / "icudtl.dat", "icu-2");
+
+    ScanOptions options;
+    Manifest manifest;
+    std::string error;
+    ASSERT_TRUE(HashTree(release_.string(), options, 1, &manifest, &error));
+    fetcher_.bodies["https://host/app-archive.json"] = kArchive;
+    fetcher_.bodies["https://host/linux-3/hashes.json"] =
+        SerializeManifest(manifest);
+
+    request_.app_archive_url = "https://host/app-archive.json";
+    request_.platform = "linux";
+    request_.current_version = 1;
+    request_.install_dir = install_.string();
+    request_.scan.exclude.push_back("update");
+  }
+
+  void TearDown() override { fs::remove_all(root_); }
+
+  fs::path root_;
+  fs::path install_;
+  fs::path release_;
+  FakeFetcher fetcher_;
+  UpdateCheckRequest request_;
+};
+
+}  // namespace
+
+TEST_F(UpdateCheckTest, DiffsInstalledBundleAgainstLatestRelease) {
+  UpdateCheckResult result;
+  std::string error;
+  ASSERT_TRUE(CheckForUpdate(&fetcher_, request_, &result, &error)) << error;
+
+  EXPECT_TRUE(result.update_available);
+  EXPECT_EQ(result.app_name, "Example");
+  EXPECT_EQ(result.latest.version, "1.0.2");
+  EXPECT_TRUE(result.latest.mandatory);
+  ASSERT_EQ(result.diff.changed.size(), 2u);
+  EXPECT_EQ(result.diff.changed[0].path, "data/icudtl.dat");
+  EXPECT_EQ(result.diff.changed[1].path, "lib/new.so");
+  ASSERT_EQ(result.diff.removed.size(), 1u);
+  EXPECT_EQ(result.diff.removed[0].path, "lib/old.so");
+  EXPECT_EQ(result.total_bytes, 5u + 11u);
+
+  // The published item is forwarded verbatim.
+  JsonWriter writer;
+  writer.Value(result.latest.json);
+  EXPECT_NE(writer.str().find("\"message\":\"New\""), std::string::npos);
+}
+
+TEST_F(UpdateCheckTest, FetchesShardsOfShardedManifests) {
+  Manifest manifest;
+  std::string error;
+  ASSERT_TRUE(HashTree(release_.string(), ScanOptions(), 1, &manifest,
+                       &error));
+  ASSERT_EQ(PublishSharded("https://host/linux-3", manifest, &fetcher_), 3u);
+  fetcher_.bodies.erase("https://host/linux-3/hashes.json");
+
+  UpdateCheckResult result;
+  ASSERT_TRUE(CheckForUpdate(&fetcher_, request_, &result, &error)) << error;
+  ASSERT_EQ(result.diff.changed.size(), 2u);
+  EXPECT_EQ(result.diff.changed[0].path, "data/icudtl.dat");
+  EXPECT_EQ(result.diff.changed[1].path, "lib/new.so");
+  ASSERT_EQ(result.diff.removed.size(), 1u);
+  EXPECT_EQ(result.diff.removed[0].path, "lib/old.so");
+  EXPECT_EQ(result.plan.files.size(), 2u);
+
+  // A shard that does not match the index fails the check.
+  fetcher_.bodies["https://host/linux-3/shards/2.json"] = "[]";
+  EXPECT_FALSE(CheckForUpdate(&fetcher_, request_, &result, &error));
+  EXPECT_NE(error.find("does not match"), std::string::npos);
+}
+
+TEST_F(UpdateCheckTest, ChainsPatchesOfShardedIntermediateReleases) {
+  // icudtl.dat went icu-1 -> icu-1.5 in build 2 -> icu-2 in build 3, and
+  // both releases publish a patch from the previous build.
+  constexpr uint64_t kLength = 1 << 24;
+  Manifest target;
+  std::string error;
+  ASSERT_TRUE(
+      HashTree(release_.string(), ScanOptions(), 1, &target, &error));
+  FileEntry& icu = target[1];
+  ASSERT_EQ(icu.path, "data/icudtl.dat");
+  icu.length = kLength;
+  PatchRef to_3;
+  to_3.from = DigestOf("icu-1.5");
+  to_3.path = "patches/data/icudtl.dat.2";
+  to_3.length = 100;
+  icu.patches.push_back(to_3);
+  fetcher_.bodies["https://host/linux-3/hashes.json"] =
+      SerializeManifest(target);
+
+  Manifest intermediate(1);
+  intermediate[0].path = "data/icudtl.dat";
+  intermediate[0].length = kLength;
+  intermediate[0].digest = DigestOf("icu-1.5");
+  PatchRef to_2;
+  to_2.from = DigestOf("icu-1");
+  to_2.path = "patches/data/icudtl.dat.1";
+  to_2.length = 100;
+  intermediate[0].patches.push_back(to_2);
+  // Only the shards, no hashes.json.
+  PublishSharded("https://host/linux-2", intermediate, &fetcher_);
+
+  UpdateCheckResult result;
+  ASSERT_TRUE(CheckForUpdate(&fetcher_, request_, &result, &error)) << error;
+  const FilePlan* plan = nullptr;
+  for (const FilePlan& file : result.plan.files) {
+    if (file.path == "data/icudtl.dat") {
+      plan = &file;
+    }
+  }
+  ASSERT_NE(plan, nullptr);
+  ASSERT_EQ(plan->steps.size(), 2u);
+  EXPECT_EQ(plan->steps[0].kind, PlanStep::Kind::kPatch);
+  EXPECT_EQ(plan->steps[0].url,
+            "https://host/linux-2/patches/data/icudtl.dat.1");
+  EXPECT_EQ(plan->steps[1].url,
+            "https://host/linux-3/patches/data/icudtl.dat.2");
+}
+
+TEST_F(UpdateCheckTest, SkipsManifestWhenUpToDate) {
+  fetcher_.bodies.erase("https://host/linux-3/hashes.json");
+  request_.current_version = 3;
+
+  UpdateCheckResult result;
+  std::string error;
+  ASSERT_TRUE(CheckForUpdate(&fetcher_, request_, &result, &error)) << error;
+  EXPECT_FALSE(result.update_available);
+  EXPECT_TRUE(result.diff.changed.empty());
+}
+
+TEST_F(UpdateCheckTest, FailsWithoutPlatformItem) {
+  request_.platform = "macos";
+  UpdateCheckResult result;
+  std::string error;
+  EXPECT_FALSE(CheckForUpdate(&fetcher_, request_, &result, &error));
+  EXPECT_EQ(error, "No version found for this platform");
+}
+
+TEST_F(UpdateCheckTest, ReportsManifestFetchErrors) {
+  fetcher_.bodies.erase("https://host/linux-3/hashes.json");
+  UpdateCheckResult result;
+  std::string error;
+  EXPECT_FALSE(CheckForUpdate(&fetcher_, request_, &result, &error));
+  EXPECT_NE(error.find("404"), std::string::npos);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include "version_info.h"
+
+namespace desktop_updater {
+namespace test {
+
+TEST(VersionInfo, ParsesSemverWithBuild) {
+  VersionInfo info;
+  ASSERT_TRUE(ParseVersionString("1.20.3-beta.2+45", &info));
+  EXPECT_EQ(info.version, "1.20.3-beta.2");
+  EXPECT_EQ(info.major, 1);
+  EXPECT_EQ(info.minor, 20);
+  EXPECT_EQ(info.patch, 3);
+  EXPECT_EQ(info.pre_release, "beta.2");
+  EXPECT_EQ(info.build_number, "45");
+  EXPECT_EQ(BuildNumberOf(info), 45);
+}
+
+TEST(VersionInfo, AcceptsShortAndWindowsStyleVersions) {
+  VersionInfo info;
+  ASSERT_TRUE(ParseVersionString(" 2+7 ", &info));
+  EXPECT_EQ(info.major, 2);
+  EXPECT_EQ(info.minor, 0);
+  EXPECT_EQ(BuildNumberOf(info), 7);
+
+  ASSERT_TRUE(ParseVersionString("1.2.3.4", &info));
+  EXPECT_EQ(info.patch, 3);
+  EXPECT_EQ(BuildNumberOf(info), -1);
+
+  EXPECT_FALSE(ParseVersionString("one.two", &info));
+}
+
+TEST(VersionInfo, ParsesFlutterVersionJson) {
+  const char json[] =
+      "{\"app_name\":\"example\",\"version\":\"0.1.1\","
+      "\"build_number\":\"2\",\"package_name\":\"example\"}";
+  VersionInfo info;
+  std::string error;
+  ASSERT_TRUE(ParseFlutterVersionJson(json, strlen(json), &info, &error))
+      << error;
+  EXPECT_EQ(info.app_name, "example");
+  EXPECT_EQ(info.version, "0.1.1");
+  EXPECT_EQ(BuildNumberOf(info), 2);
+}
+
+}  // namespace test
+}  // namespace desktop_updater
@@ -0,0 +1,55 @@
+#include "app_archive.h"
+
+namespace desktop_updater {
+
+bool ParseAppArchive(const char* data,
+                     size_t size,
+                     AppArchive* out,
+                     std::string* error) {
+  JsonValue root;
+  if (!JsonValue::Parse(data, size, &root, error)) {
+    *error = "Invalid app archive: " + *error;
+    return false;
+  }
+  const JsonValue* items = root.Find("items");
+  if (!root.is_object() || items == nullptr || !items->is_array()) {
+    *error = "Invalid app archive: expected an object with items";
+    return false;
+  }
+
+  out->app_name = root.GetString("appName");
+  out->description = root.GetString("description");
+  out->items.clear();
+  out->items.reserve(items->array_items().size());
+  for (const JsonValue& value : items->array_items()) {
+    ArchiveItem item;
+    item.version = value.GetString("version");
+    item.short_version = value.GetInt("shortVersion");
+    item.platform = value.GetString("platform");
+    item.url = value.GetString("url");
+    item.mandatory = value.GetBool("mandatory");
+    if (item.platform.empty() || item.url.empty()) {
+      *error = "Invalid app archive: item " + item.version +
+               " has no platform or url";
+      return false;
+    }
+    item.json = value;
+    out->items.push_back(std::move(item));
+  }
+  return true;
+}
+
+const ArchiveItem* FindLatestItem(const AppArchive& archive,
+                                  const std::string& platform) {
+  const ArchiveItem* latest = nullptr;
+  for (const ArchiveItem& item : archive.items) {
+    // Ties go to the later entry, like the Dart implementation.
+    if (item.platform == platform &&
+        (latest == nullptr || item.short_version >= latest->short_version)) {
+      latest = &item;
+    }
+  }
+  return latest;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,45 @@
+#ifndef DESKTOP_UPDATER_APP_ARCHIVE_H_
+#define DESKTOP_UPDATER_APP_ARCHIVE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "json.h"
+
+namespace desktop_updater {
+
+/**
+ * @brief One release listed in app-archive.json.
+ */
+struct ArchiveItem {
+  std::string version;
+  int64_t short_version = 0;
+  std::string platform;
+  // Remote folder holding the release files and its hashes.json.
+  std::string url;
+  bool mandatory = false;
+  // The item as published, so callers can hand it back unchanged.
+  JsonValue json;
+};
+
+struct AppArchive {
+  std::string app_name;
+  std::string description;
+  std::vector<ArchiveItem> items;
+};
+
+// Parses app-archive.json. Items without a platform or url are rejected.
+bool ParseAppArchive(const char* data,
+                     size_t size,
+                     AppArchive* out,
+                     std::string* error);
+
+// Returns the item for |platform| with the highest shortVersion, or nullptr.
+const ArchiveItem* FindLatestItem(const AppArchive& archive,
+                                  const std::string& platform);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_APP_ARCHIVE_H_
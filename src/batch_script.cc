@@ -0,0 +1,289 @@
+#include "batch_script.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <system_error>
+
+#include "file_hash.h"
+#include "file_util.h"
+#include "manifest.h"
+#include "update_applier.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+namespace {
+
+bool Exists(const std::string& path) {
+  std::error_code ec;
+  return fs::exists(fs::symlink_status(PathFromUtf8(path), ec));
+}
+
+// Lists the normalized paths of the files staged below |staging_dir|.
+bool ListStagedFiles(const std::string& staging_dir,
+                     std::vector<std::string>* out,
+                     std::string* error) {
+  out->clear();
+  const std::string receipt = JoinPath(staging_dir, kStagedReceiptPath);
+  if (Exists(receipt)) {
+    std::vector<uint8_t> data;
+    Manifest files;
+    if (!ReadFileBytes(receipt, &data, error) ||
+        !ParseManifest(reinterpret_cast<const char*>(data.data()),
+                       data.size(), &files, error)) {
+      return false;
+    }
+    for (const FileEntry& entry : files) {
+      out->push_back(NormalizeRelativePath(entry.path));
+    }
+    return true;
+  }
+
+  std::error_code ec;
+  if (!fs::is_directory(PathFromUtf8(staging_dir), ec)) {
+    return true;
+  }
+  // The receipt's folder is bookkeeping, not part of the app.
+  const std::string receipt_path = kStagedReceiptPath;
+  ScanOptions options;
+  options.exclude.push_back(receipt_path.substr(0, receipt_path.find('/')));
+  options.separator = '/';
+  std::vector<ScannedFile> files;
+  if (!ScanTree(staging_dir, options, &files, error)) {
+    return false;
+  }
+  for (const ScannedFile& file : files) {
+    out->push_back(file.path);
+  }
+  return true;
+}
+
+// A normalized path as a batch argument: backslashes, and '%' doubled so
+// cmd does not expand it.
+std::string BatchPath(const std::string& path) {
+  std::string out;
+  out.reserve(path.size() + 2);
+  out.push_back('"');
+  for (const char c : path) {
+    if (c == '/') {
+      out.push_back('\\');
+    } else if (c == '%') {
+      out += "%%";
+    } else {
+      out.push_back(c);
+    }
+  }
+  out.push_back('"');
+  return out;
+}
+
+std::string Join(const std::string& dir, const std::string& path) {
+  return dir.empty() ? path : dir + "/" + path;
+}
+
+// Emits a mkdir for every distinct folder holding one of |paths| below
+// |dir|.
+void AppendMakeParents(const std::string& dir,
+                       const std::vector<std::string>& paths,
+                       std::string* out) {
+  std::set<std::string> parents;
+  for (const std::string& path : paths) {
+    const size_t slash = path.rfind('/');
+    if (slash != std::string::npos) {
+      parents.insert(path.substr(0, slash));
+    }
+  }
+  for (const std::string& parent : parents) {
+    const std::string quoted = BatchPath(Join(dir, parent));
+    *out += "if not exist " + quoted.substr(0, quoted.size() - 1) +
+            "\\\" mkdir " + quoted + " >NUL 2>&1\n";
+  }
+}
+
+// Emits a move of every path in |paths| from below |from| to below |to|
+// that sets FAILED when a present file cannot be moved.
+void AppendMoves(const std::string& from,
+                 const std::string& to,
+                 const std::vector<std::string>& paths,
+                 std::string* out) {
+  for (const std::string& path : paths) {
+    const std::string source = BatchPath(Join(from, path));
+    *out += "if exist " + source + " (move /Y " + source + " " +
+            BatchPath(Join(to, path)) + " >NUL 2>&1 || set FAILED=1)\n";
+  }
+}
+
+}  // namespace
+
+bool PlanBatchUpdate(const std::string& app_dir,
+                     const std::string& staging_dir,
+                     const std::vector<std::string>& removed,
+                     BatchPlan* plan,
+                     std::string* error) {
+  *plan = BatchPlan();
+  std::vector<std::string> staged;
+  if (!ListStagedFiles(staging_dir, &staged, error)) {
+    return false;
+  }
+  std::sort(staged.begin(), staged.end());
+  staged.erase(std::unique(staged.begin(), staged.end()), staged.end());
+  for (const std::string& path : staged) {
+    if (!IsSafeRelativePath(path)) {
+      *error = "Unsafe path " + path;
+      return false;
+    }
+    (Exists(JoinPath(app_dir, path)) ? plan->changed : plan->added)
+        .push_back(path);
+  }
+
+  for (const std::string& entry : removed) {
+    const std::string path = NormalizeRelativePath(entry);
+    if (!IsSafeRelativePath(path)) {
+      *error = "Unsafe path " + entry;
+      return false;
+    }
+    if (!std::binary_search(staged.begin(), staged.end(), path) &&
+        Exists(JoinPath(app_dir, path))) {
+      plan->removed.push_back(path);
+    }
+  }
+  std::sort(plan->removed.begin(), plan->removed.end());
+  plan->removed.erase(
+      std::unique(plan->removed.begin(), plan->removed.end()),
+      plan->removed.end());
+  return true;
+}
+
+std::string GenerateBatchScript(const BatchPlan& plan,
+                                const BatchScriptOptions& options) {
+  const std::string& exe_path = options.executable_path;
+  const size_t slash = exe_path.find_last_of("\\/");
+  const std::string exe_name =
+      slash == std::string::npos ? exe_path : exe_path.substr(slash + 1);
+  const std::string staging = NormalizeRelativePath(options.staging_dir);
+  const std::string backup = kBatchBackupDirName;
+  const std::string wait_attempts = std::to_string(options.wait_attempts);
+  const std::string retry_attempts = std::to_string(options.retry_attempts);
+  const std::string retry_delay = std::to_string(options.retry_delay_seconds);
+
+  // Files moved into the backup, and files moved in from the staging
+  // folder.
+  std::vector<std::string> replaced = plan.changed;
+  replaced.insert(replaced.end(), plan.removed.begin(), plan.removed.end());
+  std::vector<std::string> staged = plan.changed;
+  staged.insert(staged.end(), plan.added.begin(), plan.added.end());
+
+  std::string out =
+      "@echo off\n"
+      "chcp 65001 > NUL\n"  // Enable UTF-8 support for non-ASCII paths
+      "echo.\n"
+      "echo ==========================================\n"
+      "echo        Application Update Process\n"
+      "echo ==========================================\n"
+      "echo.\n"
+
+      // STEP 1: Wait for application to close gracefully
+      "echo [STEP 1/5] Waiting for application to close...\n"
+      "set COUNT=0\n"
+      ":wait_loop\n"
+      "tasklist /FI \"IMAGENAME eq " + exe_name + "\" 2>NUL | find /I \"" +
+      exe_name + "\" >NUL\n"
+      "if \"%ERRORLEVEL%\"==\"0\" (\n"
+      "    set /a COUNT+=1\n"
+      "    echo   Attempt %COUNT%/" + wait_attempts +
+      " - Application still running...\n"
+      "    if %COUNT% GEQ " + wait_attempts + " (\n"
+      "        echo   Timeout reached - force closing application\n"
+      "        taskkill /F /IM \"" + exe_name + "\" >NUL 2>&1\n"
+      "        goto step2\n"
+      "    )\n"
+      "    timeout /t 1 /nobreak > NUL\n"
+      "    goto wait_loop\n"
+      ")\n"
+      "echo   Application closed successfully\n"
+      "echo.\n"
+
+      // STEP 2: Move the files the update replaces or removes aside
+      ":step2\n"
+      "echo [STEP 2/5] Backing up " + std::to_string(plan.changed.size()) +
+      " changed and " + std::to_string(plan.removed.size()) +
+      " removed files...\n"
+      "if exist " + BatchPath(backup) + " rmdir /s /q " + BatchPath(backup) +
+      " >NUL 2>&1\n"
+      "mkdir " + BatchPath(backup) + " >NUL 2>&1\n";
+  AppendMakeParents(backup, replaced, &out);
+  out += "set FAILED=0\n";
+  AppendMoves("", backup, replaced, &out);
+  out +=
+      "if \"%FAILED%\"==\"1\" (\n"
+      "    echo   Backup failed\n"
+      "    goto restore\n"
+      ")\n"
+      "echo   Backup completed successfully\n"
+      "echo.\n"
+
+      // STEP 3: Move the staged files in, with retry logic
+      "echo [STEP 3/5] Applying update...\n";
+  AppendMakeParents("", plan.added, &out);
+  out +=
+      "set RETRY=0\n"
+      ":retry_move\n"
+      "set /a RETRY+=1\n"
+      "echo   Update attempt %RETRY%/" + retry_attempts + "...\n"
+      "set FAILED=0\n";
+  AppendMoves(staging, "", staged, &out);
+  out +=
+      "if \"%FAILED%\"==\"0\" (\n"
+      "    echo   Update applied successfully\n"
+      "    rmdir /s /q " + BatchPath(backup) + " >NUL 2>&1\n"
+      "    goto cleanup\n"
+      ")\n"
+      "if %RETRY% LSS " + retry_attempts + " (\n"
+      "    echo   Update failed - retrying in " + retry_delay +
+      " seconds...\n"
+      "    timeout /t " + retry_delay + " /nobreak > NUL\n"
+      "    goto retry_move\n"
+      ")\n"
+      "echo   All update attempts failed\n"
+      "echo.\n"
+
+      // STEP 4: Undo the update if it failed
+      ":restore\n"
+      "echo [STEP 4/5] Restoring from backup...\n"
+      "echo   Update failed - restoring previous version\n"
+      "set FAILED=0\n";
+  for (const std::string& path : plan.added) {
+    const std::string target = BatchPath(path);
+    out += "if exist " + target + " (del /F /Q " + target +
+           " >NUL 2>&1 || set FAILED=1)\n";
+  }
+  AppendMoves(backup, "", replaced, &out);
+  out +=
+      "if \"%FAILED%\"==\"0\" (\n"
+      "    echo   Backup restored successfully\n"
+      "    rmdir /s /q " + BatchPath(backup) + " >NUL 2>&1\n"
+      ") else (\n"
+      "    echo   WARNING: Some files could not be restored, see " +
+      backup + "\n"
+      ")\n"
+      "echo.\n"
+
+      // STEP 5: Cleanup and restart
+      ":cleanup\n"
+      "echo [STEP 5/5] Cleanup and restart...\n"
+      "echo   Removing update files...\n"
+      "rmdir /S /Q " + BatchPath(staging) + " >NUL 2>&1\n"
+      "echo   Starting application in foreground...\n"
+      "start /MAX \"\" " + BatchPath(exe_path) + "\n"
+      "timeout /t 1 /nobreak > NUL\n"
+      "echo   Cleaning up temporary files...\n"
+      "del " + std::string(kBatchScriptName) + " >NUL 2>&1\n"
+      "echo.\n"
+      "echo Update process completed.\n"
+      "exit\n";
+  return out;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,71 @@
+#ifndef DESKTOP_UPDATER_BATCH_SCRIPT_H_
+#define DESKTOP_UPDATER_BATCH_SCRIPT_H_
+
+#include <string>
+#include <vector>
+
+namespace desktop_updater {
+
+// Script the Windows plugin writes next to the executable and runs once the
+// app has exited.
+constexpr char kBatchScriptName[] = "update_script.bat";
+// Replaced and removed files are moved here until the update is in place.
+constexpr char kBatchBackupDirName[] = "backup";
+
+/**
+ * @brief The files an update touches, as normalized relative paths.
+ */
+struct BatchPlan {
+  // Staged files replacing installed ones.
+  std::vector<std::string> changed;
+  // Staged files that are not installed yet.
+  std::vector<std::string> added;
+  // Installed files the new release no longer has.
+  std::vector<std::string> removed;
+};
+
+/**
+ * @brief Builds the plan of the update staged in |staging_dir| for the
+ *        install in |app_dir|.
+ *
+ * The staged files are the ones of the verified receipt when there is one,
+ * else every file below |staging_dir|; each is changed or added depending
+ * on whether |app_dir| has it. Of |removed| (paths of the check's
+ * removedFiles) only installed files the update does not stage are kept.
+ * Fails on paths that could escape |app_dir|.
+ */
+bool PlanBatchUpdate(const std::string& app_dir,
+                     const std::string& staging_dir,
+                     const std::vector<std::string>& removed,
+                     BatchPlan* plan,
+                     std::string* error);
+
+struct BatchScriptOptions {
+  // Full path of the executable, restarted at the end.
+  std::string executable_path;
+  // Staging folder, relative to the app folder the script runs in.
+  std::string staging_dir = "update";
+  // Polls for the app to exit before it is killed.
+  int wait_attempts = 5;
+  // Attempts at moving the staged files in, for files still locked by
+  // a scanner or indexer.
+  int retry_attempts = 3;
+  int retry_delay_seconds = 2;
+};
+
+/**
+ * @brief Generates the update script for |plan|.
+ *
+ * The script waits for the app to exit, moves the changed and removed
+ * files into the backup folder, moves the staged files in with retries and
+ * restarts the app. Renames stay on one volume, so only the files of the
+ * plan are touched and nothing is copied. If a step fails for good, the
+ * added files are deleted and the backup is moved back. Every step skips
+ * files already done, so the apply step can simply run again.
+ */
+std::string GenerateBatchScript(const BatchPlan& plan,
+                                const BatchScriptOptions& options);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_BATCH_SCRIPT_H_
@@ -0,0 +1,145 @@
+#include "blake2b.h"
+
+#include <cstring>
+
+namespace desktop_updater {
+
+namespace {
+
+constexpr uint64_t kIv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL,
+    0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+constexpr uint8_t kSigma[12][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+};
+
+inline uint64_t Rotr(uint64_t x, int n) { return (x >> n) | (x << (64 - n)); }
+
+inline uint64_t Load64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int i = 7; i >= 0; i--) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+inline void G(uint64_t* v, int a, int b, int c, int d, uint64_t x,
+              uint64_t y) {
+  v[a] = v[a] + v[b] + x;
+  v[d] = Rotr(v[d] ^ v[a], 32);
+  v[c] = v[c] + v[d];
+  v[b] = Rotr(v[b] ^ v[c], 24);
+  v[a] = v[a] + v[b] + y;
+  v[d] = Rotr(v[d] ^ v[a], 16);
+  v[c] = v[c] + v[d];
+  v[b] = Rotr(v[b] ^ v[c], 63);
+}
+
+}  // namespace
+
+Blake2b::Blake2b(size_t digest_size) : digest_size_(digest_size) {
+  if (digest_size_ == 0 || digest_size_ > kMaxDigestSize) {
+    digest_size_ = kMaxDigestSize;
+  }
+  for (size_t i = 0; i < 8; i++) {
+    h_[i] = kIv[i];
+  }
+  // Parameter block: digest length, no key, fanout 1, depth 1.
+  h_[0] ^= 0x01010000ULL ^ static_cast<uint64_t>(digest_size_);
+}
+
+void Blake2b::Update(const uint8_t* data, size_t size) {
+  while (size > 0) {
+    // Keep the last block buffered: it has to be compressed with the final
+    // flag set, which is only known in Final().
+    if (buffered_ == kBlockSize) {
+      t_[0] += kBlockSize;
+      if (t_[0] < kBlockSize) {
+        t_[1]++;
+      }
+      Compress(buffer_.data(), false);
+      buffered_ = 0;
+    }
+    // Compress whole blocks straight from the input when possible.
+    if (buffered_ == 0) {
+      while (size > kBlockSize) {
+        t_[0] += kBlockSize;
+        if (t_[0] < kBlockSize) {
+          t_[1]++;
+        }
+        Compress(data, false);
+        data += kBlockSize;
+        size -= kBlockSize;
+      }
+    }
+    const size_t take =
+        size < kBlockSize - buffered_ ? size : kBlockSize - buffered_;
+    memcpy(buffer_.data() + buffered_, data, take);
+    buffered_ += take;
+    data += take;
+    size -= take;
+  }
+}
+
+void Blake2b::Final(uint8_t* out) {
+  t_[0] += buffered_;
+  if (t_[0] < buffered_) {
+    t_[1]++;
+  }
+  memset(buffer_.data() + buffered_, 0, kBlockSize - buffered_);
+  Compress(buffer_.data(), true);
+
+  for (size_t i = 0; i < digest_size_; i++) {
+    out[i] = static_cast<uint8_t>(h_[i / 8] >> (8 * (i % 8)));
+  }
+}
+
+void Blake2b::Compress(const uint8_t* block, bool last) {
+  uint64_t m[16];
+  for (int i = 0; i < 16; i++) {
+    m[i] = Load64(block + i * 8);
+  }
+
+  uint64_t v[16];
+  for (int i = 0; i < 8; i++) {
+    v[i] = h_[i];
+    v[i + 8] = kIv[i];
+  }
+  v[12] ^= t_[0];
+  v[13] ^= t_[1];
+  if (last) {
+    v[14] = ~v[14];
+  }
+
+  for (int round = 0; round < 12; round++) {
+    const uint8_t* s = kSigma[round];
+    G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+    G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+    G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+    G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+    G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+    G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+    G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+    G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+  }
+
+  for (int i = 0; i < 8; i++) {
+    h_[i] ^= v[i] ^ v[i + 8];
+  }
+}
+
+}  // namespace desktop_updater
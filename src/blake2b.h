@@ -0,0 +1,43 @@
+#ifndef DESKTOP_UPDATER_BLAKE2B_H_
+#define DESKTOP_UPDATER_BLAKE2B_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace desktop_updater {
+
+/**
+ * @brief Incremental unkeyed BLAKE2b (RFC 7693).
+ *
+ * Defaults to the 64 byte digest produced by `Blake2b()` from
+ * package:cryptography, which the Dart code and hashes.json use.
+ */
+class Blake2b {
+ public:
+  static constexpr size_t kBlockSize = 128;
+  static constexpr size_t kMaxDigestSize = 64;
+
+  explicit Blake2b(size_t digest_size = kMaxDigestSize);
+
+  void Update(const uint8_t* data, size_t size);
+
+  // Writes digest_size() bytes to |out|. The object must not be updated
+  // afterwards.
+  void Final(uint8_t* out);
+
+  size_t digest_size() const { return digest_size_; }
+
+ private:
+  void Compress(const uint8_t* block, bool last);
+
+  std::array<uint64_t, 8> h_;
+  std::array<uint64_t, 2> t_ = {0, 0};
+  std::array<uint8_t, kBlockSize> buffer_;
+  size_t buffered_ = 0;
+  size_t digest_size_;
+};
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_BLAKE2B_H_
@@ -0,0 +1,61 @@
+#ifndef DESKTOP_UPDATER_COUNTING_ALLOCATOR_H_
+#define DESKTOP_UPDATER_COUNTING_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace desktop_updater {
+
+namespace internal {
+// Implemented in metrics.cc, which attributes the bytes to the phases open
+// on the calling thread.
+void NoteAllocated(size_t bytes);
+void NoteFreed(size_t bytes);
+}  // namespace internal
+
+/**
+ * @brief std::allocator that reports every allocation to the metrics.
+ *
+ * Used for the engine's large and numerous allocations: file and download
+ * buffers, delta inputs and outputs, manifests and JSON trees. Stateless,
+ * so containers using it swap and move like with std::allocator.
+ */
+template <typename T>
+class CountingAllocator {
+ public:
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(size_t count) {
+    T* pointer = std::allocator<T>().allocate(count);
+    internal::NoteAllocated(count * sizeof(T));
+    return pointer;
+  }
+
+  void deallocate(T* pointer, size_t count) {
+    internal::NoteFreed(count * sizeof(T));
+    std::allocator<T>().deallocate(pointer, count);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) {
+  return false;
+}
+
+// Byte buffer whose allocations show up in the phase metrics.
+using ByteBuffer = std::vector<uint8_t, CountingAllocator<uint8_t>>;
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_COUNTING_ALLOCATOR_H_
@@ -0,0 +1,299 @@
+#include "delta.h"
+
+#include <cstring>
+
+#include "elf_delta.h"
+
+namespace desktop_updater {
+
+namespace {
+
+constexpr uint8_t kOpCopy = 0x01;
+constexpr uint8_t kOpInsert = 0x02;
+
+// Largest target ApplyDelta will allocate up front.
+constexpr uint64_t kMaxTargetLength = uint64_t{1} << 34;
+
+// CreateDelta() indexes |kMatchBlock| bytes of the base every
+// |kIndexStride| bytes, so every common run of at least
+// kMatchBlock + kIndexStride - 1 bytes is found.
+constexpr size_t kMatchBlock = 32;
+constexpr size_t kIndexStride = 8;
+// A match resumes across at most |kMaxGap| differing bytes when the next
+// |kResyncBlock| bytes agree again.
+constexpr size_t kMaxGap = 8;
+constexpr size_t kResyncBlock = 8;
+constexpr uint32_t kEmptySlot = UINT32_MAX;
+constexpr uint64_t kHashBase = 0x100000001B3ull;
+
+using IndexTable = std::vector<uint32_t, CountingAllocator<uint32_t>>;
+
+// Polynomial hash of |kMatchBlock| bytes, updated by RollHash().
+uint64_t HashBlock(const uint8_t* data) {
+  uint64_t hash = 0;
+  for (size_t i = 0; i < kMatchBlock; i++) {
+    hash = hash * kHashBase + data[i];
+  }
+  return hash;
+}
+
+uint64_t BlockOutFactor() {
+  uint64_t power = 1;
+  for (size_t i = 1; i < kMatchBlock; i++) {
+    power *= kHashBase;
+  }
+  return power;
+}
+
+size_t IndexSlots(uint64_t base_size) {
+  size_t slots = 1024;
+  while (slots < base_size / kIndexStride * 2) {
+    slots <<= 1;
+  }
+  return slots;
+}
+
+size_t Slot(uint64_t hash, size_t slots) {
+  return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> 32) &
+         (slots - 1);
+}
+
+// Returns how many differing bytes at |base|[b], |target|[t] a match can
+// skip before the next |kResyncBlock| bytes agree again, or 0.
+size_t FindResync(const ByteBuffer& base,
+                  size_t b,
+                  const ByteBuffer& target,
+                  size_t t) {
+  for (size_t gap = 1; gap <= kMaxGap; gap++) {
+    if (b + gap + kResyncBlock > base.size() ||
+        t + gap + kResyncBlock > target.size()) {
+      return 0;
+    }
+    if (memcmp(base.data() + b + gap, target.data() + t + gap,
+               kResyncBlock) == 0) {
+      return gap;
+    }
+  }
+  return 0;
+}
+
+class DeltaReader {
+ public:
+  explicit DeltaReader(const ByteBuffer& data) : data_(data) {}
+
+  bool ReadByte(uint8_t* out) {
+    if (offset_ >= data_.size()) {
+      return false;
+    }
+    *out = data_[offset_++];
+    return true;
+  }
+
+  bool ReadVarint(uint64_t* out) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t byte;
+      if (!ReadByte(&byte)) {
+        return false;
+      }
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        *out = value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Skip(size_t size, const uint8_t** out) {
+    if (size > data_.size() - offset_) {
+      return false;
+    }
+    *out = data_.data() + offset_;
+    offset_ += size;
+    return true;
+  }
+
+ private:
+  const ByteBuffer& data_;
+  size_t offset_ = 0;
+};
+
+}  // namespace
+
+DeltaWriter::DeltaWriter(uint64_t target_length) {
+  data_.insert(data_.end(), kDeltaMagic, kDeltaMagic + kDeltaMagicSize);
+  AppendVarint(target_length);
+}
+
+void DeltaWriter::Copy(uint64_t offset, uint64_t length) {
+  if (copies_ != nullptr) {
+    DeltaCopy copy;
+    copy.base_offset = offset;
+    copy.target_offset = written_;
+    copy.length = length;
+    copies_->push_back(copy);
+  }
+  written_ += length;
+  data_.push_back(kOpCopy);
+  AppendVarint(offset);
+  AppendVarint(length);
+}
+
+void DeltaWriter::Insert(const uint8_t* data, size_t size) {
+  written_ += size;
+  data_.push_back(kOpInsert);
+  AppendVarint(size);
+  data_.insert(data_.end(), data, data + size);
+}
+
+void DeltaWriter::AppendVarint(uint64_t value) {
+  while (value >= 0x80) {
+    data_.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  data_.push_back(static_cast<uint8_t>(value));
+}
+
+ByteBuffer CreateDelta(const ByteBuffer& base,
+                       const ByteBuffer& target,
+                       std::vector<DeltaCopy>* copies) {
+  DeltaWriter writer(target.size());
+  writer.RecordCopies(copies);
+  const size_t base_size = base.size();
+  const size_t target_size = target.size();
+  if (base_size < kMatchBlock || target_size < kMatchBlock ||
+      base_size >= kEmptySlot) {
+    if (target_size > 0) {
+      writer.Insert(target.data(), target_size);
+    }
+    return writer.Take();
+  }
+
+  const size_t slots = IndexSlots(base_size);
+  IndexTable table(slots, kEmptySlot);
+  for (size_t p = 0; p + kMatchBlock <= base_size; p += kIndexStride) {
+    table[Slot(HashBlock(base.data() + p), slots)] = static_cast<uint32_t>(p);
+  }
+
+  const uint64_t out_factor = BlockOutFactor();
+  size_t pos = 0;
+  size_t literal = 0;
+  uint64_t hash = HashBlock(target.data());
+  for (;;) {
+    const uint32_t candidate = table[Slot(hash, slots)];
+    if (candidate != kEmptySlot &&
+        memcmp(base.data() + candidate, target.data() + pos, kMatchBlock) ==
+            0) {
+      // Grow the match backwards into the pending literal bytes.
+      size_t b = candidate;
+      size_t t = pos;
+      while (t > literal && b > 0 && base[b - 1] == target[t - 1]) {
+        b--;
+        t--;
+      }
+      if (t > literal) {
+        writer.Insert(target.data() + literal, t - literal);
+      }
+      size_t b_end = candidate + kMatchBlock;
+      size_t t_end = pos + kMatchBlock;
+      for (;;) {
+        while (t_end < target_size && b_end < base_size &&
+               base[b_end] == target[t_end]) {
+          b_end++;
+          t_end++;
+        }
+        const size_t gap = FindResync(base, b_end, target, t_end);
+        if (gap == 0) {
+          break;
+        }
+        writer.Copy(b, b_end - b);
+        writer.Insert(target.data() + t_end, gap);
+        b_end += gap;
+        t_end += gap;
+        b = b_end;
+      }
+      writer.Copy(b, b_end - b);
+      pos = t_end;
+      literal = pos;
+      if (pos + kMatchBlock > target_size) {
+        break;
+      }
+      hash = HashBlock(target.data() + pos);
+      continue;
+    }
+    if (pos + kMatchBlock >= target_size) {
+      break;
+    }
+    hash = (hash - target[pos] * out_factor) * kHashBase +
+           target[pos + kMatchBlock];
+    pos++;
+  }
+  if (literal < target_size) {
+    writer.Insert(target.data() + literal, target_size - literal);
+  }
+  return writer.Take();
+}
+
+uint64_t EstimateDeltaMemory(uint64_t base_size, uint64_t target_size) {
+  // Inputs, index, and a delta no larger than an insert of the target.
+  return base_size + target_size + IndexSlots(base_size) * sizeof(uint32_t) +
+         target_size + 64;
+}
+
+bool ApplyDelta(const ByteBuffer& base,
+                const ByteBuffer& delta,
+                ByteBuffer* out,
+                std::string* error) {
+  if (IsElfDelta(delta)) {
+    return ApplyElfDelta(base, delta, out, error);
+  }
+  DeltaReader reader(delta);
+  const uint8_t* magic;
+  uint64_t target_length;
+  if (!reader.Skip(kDeltaMagicSize, &magic) ||
+      memcmp(magic, kDeltaMagic, kDeltaMagicSize) != 0 ||
+      !reader.ReadVarint(&target_length) ||
+      target_length > kMaxTargetLength) {
+    *error = "Invalid delta header";
+    return false;
+  }
+
+  out->clear();
+  out->reserve(static_cast<size_t>(target_length));
+  while (out->size() < target_length) {
+    uint8_t op;
+    if (!reader.ReadByte(&op)) {
+      *error = "Truncated delta";
+      return false;
+    }
+    const uint64_t remaining = target_length - out->size();
+    if (op == kOpCopy) {
+      uint64_t offset;
+      uint64_t length;
+      if (!reader.ReadVarint(&offset) || !reader.ReadVarint(&length) ||
+          offset > base.size() || length > base.size() - offset ||
+          length > remaining) {
+        *error = "Delta copy out of range";
+        return false;
+      }
+      out->insert(out->end(), base.begin() + static_cast<ptrdiff_t>(offset),
+                  base.begin() + static_cast<ptrdiff_t>(offset + length));
+    } else if (op == kOpInsert) {
+      uint64_t length;
+      const uint8_t* bytes;
+      if (!reader.ReadVarint(&length) || length > remaining ||
+          !reader.Skip(static_cast<size_t>(length), &bytes)) {
+        *error = "Delta insert out of range";
+        return false;
+      }
+      out->insert(out->end(), bytes, bytes + length);
+    } else {
+      *error = "Unknown delta op";
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,90 @@
+#ifndef DESKTOP_UPDATER_DELTA_H_
+#define DESKTOP_UPDATER_DELTA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "counting_allocator.h"
+
+namespace desktop_updater {
+
+/**
+ * Binary delta format ("DUDELTA1"), referenced from hashes.json "patches":
+ *
+ *   magic    "DUDELTA1"
+ *   varint   target length
+ *   ops...   until the target is complete:
+ *     0x01 varint offset, varint length   copy bytes from the base file
+ *     0x02 varint length, bytes           insert literal bytes
+ *
+ * Varints are unsigned LEB128. The result is verified against the target
+ * digest by the caller, so the format carries no checksum of its own.
+ * ApplyDelta() also takes the ELF-aware deltas of elf_delta.h.
+ */
+constexpr char kDeltaMagic[] = "DUDELTA1";
+constexpr size_t kDeltaMagicSize = 8;
+
+// A run of the target a delta copies from the base.
+struct DeltaCopy {
+  uint64_t base_offset = 0;
+  uint64_t target_offset = 0;
+  uint64_t length = 0;
+};
+
+// Builds a delta op by op.
+class DeltaWriter {
+ public:
+  explicit DeltaWriter(uint64_t target_length);
+
+  void Copy(uint64_t offset, uint64_t length);
+  void Insert(const uint8_t* data, size_t size);
+
+  // Also appends every Copy() to |copies|, in target order.
+  void RecordCopies(std::vector<DeltaCopy>* copies) { copies_ = copies; }
+
+  const ByteBuffer& data() const { return data_; }
+  ByteBuffer Take() { return std::move(data_); }
+
+ private:
+  void AppendVarint(uint64_t value);
+
+  ByteBuffer data_;
+  // Target bytes produced by the ops so far.
+  uint64_t written_ = 0;
+  std::vector<DeltaCopy>* copies_ = nullptr;
+};
+
+/**
+ * @brief Computes a delta that turns |base| into |target|.
+ *
+ * Matches are found through a hash index of |base| sampled every few
+ * bytes and extended in both directions. Across a short run of differing
+ * bytes, such as a relocated address, a match resumes at the same
+ * alignment, so the delta becomes copy, small insert, copy instead of
+ * a long insert; this is what bsdiff's add blocks buy on binaries.
+ * Used by the release packer; clients only apply deltas. With |copies|,
+ * also returns the copy ops, i.e. how the base's bytes moved.
+ */
+ByteBuffer CreateDelta(const ByteBuffer& base,
+                       const ByteBuffer& target,
+                       std::vector<DeltaCopy>* copies = nullptr);
+
+// Upper bound of the memory CreateDelta() needs for inputs of these sizes,
+// including the inputs themselves.
+uint64_t EstimateDeltaMemory(uint64_t base_size, uint64_t target_size);
+
+/**
+ * @brief Reconstructs the target from |base| and |delta|.
+ * @return false with |error| set if the delta is malformed or reads outside
+ *         the base.
+ */
+bool ApplyDelta(const ByteBuffer& base,
+                const ByteBuffer& delta,
+                ByteBuffer* out,
+                std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_DELTA_H_
@@ -0,0 +1,164 @@
+#include "desktop_updater_core.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "file_hash.h"
+#include "manifest.h"
+
+namespace desktop_updater {
+
+namespace {
+
+// Owns the storage a du_result points into. |result| must stay the first
+// member so the public pointer can be converted back.
+struct ResultHolder {
+  du_result result;
+  std::vector<uint8_t> data;
+  std::string error;
+};
+
+void AppendLittleEndian(std::vector<uint8_t>* out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+class RecordWriter {
+ public:
+  explicit RecordWriter(size_t expected_records) {
+    data_.reserve(8 + expected_records * 128);
+    AppendLittleEndian(&data_, DU_RECORDS_VERSION, 4);
+    AppendLittleEndian(&data_, 0, 4);
+  }
+
+  void Add(const FileEntry& entry, du_record_kind kind) {
+    AppendLittleEndian(&data_, entry.length, 8);
+    AppendLittleEndian(&data_, entry.path.size(), 4);
+    data_.push_back(static_cast<uint8_t>(kind));
+    data_.insert(data_.end(), 3, 0);
+    data_.insert(data_.end(), entry.digest.begin(), entry.digest.end());
+    data_.insert(data_.end(), entry.path.begin(), entry.path.end());
+    count_++;
+  }
+
+  std::vector<uint8_t> Finish() {
+    for (int i = 0; i < 4; i++) {
+      data_[4 + i] = static_cast<uint8_t>(count_ >> (8 * i));
+    }
+    return std::move(data_);
+  }
+
+ private:
+  std::vector<uint8_t> data_;
+  uint32_t count_ = 0;
+};
+
+du_result* MakeResult(std::vector<uint8_t> data) {
+  ResultHolder* holder = new ResultHolder();
+  holder->data = std::move(data);
+  holder->result.status = DU_OK;
+  holder->result.data = holder->data.data();
+  holder->result.size = holder->data.size();
+  holder->result.error = holder->error.c_str();
+  return &holder->result;
+}
+
+du_result* MakeError(du_status status, std::string message) {
+  ResultHolder* holder = new ResultHolder();
+  holder->error = std::move(message);
+  holder->result.status = status;
+  holder->result.data = nullptr;
+  holder->result.size = 0;
+  holder->result.error = holder->error.c_str();
+  return &holder->result;
+}
+
+du_result* ManifestResult(const Manifest& manifest) {
+  RecordWriter writer(manifest.size());
+  for (const FileEntry& entry : manifest) {
+    writer.Add(entry, DU_RECORD_FILE);
+  }
+  return MakeResult(writer.Finish());
+}
+
+}  // namespace
+
+}  // namespace desktop_updater
+
+namespace du = desktop_updater;
+
+int32_t du_core_version(void) {
+  return DU_RECORDS_VERSION;
+}
+
+int32_t du_hash_file(const char* path, uint8_t* digest, uint64_t* length) {
+  if (path == nullptr || digest == nullptr || length == nullptr) {
+    return DU_ERROR_INVALID_ARGUMENT;
+  }
+  du::Digest result;
+  std::string error;
+  if (!du::HashFile(path, &result, length, &error)) {
+    return DU_ERROR_IO;
+  }
+  memcpy(digest, result.data(), result.size());
+  return DU_OK;
+}
+
+du_result* du_hash_tree(const char* root, int32_t threads) {
+  if (root == nullptr || threads < 0) {
+    return du::MakeError(DU_ERROR_INVALID_ARGUMENT, "Invalid arguments");
+  }
+  du::Manifest manifest;
+  std::string error;
+  if (!du::HashTree(root, du::ScanOptions(), static_cast<unsigned>(threads),
+                    &manifest, &error)) {
+    return du::MakeError(DU_ERROR_IO, error);
+  }
+  return du::ManifestResult(manifest);
+}
+
+du_result* du_parse_manifest(const char* json, uint64_t size) {
+  if (json == nullptr) {
+    return du::MakeError(DU_ERROR_INVALID_ARGUMENT, "Invalid arguments");
+  }
+  du::Manifest manifest;
+  std::string error;
+  if (!du::ParseManifest(json, static_cast<size_t>(size), &manifest, &error)) {
+    return du::MakeError(DU_ERROR_PARSE, error);
+  }
+  return du::ManifestResult(manifest);
+}
+
+du_result* du_diff_manifests(const char* installed_json,
+                             uint64_t installed_size,
+                             const char* target_json,
+                             uint64_t target_size) {
+  if (installed_json == nullptr || target_json == nullptr) {
+    return du::MakeError(DU_ERROR_INVALID_ARGUMENT, "Invalid arguments");
+  }
+  du::Manifest installed;
+  du::Manifest target;
+  std::string error;
+  if (!du::ParseManifest(installed_json, static_cast<size_t>(installed_size),
+                         &installed, &error) ||
+      !du::ParseManifest(target_json, static_cast<size_t>(target_size),
+                         &target, &error)) {
+    return du::MakeError(DU_ERROR_PARSE, error);
+  }
+
+  const du::ManifestDiff diff = du::DiffManifests(installed, target);
+  du::RecordWriter writer(diff.changed.size() + diff.removed.size());
+  for (const du::FileEntry& entry : diff.changed) {
+    writer.Add(entry, DU_RECORD_CHANGED);
+  }
+  for (const du::FileEntry& entry : diff.removed) {
+    writer.Add(entry, DU_RECORD_REMOVED);
+  }
+  return du::MakeResult(writer.Finish());
+}
+
+void du_result_free(du_result* result) {
+  delete reinterpret_cast<du::ResultHolder*>(result);
+}
@@ -0,0 +1,36 @@
+# Platform-independent sources of the native update engine. Included by the
+# platform plugin builds, which add their own glue (HTTP stack, channels).
+# desktop_updater_core.h is the C ABI the plugin library exports for
+# dart:ffi.
+set(DESKTOP_UPDATER_CORE_DIR "${CMAKE_CURRENT_LIST_DIR}")
+
+list(APPEND DESKTOP_UPDATER_CORE_SOURCES
+  "${DESKTOP_UPDATER_CORE_DIR}/app_archive.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/batch_script.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/blake2b.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/delta.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/desktop_updater_core.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/disk_space.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/download_engine.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/elf_delta.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/file_hash.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/file_util.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/handoff.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/http_fetcher.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/install_verifier.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/json.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/manifest.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/manifest_index.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/metrics.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/perf_counters.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/probes.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/process_memory.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/progress_tracker.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/release_planner.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/relaunch.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/startup_warmup.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/trace.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/update_applier.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/update_check.cc"
+  "${DESKTOP_UPDATER_CORE_DIR}/version_info.cc"
+)
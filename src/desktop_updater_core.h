@@ -0,0 +1,99 @@
+#ifndef DESKTOP_UPDATER_CORE_H_
+#define DESKTOP_UPDATER_CORE_H_
+
+// Stable C ABI of the native update engine.
+//
+// These functions are exported from the plugin library so Dart can bind them
+// with dart:ffi and call them from any isolate, bypassing the method channel
+// codec. They are thread-safe and block, so call them off the UI isolate.
+//
+// Results come back as a du_result owning a packed little-endian record
+// buffer that Dart reads directly as typed data:
+//
+//   header:  uint32 version (DU_RECORDS_VERSION), uint32 record count
+//   record:  uint64 length
+//            uint32 path byte length
+//            uint8  kind (du_record_kind)
+//            uint8  reserved[3]
+//            uint8  digest[DU_DIGEST_SIZE]  (BLAKE2b-512)
+//            uint8  path[path byte length]  (UTF-8, not terminated)
+//
+// Records are not padded, so readers must not assume alignment.
+
+#include <stdint.h>
+
+#if defined(FLUTTER_PLUGIN_IMPL)
+#if defined(_WIN32)
+#define DESKTOP_UPDATER_CORE_EXPORT __declspec(dllexport)
+#else
+#define DESKTOP_UPDATER_CORE_EXPORT __attribute__((visibility("default")))
+#endif
+#else
+#define DESKTOP_UPDATER_CORE_EXPORT
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define DU_RECORDS_VERSION 1
+#define DU_DIGEST_SIZE 64
+
+typedef enum {
+  DU_OK = 0,
+  DU_ERROR_INVALID_ARGUMENT = 1,
+  DU_ERROR_IO = 2,
+  DU_ERROR_PARSE = 3,
+} du_status;
+
+typedef enum {
+  // A manifest entry (hash tree, parsed manifest).
+  DU_RECORD_FILE = 0,
+  // Present in the target but missing or different locally.
+  DU_RECORD_CHANGED = 1,
+  // Present locally but no longer part of the target.
+  DU_RECORD_REMOVED = 2,
+} du_record_kind;
+
+typedef struct {
+  int32_t status;
+  // Record buffer, see above. Null unless status is DU_OK.
+  const uint8_t* data;
+  uint64_t size;
+  // NUL-terminated UTF-8 message. Empty when status is DU_OK.
+  const char* error;
+} du_result;
+
+// Returns DU_RECORDS_VERSION of the loaded library.
+DESKTOP_UPDATER_CORE_EXPORT int32_t du_core_version(void);
+
+// Hashes one file. |digest| must hold DU_DIGEST_SIZE bytes.
+DESKTOP_UPDATER_CORE_EXPORT int32_t du_hash_file(const char* path,
+                                                 uint8_t* digest,
+                                                 uint64_t* length);
+
+// Scans |root| recursively and hashes every regular file on |threads|
+// workers (0 = hardware concurrency). Records are sorted by path.
+DESKTOP_UPDATER_CORE_EXPORT du_result* du_hash_tree(const char* root,
+                                                    int32_t threads);
+
+// Parses a hashes.json document into records.
+DESKTOP_UPDATER_CORE_EXPORT du_result* du_parse_manifest(const char* json,
+                                                         uint64_t size);
+
+// Diffs two hashes.json documents. Emits DU_RECORD_CHANGED records for the
+// target's new or modified files followed by DU_RECORD_REMOVED records.
+DESKTOP_UPDATER_CORE_EXPORT du_result* du_diff_manifests(
+    const char* installed_json,
+    uint64_t installed_size,
+    const char* target_json,
+    uint64_t target_size);
+
+// Releases a result returned by any function above. Accepts null.
+DESKTOP_UPDATER_CORE_EXPORT void du_result_free(du_result* result);
+
+#if defined(__cplusplus)
+}  // extern "C"
+#endif
+
+#endif  // DESKTOP_UPDATER_CORE_H_
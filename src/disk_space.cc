@@ -0,0 +1,131 @@
+#include "disk_space.h"
+
+#include <filesystem>
+#include <system_error>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#endif
+
+#include "file_util.h"
+#include "update_applier.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+namespace {
+
+// Used where the filesystem does not report one.
+constexpr uint64_t kDefaultBlockSize = 4096;
+// Upper bound of a hash cache line: four 20-digit numbers, separators and
+// a base64 digest.
+constexpr uint64_t kHashCacheLineBytes = 4 * 20 + 4 + 88 + 1;
+
+uint64_t RoundUp(uint64_t value, uint64_t block) {
+  return (value + block - 1) / block * block;
+}
+
+uint64_t BlockSizeOf(const std::string& path) {
+#ifndef _WIN32
+  struct statvfs info;
+  if (statvfs(path.c_str(), &info) == 0 && info.f_frsize > 0) {
+    return static_cast<uint64_t>(info.f_frsize);
+  }
+#else
+  (void)path;
+#endif
+  return kDefaultBlockSize;
+}
+
+// Bytes already allocated to |path|, e.g. by an interrupted download.
+uint64_t AllocatedBytes(const std::string& path) {
+#ifndef _WIN32
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+    return static_cast<uint64_t>(st.st_blocks) * 512;
+  }
+  return 0;
+#else
+  std::error_code ec;
+  const uintmax_t size = fs::file_size(PathFromUtf8(path), ec);
+  return ec ? 0 : static_cast<uint64_t>(size);
+#endif
+}
+
+std::string Megabytes(uint64_t bytes) {
+  return std::to_string((bytes + (1 << 20) - 1) >> 20) + " MiB";
+}
+
+}  // namespace
+
+bool EstimateUpdateSpace(const std::string& app_dir,
+                         const Manifest& files,
+                         SpaceEstimate* out,
+                         std::string* error) {
+  *out = SpaceEstimate();
+  std::error_code ec;
+  const fs::space_info space = fs::space(PathFromUtf8(app_dir), ec);
+  if (ec) {
+    *error = "Cannot query free space of " + app_dir + ": " + ec.message();
+    return false;
+  }
+  out->available_bytes = static_cast<uint64_t>(space.available);
+  out->block_size = BlockSizeOf(app_dir);
+  const uint64_t block = out->block_size;
+
+  const std::string staging_dir = JoinPath(app_dir, kStagingDirName);
+  uint64_t journal_bytes = 0;
+  for (const FileEntry& entry : files) {
+    const std::string path = NormalizeRelativePath(entry.path);
+    const uint64_t needed = RoundUp(entry.length, block);
+    const uint64_t held = AllocatedBytes(JoinPath(staging_dir, path));
+    out->staging_bytes += needed > held ? needed - held : 0;
+    journal_bytes += path.size() + 1;
+  }
+  out->metadata_bytes =
+      RoundUp(SerializeManifest(files).size(), block) +
+      RoundUp(kHashCacheLineBytes * files.size(), block) +
+      RoundUp(journal_bytes, block);
+  return true;
+}
+
+bool CheckUpdateSpace(const std::string& app_dir,
+                      const Manifest& files,
+                      SpaceEstimate* out,
+                      std::string* error) {
+  if (!EstimateUpdateSpace(app_dir, files, out, error)) {
+    return false;
+  }
+  if (out->required() > out->available_bytes) {
+    *error = "Not enough disk space for the update: " +
+             Megabytes(out->required()) + " needed, " +
+             Megabytes(out->available_bytes) + " available";
+    return false;
+  }
+  return true;
+}
+
+bool PreallocateFile(FILE* file, uint64_t length) {
+#ifdef __linux__
+  if (length == 0) {
+    return true;
+  }
+  // KEEP_SIZE: a short body must not leave zero padding behind. Filesystems
+  // without fallocate report EOPNOTSUPP and just skip the reservation.
+  if (fallocate(fileno(file), FALLOC_FL_KEEP_SIZE, 0,
+                static_cast<off_t>(length)) != 0) {
+    return errno != ENOSPC && errno != EFBIG;
+  }
+  return true;
+#else
+  (void)file;
+  (void)length;
+  return true;
+#endif
+}
+
+}  // namespace desktop_updater
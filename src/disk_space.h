@@ -0,0 +1,58 @@
+#ifndef DESKTOP_UPDATER_DISK_SPACE_H_
+#define DESKTOP_UPDATER_DISK_SPACE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+
+/**
+ * @brief Disk space an update needs on the install's filesystem.
+ *
+ * Replaced files are moved to the backup folder by rename, so rollback
+ * costs no data blocks; what is needed is the staged copy of every file
+ * plus the receipt, hash cache and journal. Directory entries are not
+ * counted.
+ */
+struct SpaceEstimate {
+  // Staged files rounded up to whole blocks, minus blocks already held by
+  // a partial download of the same file.
+  uint64_t staging_bytes = 0;
+  uint64_t metadata_bytes = 0;
+  uint64_t available_bytes = 0;
+  uint64_t block_size = 0;
+
+  uint64_t required() const { return staging_bytes + metadata_bytes; }
+};
+
+/**
+ * @brief Computes the space needed to stage and apply |files| into
+ *        |app_dir|/update, and what its filesystem has available.
+ */
+bool EstimateUpdateSpace(const std::string& app_dir,
+                         const Manifest& files,
+                         SpaceEstimate* out,
+                         std::string* error);
+
+// Like EstimateUpdateSpace(), failing with a readable message when the
+// filesystem is short of space.
+bool CheckUpdateSpace(const std::string& app_dir,
+                      const Manifest& files,
+                      SpaceEstimate* out,
+                      std::string* error);
+
+/**
+ * @brief Reserves |length| bytes for |file| without changing its size.
+ *
+ * Keeps large binaries contiguous and turns a full disk into an early
+ * error. Returns false only when the filesystem is out of space; where
+ * reservation is unsupported it does nothing.
+ */
+bool PreallocateFile(FILE* file, uint64_t length);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_DISK_SPACE_H_
@@ -0,0 +1,241 @@
+#include "download_engine.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "blake2b.h"
+#include "delta.h"
+#include "disk_space.h"
+#include "file_util.h"
+#include "metrics.h"
+#include "probes.h"
+#include "trace.h"
+
+namespace desktop_updater {
+
+DownloadEngine::DownloadEngine(HttpFetcher* fetcher, ProgressTracker* tracker)
+    : fetcher_(fetcher), tracker_(tracker) {}
+
+bool DownloadEngine::Run(const std::string& base_url,
+                         const std::vector<DownloadItem>& items,
+                         const std::string& staging_dir,
+                         const DownloadOptions& options,
+                         std::string* error) {
+  TraceSpan span("fetch");
+  span.SetArg("files", static_cast<int64_t>(items.size()));
+  PhaseTimer timer(Phase::kFetch);
+  uint64_t total_bytes = 0;
+  for (const DownloadItem& item : items) {
+    if (!IsSafeRelativePath(item.path)) {
+      *error = "Refusing to download unsafe path: " + item.path;
+      return false;
+    }
+    total_bytes += item.length;
+  }
+  tracker_->Reset(total_bytes, static_cast<uint32_t>(items.size()));
+  cancelled_.store(false, std::memory_order_relaxed);
+
+  std::atomic<size_t> next{0};
+  std::mutex error_mutex;
+  std::string first_error;
+
+  auto worker = [&]() {
+    PhaseScope scope(Phase::kFetch);
+    std::string item_error;
+    while (!cancelled_.load(std::memory_order_relaxed)) {
+      const size_t index = next.fetch_add(1, std::memory_order_relaxed);
+      if (index >= items.size()) {
+        return;
+      }
+      tracker_->StartItem(static_cast<int64_t>(index));
+      const DownloadItem& item = items[index];
+      const bool ok =
+          item.steps.empty()
+              ? DownloadOne(base_url, item, staging_dir, options.preallocate,
+                            &item_error)
+              : DownloadPlanned(item, staging_dir, options.base_dir,
+                                &item_error);
+      if (!ok) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (first_error.empty()) {
+          first_error = item_error;
+        }
+        Cancel();
+        return;
+      }
+      tracker_->CompleteFile();
+    }
+  };
+
+  unsigned workers = options.workers ? options.workers : kDefaultWorkers;
+  workers = static_cast<unsigned>(
+      std::min<size_t>(workers, std::max<size_t>(items.size(), 1)));
+
+  std::vector<std::thread> threads;
+  threads.reserve(workers - 1);
+  for (unsigned i = 1; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  tracker_->MarkDone();
+
+  if (!first_error.empty()) {
+    AddCount(Counter::kFetchFailures);
+    *error = first_error;
+    return false;
+  }
+  if (cancelled_.load(std::memory_order_relaxed)) {
+    *error = "Download cancelled";
+    return false;
+  }
+  return true;
+}
+
+bool DownloadEngine::DownloadOne(const std::string& base_url,
+                                 const DownloadItem& item,
+                                 const std::string& staging_dir,
+                                 bool preallocate,
+                                 std::string* error) {
+  TraceSpan span("fetch_file");
+  span.SetArg("bytes", static_cast<int64_t>(item.length));
+  PhaseTimer timer(Phase::kFetchFile);
+  const int64_t probe_start =
+      DESKTOP_UPDATER_PROBE_ENABLED(download_done) ? ProbeNanos() : 0;
+  const std::string relative = NormalizeRelativePath(item.path);
+  const std::string destination = JoinPath(staging_dir, relative);
+  if (!CreateParentDirectories(destination, error)) {
+    return false;
+  }
+
+  FILE* file = OpenFile(destination, "wb");
+  if (file == nullptr) {
+    *error = "Cannot open " + destination + " for writing";
+    return false;
+  }
+  if (preallocate && !PreallocateFile(file, item.length)) {
+    fclose(file);
+    *error = "Not enough disk space for " + destination;
+    return false;
+  }
+
+  bool write_failed = false;
+  uint64_t received = 0;
+  const bool fetched = fetcher_->Get(
+      JoinUrl(base_url, item.object.empty() ? relative : item.object),
+      [&](const uint8_t* data, size_t size) {
+        if (cancelled_.load(std::memory_order_relaxed)) {
+          return false;
+        }
+        if (fwrite(data, 1, size, file) != size) {
+          write_failed = true;
+          return false;
+        }
+        DESKTOP_UPDATER_PROBE3(download_chunk, relative.c_str(), received,
+                               size);
+        received += size;
+        tracker_->AddBytes(size);
+        return true;
+      },
+      error);
+
+  const bool closed = fclose(file) == 0;
+  if (write_failed || !closed) {
+    *error = "Failed to write " + destination;
+    return false;
+  }
+  if (!fetched) {
+    // Keep the aggregate consistent with what actually landed on disk.
+    tracker_->RemoveBytes(received);
+    return false;
+  }
+  AddCount(Counter::kFilesDownloaded);
+  AddCount(Counter::kBytesDownloaded, received);
+  AddCount(Counter::kBytesStaged, received);
+  if (DESKTOP_UPDATER_PROBE_ENABLED(download_done)) {
+    DESKTOP_UPDATER_PROBE3(download_done, relative.c_str(), received,
+                           ProbeNanos() - probe_start);
+  }
+  return true;
+}
+
+bool DownloadEngine::DownloadPlanned(const DownloadItem& item,
+                                     const std::string& staging_dir,
+                                     const std::string& base_dir,
+                                     std::string* error) {
+  TraceSpan span("fetch_patched_file");
+  span.SetArg("steps", static_cast<int64_t>(item.steps.size()));
+  PhaseTimer timer(Phase::kFetchFile);
+  const std::string relative = NormalizeRelativePath(item.path);
+  ByteBuffer current;
+  bool have_current = false;
+  for (const PlanStep& step : item.steps) {
+    ByteBuffer body;
+    if (!FetchToMemory(step.url, &body, error)) {
+      return false;
+    }
+    if (step.kind == PlanStep::Kind::kFull) {
+      current.swap(body);
+    } else {
+      if (!have_current &&
+          !ReadFileBytes(JoinPath(base_dir, relative), &current, error)) {
+        return false;
+      }
+      ByteBuffer patched;
+      if (!ApplyDelta(current, body, &patched, error)) {
+        *error = "Cannot patch " + item.path + ": " + *error;
+        return false;
+      }
+      current.swap(patched);
+    }
+    have_current = true;
+
+    Digest digest;
+    Blake2b hash;
+    hash.Update(current.data(), current.size());
+    hash.Final(digest.data());
+    if (digest != step.result) {
+      *error = "Hash mismatch for " + item.path + " after " + step.url;
+      return false;
+    }
+  }
+
+  const std::string destination = JoinPath(staging_dir, relative);
+  if (!CreateParentDirectories(destination, error) ||
+      !WriteFileBytes(destination, current.data(), current.size(), error)) {
+    return false;
+  }
+  AddCount(Counter::kFilesDownloaded);
+  AddCount(Counter::kBytesStaged, current.size());
+  return true;
+}
+
+bool DownloadEngine::FetchToMemory(const std::string& url,
+                                   ByteBuffer* body,
+                                   std::string* error) {
+  body->clear();
+  const bool fetched = fetcher_->Get(
+      url,
+      [&](const uint8_t* data, size_t size) {
+        if (cancelled_.load(std::memory_order_relaxed)) {
+          return false;
+        }
+        body->insert(body->end(), data, data + size);
+        tracker_->AddBytes(size);
+        return true;
+      },
+      error);
+  if (!fetched) {
+    tracker_->RemoveBytes(body->size());
+    return false;
+  }
+  AddCount(Counter::kBytesDownloaded, body->size());
+  return true;
+}
+
+}  // namespace desktop_updater
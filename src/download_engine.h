@@ -0,0 +1,98 @@
+#ifndef DESKTOP_UPDATER_DOWNLOAD_ENGINE_H_
+#define DESKTOP_UPDATER_DOWNLOAD_ENGINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "http_fetcher.h"
+#include "progress_tracker.h"
+#include "release_planner.h"
+
+namespace desktop_updater {
+
+/**
+ * @brief A file to fetch, relative to both the remote folder and the
+ *        staging directory.
+ */
+struct DownloadItem {
+  std::string path;
+  // Bytes the item transfers, i.e. the plan's bytes when |steps| is set.
+  uint64_t length = 0;
+  // Manifest "object" of the file. Unplanned downloads fetch it instead of
+  // |path| when set.
+  std::string object;
+  // Planned transfers from PlanUpdate(). Empty means a full download of
+  // |path| from the base URL.
+  std::vector<PlanStep> steps;
+};
+
+struct DownloadOptions {
+  // Number of concurrent transfers; 0 selects kDefaultWorkers.
+  unsigned workers = 0;
+  // Installed bundle that patch steps apply to.
+  std::string base_dir;
+  // Reserve each full download's length up front, see PreallocateFile().
+  bool preallocate = true;
+};
+
+/**
+ * @brief Downloads a set of files concurrently into a staging directory.
+ *
+ * Workers pull items from a shared index and report every received chunk to
+ * the ProgressTracker, which is the only synchronization on the hot path.
+ */
+class DownloadEngine {
+ public:
+  static constexpr unsigned kDefaultWorkers = 6;
+
+  DownloadEngine(HttpFetcher* fetcher, ProgressTracker* tracker);
+
+  DownloadEngine(const DownloadEngine&) = delete;
+  DownloadEngine& operator=(const DownloadEngine&) = delete;
+
+  /**
+   * @brief Fetches every item from |base_url| into |staging_dir|.
+   *
+   * Blocks until all workers have finished. The tracker is reset with the
+   * totals of |items| and marked done on return.
+   *
+   * @return false with |error| describing the first failure.
+   */
+  bool Run(const std::string& base_url,
+           const std::vector<DownloadItem>& items,
+           const std::string& staging_dir,
+           const DownloadOptions& options,
+           std::string* error);
+
+  // Asks running workers to stop after their current chunk.
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+ private:
+  bool DownloadOne(const std::string& base_url,
+                   const DownloadItem& item,
+                   const std::string& staging_dir,
+                   bool preallocate,
+                   std::string* error);
+
+  // Runs |item.steps| in memory, verifying each intermediate digest, and
+  // writes the final result to the staging directory.
+  bool DownloadPlanned(const DownloadItem& item,
+                       const std::string& staging_dir,
+                       const std::string& base_dir,
+                       std::string* error);
+
+  // Buffers the body of |url|, reporting progress as it arrives.
+  bool FetchToMemory(const std::string& url,
+                     ByteBuffer* body,
+                     std::string* error);
+
+  HttpFetcher* fetcher_;
+  ProgressTracker* tracker_;
+  std::atomic<bool> cancelled_{false};
+};
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_DOWNLOAD_ENGINE_H_
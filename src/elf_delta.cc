@@ -0,0 +1,455 @@
+#include "elf_delta.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "delta.h"
+
+namespace desktop_updater {
+
+namespace {
+
+constexpr uint8_t kElfClass64 = 2;
+constexpr uint8_t kElfDataLittleEndian = 1;
+constexpr uint64_t kMachineX86_64 = 62;
+constexpr uint64_t kMachineAarch64 = 183;
+constexpr uint64_t kSectionNoBits = 8;
+constexpr uint64_t kSectionExecInstr = 0x4;
+constexpr uint64_t kSegmentLoad = 1;
+constexpr uint64_t kSegmentExecute = 0x1;
+
+// Copies shorter than this are left out of the moves; they rarely hold a
+// branch destination and would only grow the header.
+constexpr uint64_t kMinMove = 64;
+// Runs with the same shift are merged across gaps up to this size.
+constexpr uint64_t kMaxMoveGap = 4096;
+// Limits on what a delta may declare, checked before anything is read.
+constexpr uint64_t kMaxRanges = 1 << 16;
+
+// Every x86 E8 or E9 byte owns the four bytes after it, so rewriting never
+// changes which bytes are opcodes. Only displacements with a top byte of
+// 0x00 or 0xFF are taken for branches; they are rewritten modulo 2^25 and
+// every result has such a top byte too, which keeps the rewrite reversible
+// without knowing which E8 bytes were really instructions.
+constexpr uint32_t kX86Mask = 0x01FFFFFF;
+constexpr uint32_t kArm64BlMask = 0xFC000000;
+constexpr uint32_t kArm64Bl = 0x94000000;
+constexpr uint32_t kArm64ImmMask = 0x03FFFFFF;
+
+enum class Rewrite {
+  // Displacements to destinations.
+  kEncode,
+  // Destinations back to displacements.
+  kDecode,
+  // Displacements to destinations, moved like the code they point to.
+  kAdjust,
+};
+
+struct Move {
+  uint64_t base_offset = 0;
+  uint64_t length = 0;
+  int64_t shift = 0;
+};
+
+using Moves = std::vector<Move>;
+
+uint64_t ReadLe(const uint8_t* data, size_t size) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+void WriteLe32(uint32_t value, uint8_t* data) {
+  for (size_t i = 0; i < 4; i++) {
+    data[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+uint32_t SignExtendX86(uint32_t value) {
+  value &= kX86Mask;
+  return (value & 0x01000000) != 0 ? value | ~kX86Mask : value;
+}
+
+// Where the base offset |dest| ends up in the target according to |moves|.
+int64_t MoveDestination(const Moves& moves, int64_t dest) {
+  if (dest < 0) {
+    return dest;
+  }
+  const uint64_t offset = static_cast<uint64_t>(dest);
+  auto it = std::upper_bound(
+      moves.begin(), moves.end(), offset,
+      [](uint64_t value, const Move& move) { return value < move.base_offset; });
+  if (it == moves.begin()) {
+    return dest;
+  }
+  --it;
+  return offset < it->base_offset + it->length ? dest + it->shift : dest;
+}
+
+void RewriteBranches(ElfBranchArch arch,
+                     const std::vector<CodeRange>& ranges,
+                     Rewrite mode,
+                     const Moves& moves,
+                     uint8_t* data) {
+  for (const CodeRange& range : ranges) {
+    const uint64_t end = range.offset + range.size;
+    if (arch == ElfBranchArch::kX86_64) {
+      for (uint64_t i = range.offset; i + 5 <= end;) {
+        if (data[i] != 0xE8 && data[i] != 0xE9) {
+          i++;
+          continue;
+        }
+        if (data[i + 4] != 0x00 && data[i + 4] != 0xFF) {
+          i += 5;
+          continue;
+        }
+        const uint32_t value = static_cast<uint32_t>(ReadLe(data + i + 1, 4));
+        const uint32_t next = static_cast<uint32_t>(i + 5);
+        uint32_t out = 0;
+        if (mode == Rewrite::kEncode) {
+          out = value + next;
+        } else if (mode == Rewrite::kDecode) {
+          out = value - next;
+        } else {
+          const int64_t dest =
+              static_cast<int64_t>(i + 5) + static_cast<int32_t>(value);
+          out = static_cast<uint32_t>(MoveDestination(moves, dest));
+        }
+        WriteLe32(SignExtendX86(out), data + i + 1);
+        i += 5;
+      }
+    } else if (arch == ElfBranchArch::kArm64) {
+      for (uint64_t i = (range.offset + 3) & ~uint64_t{3}; i + 4 <= end;
+           i += 4) {
+        const uint32_t word = static_cast<uint32_t>(ReadLe(data + i, 4));
+        if ((word & kArm64BlMask) != kArm64Bl) {
+          continue;
+        }
+        const uint32_t imm = word & kArm64ImmMask;
+        const uint32_t pc = static_cast<uint32_t>(i >> 2);
+        uint32_t out = 0;
+        if (mode == Rewrite::kEncode) {
+          out = imm + pc;
+        } else if (mode == Rewrite::kDecode) {
+          out = imm - pc;
+        } else {
+          // Sign-extends the 26-bit word offset.
+          const int64_t words =
+              static_cast<int32_t>(imm << 6) >> 6;
+          const int64_t dest = static_cast<int64_t>(i) + words * 4;
+          out = static_cast<uint32_t>(
+              static_cast<uint64_t>(MoveDestination(moves, dest)) >> 2);
+        }
+        WriteLe32(kArm64Bl | (out & kArm64ImmMask), data + i);
+      }
+    }
+  }
+}
+
+// Turns the copies of a plain delta into sorted, disjoint moves.
+Moves BuildMoves(const std::vector<DeltaCopy>& copies) {
+  Moves moves;
+  for (const DeltaCopy& copy : copies) {
+    if (copy.length >= kMinMove) {
+      Move move;
+      move.base_offset = copy.base_offset;
+      move.length = copy.length;
+      move.shift = static_cast<int64_t>(copy.target_offset) -
+                   static_cast<int64_t>(copy.base_offset);
+      moves.push_back(move);
+    }
+  }
+  std::stable_sort(moves.begin(), moves.end(),
+                   [](const Move& a, const Move& b) {
+                     return a.base_offset < b.base_offset;
+                   });
+
+  Moves merged;
+  for (Move move : moves) {
+    if (!merged.empty()) {
+      Move& last = merged.back();
+      const uint64_t last_end = last.base_offset + last.length;
+      const uint64_t end = move.base_offset + move.length;
+      if (move.shift == last.shift &&
+          move.base_offset <= last_end + kMaxMoveGap) {
+        last.length = std::max(last_end, end) - last.base_offset;
+        continue;
+      }
+      if (end <= last_end) {
+        continue;
+      }
+      if (move.base_offset < last_end) {
+        // The base run was copied twice; the first keeps the overlap.
+        move.length = end - last_end;
+        move.base_offset = last_end;
+      }
+    }
+    merged.push_back(move);
+  }
+  return merged;
+}
+
+void AppendVarint(uint64_t value, ByteBuffer* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+void AppendRanges(const std::vector<CodeRange>& ranges, ByteBuffer* out) {
+  AppendVarint(ranges.size(), out);
+  for (const CodeRange& range : ranges) {
+    AppendVarint(range.offset, out);
+    AppendVarint(range.size, out);
+  }
+}
+
+class HeaderReader {
+ public:
+  explicit HeaderReader(const ByteBuffer& data) : data_(data) {}
+
+  size_t offset() const { return offset_; }
+  size_t remaining() const { return data_.size() - offset_; }
+
+  bool Skip(size_t size) {
+    if (size > remaining()) {
+      return false;
+    }
+    offset_ += size;
+    return true;
+  }
+
+  bool ReadVarint(uint64_t* out) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && offset_ < data_.size(); shift += 7) {
+      const uint8_t byte = data_[offset_++];
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        *out = value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Reads sorted, disjoint ranges.
+  bool ReadRanges(std::vector<CodeRange>* ranges) {
+    uint64_t count = 0;
+    if (!ReadVarint(&count) || count > kMaxRanges || count > remaining()) {
+      return false;
+    }
+    uint64_t end = 0;
+    for (uint64_t i = 0; i < count; i++) {
+      CodeRange range;
+      if (!ReadVarint(&range.offset) || !ReadVarint(&range.size) ||
+          range.offset < end || range.size > UINT64_MAX - range.offset) {
+        return false;
+      }
+      end = range.offset + range.size;
+      ranges->push_back(range);
+    }
+    return true;
+  }
+
+ private:
+  const ByteBuffer& data_;
+  size_t offset_ = 0;
+};
+
+bool RangesFit(const std::vector<CodeRange>& ranges, uint64_t size) {
+  return ranges.empty() ||
+         ranges.back().offset + ranges.back().size <= size;
+}
+
+}  // namespace
+
+ElfBranchArch FindElfCode(const ByteBuffer& data,
+                          std::vector<CodeRange>* ranges) {
+  ranges->clear();
+  const uint64_t size = data.size();
+  const uint8_t* p = data.data();
+  if (size < 64 || memcmp(p, "\x7F" "ELF", 4) != 0 ||
+      p[4] != kElfClass64 || p[5] != kElfDataLittleEndian) {
+    return ElfBranchArch::kNone;
+  }
+  const uint64_t machine = ReadLe(p + 18, 2);
+  const ElfBranchArch arch =
+      machine == kMachineX86_64    ? ElfBranchArch::kX86_64
+      : machine == kMachineAarch64 ? ElfBranchArch::kArm64
+                                   : ElfBranchArch::kNone;
+  if (arch == ElfBranchArch::kNone) {
+    return arch;
+  }
+
+  auto add = [&](uint64_t offset, uint64_t length) {
+    if (length > 0 && offset <= size && length <= size - offset) {
+      CodeRange range;
+      range.offset = offset;
+      range.size = length;
+      ranges->push_back(range);
+    }
+  };
+  const uint64_t shoff = ReadLe(p + 0x28, 8);
+  const uint64_t shentsize = ReadLe(p + 0x3A, 2);
+  const uint64_t shnum = ReadLe(p + 0x3C, 2);
+  if (shoff != 0 && shentsize >= 64 && shoff <= size &&
+      shnum <= (size - shoff) / shentsize) {
+    for (uint64_t i = 0; i < shnum; i++) {
+      const uint8_t* header = p + shoff + i * shentsize;
+      if (ReadLe(header + 4, 4) != kSectionNoBits &&
+          (ReadLe(header + 8, 8) & kSectionExecInstr) != 0) {
+        add(ReadLe(header + 0x18, 8), ReadLe(header + 0x20, 8));
+      }
+    }
+  }
+  if (ranges->empty()) {
+    // Stripped of section headers; fall back to the executable segments.
+    const uint64_t phoff = ReadLe(p + 0x20, 8);
+    const uint64_t phentsize = ReadLe(p + 0x36, 2);
+    const uint64_t phnum = ReadLe(p + 0x38, 2);
+    if (phoff != 0 && phentsize >= 56 && phoff <= size &&
+        phnum <= (size - phoff) / phentsize) {
+      for (uint64_t i = 0; i < phnum; i++) {
+        const uint8_t* header = p + phoff + i * phentsize;
+        if (ReadLe(header, 4) == kSegmentLoad &&
+            (ReadLe(header + 4, 4) & kSegmentExecute) != 0) {
+          add(ReadLe(header + 8, 8), ReadLe(header + 0x20, 8));
+        }
+      }
+    }
+  }
+
+  // Sorted and disjoint, so every branch is rewritten once.
+  std::sort(ranges->begin(), ranges->end(),
+            [](const CodeRange& a, const CodeRange& b) {
+              return a.offset < b.offset;
+            });
+  std::vector<CodeRange> disjoint;
+  for (CodeRange range : *ranges) {
+    if (!disjoint.empty()) {
+      const uint64_t end = disjoint.back().offset + disjoint.back().size;
+      if (range.offset + range.size <= end) {
+        continue;
+      }
+      if (range.offset < end) {
+        range.size -= end - range.offset;
+        range.offset = end;
+      }
+    }
+    disjoint.push_back(range);
+  }
+  *ranges = std::move(disjoint);
+  return ranges->empty() ? ElfBranchArch::kNone : arch;
+}
+
+ByteBuffer CreateElfDelta(const ByteBuffer& base, const ByteBuffer& target) {
+  std::vector<CodeRange> base_ranges;
+  std::vector<CodeRange> target_ranges;
+  const ElfBranchArch arch = FindElfCode(base, &base_ranges);
+  if (arch == ElfBranchArch::kNone ||
+      FindElfCode(target, &target_ranges) != arch) {
+    return ByteBuffer();
+  }
+
+  // A plain delta first, for how the code moved.
+  std::vector<DeltaCopy> copies;
+  CreateDelta(base, target, &copies);
+  const Moves moves = BuildMoves(copies);
+  copies.clear();
+  copies.shrink_to_fit();
+
+  ByteBuffer adjusted = base;
+  RewriteBranches(arch, base_ranges, Rewrite::kAdjust, moves,
+                  adjusted.data());
+  ByteBuffer encoded = target;
+  RewriteBranches(arch, target_ranges, Rewrite::kEncode, moves,
+                  encoded.data());
+  const ByteBuffer inner = CreateDelta(adjusted, encoded);
+
+  ByteBuffer out(kElfDeltaMagic, kElfDeltaMagic + kElfDeltaMagicSize);
+  AppendVarint(static_cast<uint64_t>(arch), &out);
+  AppendRanges(base_ranges, &out);
+  AppendRanges(target_ranges, &out);
+  AppendVarint(moves.size(), &out);
+  for (const Move& move : moves) {
+    AppendVarint(move.base_offset, &out);
+    AppendVarint(move.length, &out);
+    // Zigzag, so small negative shifts stay small.
+    AppendVarint((static_cast<uint64_t>(move.shift) << 1) ^
+                     static_cast<uint64_t>(move.shift >> 63),
+                 &out);
+  }
+  out.insert(out.end(), inner.begin(), inner.end());
+  return out;
+}
+
+uint64_t EstimateElfDeltaMemory(uint64_t base_size, uint64_t target_size) {
+  // The rewritten copies of both inputs on top of a plain delta.
+  return EstimateDeltaMemory(base_size, target_size) + base_size +
+         target_size;
+}
+
+bool IsElfDelta(const ByteBuffer& delta) {
+  return delta.size() >= kElfDeltaMagicSize &&
+         memcmp(delta.data(), kElfDeltaMagic, kElfDeltaMagicSize) == 0;
+}
+
+bool ApplyElfDelta(const ByteBuffer& base,
+                   const ByteBuffer& delta,
+                   ByteBuffer* out,
+                   std::string* error) {
+  HeaderReader reader(delta);
+  uint64_t arch = 0;
+  std::vector<CodeRange> base_ranges;
+  std::vector<CodeRange> target_ranges;
+  uint64_t count = 0;
+  if (!IsElfDelta(delta) || !reader.Skip(kElfDeltaMagicSize) ||
+      !reader.ReadVarint(&arch) ||
+      (arch != static_cast<uint64_t>(ElfBranchArch::kX86_64) &&
+       arch != static_cast<uint64_t>(ElfBranchArch::kArm64)) ||
+      !reader.ReadRanges(&base_ranges) || !RangesFit(base_ranges, base.size()) ||
+      !reader.ReadRanges(&target_ranges) || !reader.ReadVarint(&count) ||
+      count > reader.remaining() / 3) {
+    *error = "Invalid ELF delta header";
+    return false;
+  }
+  Moves moves(static_cast<size_t>(count));
+  uint64_t end = 0;
+  for (Move& move : moves) {
+    uint64_t shift = 0;
+    if (!reader.ReadVarint(&move.base_offset) ||
+        !reader.ReadVarint(&move.length) || !reader.ReadVarint(&shift) ||
+        move.base_offset < end || move.length > UINT64_MAX - move.base_offset) {
+      *error = "Invalid ELF delta moves";
+      return false;
+    }
+    move.shift = static_cast<int64_t>(shift >> 1) ^ -static_cast<int64_t>(shift & 1);
+    end = move.base_offset + move.length;
+  }
+
+  const ByteBuffer inner(delta.begin() + static_cast<ptrdiff_t>(reader.offset()),
+                         delta.end());
+  if (IsElfDelta(inner)) {
+    *error = "Nested ELF delta";
+    return false;
+  }
+  const ElfBranchArch branch_arch = static_cast<ElfBranchArch>(arch);
+  ByteBuffer adjusted = base;
+  RewriteBranches(branch_arch, base_ranges, Rewrite::kAdjust, moves,
+                  adjusted.data());
+  if (!ApplyDelta(adjusted, inner, out, error)) {
+    return false;
+  }
+  if (!RangesFit(target_ranges, out->size())) {
+    *error = "ELF delta code ranges out of range";
+    return false;
+  }
+  RewriteBranches(branch_arch, target_ranges, Rewrite::kDecode, moves,
+                  out->data());
+  return true;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,83 @@
+#ifndef DESKTOP_UPDATER_ELF_DELTA_H_
+#define DESKTOP_UPDATER_ELF_DELTA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "counting_allocator.h"
+
+namespace desktop_updater {
+
+/**
+ * ELF-aware delta format ("DUELFDL1") for executables such as libapp.so,
+ * where a small change moves code and so rewrites the relative branch
+ * displacements all over the file:
+ *
+ *   magic    "DUELFDL1"
+ *   varint   branch encoding, an ElfBranchArch
+ *   varint   base code range count, ranges: varint offset, varint size
+ *   varint   target code range count, ranges as above
+ *   varint   move count
+ *   move:    varint base offset, varint length, zigzag varint shift
+ *   bytes    a "DUDELTA1" delta from the adjusted base to the encoded
+ *            target
+ *
+ * In the code ranges the displacement of every direct call and jump (x86
+ * E8/E9 rel32, AArch64 BL) is rewritten as the absolute file offset of its
+ * destination, like the BCJ filters of xz. The moves, taken from a first
+ * plain delta, say how runs of the base shifted in the target. The applier
+ * moves every destination of the base accordingly, so branches to moved
+ * code match the target and cost nothing, applies the inner delta, then
+ * turns the destinations back into displacements. Like Courgette, minus
+ * the disassembler.
+ */
+constexpr char kElfDeltaMagic[] = "DUELFDL1";
+constexpr size_t kElfDeltaMagicSize = 8;
+
+enum class ElfBranchArch : uint8_t {
+  kNone = 0,
+  kX86_64 = 1,
+  kArm64 = 2,
+};
+
+// A range of the file holding code.
+struct CodeRange {
+  uint64_t offset = 0;
+  uint64_t size = 0;
+};
+
+/**
+ * @brief Finds the code of a 64-bit little-endian ELF file.
+ *
+ * Uses the sections flagged executable, or the executable PT_LOAD
+ * segments when there are no section headers.
+ *
+ * @return kNone, without ranges, for other files and architectures.
+ */
+ElfBranchArch FindElfCode(const ByteBuffer& data,
+                          std::vector<CodeRange>* ranges);
+
+/**
+ * @brief Computes an ELF-aware delta turning |base| into |target|.
+ * @return an empty buffer when the files are not both ELF code of the same
+ *         supported architecture; CreateDelta() is the fallback.
+ */
+ByteBuffer CreateElfDelta(const ByteBuffer& base, const ByteBuffer& target);
+
+// Like EstimateDeltaMemory(), for CreateElfDelta().
+uint64_t EstimateElfDeltaMemory(uint64_t base_size, uint64_t target_size);
+
+bool IsElfDelta(const ByteBuffer& delta);
+
+// Reconstructs the target of an ELF-aware delta. ApplyDelta() calls this
+// for deltas starting with kElfDeltaMagic.
+bool ApplyElfDelta(const ByteBuffer& base,
+                   const ByteBuffer& delta,
+                   ByteBuffer* out,
+                   std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_ELF_DELTA_H_
@@ -0,0 +1,195 @@
+#include "file_hash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include "blake2b.h"
+#include "counting_allocator.h"
+#include "file_util.h"
+#include "metrics.h"
+#include "probes.h"
+#include "trace.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+namespace {
+
+constexpr size_t kReadBufferSize = 1 << 20;
+
+bool HashFileWithBuffer(const std::string& path,
+                        uint8_t* buffer,
+                        Digest* digest,
+                        uint64_t* length,
+                        std::string* error) {
+  DESKTOP_UPDATER_PROBE1(hash_start, path.c_str());
+  const int64_t probe_start =
+      DESKTOP_UPDATER_PROBE_ENABLED(hash_done) ? ProbeNanos() : 0;
+  FILE* file = OpenFile(path, "rb");
+  if (file == nullptr) {
+    *error = "Cannot open " + path;
+    return false;
+  }
+  Blake2b hash;
+  uint64_t total = 0;
+  size_t read = 0;
+  while ((read = fread(buffer, 1, kReadBufferSize, file)) > 0) {
+    hash.Update(buffer, read);
+    total += read;
+  }
+  const bool failed = ferror(file) != 0;
+  fclose(file);
+  if (failed) {
+    *error = "Failed to read " + path;
+    return false;
+  }
+  hash.Final(digest->data());
+  *length = total;
+  AddCount(Counter::kFilesHashed);
+  AddCount(Counter::kBytesHashed, total);
+  if (DESKTOP_UPDATER_PROBE_ENABLED(hash_done)) {
+    DESKTOP_UPDATER_PROBE3(hash_done, path.c_str(), total,
+                           ProbeNanos() - probe_start);
+  }
+  return true;
+}
+
+}  // namespace
+
+unsigned ResolveThreads(unsigned threads, size_t jobs) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return static_cast<unsigned>(
+      std::min<size_t>(threads, std::max<size_t>(jobs, 1)));
+}
+
+bool HashFile(const std::string& path,
+              Digest* digest,
+              uint64_t* length,
+              std::string* error) {
+  ByteBuffer buffer(kReadBufferSize);
+  return HashFileWithBuffer(path, buffer.data(), digest, length, error);
+}
+
+bool ScanTree(const std::string& root,
+              const ScanOptions& options,
+              std::vector<ScannedFile>* out,
+              std::string* error) {
+  TraceSpan span("scan");
+  PhaseTimer timer(Phase::kScan);
+  out->clear();
+  std::error_code ec;
+  const fs::path root_path = PathFromUtf8(root);
+  if (!fs::is_directory(root_path, ec)) {
+    *error = "Directory does not exist: " + root;
+    return false;
+  }
+
+  fs::recursive_directory_iterator it(root_path, ec);
+  const fs::recursive_directory_iterator end;
+  for (; !ec && it != end; it.increment(ec)) {
+    const fs::path relative = it->path().lexically_relative(root_path);
+    if (it.depth() == 0 &&
+        std::find(options.exclude.begin(), options.exclude.end(),
+                  relative.u8string()) != options.exclude.end()) {
+      it.disable_recursion_pending();
+      continue;
+    }
+    std::error_code status_ec;
+    if (!fs::is_regular_file(it->symlink_status(status_ec)) || status_ec) {
+      continue;
+    }
+    ScannedFile file;
+    file.path = relative.generic_u8string();
+    if (options.separator != '/') {
+      std::replace(file.path.begin(), file.path.end(), '/',
+                   options.separator);
+    }
+    file.length = static_cast<uint64_t>(it->file_size(status_ec));
+    out->push_back(std::move(file));
+  }
+  if (ec) {
+    *error = "Failed to scan " + root + ": " + ec.message();
+    return false;
+  }
+
+  std::sort(out->begin(), out->end(),
+            [](const ScannedFile& a, const ScannedFile& b) {
+              return a.path < b.path;
+            });
+  AddCount(Counter::kFilesScanned, out->size());
+  return true;
+}
+
+bool HashFiles(const std::string& root,
+               const std::vector<ScannedFile>& files,
+               unsigned threads,
+               Manifest* out,
+               std::string* error) {
+  TraceSpan span("hash");
+  span.SetArg("files", static_cast<int64_t>(files.size()));
+  PhaseTimer timer(Phase::kHash);
+  out->assign(files.size(), FileEntry());
+
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::mutex error_mutex;
+
+  auto worker = [&]() {
+    PhaseScope scope(Phase::kHash);
+    ByteBuffer buffer(kReadBufferSize);
+    std::string file_error;
+    while (!failed.load(std::memory_order_relaxed)) {
+      const size_t index = next.fetch_add(1, std::memory_order_relaxed);
+      if (index >= files.size()) {
+        return;
+      }
+      FileEntry& entry = (*out)[index];
+      entry.path = files[index].path;
+      const std::string full_path =
+          JoinPath(root, NormalizeRelativePath(entry.path));
+      if (!HashFileWithBuffer(full_path, buffer.data(), &entry.digest,
+                              &entry.length, &file_error)) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed.exchange(true)) {
+          *error = file_error;
+        }
+        return;
+      }
+    }
+  };
+
+  const unsigned count = ResolveThreads(threads, files.size());
+  std::vector<std::thread> workers;
+  workers.reserve(count - 1);
+  for (unsigned i = 1; i < count; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+  return !failed.load();
+}
+
+bool HashTree(const std::string& root,
+              const ScanOptions& options,
+              unsigned threads,
+              Manifest* out,
+              std::string* error) {
+  std::vector<ScannedFile> files;
+  if (!ScanTree(root, options, &files, error)) {
+    return false;
+  }
+  return HashFiles(root, files, threads, out, error);
+}
+
+}  // namespace desktop_updater
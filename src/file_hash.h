@@ -0,0 +1,77 @@
+#ifndef DESKTOP_UPDATER_FILE_HASH_H_
+#define DESKTOP_UPDATER_FILE_HASH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+
+#ifdef _WIN32
+constexpr char kPathSeparator = '\\';
+#else
+constexpr char kPathSeparator = '/';
+#endif
+
+/**
+ * @brief A regular file found by ScanTree().
+ */
+struct ScannedFile {
+  std::string path;
+  uint64_t length = 0;
+};
+
+struct ScanOptions {
+  // Top-level entries to skip, e.g. the "update" staging folder.
+  std::vector<std::string> exclude;
+  // Separator used in the reported relative paths. Defaults to the
+  // platform's, which is what the Dart implementation has always produced.
+  char separator = kPathSeparator;
+};
+
+// The number of workers to run |jobs| on: |threads|, or the hardware
+// concurrency when 0, but at least one and no more than there are jobs.
+unsigned ResolveThreads(unsigned threads, size_t jobs);
+
+// Hashes the contents of |path| with BLAKE2b-512.
+bool HashFile(const std::string& path,
+              Digest* digest,
+              uint64_t* length,
+              std::string* error);
+
+/**
+ * @brief Lists regular files below |root| in sorted order.
+ *
+ * Symbolic links are not followed or reported, matching
+ * `Directory.list(followLinks: false)` on the Dart side.
+ */
+bool ScanTree(const std::string& root,
+              const ScanOptions& options,
+              std::vector<ScannedFile>* out,
+              std::string* error);
+
+/**
+ * @brief Scans |root| and hashes every file on |threads| workers.
+ *
+ * @param threads Worker count; 0 uses the hardware concurrency.
+ * @return the manifest sorted by path.
+ */
+bool HashTree(const std::string& root,
+              const ScanOptions& options,
+              unsigned threads,
+              Manifest* out,
+              std::string* error);
+
+// Hashes the already scanned |files| below |root|, keeping their order.
+bool HashFiles(const std::string& root,
+               const std::vector<ScannedFile>& files,
+               unsigned threads,
+               Manifest* out,
+               std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_FILE_HASH_H_
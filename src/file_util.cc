@@ -0,0 +1,146 @@
+#include "file_util.h"
+
+#include <cstring>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+std::string NormalizeRelativePath(const std::string& path) {
+  std::string normalized;
+  normalized.reserve(path.size());
+  for (const char c : path) {
+    if (c == '/' || c == '\\') {
+      if (!normalized.empty() && normalized.back() != '/') {
+        normalized.push_back('/');
+      }
+    } else {
+      normalized.push_back(c);
+    }
+  }
+  if (!normalized.empty() && normalized.back() == '/') {
+    normalized.pop_back();
+  }
+  return normalized;
+}
+
+bool IsSafeRelativePath(const std::string& path) {
+  if (path.empty() || path[0] == '/' || path[0] == '\\') {
+    return false;
+  }
+  if (path.size() >= 2 && path[1] == ':') {
+    return false;
+  }
+  size_t start = 0;
+  while (start <= path.size()) {
+    size_t end = path.find_first_of("/\\", start);
+    if (end == std::string::npos) {
+      end = path.size();
+    }
+    if (path.compare(start, end - start, "..") == 0) {
+      return false;
+    }
+    start = end + 1;
+  }
+  return true;
+}
+
+std::string JoinPath(const std::string& dir, const std::string& path) {
+  if (dir.empty()) {
+    return path;
+  }
+  if (dir.back() == '/' || dir.back() == '\\') {
+    return dir + path;
+  }
+  return dir + '/' + path;
+}
+
+fs::path PathFromUtf8(const std::string& path) {
+  return fs::u8path(path);
+}
+
+FILE* OpenFile(const std::string& path, const char* mode) {
+#ifdef _WIN32
+  const std::wstring wide_mode(mode, mode + strlen(mode));
+  return _wfopen(PathFromUtf8(path).c_str(), wide_mode.c_str());
+#else
+  return fopen(path.c_str(), mode);
+#endif
+}
+
+namespace {
+
+template <typename Buffer>
+bool ReadFileInto(const std::string& path, Buffer* out, std::string* error) {
+  FILE* file = OpenFile(path, "rb");
+  if (file == nullptr) {
+    *error = "Cannot open " + path;
+    return false;
+  }
+  out->clear();
+  uint8_t buffer[64 * 1024];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    out->insert(out->end(), buffer, buffer + read);
+  }
+  const bool failed = ferror(file) != 0;
+  fclose(file);
+  if (failed) {
+    *error = "Failed to read " + path;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool ReadFileBytes(const std::string& path,
+                   std::vector<uint8_t>* out,
+                   std::string* error) {
+  return ReadFileInto(path, out, error);
+}
+
+bool ReadFileBytes(const std::string& path,
+                   ByteBuffer* out,
+                   std::string* error) {
+  return ReadFileInto(path, out, error);
+}
+
+bool WriteFileBytes(const std::string& path,
+                    const uint8_t* data,
+                    size_t size,
+                    std::string* error) {
+  FILE* file = OpenFile(path, "wb");
+  if (file == nullptr) {
+    *error = "Cannot open " + path + " for writing";
+    return false;
+  }
+  const bool written = fwrite(data, 1, size, file) == size;
+  if (fclose(file) != 0 || !written) {
+    *error = "Failed to write " + path;
+    return false;
+  }
+  return true;
+}
+
+bool CreateParentDirectories(const std::string& file_path,
+                             std::string* error) {
+  const fs::path parent = PathFromUtf8(file_path).parent_path();
+  if (parent.empty()) {
+    return true;
+  }
+  std::error_code ec;
+  fs::create_directories(parent, ec);
+  // Another worker may have created the same directory concurrently.
+  if (ec && !fs::is_directory(parent)) {
+    if (error) {
+      *error = "Cannot create directory " + parent.u8string() + ": " +
+               ec.message();
+    }
+    return false;
+  }
+  return true;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,50 @@
+#ifndef DESKTOP_UPDATER_FILE_UTIL_H_
+#define DESKTOP_UPDATER_FILE_UTIL_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "counting_allocator.h"
+
+namespace desktop_updater {
+
+// Converts manifest paths to '/' separators and drops empty segments.
+std::string NormalizeRelativePath(const std::string& path);
+
+// Returns true for non-empty relative paths that cannot escape the directory
+// they are resolved against (no root, drive letter or ".." segment).
+bool IsSafeRelativePath(const std::string& path);
+
+// Joins |dir| and a normalized relative |path|.
+std::string JoinPath(const std::string& dir, const std::string& path);
+
+// Converts a UTF-8 path to std::filesystem::path on every platform.
+std::filesystem::path PathFromUtf8(const std::string& path);
+
+// fopen() for UTF-8 paths, including non-ASCII paths on Windows.
+FILE* OpenFile(const std::string& path, const char* mode);
+
+// Reads the whole file at |path| into |out|.
+bool ReadFileBytes(const std::string& path,
+                   std::vector<uint8_t>* out,
+                   std::string* error);
+bool ReadFileBytes(const std::string& path,
+                   ByteBuffer* out,
+                   std::string* error);
+
+// Creates |path| (truncating it) and writes |size| bytes.
+bool WriteFileBytes(const std::string& path,
+                    const uint8_t* data,
+                    size_t size,
+                    std::string* error);
+
+// Creates every missing parent directory of |file_path|. Safe to call from
+// several threads for overlapping directory trees.
+bool CreateParentDirectories(const std::string& file_path, std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_FILE_UTIL_H_
@@ -0,0 +1,191 @@
+#include "handoff.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace desktop_updater {
+
+int64_t MonotonicMicros() {
+  // steady_clock is CLOCK_MONOTONIC on Linux, shared by all processes.
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string HandoffSocketPath(int pid) {
+  const char* runtime_dir = getenv("XDG_RUNTIME_DIR");
+  const std::string dir =
+      runtime_dir != nullptr && runtime_dir[0] != '\0' ? runtime_dir : "/tmp";
+  return dir + "/desktop_updater-" + std::to_string(pid) + ".sock";
+}
+
+#ifndef _WIN32
+
+namespace {
+
+bool MakeAddress(const std::string& path,
+                 sockaddr_un* address,
+                 std::string* error) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address->sun_path)) {
+    *error = "Socket path too long: " + path;
+    return false;
+  }
+  memcpy(address->sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+std::string ErrnoText(const std::string& what) {
+  return what + ": " + strerror(errno);
+}
+
+}  // namespace
+
+HandoffListener::HandoffListener() = default;
+
+HandoffListener::~HandoffListener() {
+  if (fd_ >= 0) {
+    close(fd_);
+    unlink(path_.c_str());
+  }
+}
+
+bool HandoffListener::Listen(const std::string& path, std::string* error) {
+  sockaddr_un address;
+  if (!MakeAddress(path, &address, error)) {
+    return false;
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    *error = ErrnoText("socket");
+    return false;
+  }
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(fd, 1) != 0) {
+    *error = ErrnoText("Cannot listen on " + path);
+    close(fd);
+    return false;
+  }
+  fd_ = fd;
+  path_ = path;
+  return true;
+}
+
+bool HandoffListener::WaitForReady(int timeout_ms,
+                                   std::string* message,
+                                   std::string* error) {
+  error->clear();
+  if (fd_ < 0) {
+    *error = "Not listening";
+    return false;
+  }
+  const int64_t deadline = MonotonicMicros() + int64_t{timeout_ms} * 1000;
+  auto remaining_ms = [deadline]() {
+    const int64_t left = (deadline - MonotonicMicros()) / 1000;
+    return left > 0 ? static_cast<int>(left) : 0;
+  };
+
+  pollfd listen_poll = {fd_, POLLIN, 0};
+  const int ready = poll(&listen_poll, 1, remaining_ms());
+  if (ready <= 0) {
+    if (ready < 0 && errno != EINTR) {
+      *error = ErrnoText("poll");
+    }
+    return false;
+  }
+  const int client = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+  if (client < 0) {
+    *error = ErrnoText("accept");
+    return false;
+  }
+
+  std::string line;
+  bool done = false;
+  while (!done) {
+    pollfd client_poll = {client, POLLIN, 0};
+    if (poll(&client_poll, 1, remaining_ms()) <= 0) {
+      break;
+    }
+    char buffer[256];
+    const ssize_t read_bytes = read(client, buffer, sizeof(buffer));
+    if (read_bytes <= 0) {
+      done = true;
+      break;
+    }
+    line.append(buffer, static_cast<size_t>(read_bytes));
+    done = line.find('\n') != std::string::npos;
+  }
+  close(client);
+  if (!done) {
+    return false;
+  }
+  const size_t newline = line.find('\n');
+  *message = newline == std::string::npos ? line : line.substr(0, newline);
+  return true;
+}
+
+bool SignalHandoffReady(const std::string& path,
+                        const std::string& message,
+                        std::string* error) {
+  sockaddr_un address;
+  if (!MakeAddress(path, &address, error)) {
+    return false;
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    *error = ErrnoText("socket");
+    return false;
+  }
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+      0) {
+    *error = ErrnoText("Cannot connect to " + path);
+    close(fd);
+    return false;
+  }
+  const std::string line = message + "\n";
+  const bool ok = send(fd, line.data(), line.size(), MSG_NOSIGNAL) ==
+                  static_cast<ssize_t>(line.size());
+  if (!ok) {
+    *error = ErrnoText("send");
+  }
+  close(fd);
+  return ok;
+}
+
+#else
+
+HandoffListener::HandoffListener() = default;
+
+HandoffListener::~HandoffListener() = default;
+
+bool HandoffListener::Listen(const std::string&, std::string* error) {
+  *error = "Handoff is not supported on this platform";
+  return false;
+}
+
+bool HandoffListener::WaitForReady(int, std::string*, std::string* error) {
+  *error = "Handoff is not supported on this platform";
+  return false;
+}
+
+bool SignalHandoffReady(const std::string&,
+                        const std::string&,
+                        std::string* error) {
+  *error = "Handoff is not supported on this platform";
+  return false;
+}
+
+#endif  // _WIN32
+
+}  // namespace desktop_updater
@@ -0,0 +1,62 @@
+#ifndef DESKTOP_UPDATER_HANDOFF_H_
+#define DESKTOP_UPDATER_HANDOFF_H_
+
+#include <cstdint>
+#include <string>
+
+namespace desktop_updater {
+
+// Set for the process started by a handoff restart: the socket to report
+// the first frame on, and the monotonic time (MonotonicMicros()) at which
+// the old process started it.
+constexpr char kHandoffSocketEnv[] = "DESKTOP_UPDATER_HANDOFF";
+constexpr char kHandoffStartEnv[] = "DESKTOP_UPDATER_HANDOFF_START";
+
+// Microseconds on the system-wide monotonic clock, comparable between
+// processes.
+int64_t MonotonicMicros();
+
+/**
+ * @brief Unix socket the old process waits on while the updated one starts.
+ *
+ * The new process connects once its first frame is rendered and sends a
+ * single line, see SignalHandoffReady(). Not available on Windows.
+ */
+class HandoffListener {
+ public:
+  HandoffListener();
+  ~HandoffListener();
+
+  HandoffListener(const HandoffListener&) = delete;
+  HandoffListener& operator=(const HandoffListener&) = delete;
+
+  // Binds and listens on |path|, replacing a stale socket file.
+  bool Listen(const std::string& path, std::string* error);
+
+  /**
+   * @brief Waits up to |timeout_ms| for the ready message.
+   *
+   * @return true with the message (without the newline) once received,
+   *         false on timeout or error. Timeouts leave |error| empty, so
+   *         callers can wait in slices.
+   */
+  bool WaitForReady(int timeout_ms, std::string* message, std::string* error);
+
+  const std::string& path() const { return path_; }
+
+ private:
+  int fd_ = -1;
+  std::string path_;
+};
+
+// Connects to the listener at |path| and sends |message| as one line.
+bool SignalHandoffReady(const std::string& path,
+                        const std::string& message,
+                        std::string* error);
+
+// Returns a socket path unique to |pid| in $XDG_RUNTIME_DIR, or /tmp.
+std::string HandoffSocketPath(int pid);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_HANDOFF_H_
@@ -0,0 +1,63 @@
+#include "http_fetcher.h"
+
+namespace desktop_updater {
+
+namespace {
+
+bool IsUnreserved(unsigned char c) {
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+         (c >= '0' && c <= '9') || c == '-' || c == '.' || c == '_' ||
+         c == '~';
+}
+
+}  // namespace
+
+std::string JoinUrl(const std::string& base, const std::string& path) {
+  static const char kHex[] = "0123456789ABCDEF";
+
+  std::string url = base;
+  while (!url.empty() && url.back() == '/') {
+    url.pop_back();
+  }
+  url.reserve(url.size() + path.size() + 1);
+  // ".." never climbs above the host.
+  size_t root = url.find("://");
+  root = root == std::string::npos ? 0 : url.find('/', root + 3);
+  if (root == std::string::npos) {
+    root = url.size();
+  }
+
+  size_t begin = 0;
+  while (begin <= path.size()) {
+    size_t end = path.find_first_of("/\\", begin);
+    if (end == std::string::npos) {
+      end = path.size();
+    }
+    const size_t size = end - begin;
+    if (size == 2 && path.compare(begin, 2, "..") == 0) {
+      const size_t slash = url.rfind('/');
+      if (slash != std::string::npos && slash >= root) {
+        url.resize(slash);
+      }
+    } else if (size > 0 && !(size == 1 && path[begin] == '.')) {
+      url.push_back('/');
+      for (size_t i = begin; i < end; i++) {
+        const unsigned char c = static_cast<unsigned char>(path[i]);
+        if (IsUnreserved(c)) {
+          url.push_back(path[i]);
+        } else {
+          url.push_back('%');
+          url.push_back(kHex[c >> 4]);
+          url.push_back(kHex[c & 0x0F]);
+        }
+      }
+    }
+    begin = end + 1;
+  }
+  if (path.empty() || path.back() == '/' || path.back() == '\\') {
+    url.push_back('/');
+  }
+  return url;
+}
+
+}  // namespace desktop_updater
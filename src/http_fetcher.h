@@ -0,0 +1,64 @@
+#ifndef DESKTOP_UPDATER_HTTP_FETCHER_H_
+#define DESKTOP_UPDATER_HTTP_FETCHER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace desktop_updater {
+
+/**
+ * @brief Minimal HTTP GET interface used by the native update engine.
+ *
+ * The engine itself is platform independent; each plugin supplies an
+ * implementation backed by the platform's HTTP stack.
+ */
+class HttpFetcher {
+ public:
+  // Receives the response body in arrival order. Returning false aborts the
+  // transfer.
+  using BodyCallback = std::function<bool(const uint8_t* data, size_t size)>;
+
+  virtual ~HttpFetcher() = default;
+
+  /**
+   * @brief Performs a GET request and streams the body to |on_body|.
+   *
+   * Must be safe to call concurrently from several threads.
+   *
+   * @return false with |error| set on transport failure, a non-2xx status,
+   *         or when |on_body| aborted the transfer.
+   */
+  virtual bool Get(const std::string& url,
+                   const BodyCallback& on_body,
+                   std::string* error) = 0;
+
+  // Convenience wrapper that buffers the whole body in memory.
+  bool GetToString(const std::string& url,
+                   std::string* body,
+                   std::string* error) {
+    body->clear();
+    return Get(
+        url,
+        [body](const uint8_t* data, size_t size) {
+          body->append(reinterpret_cast<const char*>(data), size);
+          return true;
+        },
+        error);
+  }
+};
+
+/**
+ * @brief Appends a relative file path to a base URL.
+ *
+ * Each path segment is percent-encoded; '/' and '\\' both act as separators
+ * so manifests produced on Windows resolve to the same URL. "." and ".."
+ * segments are resolved, so a manifest "object" such as "../objects/<hex>"
+ * names a sibling of the release folder.
+ */
+std::string JoinUrl(const std::string& base, const std::string& path);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_HTTP_FETCHER_H_
@@ -0,0 +1,184 @@
+#include "install_verifier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "file_hash.h"
+#include "file_util.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace desktop_updater {
+
+#ifndef _WIN32
+
+bool GetFileIdentity(const std::string& path, FileIdentity* out) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  out->device = static_cast<uint64_t>(st.st_dev);
+  out->inode = static_cast<uint64_t>(st.st_ino);
+  out->size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+  out->mtime_ns = int64_t{st.st_mtimespec.tv_sec} * 1000000000 +
+                  st.st_mtimespec.tv_nsec;
+#else
+  out->mtime_ns = int64_t{st.st_mtim.tv_sec} * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+#else
+
+bool GetFileIdentity(const std::string&, FileIdentity*) {
+  return false;
+}
+
+#endif  // _WIN32
+
+void HashCache::Put(const FileIdentity& identity, const Digest& digest) {
+  entries_[{identity.device, identity.inode}] =
+      Entry{identity.size, identity.mtime_ns, digest};
+}
+
+bool HashCache::Lookup(const FileIdentity& identity, Digest* digest) const {
+  auto it = entries_.find({identity.device, identity.inode});
+  if (it == entries_.end() || it->second.size != identity.size ||
+      it->second.mtime_ns != identity.mtime_ns) {
+    return false;
+  }
+  *digest = it->second.digest;
+  return true;
+}
+
+std::string HashCache::Serialize() const {
+  std::ostringstream out;
+  for (const auto& entry : entries_) {
+    out << entry.first.first << ' ' << entry.first.second << ' '
+        << entry.second.size << ' ' << entry.second.mtime_ns << ' '
+        << Base64Encode(entry.second.digest.data(),
+                        entry.second.digest.size())
+        << '\n';
+  }
+  return out.str();
+}
+
+bool HashCache::Parse(const std::string& text, std::string* error) {
+  entries_.clear();
+  std::istringstream in(text);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream fields(line);
+    FileIdentity identity;
+    std::string encoded;
+    std::vector<uint8_t> digest;
+    if (!(fields >> identity.device >> identity.inode >> identity.size >>
+          identity.mtime_ns >> encoded) ||
+        !Base64Decode(encoded, &digest) || digest.size() != Digest().size()) {
+      *error = "Invalid hash cache line: " + line;
+      entries_.clear();
+      return false;
+    }
+    Digest value;
+    std::copy(digest.begin(), digest.end(), value.begin());
+    Put(identity, value);
+  }
+  return true;
+}
+
+bool VerifyInstalledFiles(const std::string& root,
+                          const Manifest& files,
+                          const HashCache* cache,
+                          unsigned threads,
+                          VerifyStats* stats,
+                          std::string* error) {
+  TraceSpan span("verify_installed");
+  span.SetArg("files", static_cast<int64_t>(files.size()));
+  PhaseTimer timer(Phase::kVerifyInstalled);
+  *stats = VerifyStats();
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::atomic<size_t> verified{0};
+  std::atomic<size_t> cache_hits{0};
+  std::atomic<uint64_t> hashed_bytes{0};
+  std::mutex error_mutex;
+
+  auto fail = [&](const std::string& message) {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (!failed.exchange(true)) {
+      *error = message;
+    }
+  };
+
+  auto worker = [&]() {
+    PhaseScope scope(Phase::kVerifyInstalled);
+    while (!failed.load(std::memory_order_relaxed)) {
+      const size_t index = next.fetch_add(1, std::memory_order_relaxed);
+      if (index >= files.size()) {
+        return;
+      }
+      const FileEntry& entry = files[index];
+      const std::string path = NormalizeRelativePath(entry.path);
+      const std::string full_path = JoinPath(root, path);
+
+      FileIdentity identity;
+      Digest digest;
+      if (cache != nullptr && GetFileIdentity(full_path, &identity) &&
+          identity.size == entry.length && cache->Lookup(identity, &digest)) {
+        if (digest != entry.digest) {
+          fail("Hash mismatch for " + path);
+          return;
+        }
+        cache_hits.fetch_add(1, std::memory_order_relaxed);
+        verified.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      uint64_t length = 0;
+      std::string file_error;
+      if (!HashFile(full_path, &digest, &length, &file_error)) {
+        fail(file_error);
+        return;
+      }
+      hashed_bytes.fetch_add(length, std::memory_order_relaxed);
+      if (length != entry.length || digest != entry.digest) {
+        fail("Hash mismatch for " + path);
+        return;
+      }
+      verified.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+
+  const unsigned count = ResolveThreads(threads, files.size());
+  std::vector<std::thread> workers;
+  workers.reserve(count - 1);
+  for (unsigned i = 1; i < count; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+  stats->files = verified.load();
+  stats->cache_hits = cache_hits.load();
+  stats->hashed_bytes = hashed_bytes.load();
+  if (cache != nullptr) {
+    AddCount(Counter::kHashCacheHits, stats->cache_hits);
+    AddCount(Counter::kHashCacheMisses, stats->files - stats->cache_hits);
+  }
+  return !failed.load();
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,79 @@
+#ifndef DESKTOP_UPDATER_INSTALL_VERIFIER_H_
+#define DESKTOP_UPDATER_INSTALL_VERIFIER_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+
+/**
+ * @brief Cheap stand-in for a file's contents.
+ *
+ * Same device, inode, size and modification time means the bytes hashed
+ * earlier are still the ones on disk. A rename keeps all four.
+ */
+struct FileIdentity {
+  uint64_t device = 0;
+  uint64_t inode = 0;
+  uint64_t size = 0;
+  int64_t mtime_ns = 0;
+};
+
+// Stats |path|. Returns false if it cannot be, and on platforms without
+// stable inode numbers (Windows), where every file is hashed again.
+bool GetFileIdentity(const std::string& path, FileIdentity* out);
+
+/**
+ * @brief Digests computed while staging, keyed by device and inode.
+ */
+class HashCache {
+ public:
+  void Put(const FileIdentity& identity, const Digest& digest);
+
+  // Returns the digest recorded for |identity| if size and mtime still
+  // match.
+  bool Lookup(const FileIdentity& identity, Digest* digest) const;
+
+  size_t size() const { return entries_.size(); }
+
+  // One "device inode size mtime_ns base64-digest" line per entry.
+  std::string Serialize() const;
+  bool Parse(const std::string& text, std::string* error);
+
+ private:
+  struct Entry {
+    uint64_t size;
+    int64_t mtime_ns;
+    Digest digest;
+  };
+  std::map<std::pair<uint64_t, uint64_t>, Entry> entries_;
+};
+
+struct VerifyStats {
+  size_t files = 0;
+  // Files matched through the cache without being read.
+  size_t cache_hits = 0;
+  uint64_t hashed_bytes = 0;
+};
+
+/**
+ * @brief Checks |files| below |root| against their manifest digests.
+ *
+ * Runs on |threads| workers (0 uses the hardware concurrency); the first
+ * mismatch or unreadable file stops every worker. Files found in |cache|
+ * (may be null) with the expected digest are not read again.
+ */
+bool VerifyInstalledFiles(const std::string& root,
+                          const Manifest& files,
+                          const HashCache* cache,
+                          unsigned threads,
+                          VerifyStats* stats,
+                          std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_INSTALL_VERIFIER_H_
@@ -0,0 +1,500 @@
+#include "json.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace desktop_updater {
+
+class JsonParser {
+ public:
+  JsonParser(const char* data, size_t size)
+      : p_(data), end_(data + size) {}
+
+  bool ParseDocument(JsonValue* out, std::string* error) {
+    SkipWhitespace();
+    if (!ParseValue(out, 0)) {
+      *error = error_;
+      return false;
+    }
+    SkipWhitespace();
+    if (p_ != end_) {
+      *error = "Unexpected trailing characters";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  static constexpr int kMaxDepth = 256;
+
+  bool Fail(const char* message) {
+    if (error_.empty()) {
+      error_ = message;
+    }
+    return false;
+  }
+
+  void SkipWhitespace() {
+    while (p_ < end_ &&
+           (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t')) {
+      p_++;
+    }
+  }
+
+  bool Consume(const char* literal) {
+    const size_t length = strlen(literal);
+    if (static_cast<size_t>(end_ - p_) < length ||
+        memcmp(p_, literal, length) != 0) {
+      return false;
+    }
+    p_ += length;
+    return true;
+  }
+
+  bool ParseValue(JsonValue* out, int depth) {
+    if (depth > kMaxDepth) {
+      return Fail("JSON nested too deeply");
+    }
+    if (p_ >= end_) {
+      return Fail("Unexpected end of JSON");
+    }
+    switch (*p_) {
+      case '{':
+        return ParseObject(out, depth);
+      case '[':
+        return ParseArray(out, depth);
+      case '"':
+        out->type_ = JsonValue::Type::kString;
+        return ParseString(&out->string_);
+      case 't':
+        if (!Consume("true")) {
+          return Fail("Invalid literal");
+        }
+        out->type_ = JsonValue::Type::kBool;
+        out->bool_ = true;
+        return true;
+      case 'f':
+        if (!Consume("false")) {
+          return Fail("Invalid literal");
+        }
+        out->type_ = JsonValue::Type::kBool;
+        out->bool_ = false;
+        return true;
+      case 'n':
+        if (!Consume("null")) {
+          return Fail("Invalid literal");
+        }
+        out->type_ = JsonValue::Type::kNull;
+        return true;
+      default:
+        return ParseNumber(out);
+    }
+  }
+
+  bool ParseObject(JsonValue* out, int depth) {
+    out->type_ = JsonValue::Type::kObject;
+    p_++;
+    SkipWhitespace();
+    if (p_ < end_ && *p_ == '}') {
+      p_++;
+      return true;
+    }
+    while (true) {
+      SkipWhitespace();
+      if (p_ >= end_ || *p_ != '"') {
+        return Fail("Expected object key");
+      }
+      std::string key;
+      if (!ParseString(&key)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (p_ >= end_ || *p_ != ':') {
+        return Fail("Expected ':'");
+      }
+      p_++;
+      SkipWhitespace();
+      out->members_.emplace_back(std::move(key), JsonValue());
+      if (!ParseValue(&out->members_.back().second, depth + 1)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (p_ < end_ && *p_ == ',') {
+        p_++;
+        continue;
+      }
+      if (p_ < end_ && *p_ == '}') {
+        p_++;
+        return true;
+      }
+      return Fail("Expected ',' or '}'");
+    }
+  }
+
+  bool ParseArray(JsonValue* out, int depth) {
+    out->type_ = JsonValue::Type::kArray;
+    p_++;
+    SkipWhitespace();
+    if (p_ < end_ && *p_ == ']') {
+      p_++;
+      return true;
+    }
+    while (true) {
+      SkipWhitespace();
+      out->items_.emplace_back();
+      if (!ParseValue(&out->items_.back(), depth + 1)) {
+        return false;
+      }
+      SkipWhitespace();
+      if (p_ < end_ && *p_ == ',') {
+        p_++;
+        continue;
+      }
+      if (p_ < end_ && *p_ == ']') {
+        p_++;
+        return true;
+      }
+      return Fail("Expected ',' or ']'");
+    }
+  }
+
+  bool ParseHex4(uint32_t* out) {
+    if (end_ - p_ < 4) {
+      return Fail("Truncated unicode escape");
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+      const char c = *p_++;
+      value <<= 4;
+      if (c >= '0' && c <= '9') {
+        value |= static_cast<uint32_t>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        value |= static_cast<uint32_t>(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        value |= static_cast<uint32_t>(c - 'A' + 10);
+      } else {
+        return Fail("Invalid unicode escape");
+      }
+    }
+    *out = value;
+    return true;
+  }
+
+  static void AppendUtf8(uint32_t code_point, std::string* out) {
+    if (code_point < 0x80) {
+      out->push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+      out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+      out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+  }
+
+  bool ParseString(std::string* out) {
+    p_++;  // Opening quote.
+    while (p_ < end_) {
+      // Copy runs of plain characters in one go.
+      const char* run = p_;
+      while (p_ < end_ && *p_ != '"' && *p_ != '\\' &&
+             static_cast<unsigned char>(*p_) >= 0x20) {
+        p_++;
+      }
+      out->append(run, static_cast<size_t>(p_ - run));
+      if (p_ >= end_) {
+        break;
+      }
+      const char c = *p_++;
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        return Fail("Control character in string");
+      }
+      if (p_ >= end_) {
+        break;
+      }
+      const char escape = *p_++;
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          out->push_back(escape);
+          break;
+        case 'b':
+          out->push_back('\b');
+          break;
+        case 'f':
+          out->push_back('\f');
+          break;
+        case 'n':
+          out->push_back('\n');
+          break;
+        case 'r':
+          out->push_back('\r');
+          break;
+        case 't':
+          out->push_back('\t');
+          break;
+        case 'u': {
+          uint32_t code_point = 0;
+          if (!ParseHex4(&code_point)) {
+            return false;
+          }
+          if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+            uint32_t low = 0;
+            if (!Consume("\\u") || !ParseHex4(&low) || low < 0xDC00 ||
+                low > 0xDFFF) {
+              return Fail("Invalid surrogate pair");
+            }
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                         (low - 0xDC00);
+          }
+          AppendUtf8(code_point, out);
+          break;
+        }
+        default:
+          return Fail("Invalid escape sequence");
+      }
+    }
+    return Fail("Unterminated string");
+  }
+
+  bool ParseNumber(JsonValue* out) {
+    const char* start = p_;
+    bool integral = true;
+    if (p_ < end_ && *p_ == '-') {
+      p_++;
+    }
+    if (p_ >= end_ || !(*p_ >= '0' && *p_ <= '9')) {
+      return Fail("Unexpected character");
+    }
+    while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+      p_++;
+    }
+    if (p_ < end_ && *p_ == '.') {
+      integral = false;
+      p_++;
+      while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+        p_++;
+      }
+    }
+    if (p_ < end_ && (*p_ == 'e' || *p_ == 'E')) {
+      integral = false;
+      p_++;
+      if (p_ < end_ && (*p_ == '+' || *p_ == '-')) {
+        p_++;
+      }
+      while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+        p_++;
+      }
+    }
+    // strtod/strtoll need a terminated buffer.
+    const std::string text(start, static_cast<size_t>(p_ - start));
+    out->type_ = JsonValue::Type::kNumber;
+    out->number_ = strtod(text.c_str(), nullptr);
+    out->integer_ = integral ? strtoll(text.c_str(), nullptr, 10)
+                             : static_cast<int64_t>(out->number_);
+    return true;
+  }
+
+  const char* p_;
+  const char* end_;
+  std::string error_;
+};
+
+bool JsonValue::Parse(const char* data,
+                      size_t size,
+                      JsonValue* out,
+                      std::string* error) {
+  *out = JsonValue();
+  JsonParser parser(data, size);
+  return parser.ParseDocument(out, error);
+}
+
+const JsonValue* JsonValue::Find(const char* key) const {
+  if (type_ != Type::kObject) {
+    return nullptr;
+  }
+  for (const auto& member : members_) {
+    if (member.first == key) {
+      return &member.second;
+    }
+  }
+  return nullptr;
+}
+
+std::string JsonValue::GetString(const char* key,
+                                 const std::string& fallback) const {
+  const JsonValue* value = Find(key);
+  return value && value->is_string() ? value->string_ : fallback;
+}
+
+int64_t JsonValue::GetInt(const char* key, int64_t fallback) const {
+  const JsonValue* value = Find(key);
+  return value && value->is_number() ? value->integer_ : fallback;
+}
+
+bool JsonValue::GetBool(const char* key, bool fallback) const {
+  const JsonValue* value = Find(key);
+  return value && value->is_bool() ? value->bool_ : fallback;
+}
+
+void JsonWriter::BeforeValue() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (!has_value_.empty()) {
+    if (has_value_.back()) {
+      out_.push_back(',');
+    }
+    has_value_.back() = true;
+  }
+}
+
+void JsonWriter::BeginObject() {
+  BeforeValue();
+  out_.push_back('{');
+  has_value_.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+  out_.push_back('}');
+  has_value_.pop_back();
+}
+
+void JsonWriter::BeginArray() {
+  BeforeValue();
+  out_.push_back('[');
+  has_value_.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+  out_.push_back(']');
+  has_value_.pop_back();
+}
+
+void JsonWriter::Key(const std::string& key) {
+  BeforeValue();
+  AppendEscaped(key);
+  out_.push_back(':');
+  after_key_ = true;
+}
+
+void JsonWriter::String(const std::string& value) {
+  BeforeValue();
+  AppendEscaped(value);
+}
+
+void JsonWriter::Int(int64_t value) {
+  BeforeValue();
+  out_ += std::to_string(value);
+}
+
+void JsonWriter::Uint(uint64_t value) {
+  BeforeValue();
+  out_ += std::to_string(value);
+}
+
+void JsonWriter::Double(double value) {
+  BeforeValue();
+  if (!std::isfinite(value)) {
+    out_ += "null";
+    return;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.17g", value);
+  out_ += buffer;
+}
+
+void JsonWriter::Bool(bool value) {
+  BeforeValue();
+  out_ += value ? "true" : "false";
+}
+
+void JsonWriter::Null() {
+  BeforeValue();
+  out_ += "null";
+}
+
+void JsonWriter::Value(const JsonValue& value) {
+  switch (value.type()) {
+    case JsonValue::Type::kNull:
+      Null();
+      break;
+    case JsonValue::Type::kBool:
+      Bool(value.bool_value());
+      break;
+    case JsonValue::Type::kNumber:
+      if (static_cast<double>(value.int_value()) == value.number_value()) {
+        Int(value.int_value());
+      } else {
+        Double(value.number_value());
+      }
+      break;
+    case JsonValue::Type::kString:
+      String(value.string_value());
+      break;
+    case JsonValue::Type::kArray:
+      BeginArray();
+      for (const JsonValue& item : value.array_items()) {
+        Value(item);
+      }
+      EndArray();
+      break;
+    case JsonValue::Type::kObject:
+      BeginObject();
+      for (const auto& member : value.object_members()) {
+        Key(member.first);
+        Value(member.second);
+      }
+      EndObject();
+      break;
+  }
+}
+
+void JsonWriter::AppendEscaped(const std::string& value) {
+  static const char kHex[] = "0123456789abcdef";
+  out_.push_back('"');
+  for (const char ch : value) {
+    const unsigned char c = static_cast<unsigned char>(ch);
+    switch (c) {
+      case '"':
+        out_ += "\\\"";
+        break;
+      case '\\':
+        out_ += "\\\\";
+        break;
+      case '\n':
+        out_ += "\\n";
+        break;
+      case '\r':
+        out_ += "\\r";
+        break;
+      case '\t':
+        out_ += "\\t";
+        break;
+      default:
+        if (c < 0x20) {
+          out_ += "\\u00";
+          out_.push_back(kHex[c >> 4]);
+          out_.push_back(kHex[c & 0x0F]);
+        } else {
+          out_.push_back(ch);
+        }
+    }
+  }
+  out_.push_back('"');
+}
+
+}  // namespace desktop_updater
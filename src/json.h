@@ -0,0 +1,114 @@
+#ifndef DESKTOP_UPDATER_JSON_H_
+#define DESKTOP_UPDATER_JSON_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "counting_allocator.h"
+
+namespace desktop_updater {
+
+/**
+ * @brief Immutable JSON document node.
+ *
+ * Just enough JSON for the files the updater exchanges (app-archive.json,
+ * hashes.json, version.json). Object members keep their document order.
+ */
+class JsonValue {
+ public:
+  enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  using Items = std::vector<JsonValue, CountingAllocator<JsonValue>>;
+  using Member = std::pair<std::string, JsonValue>;
+  using Members = std::vector<Member, CountingAllocator<Member>>;
+
+  JsonValue() = default;
+
+  /**
+   * @brief Parses a complete JSON document.
+   * @return false with |error| describing the first syntax error.
+   */
+  static bool Parse(const char* data,
+                    size_t size,
+                    JsonValue* out,
+                    std::string* error);
+
+  Type type() const { return type_; }
+  bool is_null() const { return type_ == Type::kNull; }
+  bool is_bool() const { return type_ == Type::kBool; }
+  bool is_number() const { return type_ == Type::kNumber; }
+  bool is_string() const { return type_ == Type::kString; }
+  bool is_array() const { return type_ == Type::kArray; }
+  bool is_object() const { return type_ == Type::kObject; }
+
+  bool bool_value() const { return bool_; }
+  double number_value() const { return number_; }
+  // Exact for integers up to 2^63, truncated otherwise.
+  int64_t int_value() const { return integer_; }
+  const std::string& string_value() const { return string_; }
+  const Items& array_items() const { return items_; }
+  const Members& object_members() const { return members_; }
+
+  // Returns the member named |key|, or nullptr for missing keys and
+  // non-objects.
+  const JsonValue* Find(const char* key) const;
+
+  // Typed member lookups returning |fallback| when the member is missing or
+  // has a different type.
+  std::string GetString(const char* key,
+                        const std::string& fallback = std::string()) const;
+  int64_t GetInt(const char* key, int64_t fallback = 0) const;
+  bool GetBool(const char* key, bool fallback = false) const;
+
+ private:
+  friend class JsonParser;
+
+  Type type_ = Type::kNull;
+  bool bool_ = false;
+  double number_ = 0;
+  int64_t integer_ = 0;
+  std::string string_;
+  Items items_;
+  Members members_;
+};
+
+/**
+ * @brief Streaming JSON writer that takes care of separators and escaping.
+ */
+class JsonWriter {
+ public:
+  JsonWriter() = default;
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+  void Key(const std::string& key);
+  void String(const std::string& value);
+  void Int(int64_t value);
+  void Uint(uint64_t value);
+  void Double(double value);
+  void Bool(bool value);
+  void Null();
+  // Writes a parsed document back out, e.g. to forward part of it.
+  void Value(const JsonValue& value);
+
+  const std::string& str() const { return out_; }
+  std::string Take() { return std::move(out_); }
+
+ private:
+  void BeforeValue();
+  void AppendEscaped(const std::string& value);
+
+  std::string out_;
+  // One entry per open container: true once it holds a value.
+  std::vector<bool> has_value_;
+  bool after_key_ = false;
+};
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_JSON_H_
@@ -0,0 +1,362 @@
+#include "manifest.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include "file_util.h"
+#include "json.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace desktop_updater {
+
+namespace {
+
+constexpr char kBase64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int Base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+' || c == '-') return 62;
+  if (c == '/' || c == '_') return 63;
+  return -1;
+}
+
+bool DecodeDigest(const JsonValue* value,
+                  std::vector<uint8_t>* scratch,
+                  Digest* out) {
+  if (value == nullptr || !value->is_string() ||
+      !Base64Decode(value->string_value(), scratch) ||
+      scratch->size() != sizeof(Digest)) {
+    return false;
+  }
+  memcpy(out->data(), scratch->data(), scratch->size());
+  return true;
+}
+
+bool ParsePatches(const JsonValue& item,
+                  std::vector<uint8_t>* scratch,
+                  FileEntry* entry,
+                  std::string* error) {
+  const JsonValue* patches = item.Find("patches");
+  if (patches == nullptr || patches->is_null()) {
+    return true;
+  }
+  if (!patches->is_array()) {
+    *error = "Invalid patches for " + entry->path;
+    return false;
+  }
+  for (const JsonValue& value : patches->array_items()) {
+    PatchRef patch;
+    patch.path = value.GetString("path");
+    patch.length = static_cast<uint64_t>(value.GetInt("length"));
+    if (patch.path.empty() ||
+        !DecodeDigest(value.Find("from"), scratch, &patch.from)) {
+      *error = "Invalid patch for " + entry->path;
+      return false;
+    }
+    entry->patches.push_back(std::move(patch));
+  }
+  return true;
+}
+
+void AppendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendBytes(const std::string& bytes, std::string* out) {
+  AppendVarint(bytes.size(), out);
+  out->append(bytes);
+}
+
+void AppendDigest(const Digest& digest, std::string* out) {
+  out->append(reinterpret_cast<const char*>(digest.data()), digest.size());
+}
+
+class BinaryReader {
+ public:
+  BinaryReader(const char* data, size_t size) : data_(data), size_(size) {}
+
+  bool ReadVarint(uint64_t* out) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && offset_ < size_; shift += 7) {
+      const uint8_t byte = static_cast<uint8_t>(data_[offset_++]);
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        *out = value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ReadString(std::string* out) {
+    uint64_t length = 0;
+    if (!ReadVarint(&length) || length > size_ - offset_) {
+      return false;
+    }
+    out->assign(data_ + offset_, static_cast<size_t>(length));
+    offset_ += static_cast<size_t>(length);
+    return true;
+  }
+
+  bool ReadDigest(Digest* out) {
+    if (out->size() > size_ - offset_) {
+      return false;
+    }
+    memcpy(out->data(), data_ + offset_, out->size());
+    offset_ += out->size();
+    return true;
+  }
+
+  size_t remaining() const { return size_ - offset_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+}  // namespace
+
+std::string Base64Encode(const uint8_t* data, size_t size) {
+  std::string out;
+  out.reserve((size + 2) / 3 * 4);
+  size_t i = 0;
+  for (; i + 2 < size; i += 3) {
+    const uint32_t v = (static_cast<uint32_t>(data[i]) << 16) |
+                       (static_cast<uint32_t>(data[i + 1]) << 8) | data[i + 2];
+    out.push_back(kBase64Alphabet[(v >> 18) & 0x3F]);
+    out.push_back(kBase64Alphabet[(v >> 12) & 0x3F]);
+    out.push_back(kBase64Alphabet[(v >> 6) & 0x3F]);
+    out.push_back(kBase64Alphabet[v & 0x3F]);
+  }
+  if (i < size) {
+    uint32_t v = static_cast<uint32_t>(data[i]) << 16;
+    if (i + 1 < size) {
+      v |= static_cast<uint32_t>(data[i + 1]) << 8;
+    }
+    out.push_back(kBase64Alphabet[(v >> 18) & 0x3F]);
+    out.push_back(kBase64Alphabet[(v >> 12) & 0x3F]);
+    out.push_back(i + 1 < size ? kBase64Alphabet[(v >> 6) & 0x3F] : '=');
+    out.push_back('=');
+  }
+  return out;
+}
+
+bool Base64Decode(const std::string& text, std::vector<uint8_t>* out) {
+  out->clear();
+  out->reserve(text.size() / 4 * 3);
+  uint32_t buffer = 0;
+  int bits = 0;
+  for (const char c : text) {
+    if (c == '=') {
+      break;
+    }
+    const int value = Base64Value(c);
+    if (value < 0) {
+      return false;
+    }
+    buffer = (buffer << 6) | static_cast<uint32_t>(value);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out->push_back(static_cast<uint8_t>(buffer >> bits));
+    }
+  }
+  return true;
+}
+
+bool ParseManifest(const char* data,
+                   size_t size,
+                   Manifest* out,
+                   std::string* error) {
+  JsonValue root;
+  if (!JsonValue::Parse(data, size, &root, error)) {
+    return false;
+  }
+  if (!root.is_array()) {
+    *error = "Manifest is not a JSON array";
+    return false;
+  }
+
+  out->clear();
+  out->reserve(root.array_items().size());
+  std::vector<uint8_t> scratch;
+  for (const JsonValue& item : root.array_items()) {
+    const JsonValue* path = item.Find("path");
+    const JsonValue* hash = item.Find("calculatedHash");
+    if (path == nullptr || !path->is_string() || hash == nullptr ||
+        !hash->is_string()) {
+      *error = "Manifest entry without path or calculatedHash";
+      return false;
+    }
+    FileEntry entry;
+    entry.path = path->string_value();
+    entry.length = static_cast<uint64_t>(item.GetInt("length"));
+    if (!DecodeDigest(hash, &scratch, &entry.digest)) {
+      *error = "Invalid hash for " + path->string_value();
+      return false;
+    }
+    const JsonValue* object = item.Find("object");
+    if (object != nullptr && object->is_string()) {
+      entry.object = object->string_value();
+    }
+    if (!ParsePatches(item, &scratch, &entry, error)) {
+      return false;
+    }
+    out->push_back(std::move(entry));
+  }
+  return true;
+}
+
+std::string SerializeManifest(const Manifest& manifest) {
+  JsonWriter writer;
+  writer.BeginArray();
+  for (const FileEntry& entry : manifest) {
+    writer.BeginObject();
+    writer.Key("path");
+    writer.String(entry.path);
+    writer.Key("calculatedHash");
+    writer.String(Base64Encode(entry.digest.data(), entry.digest.size()));
+    writer.Key("length");
+    writer.Uint(entry.length);
+    if (!entry.object.empty()) {
+      writer.Key("object");
+      writer.String(entry.object);
+    }
+    if (!entry.patches.empty()) {
+      writer.Key("patches");
+      writer.BeginArray();
+      for (const PatchRef& patch : entry.patches) {
+        writer.BeginObject();
+        writer.Key("from");
+        writer.String(Base64Encode(patch.from.data(), patch.from.size()));
+        writer.Key("path");
+        writer.String(patch.path);
+        writer.Key("length");
+        writer.Uint(patch.length);
+        writer.EndObject();
+      }
+      writer.EndArray();
+    }
+    writer.EndObject();
+  }
+  writer.EndArray();
+  return writer.Take();
+}
+
+std::string SerializeBinaryManifest(const Manifest& manifest) {
+  std::string out(kBinaryManifestMagic, kBinaryManifestMagicSize);
+  AppendVarint(manifest.size(), &out);
+  for (const FileEntry& entry : manifest) {
+    AppendBytes(entry.path, &out);
+    AppendVarint(entry.length, &out);
+    AppendDigest(entry.digest, &out);
+    AppendBytes(entry.object, &out);
+    AppendVarint(entry.patches.size(), &out);
+    for (const PatchRef& patch : entry.patches) {
+      AppendDigest(patch.from, &out);
+      AppendBytes(patch.path, &out);
+      AppendVarint(patch.length, &out);
+    }
+  }
+  return out;
+}
+
+bool ParseBinaryManifest(const char* data,
+                         size_t size,
+                         Manifest* out,
+                         std::string* error) {
+  out->clear();
+  if (size < kBinaryManifestMagicSize ||
+      memcmp(data, kBinaryManifestMagic, kBinaryManifestMagicSize) != 0) {
+    *error = "Not a binary manifest";
+    return false;
+  }
+  BinaryReader reader(data + kBinaryManifestMagicSize,
+                      size - kBinaryManifestMagicSize);
+  uint64_t count = 0;
+  // Every entry takes at least 68 bytes, which bounds the reservation.
+  if (!reader.ReadVarint(&count) ||
+      count > reader.remaining() / (sizeof(Digest) + 4)) {
+    *error = "Truncated binary manifest";
+    return false;
+  }
+  out->reserve(static_cast<size_t>(count));
+  for (uint64_t i = 0; i < count; i++) {
+    FileEntry entry;
+    uint64_t patches = 0;
+    if (!reader.ReadString(&entry.path) || !reader.ReadVarint(&entry.length) ||
+        !reader.ReadDigest(&entry.digest) || !reader.ReadString(&entry.object) ||
+        !reader.ReadVarint(&patches)) {
+      *error = "Truncated binary manifest";
+      return false;
+    }
+    for (uint64_t j = 0; j < patches; j++) {
+      PatchRef patch;
+      if (!reader.ReadDigest(&patch.from) || !reader.ReadString(&patch.path) ||
+          !reader.ReadVarint(&patch.length)) {
+        *error = "Truncated patches for " + entry.path;
+        return false;
+      }
+      entry.patches.push_back(std::move(patch));
+    }
+    out->push_back(std::move(entry));
+  }
+  if (reader.remaining() != 0) {
+    *error = "Trailing data in binary manifest";
+    return false;
+  }
+  return true;
+}
+
+ManifestDiff DiffManifests(const Manifest& installed, const Manifest& target) {
+  TraceSpan span("diff");
+  span.SetArg("files", static_cast<int64_t>(target.size()));
+  PhaseTimer timer(Phase::kDiff);
+  ManifestDiffer differ(installed);
+  differ.Add(target);
+  return differ.Finish();
+}
+
+ManifestDiffer::ManifestDiffer(const Manifest& installed)
+    : installed_(installed) {
+  remaining_.reserve(installed.size());
+  for (const FileEntry& entry : installed) {
+    remaining_.emplace(NormalizeRelativePath(entry.path), &entry);
+  }
+}
+
+void ManifestDiffer::Add(const Manifest& part) {
+  for (const FileEntry& entry : part) {
+    auto it = remaining_.find(NormalizeRelativePath(entry.path));
+    if (it == remaining_.end()) {
+      diff_.changed.push_back(entry);
+      continue;
+    }
+    if (it->second->digest != entry.digest) {
+      diff_.changed.push_back(entry);
+    }
+    // Whatever is left in the map at the end was removed.
+    remaining_.erase(it);
+  }
+}
+
+ManifestDiff ManifestDiffer::Finish() {
+  for (const FileEntry& entry : installed_) {
+    if (remaining_.count(NormalizeRelativePath(entry.path)) != 0) {
+      diff_.removed.push_back(entry);
+    }
+  }
+  remaining_.clear();
+  return std::move(diff_);
+}
+
+}  // namespace desktop_updater
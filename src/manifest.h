@@ -0,0 +1,138 @@
+#ifndef DESKTOP_UPDATER_MANIFEST_H_
+#define DESKTOP_UPDATER_MANIFEST_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "counting_allocator.h"
+
+namespace desktop_updater {
+
+// BLAKE2b-512 digest of a file's contents.
+using Digest = std::array<uint8_t, 64>;
+
+/**
+ * @brief A published binary delta producing a manifest entry's contents
+ *        from an older version of the same file.
+ */
+struct PatchRef {
+  // Digest of the file the patch applies to.
+  Digest from = {};
+  // Location of the patch relative to the release folder.
+  std::string path;
+  uint64_t length = 0;
+};
+
+/**
+ * @brief One file of a hashes.json manifest.
+ */
+struct FileEntry {
+  // Relative path as written by the producer; may use '\\' on Windows.
+  std::string path;
+  uint64_t length = 0;
+  Digest digest = {};
+  // Optional "object": where the packer published the contents by digest,
+  // relative to the release folder, e.g. "../objects/<hex>". Releases that
+  // share a file share its object and its URL.
+  std::string object;
+  // Optional "patches" published next to the full file.
+  std::vector<PatchRef> patches;
+};
+
+using Manifest = std::vector<FileEntry, CountingAllocator<FileEntry>>;
+
+/**
+ * @brief Difference between the installed tree and a release.
+ */
+struct ManifestDiff {
+  // Entries of the target that are missing or differ locally.
+  Manifest changed;
+  // Installed entries the target no longer contains.
+  Manifest removed;
+};
+
+std::string Base64Encode(const uint8_t* data, size_t size);
+bool Base64Decode(const std::string& text, std::vector<uint8_t>* out);
+
+/**
+ * @brief Parses a hashes.json document:
+ *        [{"path": ..., "calculatedHash": <base64>, "length": ...,
+ *          "object": ...,
+ *          "patches": [{"from": <base64>, "path": ..., "length": ...}]}]
+ *
+ * "object" and "patches" are optional and ignored by older clients.
+ */
+bool ParseManifest(const char* data,
+                   size_t size,
+                   Manifest* out,
+                   std::string* error);
+
+// Serializes |manifest| in the hashes.json format read by the Dart side.
+std::string SerializeManifest(const Manifest& manifest);
+
+/**
+ * Binary manifest ("hashes.bin"), the entries of hashes.json without base64
+ * and JSON, written next to it by the release packer:
+ *
+ *   magic    "DUHASHB1"
+ *   varint   entry count
+ *   entry:   varint path size, path (UTF-8)
+ *            varint length
+ *            digest[64]
+ *            varint object size, object (empty without one)
+ *            varint patch count
+ *            patch: digest from[64], varint path size, path, varint length
+ *
+ * Varints are unsigned LEB128, as in delta.h.
+ */
+constexpr char kBinaryManifestMagic[] = "DUHASHB1";
+constexpr size_t kBinaryManifestMagicSize = 8;
+
+std::string SerializeBinaryManifest(const Manifest& manifest);
+bool ParseBinaryManifest(const char* data,
+                         size_t size,
+                         Manifest* out,
+                         std::string* error);
+
+/**
+ * @brief Compares two manifests by normalized path and digest.
+ *
+ * Runs in O(n) expected time; paths produced on Windows and POSIX compare
+ * equal. Output order follows |target| (changed) and |installed| (removed).
+ */
+ManifestDiff DiffManifests(const Manifest& installed, const Manifest& target);
+
+/**
+ * @brief DiffManifests() for a target that arrives in parts, such as the
+ *        shards of a sharded manifest.
+ *
+ * The parts must not list a path twice. |installed| must outlive the
+ * differ.
+ */
+class ManifestDiffer {
+ public:
+  explicit ManifestDiffer(const Manifest& installed);
+
+  ManifestDiffer(const ManifestDiffer&) = delete;
+  ManifestDiffer& operator=(const ManifestDiffer&) = delete;
+
+  // Adds the changed entries of |part| to the diff.
+  void Add(const Manifest& part);
+
+  // Completes the diff with the installed entries no part listed.
+  ManifestDiff Finish();
+
+ private:
+  const Manifest& installed_;
+  // Installed entries by normalized path, until a part lists them.
+  std::unordered_map<std::string, const FileEntry*> remaining_;
+  ManifestDiff diff_;
+};
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_MANIFEST_H_
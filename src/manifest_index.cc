@@ -0,0 +1,99 @@
+#include "manifest_index.h"
+
+#include <cstring>
+#include <map>
+
+#include "file_util.h"
+#include "json.h"
+
+namespace desktop_updater {
+
+bool ParseManifestIndex(const char* data,
+                        size_t size,
+                        ManifestIndex* out,
+                        std::string* error) {
+  JsonValue root;
+  if (!JsonValue::Parse(data, size, &root, error)) {
+    return false;
+  }
+  const JsonValue* shards = root.is_object() ? root.Find("shards") : nullptr;
+  if (shards == nullptr || !shards->is_array()) {
+    *error = "Manifest index without shards";
+    return false;
+  }
+
+  out->clear();
+  out->reserve(shards->array_items().size());
+  std::vector<uint8_t> digest;
+  for (const JsonValue& item : shards->array_items()) {
+    ManifestShard shard;
+    shard.dir = item.GetString("dir");
+    shard.path = item.GetString("path");
+    shard.length = static_cast<uint64_t>(item.GetInt("length"));
+    shard.entries = static_cast<uint64_t>(item.GetInt("entries"));
+    if (shard.path.empty() ||
+        !Base64Decode(item.GetString("calculatedHash"), &digest) ||
+        digest.size() != shard.digest.size()) {
+      *error = "Invalid shard in manifest index";
+      return false;
+    }
+    memcpy(shard.digest.data(), digest.data(), digest.size());
+    out->push_back(std::move(shard));
+  }
+  return true;
+}
+
+std::string SerializeManifestIndex(const ManifestIndex& index) {
+  JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("shards");
+  writer.BeginArray();
+  for (const ManifestShard& shard : index) {
+    writer.BeginObject();
+    writer.Key("dir");
+    writer.String(shard.dir);
+    writer.Key("path");
+    writer.String(shard.path);
+    writer.Key("length");
+    writer.Uint(shard.length);
+    writer.Key("calculatedHash");
+    writer.String(Base64Encode(shard.digest.data(), shard.digest.size()));
+    writer.Key("entries");
+    writer.Uint(shard.entries);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+  return writer.Take();
+}
+
+void ShardManifest(const Manifest& manifest,
+                   int depth,
+                   ManifestIndex* index,
+                   std::vector<Manifest>* shards) {
+  std::map<std::string, Manifest> by_dir;
+  for (const FileEntry& entry : manifest) {
+    const std::string path = NormalizeRelativePath(entry.path);
+    size_t end = 0;
+    for (int i = 0; i < depth; i++) {
+      const size_t slash = path.find('/', end == 0 ? 0 : end + 1);
+      if (slash == std::string::npos) {
+        break;
+      }
+      end = slash;
+    }
+    by_dir[path.substr(0, end)].push_back(entry);
+  }
+
+  index->clear();
+  shards->clear();
+  for (auto& dir : by_dir) {
+    ManifestShard shard;
+    shard.dir = dir.first;
+    shard.entries = dir.second.size();
+    index->push_back(std::move(shard));
+    shards->push_back(std::move(dir.second));
+  }
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,66 @@
+#ifndef DESKTOP_UPDATER_MANIFEST_INDEX_H_
+#define DESKTOP_UPDATER_MANIFEST_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+
+// Index of a sharded manifest, next to the hashes.json it splits up.
+constexpr char kManifestIndexName[] = "hashes.index.json";
+// Folder below the release folder holding the shards.
+constexpr char kManifestShardDirName[] = "shards";
+
+/**
+ * @brief One shard of a sharded manifest: the hashes.json entries of the
+ *        files below one directory.
+ */
+struct ManifestShard {
+  // '/'-separated directory the shard covers; empty for the files at the
+  // top of a shallow tree.
+  std::string dir;
+  // Location of the shard relative to the release folder.
+  std::string path;
+  // Size and digest of the shard document, so a client can verify it.
+  uint64_t length = 0;
+  Digest digest = {};
+  uint64_t entries = 0;
+};
+
+using ManifestIndex = std::vector<ManifestShard>;
+
+/**
+ * @brief Parses a hashes.index.json document:
+ *        {"shards": [{"dir": ..., "path": ..., "length": ...,
+ *                     "calculatedHash": <base64>, "entries": ...}]}
+ *
+ * Each shard is a hashes.json document of its own. Together the shards
+ * list exactly the entries of the release's hashes.json, which older
+ * clients keep reading.
+ */
+bool ParseManifestIndex(const char* data,
+                        size_t size,
+                        ManifestIndex* out,
+                        std::string* error);
+
+std::string SerializeManifestIndex(const ManifestIndex& index);
+
+/**
+ * @brief Splits |manifest| by the first |depth| directories of each path.
+ *
+ * Files in shallower directories share the shard of their own directory.
+ * Shards are ordered by directory and keep the manifest's order inside;
+ * the returned index has |dir| and |entries| set.
+ */
+void ShardManifest(const Manifest& manifest,
+                   int depth,
+                   ManifestIndex* index,
+                   std::vector<Manifest>* shards);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_MANIFEST_INDEX_H_
@@ -0,0 +1,344 @@
+#include "metrics.h"
+
+#include "counting_allocator.h"
+#include "process_memory.h"
+#include "trace.h"
+
+namespace desktop_updater {
+
+namespace internal {
+std::array<std::atomic<uint64_t>, kCounterCount> g_counters{};
+}  // namespace internal
+
+namespace {
+
+std::array<std::array<std::atomic<uint64_t>, kPerfEventCount>, kPhaseCount>
+    g_phase_perf{};
+
+struct PhaseMemory {
+  std::atomic<uint64_t> allocated{0};
+  std::atomic<uint64_t> peak_allocated{0};
+  std::atomic<uint64_t> max_rss{0};
+  std::atomic<uint64_t> max_pss{0};
+};
+
+std::array<PhaseMemory, kPhaseCount> g_phase_memory;
+std::atomic<uint64_t> g_live_bytes{0};
+std::atomic<uint64_t> g_peak_live_bytes{0};
+
+// Phases whose PhaseScope is open on this thread.
+thread_local uint32_t t_active_phases = 0;
+
+void UpdateMax(std::atomic<uint64_t>* target, uint64_t value) {
+  uint64_t current = target->load(std::memory_order_relaxed);
+  while (value > current &&
+         !target->compare_exchange_weak(current, value,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+// Samples RSS and PSS for |phase| and, while tracing, adds them and the
+// live allocated bytes to the trace as counters.
+void SampleMemory(Phase phase) {
+  ProcessMemory memory;
+  const bool sampled = SampleProcessMemory(&memory);
+  if (sampled) {
+    PhaseMemory& totals = g_phase_memory[static_cast<size_t>(phase)];
+    UpdateMax(&totals.max_rss, memory.rss_bytes);
+    UpdateMax(&totals.max_pss, memory.pss_bytes);
+  }
+  if (TraceEnabled()) {
+    TraceCounter("allocated", "bytes",
+                 static_cast<int64_t>(
+                     g_live_bytes.load(std::memory_order_relaxed)));
+    if (sampled) {
+      TraceCounter("rss", "bytes", static_cast<int64_t>(memory.rss_bytes));
+      TraceCounter("pss", "bytes", static_cast<int64_t>(memory.pss_bytes));
+    }
+  }
+}
+
+std::array<LatencyHistogram, kPhaseCount>& PhaseHistograms() {
+  // Never destroyed: timers may end during static destruction.
+  static auto* histograms = new std::array<LatencyHistogram, kPhaseCount>();
+  return *histograms;
+}
+
+int HighestBit(uint64_t value) {
+  int bit = 0;
+  for (int shift = 32; shift > 0; shift /= 2) {
+    if (value >> shift) {
+      value >>= shift;
+      bit += shift;
+    }
+  }
+  return bit;
+}
+
+}  // namespace
+
+const char* CounterName(Counter counter) {
+  switch (counter) {
+    case Counter::kFilesScanned:
+      return "filesScanned";
+    case Counter::kFilesHashed:
+      return "filesHashed";
+    case Counter::kBytesHashed:
+      return "bytesHashed";
+    case Counter::kFilesDownloaded:
+      return "filesDownloaded";
+    case Counter::kBytesDownloaded:
+      return "bytesDownloaded";
+    case Counter::kBytesStaged:
+      return "bytesStaged";
+    case Counter::kFetchFailures:
+      return "fetchFailures";
+    case Counter::kFilesStaged:
+      return "filesStaged";
+    case Counter::kFilesApplied:
+      return "filesApplied";
+    case Counter::kApplyFailures:
+      return "applyFailures";
+    case Counter::kHashCacheHits:
+      return "hashCacheHits";
+    case Counter::kHashCacheMisses:
+      return "hashCacheMisses";
+    case Counter::kBytesAllocated:
+      return "bytesAllocated";
+    case Counter::kCount:
+      break;
+  }
+  return "";
+}
+
+const char* PhaseName(Phase phase) {
+  switch (phase) {
+    case Phase::kCheck:
+      return "check";
+    case Phase::kScan:
+      return "scan";
+    case Phase::kHash:
+      return "hash";
+    case Phase::kDiff:
+      return "diff";
+    case Phase::kFetch:
+      return "fetch";
+    case Phase::kFetchFile:
+      return "fetchFile";
+    case Phase::kStage:
+      return "stage";
+    case Phase::kApply:
+      return "apply";
+    case Phase::kVerifyInstalled:
+      return "verifyInstalled";
+    case Phase::kCount:
+      break;
+  }
+  return "";
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+  const int shift = HighestBit(value) - 4;
+  const uint64_t sub = (value >> shift) & (kSubBuckets - 1);
+  return static_cast<size_t>(shift + 1) * kSubBuckets +
+         static_cast<size_t>(sub);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  const int shift = static_cast<int>(index / kSubBuckets) - 1;
+  const uint64_t sub = index % kSubBuckets;
+  const uint64_t lower = (kSubBuckets + sub) << shift;
+  return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t value) {
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  UpdateMax(&max_, value);
+}
+
+void LatencyHistogram::Reset() {
+  for (std::atomic<uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(double percentile) const {
+  uint64_t total = 0;
+  for (const std::atomic<uint64_t>& bucket : buckets_) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+  // Rank of the requested value, 1-based.
+  uint64_t rank = static_cast<uint64_t>(percentile / 100.0 *
+                                        static_cast<double>(total) + 0.5);
+  rank = rank < 1 ? 1 : (rank > total ? total : rank);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; i++) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      const uint64_t upper = BucketUpperBound(i);
+      // Never report more than was recorded.
+      const uint64_t max = this->max();
+      return upper < max ? upper : max;
+    }
+  }
+  return max();
+}
+
+namespace internal {
+
+void NoteAllocated(size_t bytes) {
+  AddCount(Counter::kBytesAllocated, bytes);
+  const uint64_t live =
+      g_live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  UpdateMax(&g_peak_live_bytes, live);
+  const uint32_t active = t_active_phases;
+  for (size_t i = 0; active != 0 && i < kPhaseCount; i++) {
+    if ((active & (1u << i)) != 0) {
+      g_phase_memory[i].allocated.fetch_add(bytes, std::memory_order_relaxed);
+      UpdateMax(&g_phase_memory[i].peak_allocated, live);
+    }
+  }
+}
+
+void NoteFreed(size_t bytes) {
+  g_live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+}  // namespace internal
+
+PhaseScope::PhaseScope(Phase phase) : phase_(phase) {
+  const uint32_t bit = 1u << static_cast<uint32_t>(phase_);
+  if ((t_active_phases & bit) != 0) {
+    return;
+  }
+  t_active_phases |= bit;
+  active_ = true;
+  UpdateMax(&g_phase_memory[static_cast<size_t>(phase_)].peak_allocated,
+            g_live_bytes.load(std::memory_order_relaxed));
+  counting_ = PerfCountersEnabled() && ReadThreadPerfCounters(&start_);
+}
+
+PhaseScope::~PhaseScope() {
+  if (!active_) {
+    return;
+  }
+  t_active_phases &= ~(1u << static_cast<uint32_t>(phase_));
+  PerfSample end;
+  if (!counting_ || !ReadThreadPerfCounters(&end)) {
+    return;
+  }
+  auto& totals = g_phase_perf[static_cast<size_t>(phase_)];
+  for (size_t i = 0; i < kPerfEventCount; i++) {
+    if (end[i] > start_[i]) {
+      totals[i].fetch_add(end[i] - start_[i], std::memory_order_relaxed);
+    }
+  }
+}
+
+PhaseTimer::PhaseTimer(Phase phase)
+    : phase_(phase), start_(std::chrono::steady_clock::now()), scope_(phase) {
+  if (phase_ != Phase::kFetchFile) {
+    SampleMemory(phase_);
+    allocated_at_start_ = g_phase_memory[static_cast<size_t>(phase_)]
+                              .allocated.load(std::memory_order_relaxed);
+  }
+}
+
+PhaseTimer::~PhaseTimer() {
+  RecordPhase(phase_, static_cast<uint64_t>(
+                          std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start_)
+                              .count()));
+  if (phase_ == Phase::kFetchFile) {
+    return;
+  }
+  SampleMemory(phase_);
+  if (TraceEnabled()) {
+    TraceCounter("allocated by phase", PhaseName(phase_),
+                 static_cast<int64_t>(
+                     g_phase_memory[static_cast<size_t>(phase_)]
+                         .allocated.load(std::memory_order_relaxed) -
+                     allocated_at_start_));
+  }
+}
+
+void RecordPhase(Phase phase, uint64_t micros) {
+  PhaseHistograms()[static_cast<size_t>(phase)].Record(micros);
+}
+
+MetricsSnapshot SnapshotMetrics() {
+  MetricsSnapshot snapshot;
+  for (size_t i = 0; i < kCounterCount; i++) {
+    snapshot.counters[i] =
+        internal::g_counters[i].load(std::memory_order_relaxed);
+  }
+  const auto& histograms = PhaseHistograms();
+  for (size_t i = 0; i < kPhaseCount; i++) {
+    const LatencyHistogram& histogram = histograms[i];
+    PhaseSummary& summary = snapshot.phases[i];
+    for (size_t j = 0; j < kPerfEventCount; j++) {
+      summary.perf[j] = g_phase_perf[i][j].load(std::memory_order_relaxed);
+    }
+    const PhaseMemory& memory = g_phase_memory[i];
+    summary.allocated_bytes = memory.allocated.load(std::memory_order_relaxed);
+    summary.peak_allocated_bytes =
+        memory.peak_allocated.load(std::memory_order_relaxed);
+    summary.max_rss_bytes = memory.max_rss.load(std::memory_order_relaxed);
+    summary.max_pss_bytes = memory.max_pss.load(std::memory_order_relaxed);
+    summary.count = histogram.count();
+    if (summary.count == 0) {
+      continue;
+    }
+    summary.total_us = histogram.sum();
+    summary.max_us = histogram.max();
+    summary.p50_us = histogram.ValueAtPercentile(50);
+    summary.p90_us = histogram.ValueAtPercentile(90);
+    summary.p99_us = histogram.ValueAtPercentile(99);
+  }
+  snapshot.perf_enabled = PerfCountersEnabled();
+  snapshot.perf_events = AvailablePerfEvents();
+  snapshot.perf_error = PerfCountersError();
+  snapshot.live_allocated_bytes = g_live_bytes.load(std::memory_order_relaxed);
+  snapshot.peak_allocated_bytes =
+      g_peak_live_bytes.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void ResetMetrics() {
+  for (std::atomic<uint64_t>& counter : internal::g_counters) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+  for (LatencyHistogram& histogram : PhaseHistograms()) {
+    histogram.Reset();
+  }
+  // Live bytes stay: the buffers they count still exist.
+  g_peak_live_bytes.store(g_live_bytes.load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+  for (PhaseMemory& memory : g_phase_memory) {
+    memory.allocated.store(0, std::memory_order_relaxed);
+    memory.peak_allocated.store(0, std::memory_order_relaxed);
+    memory.max_rss.store(0, std::memory_order_relaxed);
+    memory.max_pss.store(0, std::memory_order_relaxed);
+  }
+  for (auto& totals : g_phase_perf) {
+    for (std::atomic<uint64_t>& total : totals) {
+      total.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace desktop_updater
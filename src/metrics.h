@@ -0,0 +1,184 @@
+#ifndef DESKTOP_UPDATER_METRICS_H_
+#define DESKTOP_UPDATER_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "perf_counters.h"
+
+namespace desktop_updater {
+
+// Process-wide counters. Names are listed in CounterName().
+enum class Counter {
+  kFilesScanned,
+  kFilesHashed,
+  kBytesHashed,
+  kFilesDownloaded,
+  kBytesDownloaded,
+  // Bytes written into the staging directory: downloads and patch results.
+  kBytesStaged,
+  kFetchFailures,
+  kFilesStaged,
+  kFilesApplied,
+  kApplyFailures,
+  kHashCacheHits,
+  kHashCacheMisses,
+  // Bytes allocated through CountingAllocator.
+  kBytesAllocated,
+  kCount,
+};
+
+// Timed phases. Names are listed in PhaseName().
+enum class Phase {
+  kCheck,
+  kScan,
+  kHash,
+  kDiff,
+  kFetch,
+  kFetchFile,
+  kStage,
+  kApply,
+  kVerifyInstalled,
+  kCount,
+};
+
+constexpr size_t kCounterCount = static_cast<size_t>(Counter::kCount);
+constexpr size_t kPhaseCount = static_cast<size_t>(Phase::kCount);
+
+// camelCase names, as reported to Dart.
+const char* CounterName(Counter counter);
+const char* PhaseName(Phase phase);
+
+/**
+ * @brief Lock-free log-linear histogram of non-negative values.
+ *
+ * Bucketed like an HDR histogram: values below 16 are exact, and above
+ * that each power of two is split into 16 buckets, so any recorded value
+ * is reported within 6.25%. Recording is a few relaxed atomic adds.
+ */
+class LatencyHistogram {
+ public:
+  static constexpr size_t kSubBuckets = 16;
+  static constexpr size_t kBucketCount = 61 * kSubBuckets;
+
+  void Record(uint64_t value);
+  void Reset();
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  // Upper bound of the bucket holding the |percentile| (0-100) value, or 0
+  // when empty.
+  uint64_t ValueAtPercentile(double percentile) const;
+
+  static size_t BucketIndex(uint64_t value);
+  static uint64_t BucketUpperBound(size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+struct PhaseSummary {
+  uint64_t count = 0;
+  uint64_t total_us = 0;
+  uint64_t max_us = 0;
+  uint64_t p50_us = 0;
+  uint64_t p90_us = 0;
+  uint64_t p99_us = 0;
+  // Hardware counter totals over all threads that worked on the phase,
+  // zero unless SetPerfCountersEnabled() succeeded.
+  PerfSample perf{};
+  // Bytes allocated through CountingAllocator while the phase was open on
+  // the allocating thread, and the most such bytes (process-wide) that were
+  // live at once while it was.
+  uint64_t allocated_bytes = 0;
+  uint64_t peak_allocated_bytes = 0;
+  // Largest process RSS and PSS sampled when the phase started or ended.
+  uint64_t max_rss_bytes = 0;
+  uint64_t max_pss_bytes = 0;
+};
+
+struct MetricsSnapshot {
+  std::array<uint64_t, kCounterCount> counters{};
+  std::array<PhaseSummary, kPhaseCount> phases{};
+  bool perf_enabled = false;
+  // Bit i is set if PerfEvent i could be counted.
+  uint32_t perf_events = 0;
+  std::string perf_error;
+  // Bytes currently and at most allocated through CountingAllocator.
+  uint64_t live_allocated_bytes = 0;
+  uint64_t peak_allocated_bytes = 0;
+};
+
+namespace internal {
+extern std::array<std::atomic<uint64_t>, kCounterCount> g_counters;
+}  // namespace internal
+
+inline void AddCount(Counter counter, uint64_t value = 1) {
+  internal::g_counters[static_cast<size_t>(counter)].fetch_add(
+      value, std::memory_order_relaxed);
+}
+
+// Adds |micros| to the duration histogram of |phase|.
+void RecordPhase(Phase phase, uint64_t micros);
+
+/**
+ * @brief Marks |phase| as being worked on by the calling thread.
+ *
+ * Allocations through CountingAllocator made inside the scope are
+ * attributed to the phase, as are the thread's performance counter deltas
+ * while counting is on. Worker threads of a phase open their own scope; a
+ * scope for a phase the thread already has open does nothing, so the work
+ * is not counted twice.
+ */
+class PhaseScope {
+ public:
+  explicit PhaseScope(Phase phase);
+  ~PhaseScope();
+
+  PhaseScope(const PhaseScope&) = delete;
+  PhaseScope& operator=(const PhaseScope&) = delete;
+
+ private:
+  Phase phase_;
+  bool active_ = false;
+  bool counting_ = false;
+  PerfSample start_;
+};
+
+// Records the lifetime of a scope with RecordPhase() inside a PhaseScope.
+// Except for the per-file kFetchFile, also samples the process's memory at
+// both ends, and adds memory counters to the trace when it is on.
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(Phase phase);
+  ~PhaseTimer();
+
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+ private:
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+  PhaseScope scope_;
+  uint64_t allocated_at_start_ = 0;
+};
+
+// Reads every counter and summarizes every phase. Concurrent updates may
+// or may not be included.
+MetricsSnapshot SnapshotMetrics();
+
+// Zeroes all counters and histograms.
+void ResetMetrics();
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_METRICS_H_
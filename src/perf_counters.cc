@@ -0,0 +1,242 @@
+#include "perf_counters.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <vector>
+
+#include "file_util.h"
+#endif
+
+namespace desktop_updater {
+
+namespace internal {
+std::atomic<bool> g_perf_enabled{false};
+}  // namespace internal
+
+namespace {
+
+std::atomic<uint32_t> g_available_events{0};
+std::mutex g_error_mutex;
+
+std::string& LastError() {
+  static auto* error = new std::string();
+  return *error;
+}
+
+#ifdef __linux__
+
+void SetLastError(const std::string& message) {
+  std::lock_guard<std::mutex> lock(g_error_mutex);
+  LastError() = message;
+}
+
+struct EventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+constexpr EventConfig kEvents[kPerfEventCount] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+std::string ParanoidSetting() {
+  std::vector<uint8_t> data;
+  std::string error;
+  if (!ReadFileBytes("/proc/sys/kernel/perf_event_paranoid", &data, &error)) {
+    return "";
+  }
+  std::string value(data.begin(), data.end());
+  while (!value.empty() && (value.back() == '\n' || value.back() == ' ')) {
+    value.pop_back();
+  }
+  return " (perf_event_paranoid=" + value + ")";
+}
+
+/**
+ * @brief One thread's perf_event_open group.
+ *
+ * The first event that opens leads the group, so a VM without a PMU still
+ * gets the software page fault counter. The whole group is read with one
+ * read() call.
+ */
+class ThreadCounters {
+ public:
+  ThreadCounters() { fds_.fill(-1); }
+
+  ~ThreadCounters() { Close(); }
+
+  bool Read(PerfSample* out) {
+    if (!attempted_) {
+      Open();
+    }
+    if (leader_ < 0) {
+      return false;
+    }
+    // nr, time_enabled, time_running, then one value per member.
+    uint64_t buffer[3 + kPerfEventCount];
+    const ssize_t size = read(leader_, buffer, sizeof(buffer));
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t))) {
+      return false;
+    }
+    const uint64_t enabled = buffer[1];
+    const uint64_t running = buffer[2];
+    out->fill(0);
+    for (size_t i = 0; i < buffer[0] && i < members_; i++) {
+      uint64_t value = buffer[3 + i];
+      // Scale up when the PMU was shared and the group was multiplexed.
+      if (running != 0 && running < enabled) {
+        value = static_cast<uint64_t>(static_cast<double>(value) *
+                                      static_cast<double>(enabled) /
+                                      static_cast<double>(running));
+      }
+      (*out)[order_[i]] = value;
+    }
+    return true;
+  }
+
+  // Lets the next Read() try again if nothing opened last time.
+  void RetryIfUnavailable() {
+    if (leader_ < 0) {
+      attempted_ = false;
+    }
+  }
+
+ private:
+  void Open() {
+    attempted_ = true;
+    for (size_t i = 0; i < kPerfEventCount; i++) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = kEvents[i].type;
+      attr.config = kEvents[i].config;
+      // User space only, which perf_event_paranoid 2 (the usual default)
+      // still allows for the calling thread.
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0,
+                                              -1, leader_,
+                                              PERF_FLAG_FD_CLOEXEC));
+      if (fd < 0) {
+        SetLastError(std::string(PerfEventName(static_cast<PerfEvent>(i))) +
+                     ": " + strerror(errno) + ParanoidSetting());
+        continue;
+      }
+      if (leader_ < 0) {
+        leader_ = fd;
+      }
+      fds_[i] = fd;
+      order_[members_++] = i;
+      g_available_events.fetch_or(1u << i, std::memory_order_relaxed);
+    }
+  }
+
+  void Close() {
+    for (int fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  bool attempted_ = false;
+  int leader_ = -1;
+  std::array<int, kPerfEventCount> fds_;
+  // Event of each group member, in the order read() reports them.
+  std::array<size_t, kPerfEventCount> order_{};
+  size_t members_ = 0;
+};
+
+ThreadCounters& CurrentThreadCounters() {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+const char* PerfEventName(PerfEvent event) {
+  switch (event) {
+    case PerfEvent::kCycles:
+      return "cycles";
+    case PerfEvent::kInstructions:
+      return "instructions";
+    case PerfEvent::kCacheMisses:
+      return "cacheMisses";
+    case PerfEvent::kPageFaults:
+      return "pageFaults";
+    case PerfEvent::kCount:
+      break;
+  }
+  return "";
+}
+
+bool SetPerfCountersEnabled(bool enabled, std::string* error) {
+  if (!enabled) {
+    internal::g_perf_enabled.store(false, std::memory_order_relaxed);
+    return true;
+  }
+#ifdef __linux__
+  CurrentThreadCounters().RetryIfUnavailable();
+  internal::g_perf_enabled.store(true, std::memory_order_relaxed);
+  PerfSample sample;
+  if (!ReadThreadPerfCounters(&sample)) {
+    internal::g_perf_enabled.store(false, std::memory_order_relaxed);
+    *error = "No performance counter could be opened: " + PerfCountersError();
+    return false;
+  }
+  return true;
+#else
+  *error = "Performance counters need Linux perf_event_open";
+  return false;
+#endif
+}
+
+bool ReadThreadPerfCounters(PerfSample* out) {
+#ifdef __linux__
+  return PerfCountersEnabled() && CurrentThreadCounters().Read(out);
+#else
+  (void)out;
+  return false;
+#endif
+}
+
+uint32_t AvailablePerfEvents() {
+  return g_available_events.load(std::memory_order_relaxed);
+}
+
+std::string PerfCountersError() {
+  std::lock_guard<std::mutex> lock(g_error_mutex);
+  return LastError();
+}
+
+void InitPerfCountersFromEnvironment() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    const char* value = getenv(kPerfEnv);
+    if (value == nullptr || value[0] == '\0' || strcmp(value, "0") == 0) {
+      return;
+    }
+    std::string error;
+    if (!SetPerfCountersEnabled(true, &error)) {
+      fprintf(stderr, "desktop_updater: %s\n", error.c_str());
+    }
+  });
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,67 @@
+#ifndef DESKTOP_UPDATER_PERF_COUNTERS_H_
+#define DESKTOP_UPDATER_PERF_COUNTERS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace desktop_updater {
+
+// When set to a non-empty value other than "0", hardware counters start
+// enabled, see InitPerfCountersFromEnvironment().
+constexpr char kPerfEnv[] = "DESKTOP_UPDATER_PERF";
+
+// Counted events. Names are listed in PerfEventName().
+enum class PerfEvent {
+  kCycles,
+  kInstructions,
+  kCacheMisses,
+  kPageFaults,
+  kCount,
+};
+
+constexpr size_t kPerfEventCount = static_cast<size_t>(PerfEvent::kCount);
+
+// camelCase names, as reported to Dart.
+const char* PerfEventName(PerfEvent event);
+
+// Event totals of one thread, user space only.
+using PerfSample = std::array<uint64_t, kPerfEventCount>;
+
+namespace internal {
+extern std::atomic<bool> g_perf_enabled;
+}  // namespace internal
+
+inline bool PerfCountersEnabled() {
+  return internal::g_perf_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Turns per-thread counting on or off.
+ *
+ * Each thread opens its perf_event_open group the first time it is read.
+ * Events the kernel refuses (perf_event_paranoid, no PMU in a VM, seccomp)
+ * read as zero; the rest keep working. Enabling fails, and leaves counting
+ * off, only if not a single event could be opened on the calling thread.
+ */
+bool SetPerfCountersEnabled(bool enabled, std::string* error);
+
+// Reads the calling thread's counters, opening them on first use. Returns
+// false when counting is off or nothing could be opened.
+bool ReadThreadPerfCounters(PerfSample* out);
+
+// Bit i is set once PerfEvent i opened on some thread.
+uint32_t AvailablePerfEvents();
+
+// Why the last event that failed to open was refused, or empty.
+std::string PerfCountersError();
+
+// Enables counting if $DESKTOP_UPDATER_PERF is set. Safe to call more than
+// once.
+void InitPerfCountersFromEnvironment();
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_PERF_COUNTERS_H_
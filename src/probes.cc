@@ -0,0 +1,23 @@
+#include "probes.h"
+
+#ifdef DESKTOP_UPDATER_HAVE_USDT
+
+// Semaphores of the probes in probes.h. The tracer finds them through the
+// probe notes and increments them while attached; they must live in the
+// ".probes" section.
+#define DESKTOP_UPDATER_DEFINE_PROBE(name)                      \
+  volatile unsigned short DESKTOP_UPDATER_PROBE_SEMAPHORE(name) \
+      __attribute__((section(".probes"), used)) = 0
+
+extern "C" {
+DESKTOP_UPDATER_DEFINE_PROBE(hash_start);
+DESKTOP_UPDATER_DEFINE_PROBE(hash_done);
+DESKTOP_UPDATER_DEFINE_PROBE(download_chunk);
+DESKTOP_UPDATER_DEFINE_PROBE(download_done);
+DESKTOP_UPDATER_DEFINE_PROBE(stage_file);
+DESKTOP_UPDATER_DEFINE_PROBE(stage_done);
+DESKTOP_UPDATER_DEFINE_PROBE(apply_done);
+DESKTOP_UPDATER_DEFINE_PROBE(restart);
+}
+
+#endif  // DESKTOP_UPDATER_HAVE_USDT
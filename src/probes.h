@@ -0,0 +1,87 @@
+#ifndef DESKTOP_UPDATER_PROBES_H_
+#define DESKTOP_UPDATER_PROBES_H_
+
+// USDT (statically defined tracing) probes of provider "desktop_updater",
+// for bpftrace, perf and SystemTap on shipped binaries. See
+// tools/bpftrace/ for example scripts.
+//
+// Probes, with arguments in order:
+//   hash_start     path
+//   hash_done      path, bytes, latency_ns
+//   download_chunk path, offset, bytes
+//   download_done  path, bytes, latency_ns
+//   stage_file     path, bytes
+//   stage_done     staging_dir, files, latency_ns
+//   apply_done     app_dir, files, latency_ns, result (ApplyResult)
+//   restart        phase, pid
+//
+// An unattached probe is a single nop. Every probe has a semaphore that
+// the tracer raises while attached; arguments that cost something to
+// compute, such as latencies, are only computed when
+// DESKTOP_UPDATER_PROBE_ENABLED() says so. Without <sys/sdt.h> (from
+// systemtap-sdt-dev) or off Linux the probes compile to nothing.
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define DESKTOP_UPDATER_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef DESKTOP_UPDATER_HAVE_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define DESKTOP_UPDATER_PROBE_SEMAPHORE(name) desktop_updater_##name##_semaphore
+
+#define DESKTOP_UPDATER_DECLARE_PROBE(name) \
+  extern "C" volatile unsigned short DESKTOP_UPDATER_PROBE_SEMAPHORE(name)
+
+#define DESKTOP_UPDATER_PROBE_ENABLED(name) \
+  __builtin_expect(DESKTOP_UPDATER_PROBE_SEMAPHORE(name) != 0, 0)
+
+#define DESKTOP_UPDATER_PROBE1(name, a) STAP_PROBE1(desktop_updater, name, a)
+#define DESKTOP_UPDATER_PROBE2(name, a, b) \
+  STAP_PROBE2(desktop_updater, name, a, b)
+#define DESKTOP_UPDATER_PROBE3(name, a, b, c) \
+  STAP_PROBE3(desktop_updater, name, a, b, c)
+#define DESKTOP_UPDATER_PROBE4(name, a, b, c, d) \
+  STAP_PROBE4(desktop_updater, name, a, b, c, d)
+
+DESKTOP_UPDATER_DECLARE_PROBE(hash_start);
+DESKTOP_UPDATER_DECLARE_PROBE(hash_done);
+DESKTOP_UPDATER_DECLARE_PROBE(download_chunk);
+DESKTOP_UPDATER_DECLARE_PROBE(download_done);
+DESKTOP_UPDATER_DECLARE_PROBE(stage_file);
+DESKTOP_UPDATER_DECLARE_PROBE(stage_done);
+DESKTOP_UPDATER_DECLARE_PROBE(apply_done);
+DESKTOP_UPDATER_DECLARE_PROBE(restart);
+
+#else
+
+// Arguments are not evaluated, only kept "used" for the compiler.
+#define DESKTOP_UPDATER_PROBE_ENABLED(name) false
+#define DESKTOP_UPDATER_PROBE1(name, a) ((void)sizeof(a))
+#define DESKTOP_UPDATER_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#define DESKTOP_UPDATER_PROBE3(name, a, b, c) \
+  ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c))
+#define DESKTOP_UPDATER_PROBE4(name, a, b, c, d) \
+  ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c), (void)sizeof(d))
+
+#endif  // DESKTOP_UPDATER_HAVE_USDT
+
+namespace desktop_updater {
+
+// Clock for probe latencies; only read while a probe is attached.
+inline int64_t ProbeNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_PROBES_H_
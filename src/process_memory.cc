@@ -0,0 +1,70 @@
+#include "process_memory.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace desktop_updater {
+
+#ifdef __linux__
+
+namespace {
+
+// Value of a "Name:   123 kB" line of smaps_rollup, in bytes.
+bool ParseKilobytes(const char* line, const char* name, uint64_t* out) {
+  const size_t length = strlen(name);
+  if (strncmp(line, name, length) != 0) {
+    return false;
+  }
+  *out = strtoull(line + length, nullptr, 10) * 1024;
+  return true;
+}
+
+}  // namespace
+
+bool SampleProcessMemory(ProcessMemory* out) {
+  *out = ProcessMemory();
+  if (FILE* file = fopen("/proc/self/smaps_rollup", "r")) {
+    char line[256];
+    bool have_rss = false;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+      if (ParseKilobytes(line, "Rss:", &out->rss_bytes)) {
+        have_rss = true;
+      } else {
+        ParseKilobytes(line, "Pss:", &out->pss_bytes);
+      }
+    }
+    fclose(file);
+    if (have_rss) {
+      return true;
+    }
+  }
+  FILE* file = fopen("/proc/self/statm", "r");
+  if (file == nullptr) {
+    return false;
+  }
+  unsigned long long size = 0;
+  unsigned long long resident = 0;
+  const bool parsed = fscanf(file, "%llu %llu", &size, &resident) == 2;
+  fclose(file);
+  if (!parsed) {
+    return false;
+  }
+  out->rss_bytes = resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  return true;
+}
+
+#else
+
+bool SampleProcessMemory(ProcessMemory* out) {
+  *out = ProcessMemory();
+  return false;
+}
+
+#endif  // __linux__
+
+}  // namespace desktop_updater
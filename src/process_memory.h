@@ -0,0 +1,28 @@
+#ifndef DESKTOP_UPDATER_PROCESS_MEMORY_H_
+#define DESKTOP_UPDATER_PROCESS_MEMORY_H_
+
+#include <cstdint>
+
+namespace desktop_updater {
+
+struct ProcessMemory {
+  // Resident set size.
+  uint64_t rss_bytes = 0;
+  // Proportional set size: shared pages divided among the processes that
+  // map them. 0 when the kernel does not report it.
+  uint64_t pss_bytes = 0;
+};
+
+/**
+ * @brief Reads the memory use of the calling process from
+ *        /proc/self/smaps_rollup, or /proc/self/statm (RSS only) on kernels
+ *        before 4.14.
+ *
+ * Takes tens of microseconds for a typical app, so it is sampled at phase
+ * boundaries rather than per file. Returns false off Linux.
+ */
+bool SampleProcessMemory(ProcessMemory* out);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_PROCESS_MEMORY_H_
@@ -0,0 +1,136 @@
+#include "progress_tracker.h"
+
+#include <cmath>
+
+namespace desktop_updater {
+
+void ProgressTracker::Reset(uint64_t total_bytes, uint32_t total_files) {
+  received_bytes_.store(0, std::memory_order_relaxed);
+  total_bytes_.store(total_bytes, std::memory_order_relaxed);
+  completed_files_.store(0, std::memory_order_relaxed);
+  total_files_.store(total_files, std::memory_order_relaxed);
+  current_item_.store(-1, std::memory_order_relaxed);
+  done_.store(false, std::memory_order_release);
+  has_sample_ = false;
+  last_bytes_ = 0;
+  rate_ = 0;
+}
+
+ProgressSnapshot ProgressTracker::Sample(
+    std::chrono::steady_clock::time_point now) {
+  ProgressSnapshot snapshot;
+  snapshot.done = done_.load(std::memory_order_acquire);
+  snapshot.received_bytes = received_bytes_.load(std::memory_order_relaxed);
+  snapshot.total_bytes = total_bytes_.load(std::memory_order_relaxed);
+  snapshot.completed_files = completed_files_.load(std::memory_order_relaxed);
+  snapshot.total_files = total_files_.load(std::memory_order_relaxed);
+  snapshot.current_item = current_item_.load(std::memory_order_relaxed);
+
+  if (!has_sample_) {
+    has_sample_ = true;
+  } else {
+    const double elapsed =
+        std::chrono::duration<double>(now - last_time_).count();
+    if (elapsed > 0) {
+      // Retries can roll the counter back; treat that as no progress.
+      const uint64_t delta = snapshot.received_bytes > last_bytes_
+                                 ? snapshot.received_bytes - last_bytes_
+                                 : 0;
+      const double instant = static_cast<double>(delta) / elapsed;
+      // Time-based smoothing keeps the estimate independent of the rate at
+      // which Sample() happens to be called.
+      const double alpha =
+          1.0 - std::exp(-elapsed / kRateTimeConstantSeconds);
+      rate_ = rate_ == 0 ? instant : rate_ + alpha * (instant - rate_);
+    }
+  }
+  last_bytes_ = snapshot.received_bytes;
+  last_time_ = now;
+
+  snapshot.bytes_per_second = rate_;
+  if (snapshot.received_bytes >= snapshot.total_bytes) {
+    snapshot.eta_seconds = 0;
+  } else if (rate_ > 0) {
+    snapshot.eta_seconds =
+        static_cast<double>(snapshot.total_bytes - snapshot.received_bytes) /
+        rate_;
+  }
+  return snapshot;
+}
+
+ProgressEmitter::ProgressEmitter(ProgressTracker* tracker,
+                                 double hz,
+                                 Callback callback)
+    : tracker_(tracker), callback_(std::move(callback)) {
+  if (!(hz > 0)) {
+    hz = kDefaultHz;
+  }
+  interval_ = std::chrono::nanoseconds(static_cast<int64_t>(1e9 / hz));
+}
+
+ProgressEmitter::~ProgressEmitter() {
+  // Only joins; the final snapshot is reserved for an explicit Stop() so the
+  // callback never runs while the owner is being torn down.
+  Join();
+}
+
+void ProgressEmitter::Start() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (thread_.joinable() || stopping_) {
+    return;
+  }
+  thread_ = std::thread(&ProgressEmitter::Run, this);
+}
+
+void ProgressEmitter::Stop() {
+  if (Join()) {
+    Emit(true);
+  }
+}
+
+bool ProgressEmitter::Join() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return false;
+    }
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  return true;
+}
+
+void ProgressEmitter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (wake_.wait_for(lock, interval_, [this] { return stopping_; })) {
+      break;
+    }
+    lock.unlock();
+    Emit(false);
+    lock.lock();
+  }
+}
+
+void ProgressEmitter::Emit(bool force) {
+  const ProgressSnapshot snapshot =
+      tracker_->Sample(std::chrono::steady_clock::now());
+  const bool changed = !has_emitted_ ||
+                       snapshot.received_bytes != last_.received_bytes ||
+                       snapshot.completed_files != last_.completed_files ||
+                       snapshot.current_item != last_.current_item ||
+                       snapshot.done != last_.done;
+  if (!force && !changed) {
+    return;
+  }
+  has_emitted_ = true;
+  last_ = snapshot;
+  if (callback_) {
+    callback_(snapshot);
+  }
+}
+
+}  // namespace desktop_updater
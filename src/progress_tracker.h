@@ -0,0 +1,136 @@
+#ifndef DESKTOP_UPDATER_PROGRESS_TRACKER_H_
+#define DESKTOP_UPDATER_PROGRESS_TRACKER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace desktop_updater {
+
+/**
+ * @brief Point-in-time view of an update transfer.
+ */
+struct ProgressSnapshot {
+  uint64_t received_bytes = 0;
+  uint64_t total_bytes = 0;
+  uint32_t completed_files = 0;
+  uint32_t total_files = 0;
+  // Index of the most recently started item, or -1 before the first one.
+  int64_t current_item = -1;
+  // Exponentially weighted moving average of the transfer rate.
+  double bytes_per_second = 0;
+  // Estimated seconds until completion, or -1 while the rate is unknown.
+  double eta_seconds = -1;
+  bool done = false;
+};
+
+/**
+ * @brief Aggregates progress reported by concurrent download workers.
+ *
+ * Workers only touch relaxed atomic counters, so reporting a chunk costs a
+ * single fetch_add. Rate and ETA are derived lazily by Sample(), which must
+ * only be called from one thread (normally the ProgressEmitter).
+ */
+class ProgressTracker {
+ public:
+  // Time constant of the throughput EWMA.
+  static constexpr double kRateTimeConstantSeconds = 2.0;
+
+  ProgressTracker() = default;
+
+  ProgressTracker(const ProgressTracker&) = delete;
+  ProgressTracker& operator=(const ProgressTracker&) = delete;
+
+  // Clears all counters and sets the expected totals for a new transfer.
+  void Reset(uint64_t total_bytes, uint32_t total_files);
+
+  void AddBytes(uint64_t bytes) {
+    received_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  // Rolls back bytes of a partially received file before it is retried.
+  void RemoveBytes(uint64_t bytes) {
+    received_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  void StartItem(int64_t index) {
+    current_item_.store(index, std::memory_order_relaxed);
+  }
+
+  void CompleteFile() {
+    completed_files_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void MarkDone() { done_.store(true, std::memory_order_release); }
+
+  bool IsDone() const { return done_.load(std::memory_order_acquire); }
+
+  // Reads the counters and updates the rate estimate as of |now|.
+  ProgressSnapshot Sample(std::chrono::steady_clock::time_point now);
+
+ private:
+  std::atomic<uint64_t> received_bytes_{0};
+  std::atomic<uint64_t> total_bytes_{0};
+  std::atomic<uint32_t> completed_files_{0};
+  std::atomic<uint32_t> total_files_{0};
+  std::atomic<int64_t> current_item_{-1};
+  std::atomic<bool> done_{false};
+
+  // Sampler-only state.
+  bool has_sample_ = false;
+  uint64_t last_bytes_ = 0;
+  std::chrono::steady_clock::time_point last_time_;
+  double rate_ = 0;
+};
+
+/**
+ * @brief Publishes coalesced ProgressTracker snapshots at a fixed rate.
+ *
+ * A background thread samples the tracker every 1/hz seconds and invokes the
+ * callback only when something changed since the previous emission, so the
+ * receiver sees at most |hz| events per second regardless of how many chunks
+ * the workers process. Stop() always delivers one final snapshot.
+ */
+class ProgressEmitter {
+ public:
+  using Callback = std::function<void(const ProgressSnapshot&)>;
+
+  static constexpr double kDefaultHz = 10.0;
+
+  ProgressEmitter(ProgressTracker* tracker, double hz, Callback callback);
+  ~ProgressEmitter();
+
+  ProgressEmitter(const ProgressEmitter&) = delete;
+  ProgressEmitter& operator=(const ProgressEmitter&) = delete;
+
+  void Start();
+
+  // Stops the sampling thread and emits the final snapshot. Idempotent.
+  void Stop();
+
+ private:
+  void Run();
+  void Emit(bool force);
+  // Stops the thread; returns false if it had already been stopped.
+  bool Join();
+
+  ProgressTracker* tracker_;
+  std::chrono::nanoseconds interval_;
+  Callback callback_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::thread thread_;
+
+  bool has_emitted_ = false;
+  ProgressSnapshot last_;
+};
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_PROGRESS_TRACKER_H_
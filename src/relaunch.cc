@@ -0,0 +1,130 @@
+#include "relaunch.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <spawn.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+#include "file_util.h"
+#include "handoff.h"
+#include "probes.h"
+
+namespace desktop_updater {
+
+void RecordRestartPhase(const char* phase) {
+#ifndef _WIN32
+  DESKTOP_UPDATER_PROBE2(restart, phase, static_cast<int>(getpid()));
+#endif
+  const char* path = getenv(kRestartLogEnv);
+  if (path == nullptr || path[0] == '\0') {
+    return;
+  }
+  FILE* file = OpenFile(path, "a");
+  if (file == nullptr) {
+    return;
+  }
+#ifndef _WIN32
+  const long pid = static_cast<long>(getpid());
+#else
+  const long pid = 0;
+#endif
+  fprintf(file, "%s %lld %ld\n", phase,
+          static_cast<long long>(MonotonicMicros()), pid);
+  fclose(file);
+}
+
+std::vector<std::string> ReadSelfArguments(const std::string& executable_path) {
+  std::vector<std::string> args;
+#ifdef __linux__
+  std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+  std::string arg;
+  while (std::getline(cmdline, arg, '\0')) {
+    args.push_back(arg);
+  }
+#endif
+  if (args.empty()) {
+    args.push_back(executable_path);
+  }
+  return args;
+}
+
+#ifndef _WIN32
+
+namespace {
+
+// Returns a null-terminated array pointing into |values|.
+std::vector<char*> ToCStrings(std::vector<std::string>& values) {
+  std::vector<char*> pointers;
+  pointers.reserve(values.size() + 1);
+  for (std::string& value : values) {
+    pointers.push_back(&value[0]);
+  }
+  pointers.push_back(nullptr);
+  return pointers;
+}
+
+}  // namespace
+
+bool ExecSelf(const std::string& executable_path, std::string* error) {
+  std::vector<std::string> args = ReadSelfArguments(executable_path);
+  std::vector<char*> argv = ToCStrings(args);
+  RecordRestartPhase("exec");
+  execv(executable_path.c_str(), argv.data());
+  *error = "Cannot start " + executable_path + ": " + strerror(errno);
+  return false;
+}
+
+bool SpawnSelf(const std::string& executable_path,
+               const std::vector<std::string>& extra_env,
+               const std::string& drop_prefix,
+               int* pid,
+               std::string* error) {
+  std::vector<std::string> args = ReadSelfArguments(executable_path);
+  std::vector<std::string> env;
+  for (char** entry = environ; *entry != nullptr; entry++) {
+    if (drop_prefix.empty() ||
+        strncmp(*entry, drop_prefix.c_str(), drop_prefix.size()) != 0) {
+      env.push_back(*entry);
+    }
+  }
+  env.insert(env.end(), extra_env.begin(), extra_env.end());
+  std::vector<char*> argv = ToCStrings(args);
+  std::vector<char*> envp = ToCStrings(env);
+  pid_t child = -1;
+  const int result = posix_spawn(&child, executable_path.c_str(), nullptr,
+                                 nullptr, argv.data(), envp.data());
+  if (result != 0) {
+    *error = "Cannot start " + executable_path + ": " + strerror(result);
+    return false;
+  }
+  *pid = static_cast<int>(child);
+  return true;
+}
+
+#else
+
+bool ExecSelf(const std::string&, std::string* error) {
+  *error = "Not supported on this platform";
+  return false;
+}
+
+bool SpawnSelf(const std::string&,
+               const std::vector<std::string>&,
+               const std::string&,
+               int*,
+               std::string* error) {
+  *error = "Not supported on this platform";
+  return false;
+}
+
+#endif  // _WIN32
+
+}  // namespace desktop_updater
@@ -0,0 +1,50 @@
+#ifndef DESKTOP_UPDATER_RELAUNCH_H_
+#define DESKTOP_UPDATER_RELAUNCH_H_
+
+#include <string>
+#include <vector>
+
+namespace desktop_updater {
+
+// When set, restart phases are appended to this file, see
+// RecordRestartPhase().
+constexpr char kRestartLogEnv[] = "DESKTOP_UPDATER_RESTART_LOG";
+
+/**
+ * @brief Appends "<phase> <MonotonicMicros()> <pid>" to the file named by
+ *        $DESKTOP_UPDATER_RESTART_LOG, if set.
+ *
+ * Marks the steps of a restart (requested, applied, exec, main) so their
+ * latency can be measured across the exec boundary. Also fires the
+ * "restart" USDT probe, with or without the variable.
+ */
+void RecordRestartPhase(const char* phase);
+
+// Returns the arguments the process was started with, or just
+// |executable_path| if they cannot be read.
+std::vector<std::string> ReadSelfArguments(const std::string& executable_path);
+
+/**
+ * @brief Replaces the process with a fresh start of |executable_path|,
+ *        keeping the original arguments.
+ *
+ * Only returns on failure. Not available on Windows.
+ */
+bool ExecSelf(const std::string& executable_path, std::string* error);
+
+/**
+ * @brief Starts |executable_path| with the original arguments next to the
+ *        running process.
+ *
+ * The environment is inherited, minus variables starting with
+ * |drop_prefix| (if non-empty), plus |extra_env| ("NAME=value").
+ */
+bool SpawnSelf(const std::string& executable_path,
+               const std::vector<std::string>& extra_env,
+               const std::string& drop_prefix,
+               int* pid,
+               std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_RELAUNCH_H_
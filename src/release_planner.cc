@@ -0,0 +1,188 @@
+#include "release_planner.h"
+
+#include <limits>
+#include <map>
+#include <unordered_map>
+
+#include "file_util.h"
+#include "http_fetcher.h"
+
+namespace desktop_updater {
+
+namespace {
+
+using PathIndex = std::unordered_map<std::string, const FileEntry*>;
+
+PathIndex IndexByPath(const Manifest& manifest) {
+  PathIndex index;
+  index.reserve(manifest.size());
+  for (const FileEntry& entry : manifest) {
+    index.emplace(NormalizeRelativePath(entry.path), &entry);
+  }
+  return index;
+}
+
+// The published object when the packer wrote one, so every release listing
+// the same contents downloads them from the same URL.
+std::string FullFileUrl(const std::string& release_url,
+                        const FileEntry& entry) {
+  return JoinUrl(release_url, entry.object.empty() ? entry.path : entry.object);
+}
+
+struct Edge {
+  // Patch edges start at |from|; full downloads start anywhere.
+  Digest from = {};
+  PlanStep step;
+};
+
+struct Node {
+  uint64_t cost = std::numeric_limits<uint64_t>::max();
+  // Index into the edge list, or -1 for the installed file.
+  int via = -1;
+  bool done = false;
+};
+
+// Shortest path over the file's known digests. Files only have a handful of
+// versions, so a linear scan for the next node is plenty.
+FilePlan PlanFile(const FileEntry& target,
+                  const FileEntry* installed,
+                  const std::vector<Edge>& edges,
+                  const PlannerOptions& options) {
+  std::map<Digest, Node> nodes;
+  if (installed != nullptr) {
+    nodes[installed->digest].cost = 0;
+  }
+  for (size_t i = 0; i < edges.size(); i++) {
+    const Edge& edge = edges[i];
+    if (edge.step.kind != PlanStep::Kind::kFull) {
+      continue;
+    }
+    Node& node = nodes[edge.step.result];
+    const uint64_t cost = edge.step.length + options.request_overhead_bytes;
+    if (cost < node.cost) {
+      node.cost = cost;
+      node.via = static_cast<int>(i);
+    }
+  }
+
+  while (true) {
+    Node* current = nullptr;
+    const Digest* current_digest = nullptr;
+    for (auto& entry : nodes) {
+      Node& node = entry.second;
+      if (!node.done && node.cost != std::numeric_limits<uint64_t>::max() &&
+          (current == nullptr || node.cost < current->cost)) {
+        current = &node;
+        current_digest = &entry.first;
+      }
+    }
+    if (current == nullptr || *current_digest == target.digest) {
+      break;
+    }
+    current->done = true;
+    for (size_t i = 0; i < edges.size(); i++) {
+      const Edge& edge = edges[i];
+      if (edge.step.kind != PlanStep::Kind::kPatch ||
+          edge.from != *current_digest) {
+        continue;
+      }
+      Node& next = nodes[edge.step.result];
+      const uint64_t cost =
+          current->cost + edge.step.length + options.request_overhead_bytes;
+      if (!next.done && cost < next.cost) {
+        next.cost = cost;
+        next.via = static_cast<int>(i);
+      }
+    }
+  }
+
+  FilePlan plan;
+  plan.path = target.path;
+  plan.length = target.length;
+  plan.digest = target.digest;
+
+  Digest digest = target.digest;
+  while (true) {
+    auto it = nodes.find(digest);
+    if (it == nodes.end() || it->second.via < 0) {
+      break;
+    }
+    const Edge& edge = edges[static_cast<size_t>(it->second.via)];
+    plan.steps.insert(plan.steps.begin(), edge.step);
+    if (edge.step.kind == PlanStep::Kind::kFull) {
+      break;
+    }
+    digest = edge.from;
+  }
+  for (const PlanStep& step : plan.steps) {
+    plan.bytes += step.length;
+  }
+  return plan;
+}
+
+}  // namespace
+
+UpdatePlan PlanUpdate(const Manifest& installed,
+                      const std::vector<ReleaseManifest>& releases,
+                      const Manifest& changed,
+                      const PlannerOptions& options) {
+  UpdatePlan plan;
+  if (releases.empty()) {
+    return plan;
+  }
+
+  const PathIndex installed_index = IndexByPath(installed);
+  std::vector<PathIndex> release_indexes;
+  release_indexes.reserve(releases.size());
+  for (const ReleaseManifest& release : releases) {
+    release_indexes.push_back(IndexByPath(release.manifest));
+  }
+
+  std::vector<Edge> edges;
+  for (const FileEntry& target : changed) {
+    const std::string key = NormalizeRelativePath(target.path);
+    edges.clear();
+    for (size_t r = 0; r < releases.size(); r++) {
+      auto it = release_indexes[r].find(key);
+      if (it == release_indexes[r].end()) {
+        continue;
+      }
+      const FileEntry& entry = *it->second;
+      Edge full;
+      full.step.kind = PlanStep::Kind::kFull;
+      full.step.url = FullFileUrl(releases[r].url, entry);
+      full.step.length = entry.length;
+      full.step.result = entry.digest;
+      edges.push_back(full);
+      for (const PatchRef& patch : entry.patches) {
+        Edge edge;
+        edge.from = patch.from;
+        edge.step.kind = PlanStep::Kind::kPatch;
+        edge.step.url = JoinUrl(releases[r].url, patch.path);
+        edge.step.length = patch.length;
+        edge.step.result = entry.digest;
+        edges.push_back(edge);
+      }
+    }
+
+    auto local = installed_index.find(key);
+    FilePlan file = PlanFile(
+        target, local == installed_index.end() ? nullptr : local->second,
+        edges, options);
+    if (file.steps.empty()) {
+      // Not listed in any release manifest; fetch it from the target.
+      PlanStep step;
+      step.url = FullFileUrl(releases.back().url, target);
+      step.length = target.length;
+      step.result = target.digest;
+      file.steps.push_back(step);
+      file.bytes = step.length;
+    }
+    plan.expected_bytes += file.bytes;
+    plan.full_bytes += target.length;
+    plan.files.push_back(std::move(file));
+  }
+  return plan;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,86 @@
+#ifndef DESKTOP_UPDATER_RELEASE_PLANNER_H_
+#define DESKTOP_UPDATER_RELEASE_PLANNER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+
+/**
+ * @brief hashes.json of one published release.
+ */
+struct ReleaseManifest {
+  int64_t short_version = 0;
+  // Release folder the manifest paths are relative to.
+  std::string url;
+  Manifest manifest;
+};
+
+/**
+ * @brief One transfer of a file plan.
+ */
+struct PlanStep {
+  enum class Kind {
+    // Download the file of some release in full.
+    kFull,
+    // Download a delta and apply it to the previous step's result, or to
+    // the installed file for the first step.
+    kPatch,
+  };
+
+  Kind kind = Kind::kFull;
+  std::string url;
+  // Bytes transferred by this step.
+  uint64_t length = 0;
+  // Digest of the file after this step.
+  Digest result = {};
+};
+
+struct FilePlan {
+  // Path as written in the target manifest.
+  std::string path;
+  // Final contents.
+  uint64_t length = 0;
+  Digest digest = {};
+  std::vector<PlanStep> steps;
+  // Sum of the steps' lengths.
+  uint64_t bytes = 0;
+};
+
+struct UpdatePlan {
+  std::vector<FilePlan> files;
+  // Bytes the plan transfers.
+  uint64_t expected_bytes = 0;
+  // Bytes a plain full-file download of the same files would transfer.
+  uint64_t full_bytes = 0;
+};
+
+struct PlannerOptions {
+  // Fixed cost added per step, so a chain only wins when it saves more
+  // than the extra round trips cost.
+  uint64_t request_overhead_bytes = 16 * 1024;
+};
+
+/**
+ * @brief Picks the cheapest way to bring every |changed| file to its
+ *        target digest.
+ *
+ * For each file the planner searches the digests the file had across
+ * |releases|: full downloads of any release's copy, and the published
+ * patches between them, starting from the |installed| receipt. The result
+ * may mix full downloads and patch chains per file.
+ *
+ * @param releases Releases newer than the installed build, oldest first;
+ *                 the last one is the target.
+ */
+UpdatePlan PlanUpdate(const Manifest& installed,
+                      const std::vector<ReleaseManifest>& releases,
+                      const Manifest& changed,
+                      const PlannerOptions& options = PlannerOptions());
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_RELEASE_PLANNER_H_
@@ -0,0 +1,135 @@
+#include "startup_warmup.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "file_util.h"
+#include "trace.h"
+
+namespace desktop_updater {
+
+namespace {
+
+// Read by the engine in this order on every launch.
+const char* const kStartupFiles[] = {
+    "lib/libflutter_linux_gtk.so",
+    "data/icudtl.dat",
+    "lib/libapp.so",
+};
+
+bool EndsWith(const std::string& text, const std::string& suffix) {
+  return text.size() >= suffix.size() &&
+         text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+std::vector<std::string> StartupPathFiles(
+    const std::vector<std::string>& replaced) {
+  std::vector<std::string> files(std::begin(kStartupFiles),
+                                 std::end(kStartupFiles));
+  for (const std::string& path : replaced) {
+    const std::string normalized = NormalizeRelativePath(path);
+    if (normalized.compare(0, 4, "lib/") == 0 && EndsWith(normalized, ".so") &&
+        std::find(files.begin(), files.end(), normalized) == files.end()) {
+      files.push_back(normalized);
+    }
+  }
+  return files;
+}
+
+#ifdef __linux__
+
+bool ResidentBytes(const std::string& path,
+                   uint64_t* resident,
+                   uint64_t* length) {
+  *resident = 0;
+  *length = 0;
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  *length = static_cast<uint64_t>(st.st_size);
+  if (st.st_size == 0) {
+    close(fd);
+    return true;
+  }
+  void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                   MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const size_t pages = (static_cast<size_t>(st.st_size) + page - 1) / page;
+  std::vector<unsigned char> vec(pages);
+  const bool ok = mincore(map, static_cast<size_t>(st.st_size), vec.data()) == 0;
+  munmap(map, static_cast<size_t>(st.st_size));
+  if (!ok) {
+    return false;
+  }
+  uint64_t count = 0;
+  for (const unsigned char v : vec) {
+    count += v & 1;
+  }
+  *resident = std::min<uint64_t>(count * page, *length);
+  return true;
+}
+
+bool WarmFiles(const std::string& app_dir,
+               const std::vector<std::string>& paths,
+               WarmupStats* stats) {
+  TraceSpan span("warmup");
+  *stats = WarmupStats();
+  for (const std::string& path : paths) {
+    const std::string full_path = JoinPath(app_dir, path);
+    uint64_t resident = 0;
+    uint64_t length = 0;
+    if (!ResidentBytes(full_path, &resident, &length)) {
+      continue;
+    }
+    const int fd = open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+    stats->files++;
+    stats->bytes += length;
+    stats->resident_before += resident;
+    if (ResidentBytes(full_path, &resident, &length)) {
+      stats->resident_after += resident;
+    }
+  }
+  return true;
+}
+
+#else
+
+bool ResidentBytes(const std::string&, uint64_t* resident, uint64_t* length) {
+  *resident = 0;
+  *length = 0;
+  return false;
+}
+
+bool WarmFiles(const std::string&,
+               const std::vector<std::string>&,
+               WarmupStats* stats) {
+  *stats = WarmupStats();
+  return false;
+}
+
+#endif  // __linux__
+
+}  // namespace desktop_updater
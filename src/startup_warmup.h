@@ -0,0 +1,49 @@
+#ifndef DESKTOP_UPDATER_STARTUP_WARMUP_H_
+#define DESKTOP_UPDATER_STARTUP_WARMUP_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace desktop_updater {
+
+/**
+ * @brief Page cache state of the files warmed by WarmFiles().
+ */
+struct WarmupStats {
+  size_t files = 0;
+  uint64_t bytes = 0;
+  // Bytes already in the page cache before and right after the hints were
+  // issued. Readahead continues in the background, so |resident_after| is
+  // a lower bound.
+  uint64_t resident_before = 0;
+  uint64_t resident_after = 0;
+};
+
+/**
+ * @brief Lists the files a Flutter Linux bundle reads before its first
+ *        frame: the AOT snapshot, the engine and ICU data, plus any
+ *        replaced plugin library in lib/.
+ */
+std::vector<std::string> StartupPathFiles(
+    const std::vector<std::string>& replaced);
+
+/**
+ * @brief Asks the kernel to read |paths| below |app_dir| into the page
+ *        cache (posix_fadvise(WILLNEED)) without waiting for it.
+ *
+ * Missing files are skipped. A no-op returning false where the hint is not
+ * available.
+ */
+bool WarmFiles(const std::string& app_dir,
+               const std::vector<std::string>& paths,
+               WarmupStats* stats);
+
+// Returns how many bytes of |path| are in the page cache (mincore).
+bool ResidentBytes(const std::string& path,
+                   uint64_t* resident,
+                   uint64_t* length);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_STARTUP_WARMUP_H_
@@ -0,0 +1,242 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "file_util.h"
+#include "json.h"
+
+namespace desktop_updater {
+
+namespace internal {
+std::atomic<bool> g_trace_enabled{false};
+}  // namespace internal
+
+namespace {
+
+// Counter samples have a negative duration.
+struct TraceEvent {
+  const char* name;
+  const char* category;
+  int64_t start_ns;
+  int64_t duration_ns;
+  const char* arg_key;
+  int64_t arg_value;
+};
+
+// Written by its own thread only; the lock is contended only while the
+// trace is being dumped.
+struct TraceRing {
+  std::mutex mutex;
+  uint32_t tid = 0;
+  std::vector<TraceEvent> events;
+  size_t next = 0;
+  size_t count = 0;
+};
+
+struct TraceRegistry {
+  std::mutex mutex;
+  // Rings outlive their threads so short-lived workers still show up.
+  std::vector<std::shared_ptr<TraceRing>> rings;
+  uint32_t next_tid = 1;
+};
+
+TraceRegistry& Registry() {
+  // Never destroyed: spans may end during static destruction.
+  static TraceRegistry* registry = new TraceRegistry();
+  return *registry;
+}
+
+TraceRing& ThreadRing() {
+  thread_local std::shared_ptr<TraceRing> ring;
+  if (!ring) {
+    ring = std::make_shared<TraceRing>();
+    ring->events.resize(kTraceRingSize);
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    ring->tid = registry.next_tid++;
+    registry.rings.push_back(ring);
+  }
+  return *ring;
+}
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int ProcessId() {
+#ifdef _WIN32
+  return _getpid();
+#else
+  return static_cast<int>(getpid());
+#endif
+}
+
+std::vector<std::shared_ptr<TraceRing>> AllRings() {
+  TraceRegistry& registry = Registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return registry.rings;
+}
+
+// $DESKTOP_UPDATER_TRACE with "%p" replaced by the process id, so the
+// processes on either side of a restart can keep separate files.
+std::string EnvironmentTracePath() {
+  const char* value = getenv(kTraceEnv);
+  std::string path = value != nullptr ? value : "";
+  const size_t pid = path.find("%p");
+  if (pid != std::string::npos) {
+    path.replace(pid, 2, std::to_string(ProcessId()));
+  }
+  return path;
+}
+
+void AppendEvent(const TraceEvent& event) {
+  TraceRing& ring = ThreadRing();
+  std::lock_guard<std::mutex> lock(ring.mutex);
+  ring.events[ring.next] = event;
+  ring.next = (ring.next + 1) % ring.events.size();
+  if (ring.count < ring.events.size()) {
+    ring.count++;
+  }
+}
+
+void WriteTraceAtExit() {
+  FlushTraceToEnvironmentPath();
+}
+
+}  // namespace
+
+void SetTraceEnabled(bool enabled) {
+  internal::g_trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category)
+    : name_(name), category_(category) {
+  if (TraceEnabled()) {
+    start_ns_ = NowNanos();
+  }
+}
+
+TraceSpan::~TraceSpan() {
+  if (start_ns_ < 0) {
+    return;
+  }
+  AppendEvent({name_, category_, start_ns_, NowNanos() - start_ns_,
+               arg_key_, arg_value_});
+}
+
+void TraceCounter(const char* name, const char* key, int64_t value) {
+  if (TraceEnabled()) {
+    AppendEvent({name, "updater", NowNanos(), -1, key, value});
+  }
+}
+
+size_t TraceEventCount() {
+  size_t count = 0;
+  for (const std::shared_ptr<TraceRing>& ring : AllRings()) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    count += ring->count;
+  }
+  return count;
+}
+
+void ClearTrace() {
+  for (const std::shared_ptr<TraceRing>& ring : AllRings()) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    ring->next = 0;
+    ring->count = 0;
+  }
+}
+
+bool WriteTrace(const std::string& path, std::string* error) {
+  const int pid = ProcessId();
+  JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("traceEvents");
+  writer.BeginArray();
+  for (const std::shared_ptr<TraceRing>& ring : AllRings()) {
+    std::vector<TraceEvent> events;
+    {
+      std::lock_guard<std::mutex> lock(ring->mutex);
+      const size_t size = ring->events.size();
+      const size_t first = (ring->next + size - ring->count) % size;
+      for (size_t i = 0; i < ring->count; i++) {
+        events.push_back(ring->events[(first + i) % size]);
+      }
+    }
+    for (const TraceEvent& event : events) {
+      writer.BeginObject();
+      writer.Key("name");
+      writer.String(event.name);
+      writer.Key("cat");
+      writer.String(event.category);
+      writer.Key("ph");
+      writer.String(event.duration_ns < 0 ? "C" : "X");
+      writer.Key("ts");
+      writer.Double(static_cast<double>(event.start_ns) / 1000.0);
+      if (event.duration_ns >= 0) {
+        writer.Key("dur");
+        writer.Double(static_cast<double>(event.duration_ns) / 1000.0);
+      }
+      writer.Key("pid");
+      writer.Int(pid);
+      writer.Key("tid");
+      writer.Uint(ring->tid);
+      if (event.arg_key != nullptr) {
+        writer.Key("args");
+        writer.BeginObject();
+        writer.Key(event.arg_key);
+        writer.Int(event.arg_value);
+        writer.EndObject();
+      }
+      writer.EndObject();
+    }
+  }
+  writer.EndArray();
+  writer.Key("displayTimeUnit");
+  writer.String("ms");
+  writer.EndObject();
+
+  const std::string& json = writer.str();
+  return CreateParentDirectories(path, error) &&
+         WriteFileBytes(path, reinterpret_cast<const uint8_t*>(json.data()),
+                        json.size(), error);
+}
+
+void InitTraceFromEnvironment() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    const char* path = getenv(kTraceEnv);
+    if (path == nullptr || path[0] == '\0') {
+      return;
+    }
+    SetTraceEnabled(true);
+    atexit(WriteTraceAtExit);
+  });
+}
+
+void FlushTraceToEnvironmentPath() {
+  const std::string path = EnvironmentTracePath();
+  if (path.empty() || !TraceEnabled()) {
+    return;
+  }
+  std::string error;
+  if (!WriteTrace(path, &error)) {
+    fprintf(stderr, "desktop_updater: cannot write trace: %s\n",
+            error.c_str());
+  }
+}
+
+}  // namespace desktop_updater
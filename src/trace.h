@@ -0,0 +1,88 @@
+#ifndef DESKTOP_UPDATER_TRACE_H_
+#define DESKTOP_UPDATER_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace desktop_updater {
+
+// When set to a file path, tracing starts enabled and the trace is written
+// there at exit and before the app restarts itself, see
+// InitTraceFromEnvironment(). "%p" in the path is replaced by the process
+// id.
+constexpr char kTraceEnv[] = "DESKTOP_UPDATER_TRACE";
+
+// Events kept per thread; older ones are overwritten.
+constexpr size_t kTraceRingSize = 8192;
+
+namespace internal {
+extern std::atomic<bool> g_trace_enabled;
+}  // namespace internal
+
+inline bool TraceEnabled() {
+  return internal::g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+void SetTraceEnabled(bool enabled);
+
+/**
+ * @brief Records the lifetime of a scope as a Chrome trace "complete"
+ *        event on the calling thread's ring buffer.
+ *
+ * Costs one relaxed atomic load when tracing is disabled. |name| and
+ * |category| must be string literals (or otherwise outlive the trace).
+ */
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name, const char* category = "updater");
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  // Attaches a numeric argument, shown in the trace viewer's details.
+  void SetArg(const char* key, int64_t value) {
+    arg_key_ = key;
+    arg_value_ = value;
+  }
+
+ private:
+  const char* name_;
+  const char* category_;
+  int64_t start_ns_ = -1;
+  const char* arg_key_ = nullptr;
+  int64_t arg_value_ = 0;
+};
+
+// Records a Chrome trace counter sample: series |key| of counter |name|
+// is |value| from now on. Does nothing while tracing is disabled. |name|
+// and |key| must outlive the trace, like span names.
+void TraceCounter(const char* name, const char* key, int64_t value);
+
+// Number of events currently held in all ring buffers.
+size_t TraceEventCount();
+
+// Drops all recorded events.
+void ClearTrace();
+
+/**
+ * @brief Writes the recorded events as Chrome trace JSON, loadable in
+ *        chrome://tracing and ui.perfetto.dev.
+ *
+ * Events stay recorded; call ClearTrace() to start over.
+ */
+bool WriteTrace(const std::string& path, std::string* error);
+
+// Enables tracing if $DESKTOP_UPDATER_TRACE is set and writes the trace
+// there at exit. Safe to call more than once.
+void InitTraceFromEnvironment();
+
+// Writes the trace to $DESKTOP_UPDATER_TRACE, if set. For paths that leave
+// the process without running exit handlers, such as exec().
+void FlushTraceToEnvironmentPath();
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_TRACE_H_
@@ -0,0 +1,402 @@
+#include "update_applier.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "file_hash.h"
+#include "file_util.h"
+#include "install_verifier.h"
+#include "metrics.h"
+#include "probes.h"
+#include "trace.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+namespace {
+
+constexpr char kJournalName[] = "journal";
+// Digests of the staged files keyed by inode, written next to the receipt
+// so the post-apply check does not read renamed files again.
+constexpr char kHashCachePath[] = ".desktop_updater/hash_cache";
+
+bool FlushToDisk(FILE* file) {
+  if (fflush(file) != 0) {
+    return false;
+  }
+#ifndef _WIN32
+  return fsync(fileno(file)) == 0;
+#else
+  return true;
+#endif
+}
+
+bool WriteFileAtomically(const std::string& path,
+                         const std::string& contents,
+                         std::string* error) {
+  if (!CreateParentDirectories(path, error)) {
+    return false;
+  }
+  const std::string temp_path = path + ".tmp";
+  FILE* file = OpenFile(temp_path, "wb");
+  if (file == nullptr) {
+    *error = "Cannot create " + temp_path;
+    return false;
+  }
+  const bool written =
+      fwrite(contents.data(), 1, contents.size(), file) == contents.size() &&
+      FlushToDisk(file);
+  fclose(file);
+  if (!written) {
+    *error = "Cannot write " + temp_path;
+    return false;
+  }
+  std::error_code ec;
+  fs::rename(PathFromUtf8(temp_path), PathFromUtf8(path), ec);
+  if (ec) {
+    *error = "Cannot rename " + temp_path + ": " + ec.message();
+    return false;
+  }
+  return true;
+}
+
+bool Exists(const std::string& path) {
+  std::error_code ec;
+  return fs::exists(fs::symlink_status(PathFromUtf8(path), ec));
+}
+
+bool Rename(const std::string& from, const std::string& to) {
+  std::error_code ec;
+  fs::rename(PathFromUtf8(from), PathFromUtf8(to), ec);
+  return !ec;
+}
+
+// Undoes the swaps listed in the journal, newest first. The journal lists
+// every path before the first swap starts, so each entry may be in any of
+// three states: untouched, target moved to the backup, or new file moved
+// in.
+bool RollBack(const std::string& app_dir,
+              const std::vector<std::string>& paths,
+              std::string* error) {
+  const std::string staging_dir = JoinPath(app_dir, kStagingDirName);
+  const std::string backup_dir = JoinPath(app_dir, kBackupDirName);
+  bool ok = true;
+  for (auto it = paths.rbegin(); it != paths.rend(); ++it) {
+    const std::string target = JoinPath(app_dir, *it);
+    const std::string staged = JoinPath(staging_dir, *it);
+    const std::string backup = JoinPath(backup_dir, *it);
+    std::string ignored;
+    if (!Exists(staged) && Exists(target)) {
+      if (!CreateParentDirectories(staged, &ignored) ||
+          !Rename(target, staged)) {
+        ok = false;
+        *error = "Cannot restore " + staged;
+        continue;
+      }
+    }
+    if (Exists(backup) && !Rename(backup, target)) {
+      ok = false;
+      *error = "Cannot restore " + target;
+    }
+  }
+  return ok;
+}
+
+bool ReadJournal(const std::string& path, std::vector<std::string>* out) {
+  std::vector<uint8_t> data;
+  std::string ignored;
+  if (!ReadFileBytes(path, &data, &ignored)) {
+    return false;
+  }
+  std::string line;
+  for (const uint8_t c : data) {
+    if (c == '\n') {
+      if (!line.empty()) {
+        out->push_back(line);
+      }
+      line.clear();
+    } else {
+      line.push_back(static_cast<char>(c));
+    }
+  }
+  // A truncated journal was never acted on: the swaps start only once the
+  // whole journal is on disk.
+  return true;
+}
+
+// Rolls back an apply that was interrupted by a crash or power loss. The
+// receipt is removed once every swap is done, so a journal without one only
+// needs cleaning up.
+bool RecoverInterruptedApply(const std::string& app_dir, std::string* error) {
+  const std::string backup_dir = JoinPath(app_dir, kBackupDirName);
+  const std::string journal = JoinPath(backup_dir, kJournalName);
+  std::vector<std::string> paths;
+  if (!ReadJournal(journal, &paths)) {
+    return true;
+  }
+  if (HasPendingUpdate(app_dir) && !RollBack(app_dir, paths, error)) {
+    return false;
+  }
+  std::error_code ec;
+  fs::remove_all(PathFromUtf8(backup_dir), ec);
+  return true;
+}
+
+}  // namespace
+
+bool VerifyAndStage(const std::string& staging_dir,
+                    const Manifest& files,
+                    unsigned threads,
+                    std::string* error) {
+  TraceSpan span("stage");
+  span.SetArg("files", static_cast<int64_t>(files.size()));
+  PhaseTimer timer(Phase::kStage);
+  const int64_t probe_start =
+      DESKTOP_UPDATER_PROBE_ENABLED(stage_done) ? ProbeNanos() : 0;
+  std::vector<ScannedFile> scanned;
+  scanned.reserve(files.size());
+  for (const FileEntry& entry : files) {
+    const std::string path = NormalizeRelativePath(entry.path);
+    if (!IsSafeRelativePath(path)) {
+      *error = "Unsafe path " + entry.path;
+      return false;
+    }
+    scanned.push_back(ScannedFile{path, entry.length});
+  }
+  Manifest hashed;
+  if (!HashFiles(staging_dir, scanned, threads, &hashed, error)) {
+    return false;
+  }
+  Manifest staged;
+  staged.reserve(files.size());
+  HashCache cache;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (hashed[i].length != files[i].length ||
+        hashed[i].digest != files[i].digest) {
+      *error = "Hash mismatch for " + scanned[i].path;
+      return false;
+    }
+    FileIdentity identity;
+    if (GetFileIdentity(JoinPath(staging_dir, scanned[i].path), &identity)) {
+      cache.Put(identity, hashed[i].digest);
+    }
+    DESKTOP_UPDATER_PROBE2(stage_file, scanned[i].path.c_str(),
+                           files[i].length);
+    FileEntry entry;
+    entry.path = scanned[i].path;
+    entry.length = files[i].length;
+    entry.digest = files[i].digest;
+    staged.push_back(std::move(entry));
+  }
+  // The receipt goes last: it is what marks the update as ready.
+  if (!WriteFileAtomically(JoinPath(staging_dir, kHashCachePath),
+                           cache.Serialize(), error) ||
+      !WriteFileAtomically(JoinPath(staging_dir, kStagedReceiptPath),
+                           SerializeManifest(staged), error)) {
+    return false;
+  }
+  AddCount(Counter::kFilesStaged, staged.size());
+  if (DESKTOP_UPDATER_PROBE_ENABLED(stage_done)) {
+    DESKTOP_UPDATER_PROBE3(stage_done, staging_dir.c_str(), staged.size(),
+                           ProbeNanos() - probe_start);
+  }
+  return true;
+}
+
+bool HasPendingUpdate(const std::string& app_dir) {
+  return Exists(
+      JoinPath(JoinPath(app_dir, kStagingDirName), kStagedReceiptPath));
+}
+
+namespace {
+
+ApplyResult ApplyStagedUpdate(const std::string& app_dir,
+                              const std::string& executable_path,
+                              std::vector<std::string>* replaced,
+                              std::string* error) {
+  replaced->clear();
+  if (!RecoverInterruptedApply(app_dir, error)) {
+    return ApplyResult::kFailed;
+  }
+
+  const std::string staging_dir = JoinPath(app_dir, kStagingDirName);
+  const std::string receipt = JoinPath(staging_dir, kStagedReceiptPath);
+  if (!Exists(receipt)) {
+    return ApplyResult::kNothingPending;
+  }
+  std::vector<uint8_t> data;
+  Manifest files;
+  if (!ReadFileBytes(receipt, &data, error) ||
+      !ParseManifest(reinterpret_cast<const char*>(data.data()), data.size(),
+                     &files, error)) {
+    return ApplyResult::kFailed;
+  }
+
+  // Everything must still be in place before the first rename, so a
+  // half-deleted staging folder is never applied.
+  std::vector<std::string> paths;
+  paths.reserve(files.size());
+  for (const FileEntry& entry : files) {
+    const std::string path = NormalizeRelativePath(entry.path);
+    if (!IsSafeRelativePath(path)) {
+      *error = "Unsafe path " + entry.path;
+      return ApplyResult::kFailed;
+    }
+    std::error_code ec;
+    const uintmax_t size =
+        fs::file_size(PathFromUtf8(JoinPath(staging_dir, path)), ec);
+    if (ec || size != entry.length) {
+      *error = "Staged file missing or truncated: " + path;
+      return ApplyResult::kFailed;
+    }
+    paths.push_back(path);
+  }
+
+  // Optional: without it every applied file is hashed again.
+  HashCache cache;
+  std::vector<uint8_t> cache_data;
+  std::string cache_error;
+  if (ReadFileBytes(JoinPath(staging_dir, kHashCachePath), &cache_data,
+                    &cache_error)) {
+    cache.Parse(std::string(cache_data.begin(), cache_data.end()),
+                &cache_error);
+  }
+
+  const std::string backup_dir = JoinPath(app_dir, kBackupDirName);
+  const std::string journal_path = JoinPath(backup_dir, kJournalName);
+  std::error_code stale_ec;
+  fs::remove_all(PathFromUtf8(backup_dir), stale_ec);
+  if (!CreateParentDirectories(journal_path, error)) {
+    return ApplyResult::kFailed;
+  }
+  FILE* journal = OpenFile(journal_path, "wb");
+  if (journal == nullptr) {
+    *error = "Cannot create " + journal_path;
+    return ApplyResult::kFailed;
+  }
+
+  // One flush for the whole journal: rolling back a path that was never
+  // swapped is a no-op.
+  std::string lines;
+  for (const std::string& path : paths) {
+    lines += path + "\n";
+  }
+  bool ok = fwrite(lines.data(), 1, lines.size(), journal) == lines.size() &&
+            FlushToDisk(journal);
+  fclose(journal);
+  if (!ok) {
+    *error = "Cannot write " + journal_path;
+    std::error_code ec;
+    fs::remove_all(PathFromUtf8(backup_dir), ec);
+    return ApplyResult::kFailed;
+  }
+
+  // Downloads are created with default permissions: replaced files keep
+  // those of the old file, added code those of the app.
+  std::error_code exe_ec;
+  const fs::file_status exe_status =
+      fs::status(PathFromUtf8(executable_path), exe_ec);
+  const bool has_exe_status = !exe_ec && fs::is_regular_file(exe_status);
+
+  for (const std::string& path : paths) {
+    const std::string target = JoinPath(app_dir, path);
+    const std::string backup = JoinPath(backup_dir, path);
+    const std::string staged = JoinPath(staging_dir, path);
+    std::error_code ec;
+    const fs::file_status old_status =
+        fs::symlink_status(PathFromUtf8(target), ec);
+    const bool had_target = fs::exists(old_status);
+    if (had_target &&
+        (!CreateParentDirectories(backup, error) || !Rename(target, backup))) {
+      *error = "Cannot move aside " + target;
+      ok = false;
+      break;
+    }
+    if (!CreateParentDirectories(target, error) || !Rename(staged, target)) {
+      *error = "Cannot move " + staged + " into place";
+      ok = false;
+      break;
+    }
+    if (had_target && fs::is_regular_file(old_status)) {
+      fs::permissions(PathFromUtf8(target), old_status.permissions(),
+                      fs::perm_options::replace, ec);
+    } else if (!had_target && has_exe_status &&
+               (path.find('/') == std::string::npos ||
+                path.compare(0, 4, "lib/") == 0)) {
+      fs::permissions(PathFromUtf8(target), exe_status.permissions(),
+                      fs::perm_options::replace, ec);
+    }
+  }
+
+  // Check what actually landed in the install folder before committing.
+  VerifyStats verify_stats;
+  std::string verify_error;
+  if (ok && !VerifyInstalledFiles(app_dir, files, &cache, 0, &verify_stats,
+                                  &verify_error)) {
+    *error = "Applied files do not match the update: " + verify_error;
+    ok = false;
+  }
+
+  if (!ok) {
+    std::string rollback_error;
+    if (RollBack(app_dir, paths, &rollback_error)) {
+      std::error_code ec;
+      fs::remove_all(PathFromUtf8(backup_dir), ec);
+    } else {
+      // Keep the journal: the next launch retries the rollback.
+      *error += "; rollback incomplete: " + rollback_error;
+    }
+    return ApplyResult::kFailed;
+  }
+
+  *replaced = std::move(paths);
+  std::error_code ec;
+  // Removing the receipt commits the update: a crash after this point only
+  // leaves folders behind for the next launch to clean up.
+  fs::remove(PathFromUtf8(receipt), ec);
+  fs::remove_all(PathFromUtf8(backup_dir), ec);
+  fs::remove_all(PathFromUtf8(staging_dir), ec);
+  return ApplyResult::kApplied;
+}
+
+}  // namespace
+
+ApplyResult ApplyPendingUpdate(const std::string& app_dir,
+                               const std::string& executable_path,
+                               std::vector<std::string>* replaced,
+                               std::string* error) {
+  TraceSpan span("apply");
+  const auto start = std::chrono::steady_clock::now();
+  const ApplyResult result = ApplyStagedUpdate(app_dir, executable_path, replaced, error);
+  // Every launch looks for an update; only count the ones that had one.
+  if (result != ApplyResult::kNothingPending) {
+    RecordPhase(Phase::kApply,
+                static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count()));
+  }
+  if (result == ApplyResult::kApplied) {
+    AddCount(Counter::kFilesApplied, replaced->size());
+  } else if (result == ApplyResult::kFailed) {
+    AddCount(Counter::kApplyFailures);
+  }
+  if (DESKTOP_UPDATER_PROBE_ENABLED(apply_done)) {
+    DESKTOP_UPDATER_PROBE4(
+        apply_done, app_dir.c_str(), replaced->size(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count(),
+        static_cast<int>(result));
+  }
+  return result;
+}
+
+}  // namespace desktop_updater
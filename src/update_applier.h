@@ -0,0 +1,64 @@
+#ifndef DESKTOP_UPDATER_UPDATE_APPLIER_H_
+#define DESKTOP_UPDATER_UPDATE_APPLIER_H_
+
+#include <string>
+#include <vector>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+
+// Downloads are staged in <app>/update. Once verified, the staged file list
+// is recorded in <app>/update/.desktop_updater/staged.json (hashes.json
+// format), which is what marks an update as ready to apply.
+constexpr char kStagingDirName[] = "update";
+constexpr char kStagedReceiptPath[] = ".desktop_updater/staged.json";
+// Replaced files are moved here while applying, next to a journal of the
+// paths being swapped, so an interrupted apply can be rolled back.
+constexpr char kBackupDirName[] = ".desktop_updater_backup";
+
+/**
+ * @brief Hashes the staged |files| and records them as ready to apply.
+ *
+ * Every file must exist below |staging_dir| with the listed length and
+ * digest. The receipt is written atomically, so a crash leaves either no
+ * receipt or a complete one.
+ */
+bool VerifyAndStage(const std::string& staging_dir,
+                    const Manifest& files,
+                    unsigned threads,
+                    std::string* error);
+
+// Returns true if |app_dir| holds a verified staged update.
+bool HasPendingUpdate(const std::string& app_dir);
+
+enum class ApplyResult {
+  kNothingPending,
+  kApplied,
+  // Nothing was changed, or every change was rolled back.
+  kFailed,
+};
+
+/**
+ * @brief Moves a verified staged update into |app_dir| with renames.
+ *
+ * Each replaced file is first renamed into the backup directory, and keeps
+ * its permissions on the new copy. Files the update adds to the bundle
+ * root or lib/, such as helper executables and plugins, get the
+ * permissions of |executable_path|. The installed files are then checked
+ * against the receipt's digests (VerifyInstalledFiles()). On any failure
+ * or mismatch every swap is undone. A journal left by a previous crash is
+ * rolled back before anything else.
+ * On success the staging and backup directories are removed.
+ *
+ * @param executable_path The app's executable in |app_dir|.
+ * @param replaced Receives the normalized paths that were swapped in.
+ */
+ApplyResult ApplyPendingUpdate(const std::string& app_dir,
+                               const std::string& executable_path,
+                               std::vector<std::string>* replaced,
+                               std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_UPDATE_APPLIER_H_
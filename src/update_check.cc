@@ -0,0 +1,338 @@
+#include "update_check.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "blake2b.h"
+#include "manifest_index.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace desktop_updater {
+
+namespace {
+
+// Shard downloads in flight at once.
+constexpr unsigned kShardWorkers = 8;
+// Intermediate release manifests fetched at once. Each one fetches its
+// shards on kShardWorkers / kReleaseWorkers threads, so the total stays at
+// kShardWorkers requests in flight.
+constexpr unsigned kReleaseWorkers = 4;
+
+// Fetches and parses the shards of a sharded manifest on worker threads
+// and hands them out in index order as they arrive.
+class ShardFetch {
+ public:
+  ShardFetch(HttpFetcher* fetcher,
+             const std::string& release_url,
+             ManifestIndex index,
+             unsigned max_workers = kShardWorkers)
+      : fetcher_(fetcher),
+        release_url_(release_url),
+        index_(std::move(index)),
+        shards_(index_.size()),
+        done_(index_.size(), 0),
+        errors_(index_.size()) {
+    const size_t workers =
+        std::min<size_t>(max_workers, std::max<size_t>(index_.size(), 1));
+    for (size_t i = 0; i < workers; i++) {
+      workers_.emplace_back([this]() { Work(); });
+    }
+  }
+
+  ~ShardFetch() {
+    cancelled_ = true;
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  ShardFetch(const ShardFetch&) = delete;
+  ShardFetch& operator=(const ShardFetch&) = delete;
+
+  size_t size() const { return index_.size(); }
+
+  // Waits for shard |i| and moves it to |out|.
+  bool Take(size_t i, Manifest* out, std::string* error) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    arrived_.wait(lock, [&]() { return done_[i] != 0; });
+    if (!errors_[i].empty()) {
+      *error = errors_[i];
+      return false;
+    }
+    *out = std::move(shards_[i]);
+    return true;
+  }
+
+ private:
+  void Work() {
+    PhaseScope scope(Phase::kCheck);
+    for (size_t i = next_++; i < index_.size(); i = next_++) {
+      Manifest shard;
+      std::string error;
+      if (!cancelled_) {
+        Fetch(index_[i], &shard, &error);
+      } else {
+        error = "Cancelled";
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      shards_[i] = std::move(shard);
+      errors_[i] = std::move(error);
+      done_[i] = 1;
+      arrived_.notify_all();
+    }
+  }
+
+  void Fetch(const ManifestShard& shard, Manifest* out, std::string* error) {
+    TraceSpan span("fetch_shard");
+    span.SetArg("bytes", static_cast<int64_t>(shard.length));
+    std::string body;
+    if (!fetcher_->GetToString(JoinUrl(release_url_, shard.path), &body,
+                               error)) {
+      return;
+    }
+    Digest digest;
+    Blake2b hash;
+    hash.Update(reinterpret_cast<const uint8_t*>(body.data()), body.size());
+    hash.Final(digest.data());
+    if (digest != shard.digest) {
+      *error = "Manifest shard " + shard.path + " does not match its index";
+      return;
+    }
+    if (!ParseManifest(body.data(), body.size(), out, error) &&
+        error->empty()) {
+      *error = "Invalid manifest shard " + shard.path;
+    }
+  }
+
+  HttpFetcher* fetcher_;
+  const std::string release_url_;
+  const ManifestIndex index_;
+  std::atomic<size_t> next_{0};
+  std::atomic<bool> cancelled_{false};
+  std::mutex mutex_;
+  std::condition_variable arrived_;
+  std::vector<Manifest> shards_;
+  std::vector<char> done_;
+  // Empty for shards that arrived intact.
+  std::vector<std::string> errors_;
+  std::vector<std::thread> workers_;
+};
+
+bool HasPatches(const Manifest& manifest) {
+  return std::any_of(manifest.begin(), manifest.end(),
+                     [](const FileEntry& entry) {
+                       return !entry.patches.empty();
+                     });
+}
+
+// Fetches the index of the release at |release_url| if its manifest is
+// sharded.
+bool FetchManifestIndex(HttpFetcher* fetcher,
+                        const std::string& release_url,
+                        ManifestIndex* index) {
+  std::string body;
+  std::string error;
+  return fetcher->GetToString(JoinUrl(release_url, kManifestIndexName), &body,
+                              &error) &&
+         ParseManifestIndex(body.data(), body.size(), index, &error);
+}
+
+// Fetches the hashes.json of the release at |release_url|.
+bool FetchWholeManifest(HttpFetcher* fetcher,
+                        const std::string& release_url,
+                        Manifest* out,
+                        std::string* error) {
+  std::string body;
+  return fetcher->GetToString(JoinUrl(release_url, "hashes.json"), &body,
+                              error) &&
+         ParseManifest(body.data(), body.size(), out, error);
+}
+
+// Fetches the manifest of the release at |release_url|, from its shards on
+// up to |shard_workers| threads when it is sharded.
+bool FetchManifest(HttpFetcher* fetcher,
+                   const std::string& release_url,
+                   unsigned shard_workers,
+                   Manifest* out,
+                   std::string* error) {
+  ManifestIndex index;
+  if (!FetchManifestIndex(fetcher, release_url, &index)) {
+    return FetchWholeManifest(fetcher, release_url, out, error);
+  }
+  ShardFetch shards(fetcher, release_url, std::move(index), shard_workers);
+  out->clear();
+  for (size_t i = 0; i < shards.size(); i++) {
+    Manifest shard;
+    if (!shards.Take(i, &shard, error)) {
+      return false;
+    }
+    out->insert(out->end(), std::make_move_iterator(shard.begin()),
+                std::make_move_iterator(shard.end()));
+  }
+  return true;
+}
+
+// Fetches the manifests of the releases between the installed build and
+// |latest|, oldest first, kReleaseWorkers at a time. Releases whose
+// manifest cannot be fetched are left out; the planner then just has fewer
+// patches to choose from.
+std::vector<ReleaseManifest> FetchIntermediateReleases(
+    HttpFetcher* fetcher,
+    const AppArchive& archive,
+    const UpdateCheckRequest& request,
+    const ArchiveItem& latest) {
+  std::vector<const ArchiveItem*> items;
+  for (const ArchiveItem& item : archive.items) {
+    if (item.platform == request.platform &&
+        item.short_version > request.current_version &&
+        item.short_version < latest.short_version) {
+      items.push_back(&item);
+    }
+  }
+  std::sort(items.begin(), items.end(),
+            [](const ArchiveItem* a, const ArchiveItem* b) {
+              return a->short_version < b->short_version;
+            });
+
+  std::vector<ReleaseManifest> releases(items.size());
+  std::vector<char> ok(items.size(), 0);
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    PhaseScope scope(Phase::kCheck);
+    for (size_t i = next++; i < items.size(); i = next++) {
+      std::string error;
+      releases[i].short_version = items[i]->short_version;
+      releases[i].url = items[i]->url;
+      ok[i] = FetchManifest(fetcher, items[i]->url,
+                            kShardWorkers / kReleaseWorkers,
+                            &releases[i].manifest, &error);
+    }
+  };
+  const size_t workers = std::min<size_t>(kReleaseWorkers, items.size());
+  std::vector<std::thread> threads;
+  threads.reserve(workers);
+  for (size_t i = 0; i < workers; i++) {
+    threads.emplace_back(work);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<ReleaseManifest> fetched;
+  for (size_t i = 0; i < releases.size(); i++) {
+    if (ok[i]) {
+      fetched.push_back(std::move(releases[i]));
+    }
+  }
+  return fetched;
+}
+
+}  // namespace
+
+bool CheckForUpdate(HttpFetcher* fetcher,
+                    const UpdateCheckRequest& request,
+                    UpdateCheckResult* result,
+                    std::string* error) {
+  TraceSpan span("check");
+  PhaseTimer timer(Phase::kCheck);
+  std::string body;
+  if (!fetcher->GetToString(request.app_archive_url, &body, error)) {
+    return false;
+  }
+  AppArchive archive;
+  if (!ParseAppArchive(body.data(), body.size(), &archive, error)) {
+    return false;
+  }
+  const ArchiveItem* latest = FindLatestItem(archive, request.platform);
+  if (latest == nullptr) {
+    *error = "No version found for this platform";
+    return false;
+  }
+
+  result->app_name = archive.app_name;
+  result->latest = *latest;
+  result->update_available = latest->short_version > request.current_version;
+  result->diff = ManifestDiff();
+  result->total_bytes = 0;
+  result->plan = UpdatePlan();
+  if (!result->update_available) {
+    return true;
+  }
+
+  // The manifest download overlaps with hashing the installed bundle.
+  // Sharded releases publish a small index first; its shards are fetched
+  // in parallel and diffed one by one as they arrive.
+  Manifest target;
+  std::unique_ptr<ShardFetch> shards;
+  bool fetched = false;
+  std::string fetch_error;
+  std::thread fetch_thread([&]() {
+    PhaseScope scope(Phase::kCheck);
+    ManifestIndex index;
+    if (FetchManifestIndex(fetcher, latest->url, &index)) {
+      shards = std::make_unique<ShardFetch>(fetcher, latest->url,
+                                            std::move(index));
+      fetched = true;
+      return;
+    }
+    fetched = FetchWholeManifest(fetcher, latest->url, &target, &fetch_error);
+  });
+
+  Manifest installed;
+  std::string hash_error;
+  const bool hashed = HashTree(request.install_dir, request.scan,
+                               request.threads, &installed, &hash_error);
+  fetch_thread.join();
+
+  if (!fetched) {
+    *error = fetch_error;
+    return false;
+  }
+  if (!hashed) {
+    *error = hash_error;
+    return false;
+  }
+
+  if (shards == nullptr) {
+    result->diff = DiffManifests(installed, target);
+  } else {
+    ManifestDiffer differ(installed);
+    for (size_t i = 0; i < shards->size(); i++) {
+      Manifest shard;
+      if (!shards->Take(i, &shard, error)) {
+        return false;
+      }
+      TraceSpan diff_span("diff");
+      diff_span.SetArg("files", static_cast<int64_t>(shard.size()));
+      PhaseTimer diff_timer(Phase::kDiff);
+      differ.Add(shard);
+      target.insert(target.end(), std::make_move_iterator(shard.begin()),
+                    std::make_move_iterator(shard.end()));
+    }
+    result->diff = differ.Finish();
+  }
+  for (const FileEntry& entry : result->diff.changed) {
+    result->total_bytes += entry.length;
+  }
+
+  std::vector<ReleaseManifest> releases;
+  if (HasPatches(target)) {
+    releases = FetchIntermediateReleases(fetcher, archive, request, *latest);
+  }
+  ReleaseManifest target_release;
+  target_release.short_version = latest->short_version;
+  target_release.url = latest->url;
+  target_release.manifest = std::move(target);
+  releases.push_back(std::move(target_release));
+  result->plan = PlanUpdate(installed, releases, result->diff.changed);
+  return true;
+}
+
+}  // namespace desktop_updater
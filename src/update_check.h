@@ -0,0 +1,63 @@
+#ifndef DESKTOP_UPDATER_UPDATE_CHECK_H_
+#define DESKTOP_UPDATER_UPDATE_CHECK_H_
+
+#include <cstdint>
+#include <string>
+
+#include "app_archive.h"
+#include "file_hash.h"
+#include "http_fetcher.h"
+#include "manifest.h"
+#include "release_planner.h"
+
+namespace desktop_updater {
+
+struct UpdateCheckRequest {
+  std::string app_archive_url;
+  // Platform name as written in app-archive.json ("linux", "windows").
+  std::string platform;
+  // Build number of the running app.
+  int64_t current_version = 0;
+  // Installed bundle to compare against the release.
+  std::string install_dir;
+  ScanOptions scan;
+  // Hashing workers; 0 uses the hardware concurrency.
+  unsigned threads = 0;
+};
+
+struct UpdateCheckResult {
+  bool update_available = false;
+  std::string app_name;
+  // Newest item for the platform. Set whenever the check succeeds.
+  ArchiveItem latest;
+  // Only filled when |update_available|.
+  ManifestDiff diff;
+  // Sum of the changed files' lengths.
+  uint64_t total_bytes = 0;
+  // How to fetch |diff.changed|; plan.expected_bytes is what it transfers.
+  UpdatePlan plan;
+};
+
+/**
+ * @brief Runs a complete update check in memory.
+ *
+ * Fetches app-archive.json, picks the newest item for the platform and, if
+ * it is newer than the running build, fetches its hashes.json while the
+ * installed bundle is hashed on worker threads, then diffs the two. A
+ * release with a hashes.index.json has its shards fetched in parallel
+ * instead, each diffed as soon as it and the hashes are in. When
+ * the release publishes patches, the manifests of the releases in between
+ * are fetched too and PlanUpdate() picks full files or patch chains per
+ * file. Nothing is written to disk.
+ *
+ * @return false with |error| set if a download, parse or scan fails, or the
+ *         archive has no item for the platform.
+ */
+bool CheckForUpdate(HttpFetcher* fetcher,
+                    const UpdateCheckRequest& request,
+                    UpdateCheckResult* result,
+                    std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_UPDATE_CHECK_H_
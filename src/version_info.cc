@@ -0,0 +1,117 @@
+#include "version_info.h"
+
+#include <vector>
+
+#include "file_util.h"
+#include "json.h"
+
+namespace desktop_updater {
+
+namespace {
+
+bool ParseNumber(const std::string& text, int64_t* out) {
+  if (text.empty() || text.size() > 18) {
+    return false;
+  }
+  int64_t value = 0;
+  for (const char c : text) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    value = value * 10 + (c - '0');
+  }
+  *out = value;
+  return true;
+}
+
+std::string Trim(const std::string& text) {
+  const size_t begin = text.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos) {
+    return std::string();
+  }
+  const size_t end = text.find_last_not_of(" \t\r\n");
+  return text.substr(begin, end - begin + 1);
+}
+
+}  // namespace
+
+bool ParseVersionString(const std::string& input, VersionInfo* out) {
+  const std::string text = Trim(input);
+  std::string core = text;
+  out->build_number.clear();
+  const size_t plus = text.find('+');
+  if (plus != std::string::npos) {
+    out->build_number = text.substr(plus + 1);
+    core = text.substr(0, plus);
+  }
+  const size_t dash = core.find('-');
+  out->pre_release =
+      dash == std::string::npos ? std::string() : core.substr(dash + 1);
+  out->version = core;
+  if (dash != std::string::npos) {
+    core = core.substr(0, dash);
+  }
+
+  int64_t* parts[] = {&out->major, &out->minor, &out->patch};
+  size_t start = 0;
+  for (int i = 0; i < 3; i++) {
+    *parts[i] = 0;
+    if (start > core.size()) {
+      continue;
+    }
+    size_t end = core.find('.', start);
+    if (end == std::string::npos) {
+      end = core.size();
+    }
+    if (!ParseNumber(core.substr(start, end - start), parts[i])) {
+      return false;
+    }
+    start = end + 1;
+  }
+  // More than three numeric parts ("1.2.3.4" from a Windows resource) keep
+  // only the first three.
+  return true;
+}
+
+bool ParseFlutterVersionJson(const char* data,
+                             size_t size,
+                             VersionInfo* out,
+                             std::string* error) {
+  JsonValue root;
+  if (!JsonValue::Parse(data, size, &root, error)) {
+    return false;
+  }
+  const std::string version = root.GetString("version");
+  if (!ParseVersionString(version, out)) {
+    *error = "Invalid version \"" + version + "\"";
+    return false;
+  }
+  out->app_name = root.GetString("app_name");
+  // build_number is a string, but tolerate numbers written by hand.
+  const JsonValue* build = root.Find("build_number");
+  if (build != nullptr && build->is_string()) {
+    out->build_number = Trim(build->string_value());
+  } else if (build != nullptr && build->is_number()) {
+    out->build_number = std::to_string(build->int_value());
+  }
+  return true;
+}
+
+bool ReadFlutterVersionFile(const std::string& bundle_dir,
+                            VersionInfo* out,
+                            std::string* error) {
+  std::vector<uint8_t> data;
+  if (!ReadFileBytes(JoinPath(bundle_dir, "data/flutter_assets/version.json"),
+                     &data, error)) {
+    return false;
+  }
+  return ParseFlutterVersionJson(reinterpret_cast<const char*>(data.data()),
+                                 data.size(), out, error);
+}
+
+int64_t BuildNumberOf(const VersionInfo& info, int64_t fallback) {
+  int64_t value;
+  return ParseNumber(info.build_number, &value) ? value : fallback;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,52 @@
+#ifndef DESKTOP_UPDATER_VERSION_INFO_H_
+#define DESKTOP_UPDATER_VERSION_INFO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace desktop_updater {
+
+/**
+ * @brief Build metadata of the running app, i.e. pubspec's
+ *        "version: 1.2.3-beta+4".
+ */
+struct VersionInfo {
+  // "1.2.3-beta", without the build number.
+  std::string version;
+  int64_t major = 0;
+  int64_t minor = 0;
+  int64_t patch = 0;
+  // "beta" in the example above, empty for releases.
+  std::string pre_release;
+  // "4" in the example above. Compared against shortVersion of
+  // app-archive.json items.
+  std::string build_number;
+  // Only known from version.json.
+  std::string app_name;
+};
+
+// Parses "major.minor.patch[-pre][+build]". Missing minor/patch parts are
+// accepted, as Windows resources often carry "1.2+3".
+bool ParseVersionString(const std::string& text, VersionInfo* out);
+
+/**
+ * @brief Parses the flutter_assets/version.json the Flutter tool writes:
+ *        {"app_name": ..., "version": "1.2.3", "build_number": "4"}
+ */
+bool ParseFlutterVersionJson(const char* data,
+                             size_t size,
+                             VersionInfo* out,
+                             std::string* error);
+
+// Reads <bundle_dir>/data/flutter_assets/version.json.
+bool ReadFlutterVersionFile(const std::string& bundle_dir,
+                            VersionInfo* out,
+                            std::string* error);
+
+// Returns the build number as an integer, or |fallback| if it is not one.
+int64_t BuildNumberOf(const VersionInfo& info, int64_t fallback = -1);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_VERSION_INFO_H_
@@ -1,6 +1,7 @@
 import 'package:flutter/services.dart';
 import 'package:flutter_test/flutter_test.dart';
 import 'package:desktop_updater/desktop_updater_method_channel.dart';
+import 'package:desktop_updater/src/app_archive.dart';
 
 void main() {
   TestWidgetsFlutterBinding.ensureInitialized();
@@ -24,4 +25,54 @@ void main() {
   test('getPlatformVersion', () async {
     expect(await platform.getPlatformVersion(), '42');
   });
+
+  test('downloadUpdate forwards the published objects', () async {
+    final messenger =
+        TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger;
+    final calls = <MethodCall>[];
+    messenger.setMockMethodCallHandler(channel, (MethodCall methodCall) async {
+      calls.add(methodCall);
+      return null;
+    });
+    // Answers the listen and cancel calls of the progress stream.
+    const progress = MethodChannel('desktop_updater/progress');
+    messenger.setMockMethodCallHandler(
+      progress,
+      (MethodCall methodCall) async => null,
+    );
+    addTearDown(() => messenger.setMockMethodCallHandler(progress, null));
+
+    await platform.downloadUpdate(
+      remoteUpdateFolder: 'https://example.com/1.0.1+2-linux',
+      files: [
+        FileHashModel(
+          filePath: 'lib/libapp.so',
+          calculatedHash: 'aGFzaA==',
+          length: 3,
+          object: '../objects/ab12',
+        ),
+        FileHashModel(
+          filePath: 'data/icudtl.dat',
+          calculatedHash: 'aGFzaA==',
+          length: 4,
+        ),
+      ],
+    ).toList();
+
+    final download = calls.singleWhere((call) => call.method == 'downloadUpdate');
+    final files = (download.arguments as Map)['files'] as List;
+    expect(files, [
+      {
+        'path': 'lib/libapp.so',
+        'length': 3,
+        'calculatedHash': 'aGFzaA==',
+        'object': '../objects/ab12',
+      },
+      {
+        'path': 'data/icudtl.dat',
+        'length': 4,
+        'calculatedHash': 'aGFzaA==',
+      },
+    ]);
+  });
 }
@@ -11,7 +11,10 @@ class MockDesktopUpdaterPlatform
   Future<String?> getPlatformVersion() => Future.value("42");
 
   @override
-  Future<void> restartApp() {
+  Future<void> restartApp({
+    bool handoff = false,
+    List<String> removedFiles = const [],
+  }) {
     return Future.value();
   }
 
@@ -48,6 +51,50 @@ class MockDesktopUpdaterPlatform
     return Future.value();
   }
 
+  @override
+  Future<AppVersionInfo?> getVersionInfo() {
+    return Future.value();
+  }
+
+  @override
+  Future<Duration?> getHandoffDuration() {
+    return Future.value();
+  }
+
+  @override
+  Future<UpdateMetrics?> getUpdateMetrics() {
+    return Future.value();
+  }
+
+  @override
+  Future<bool> setPerfCountersEnabled(bool enabled) {
+    return Future.value(false);
+  }
+
+  @override
+  Future<void> setTraceEnabled(bool enabled) {
+    return Future.value();
+  }
+
+  @override
+  Future<String?> dumpTrace({String? path}) {
+    return Future.value(path);
+  }
+
+  @override
+  Future<ItemModel?> checkAndPrepare({required String appArchiveUrl}) {
+    return Future.value();
+  }
+
+  @override
+  Stream<UpdateProgress> downloadUpdate({
+    required String remoteUpdateFolder,
+    required List<FileHashModel?> files,
+    double progressHz = 10,
+  }) {
+    return const Stream.empty();
+  }
+
   @override
   Future<List<FileHashModel?>> prepareUpdateApp(
       {required String remoteUpdateFolder}) {
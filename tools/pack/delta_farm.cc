@@ -0,0 +1,313 @@
+#include "delta_farm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include "blake2b.h"
+#include "delta.h"
+#include "elf_delta.h"
+#include "file_util.h"
+#include "release_packer.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+namespace {
+
+struct PatchJob {
+  // Index into the target manifest.
+  size_t entry = 0;
+  std::string base_path;
+  Digest from = {};
+  uint64_t memory = 0;
+};
+
+struct PatchResult {
+  bool kept = false;
+  bool elf = false;
+  PatchRef patch;
+};
+
+// Per-worker job queue. The owner pops from the front, where the largest
+// jobs are; thieves take from the back.
+class JobQueue {
+ public:
+  void Push(size_t job) { jobs_.push_back(job); }
+
+  bool Pop(size_t* job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (jobs_.empty()) {
+      return false;
+    }
+    *job = jobs_.front();
+    jobs_.pop_front();
+    return true;
+  }
+
+  bool Steal(size_t* job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (jobs_.empty()) {
+      return false;
+    }
+    *job = jobs_.back();
+    jobs_.pop_back();
+    return true;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<size_t> jobs_;
+};
+
+std::string ShortHex(const Digest& digest) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string out;
+  for (size_t i = 0; i < 8; i++) {
+    out.push_back(kHex[digest[i] >> 4]);
+    out.push_back(kHex[digest[i] & 0x0F]);
+  }
+  return out;
+}
+
+Digest DigestOf(const ByteBuffer& data) {
+  Digest digest;
+  Blake2b hash;
+  hash.Update(data.data(), data.size());
+  hash.Final(digest.data());
+  return digest;
+}
+
+// Builds, checks and writes the patch of |job|. Returns false only on
+// errors; a patch that is not worth keeping leaves |result| unkept.
+bool RunJob(const std::string& release_dir,
+            const FileEntry& entry,
+            const PatchJob& job,
+            const DeltaFarmOptions& options,
+            PatchResult* result,
+            std::atomic<uint64_t>* skipped_ratio,
+            std::string* error) {
+  const std::string relative = NormalizeRelativePath(entry.path);
+  ByteBuffer base;
+  ByteBuffer target;
+  if (!ReadFileBytes(job.base_path, &base, error) ||
+      !ReadFileBytes(JoinPath(release_dir, relative), &target, error)) {
+    return false;
+  }
+  if (DigestOf(base) != job.from) {
+    *error = job.base_path + " does not match its release's manifest";
+    return false;
+  }
+  if (DigestOf(target) != entry.digest) {
+    *error = JoinPath(release_dir, relative) + " changed while packing";
+    return false;
+  }
+
+  ByteBuffer delta = CreateDelta(base, target);
+  if (options.elf) {
+    ByteBuffer elf = CreateElfDelta(base, target);
+    if (!elf.empty() && elf.size() < delta.size()) {
+      delta = std::move(elf);
+      result->elf = true;
+    }
+  }
+  if (static_cast<double>(delta.size()) >=
+      options.max_patch_ratio * static_cast<double>(target.size())) {
+    (*skipped_ratio)++;
+    return true;
+  }
+  ByteBuffer patched;
+  if (!ApplyDelta(base, delta, &patched, error) ||
+      DigestOf(patched) != entry.digest) {
+    *error = "Generated patch for " + entry.path + " does not apply";
+    return false;
+  }
+
+  result->patch.from = job.from;
+  result->patch.path = std::string(kPatchDirName) + "/" + relative + "." +
+                       ShortHex(job.from);
+  result->patch.length = delta.size();
+  const std::string path = JoinPath(release_dir, result->patch.path);
+  if (!CreateParentDirectories(path, error) ||
+      !WriteFileBytes(path, delta.data(), delta.size(), error)) {
+    return false;
+  }
+  result->kept = true;
+  return true;
+}
+
+}  // namespace
+
+bool LoadPreviousRelease(const std::string& dir,
+                         PreviousRelease* out,
+                         std::string* error) {
+  out->dir = dir;
+  std::vector<uint8_t> data;
+  std::string ignored;
+  if (ReadFileBytes(JoinPath(dir, kHashesBinName), &data, &ignored)) {
+    return ParseBinaryManifest(reinterpret_cast<const char*>(data.data()),
+                               data.size(), &out->manifest, error);
+  }
+  if (!ReadFileBytes(JoinPath(dir, kHashesJsonName), &data, error)) {
+    return false;
+  }
+  return ParseManifest(reinterpret_cast<const char*>(data.data()),
+                       data.size(), &out->manifest, error);
+}
+
+bool GeneratePatches(const std::string& release_dir,
+                     const std::vector<PreviousRelease>& previous,
+                     const DeltaFarmOptions& options,
+                     Manifest* manifest,
+                     DeltaFarmStats* stats,
+                     std::string* error) {
+  const auto start = std::chrono::steady_clock::now();
+  *stats = DeltaFarmStats();
+  std::error_code ec;
+  fs::remove_all(PathFromUtf8(JoinPath(release_dir, kPatchDirName)), ec);
+
+  // One job per file and distinct earlier version of it.
+  std::vector<PatchJob> jobs;
+  for (size_t i = 0; i < manifest->size(); i++) {
+    FileEntry& entry = (*manifest)[i];
+    entry.patches.clear();
+    const std::string key = NormalizeRelativePath(entry.path);
+    std::vector<Digest> seen;
+    for (const PreviousRelease& release : previous) {
+      for (const FileEntry& old : release.manifest) {
+        if (old.digest == entry.digest ||
+            std::find(seen.begin(), seen.end(), old.digest) != seen.end() ||
+            NormalizeRelativePath(old.path) != key) {
+          continue;
+        }
+        PatchJob job;
+        job.entry = i;
+        job.base_path = JoinPath(release.dir, key);
+        if (!fs::is_regular_file(PathFromUtf8(job.base_path), ec) &&
+            !old.object.empty()) {
+          // Packed with objects only; the store mirrors the server layout.
+          job.base_path = JoinPath(release.dir, old.object);
+        }
+        if (!fs::is_regular_file(PathFromUtf8(job.base_path), ec)) {
+          // Pruned from the earlier folder; nothing to patch from.
+          continue;
+        }
+        seen.push_back(old.digest);
+        job.from = old.digest;
+        job.memory = options.elf
+                         ? EstimateElfDeltaMemory(old.length, entry.length)
+                         : EstimateDeltaMemory(old.length, entry.length);
+        if (job.memory > options.worker_memory_budget) {
+          stats->skipped_budget++;
+        } else {
+          jobs.push_back(std::move(job));
+        }
+        stats->candidates++;
+      }
+    }
+  }
+
+  unsigned threads = options.threads;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = static_cast<unsigned>(
+      std::min<size_t>(threads, std::max<size_t>(jobs.size(), 1)));
+
+  // Largest first, dealt round robin, so every queue starts with its share
+  // of the long jobs.
+  std::vector<size_t> order(jobs.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return jobs[a].memory > jobs[b].memory;
+  });
+  std::vector<std::unique_ptr<JobQueue>> queues;
+  for (unsigned i = 0; i < threads; i++) {
+    queues.push_back(std::make_unique<JobQueue>());
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+    queues[i % threads]->Push(order[i]);
+  }
+
+  std::vector<PatchResult> results(jobs.size());
+  std::atomic<bool> failed{false};
+  std::atomic<uint64_t> skipped_ratio{0};
+  std::atomic<uint64_t> stolen{0};
+  std::mutex error_mutex;
+
+  auto worker = [&](unsigned self) {
+    std::string job_error;
+    while (!failed.load(std::memory_order_relaxed)) {
+      size_t job = 0;
+      bool found = queues[self]->Pop(&job);
+      for (unsigned i = 1; !found && i < threads; i++) {
+        found = queues[(self + i) % threads]->Steal(&job);
+        if (found) {
+          stolen++;
+        }
+      }
+      if (!found) {
+        return;
+      }
+      if (!RunJob(release_dir, (*manifest)[jobs[job].entry], jobs[job],
+                  options, &results[job], &skipped_ratio, &job_error)) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed.exchange(true)) {
+          *error = job_error;
+        }
+        return;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (unsigned i = 1; i < threads; i++) {
+    workers.emplace_back(worker, i);
+  }
+  worker(0);
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+  if (failed.load()) {
+    return false;
+  }
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!results[i].kept) {
+      continue;
+    }
+    FileEntry& entry = (*manifest)[jobs[i].entry];
+    stats->patches++;
+    if (results[i].elf) {
+      stats->elf_patches++;
+    }
+    stats->patch_bytes += results[i].patch.length;
+    stats->full_bytes += entry.length;
+    entry.patches.push_back(std::move(results[i].patch));
+  }
+  for (FileEntry& entry : *manifest) {
+    std::sort(entry.patches.begin(), entry.patches.end(),
+              [](const PatchRef& a, const PatchRef& b) {
+                return a.path < b.path;
+              });
+  }
+  stats->skipped_ratio = skipped_ratio.load();
+  stats->stolen = stolen.load();
+  stats->elapsed_ms = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+  return true;
+}
+
+}  // namespace desktop_updater
@@ -0,0 +1,82 @@
+#ifndef DESKTOP_UPDATER_DELTA_FARM_H_
+#define DESKTOP_UPDATER_DELTA_FARM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "manifest.h"
+
+namespace desktop_updater {
+
+// Folder below a release folder holding its patches. The packer never
+// lists it in the manifest.
+constexpr char kPatchDirName[] = "patches";
+
+/**
+ * @brief An earlier release folder patches are generated from.
+ */
+struct PreviousRelease {
+  // Release folder, e.g. dist/8/0.1.7+8-linux.
+  std::string dir;
+  Manifest manifest;
+};
+
+// Reads the hashes.bin, or else the hashes.json, of the release in |dir|.
+bool LoadPreviousRelease(const std::string& dir,
+                         PreviousRelease* out,
+                         std::string* error);
+
+struct DeltaFarmOptions {
+  // Worker count; 0 uses the hardware concurrency.
+  unsigned threads = 0;
+  // Memory one worker may use for a patch, inputs included (see
+  // EstimateDeltaMemory()). Larger pairs get no patch, so the farm never
+  // needs more than |threads| times this.
+  uint64_t worker_memory_budget = uint64_t{1} << 30;
+  // Patches of at least this fraction of the full file are dropped; the
+  // planner would rarely pick them over the full download.
+  double max_patch_ratio = 0.5;
+  // Also tries an ELF-aware delta (see CreateElfDelta()) for ELF files and
+  // keeps it when it is smaller.
+  bool elf = true;
+};
+
+struct DeltaFarmStats {
+  // (file, earlier version) pairs considered.
+  uint64_t candidates = 0;
+  uint64_t patches = 0;
+  // Kept patches that are ELF-aware deltas.
+  uint64_t elf_patches = 0;
+  uint64_t patch_bytes = 0;
+  // Full size of the files the kept patches replace.
+  uint64_t full_bytes = 0;
+  uint64_t skipped_ratio = 0;
+  uint64_t skipped_budget = 0;
+  // Jobs run by a worker other than the one they were dealt to.
+  uint64_t stolen = 0;
+  uint64_t elapsed_ms = 0;
+};
+
+/**
+ * @brief Generates patches from the files of |previous| releases to the
+ *        files of the release in |release_dir| described by |manifest|.
+ *
+ * One job per file and distinct earlier digest runs on a work-stealing
+ * pool: jobs are dealt to per-worker queues largest first, and idle
+ * workers take from the back of the others' queues. Every patch is checked
+ * against both digests before it is written to
+ * <release_dir>/patches/<path>.<from digest> and added to the entry's
+ * "patches", in a deterministic order. An earlier patches/ folder is
+ * replaced.
+ */
+bool GeneratePatches(const std::string& release_dir,
+                     const std::vector<PreviousRelease>& previous,
+                     const DeltaFarmOptions& options,
+                     Manifest* manifest,
+                     DeltaFarmStats* stats,
+                     std::string* error);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_DELTA_FARM_H_
@@ -0,0 +1,199 @@
+#include "file_clone.h"
+
+#include <filesystem>
+#include <system_error>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
+#include "file_util.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+namespace {
+
+#if defined(__linux__)
+
+// Opens |to| for a clone of |in|, with the source's permission bits.
+int CreateTarget(const std::string& to, int in) {
+  struct stat st;
+  if (fstat(in, &st) != 0) {
+    return -1;
+  }
+  const int out =
+      open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (out >= 0) {
+    fchmod(out, st.st_mode & 07777);
+  }
+  return out;
+}
+
+bool Reflink(const std::string& from, const std::string& to) {
+  const int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) {
+    return false;
+  }
+  const int out = CreateTarget(to, in);
+  const bool cloned = out >= 0 && ioctl(out, FICLONE, in) == 0;
+  if (out >= 0) {
+    close(out);
+    if (!cloned) {
+      unlink(to.c_str());
+    }
+  }
+  close(in);
+  return cloned;
+}
+
+bool CopyRange(const std::string& from, const std::string& to) {
+  const int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) {
+    return false;
+  }
+  const int out = CreateTarget(to, in);
+  bool copied = out >= 0;
+  while (copied) {
+    const ssize_t n =
+        copy_file_range(in, nullptr, out, nullptr, size_t{1} << 30, 0);
+    if (n == 0) {
+      break;
+    }
+    if (n < 0) {
+      // EXDEV, ENOSYS, EOPNOTSUPP and friends: not possible here.
+      copied = errno == EINTR;
+    }
+  }
+  if (out >= 0 && close(out) != 0) {
+    copied = false;
+  }
+  if (out >= 0 && !copied) {
+    unlink(to.c_str());
+  }
+  close(in);
+  return copied;
+}
+
+using Extent = std::pair<uint64_t, uint64_t>;
+
+// Reads the physical extents of |path|. |all_shared| tells whether every
+// extent carries FIEMAP_EXTENT_SHARED.
+bool ReadExtents(const std::string& path,
+                 std::vector<Extent>* out,
+                 bool* all_shared) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  constexpr unsigned kBatch = 64;
+  // uint64_t storage keeps struct fiemap aligned.
+  std::vector<uint64_t> storage(
+      (sizeof(fiemap) + kBatch * sizeof(fiemap_extent)) / sizeof(uint64_t) +
+      1);
+  fiemap* map = reinterpret_cast<fiemap*>(storage.data());
+  *all_shared = true;
+  uint64_t start = 0;
+  bool ok = true;
+  bool last = false;
+  while (ok && !last) {
+    memset(storage.data(), 0, storage.size() * sizeof(uint64_t));
+    map->fm_start = start;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_flags = FIEMAP_FLAG_SYNC;
+    map->fm_extent_count = kBatch;
+    if (ioctl(fd, FS_IOC_FIEMAP, map) != 0) {
+      ok = false;
+      break;
+    }
+    if (map->fm_mapped_extents == 0) {
+      break;
+    }
+    for (unsigned i = 0; i < map->fm_mapped_extents; i++) {
+      const fiemap_extent& extent = map->fm_extents[i];
+      if ((extent.fe_flags &
+           (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE)) != 0) {
+        ok = false;
+        break;
+      }
+      if ((extent.fe_flags & FIEMAP_EXTENT_SHARED) == 0) {
+        *all_shared = false;
+      }
+      out->emplace_back(extent.fe_physical, extent.fe_length);
+      start = extent.fe_logical + extent.fe_length;
+      last = (extent.fe_flags & FIEMAP_EXTENT_LAST) != 0;
+    }
+  }
+  close(fd);
+  return ok && !out->empty();
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+CloneMethod CloneFile(const std::string& from,
+                      const std::string& to,
+                      bool allow_hard_link) {
+#if defined(__linux__)
+  if (Reflink(from, to)) {
+    return CloneMethod::kReflink;
+  }
+#elif defined(__APPLE__)
+  if (clonefile(from.c_str(), to.c_str(), CLONE_NOFOLLOW) == 0) {
+    return CloneMethod::kReflink;
+  }
+#endif
+  if (allow_hard_link) {
+    std::error_code ec;
+    fs::create_hard_link(PathFromUtf8(from), PathFromUtf8(to), ec);
+    if (!ec) {
+      return CloneMethod::kHardLink;
+    }
+  }
+#if defined(__linux__)
+  if (CopyRange(from, to)) {
+    return CloneMethod::kCopyRange;
+  }
+#endif
+  return CloneMethod::kNone;
+}
+
+SharedStorage CheckSharedStorage(const std::string& a, const std::string& b) {
+  std::error_code ec;
+  if (fs::equivalent(PathFromUtf8(a), PathFromUtf8(b), ec)) {
+    return SharedStorage::kShared;
+  }
+  if (ec) {
+    return SharedStorage::kUnknown;
+  }
+#if defined(__linux__)
+  std::vector<Extent> a_extents;
+  std::vector<Extent> b_extents;
+  bool a_shared = false;
+  bool b_shared = false;
+  if (!ReadExtents(a, &a_extents, &a_shared) ||
+      !ReadExtents(b, &b_extents, &b_shared)) {
+    return SharedStorage::kUnknown;
+  }
+  return a_extents == b_extents && a_shared && b_shared
+             ? SharedStorage::kShared
+             : SharedStorage::kDistinct;
+#else
+  return SharedStorage::kUnknown;
+#endif
+}
+
+}  // namespace desktop_updater
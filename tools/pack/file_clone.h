@@ -0,0 +1,49 @@
+#ifndef DESKTOP_UPDATER_FILE_CLONE_H_
+#define DESKTOP_UPDATER_FILE_CLONE_H_
+
+#include <string>
+
+namespace desktop_updater {
+
+// How CloneFile() materialized a file.
+enum class CloneMethod {
+  // Nothing applied; the caller copies the bytes itself.
+  kNone,
+  // Copy-on-write clone sharing the source's extents (FICLONE on Btrfs,
+  // XFS and bcachefs, clonefile() on APFS).
+  kReflink,
+  // Second name for the source's inode.
+  kHardLink,
+  // In-kernel copy with copy_file_range(), which some filesystems and NFS
+  // servers turn into a clone or server-side copy.
+  kCopyRange,
+};
+
+/**
+ * @brief Creates |to| with the contents of |from| without moving the bytes
+ *        through user space, trying a reflink, then a hard link when
+ *        |allow_hard_link| is set, then copy_file_range().
+ *
+ * |to| must not exist. Returns kNone, leaving no file behind, when no
+ * method works here, e.g. across filesystems or on ext4 without
+ * copy_file_range().
+ */
+CloneMethod CloneFile(const std::string& from,
+                      const std::string& to,
+                      bool allow_hard_link);
+
+enum class SharedStorage {
+  // Same inode, or the same physical extents all flagged shared.
+  kShared,
+  kDistinct,
+  // The filesystem cannot tell, e.g. no FIEMAP or an empty file.
+  kUnknown,
+};
+
+// Checks whether |a| and |b| are backed by the same storage, by inode and,
+// on Linux, by FIEMAP extents.
+SharedStorage CheckSharedStorage(const std::string& a, const std::string& b);
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_FILE_CLONE_H_
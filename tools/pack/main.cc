@@ -0,0 +1,174 @@
+// desktop_updater_pack: copies a build into its release folder and writes
+// hashes.json and hashes.bin in one parallel pass. Used by bin/release.dart
+// and bin/archive.dart when it is on PATH or named by DESKTOP_UPDATER_PACK.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "release_packer.h"
+
+namespace {
+
+constexpr char kUsage[] =
+    "Usage: desktop_updater_pack [options] <source> <output>\n"
+    "\n"
+    "Copies the build in <source> to the release folder <output> and writes\n"
+    "<output>/hashes.json and hashes.bin. With <output> equal to <source>\n"
+    "the files are only hashed.\n"
+    "\n"
+    "Options:\n"
+    "  --threads=N      worker threads (default: one per core)\n"
+    "  --gzip           also write hashes.json.gz and hashes.bin.gz\n"
+    "  --stage=MODE     how files reach <output>: auto (reflink, then\n"
+    "                   copy_file_range, then copy; the default), hardlink\n"
+    "                   (hard links first; only for sources that are never\n"
+    "                   rewritten in place) or copy\n"
+    "  --no-manifest    only stage the tree, without hashes.json/bin\n"
+    "  --separator=C    manifest path separator, '/' or '\\' (default: the\n"
+    "                   platform's, like bin/archive.dart)\n"
+    "  --previous=DIR   earlier release folder to publish patches from into\n"
+    "                   <output>/patches; repeat for a window of releases\n"
+    "  --max-patch-ratio=R\n"
+    "                   drop patches of at least R times the file size\n"
+    "                   (default: 0.5)\n"
+    "  --worker-memory=MIB\n"
+    "                   memory budget of one patch worker (default: 1024)\n"
+    "  --no-elf-delta   only plain patches, also for ELF executables\n"
+    "  --objects=DIR    also publish every file by digest into DIR, shared\n"
+    "                   by all release folders, and list it as the entry's\n"
+    "                   \"object\" in the manifests\n"
+    "  --objects-url=URL\n"
+    "                   DIR as seen from <output> on the server (default:\n"
+    "                   the relative path, e.g. ../objects)\n"
+    "  --objects-only   keep only the manifests and patches in <output>;\n"
+    "                   clients older than \"object\" cannot update from it\n"
+    "  --shard-depth=N  also split the manifest by the first N directories\n"
+    "                   into shards/ with a hashes.index.json, which the\n"
+    "                   native updater fetches in parallel\n";
+
+bool ParseStageMode(const char* value, desktop_updater::StageMode* out) {
+  if (strcmp(value, "auto") == 0) {
+    *out = desktop_updater::StageMode::kAuto;
+  } else if (strcmp(value, "hardlink") == 0) {
+    *out = desktop_updater::StageMode::kHardLink;
+  } else if (strcmp(value, "copy") == 0) {
+    *out = desktop_updater::StageMode::kCopy;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool StartsWith(const char* arg, const char* prefix, const char** value) {
+  const size_t length = strlen(prefix);
+  if (strncmp(arg, prefix, length) != 0) {
+    return false;
+  }
+  *value = arg + length;
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  desktop_updater::PackOptions options;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const char* value = nullptr;
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      fputs(kUsage, stdout);
+      return 0;
+    } else if (strcmp(argv[i], "--gzip") == 0) {
+      options.gzip = true;
+    } else if (strcmp(argv[i], "--no-manifest") == 0) {
+      options.write_manifests = false;
+    } else if (StartsWith(argv[i], "--stage=", &value)) {
+      if (!ParseStageMode(value, &options.stage)) {
+        fprintf(stderr, "Unknown stage mode %s\n\n%s", value, kUsage);
+        return 2;
+      }
+    } else if (StartsWith(argv[i], "--threads=", &value)) {
+      options.threads = static_cast<unsigned>(strtoul(value, nullptr, 10));
+    } else if (StartsWith(argv[i], "--separator=", &value) &&
+               (strcmp(value, "/") == 0 || strcmp(value, "\\") == 0)) {
+      options.separator = value[0];
+    } else if (StartsWith(argv[i], "--previous=", &value)) {
+      options.previous_releases.push_back(value);
+    } else if (StartsWith(argv[i], "--max-patch-ratio=", &value)) {
+      options.delta.max_patch_ratio = strtod(value, nullptr);
+    } else if (StartsWith(argv[i], "--worker-memory=", &value)) {
+      options.delta.worker_memory_budget =
+          static_cast<uint64_t>(strtoull(value, nullptr, 10)) << 20;
+    } else if (strcmp(argv[i], "--no-elf-delta") == 0) {
+      options.delta.elf = false;
+    } else if (StartsWith(argv[i], "--objects=", &value)) {
+      options.objects_dir = value;
+    } else if (StartsWith(argv[i], "--objects-url=", &value)) {
+      options.objects_url = value;
+    } else if (StartsWith(argv[i], "--shard-depth=", &value)) {
+      options.shard_depth = atoi(value);
+    } else if (strcmp(argv[i], "--objects-only") == 0) {
+      options.objects_only = true;
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "Unknown option %s\n\n%s", argv[i], kUsage);
+      return 2;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  desktop_updater::Manifest manifest;
+  desktop_updater::PackStats stats;
+  std::string error;
+  if (!desktop_updater::PackRelease(paths[0], paths[1], options, &manifest,
+                                    &stats, &error)) {
+    fprintf(stderr, "desktop_updater_pack: %s\n", error.c_str());
+    return 1;
+  }
+  printf("Packed %llu files (%.1f MiB, %llu links) into %s in %llu ms\n",
+         static_cast<unsigned long long>(stats.files),
+         static_cast<double>(stats.bytes) / (1 << 20),
+         static_cast<unsigned long long>(stats.symlinks), paths[1].c_str(),
+         static_cast<unsigned long long>(stats.elapsed_ms));
+  printf("  %llu reflinked, %llu hard-linked, %llu copied in kernel, "
+         "%llu copied; %llu verified as shared\n",
+         static_cast<unsigned long long>(stats.reflinked),
+         static_cast<unsigned long long>(stats.hard_linked),
+         static_cast<unsigned long long>(stats.copy_ranged),
+         static_cast<unsigned long long>(stats.copied),
+         static_cast<unsigned long long>(stats.verified_shared));
+  if (!options.previous_releases.empty()) {
+    const desktop_updater::DeltaFarmStats& delta = stats.delta;
+    printf("  %llu patches (%llu ELF-aware, %.1f of %.1f MiB) from %llu "
+           "candidates in %llu ms; %llu too large, %llu over the memory "
+           "budget, %llu stolen\n",
+           static_cast<unsigned long long>(delta.patches),
+           static_cast<unsigned long long>(delta.elf_patches),
+           static_cast<double>(delta.patch_bytes) / (1 << 20),
+           static_cast<double>(delta.full_bytes) / (1 << 20),
+           static_cast<unsigned long long>(delta.candidates),
+           static_cast<unsigned long long>(delta.elapsed_ms),
+           static_cast<unsigned long long>(delta.skipped_ratio),
+           static_cast<unsigned long long>(delta.skipped_budget),
+           static_cast<unsigned long long>(delta.stolen));
+  }
+  if (stats.shards != 0) {
+    printf("  manifest split into %llu shards\n",
+           static_cast<unsigned long long>(stats.shards));
+  }
+  if (!options.objects_dir.empty()) {
+    printf("  %llu objects published (%.1f MiB), %llu already in %s\n",
+           static_cast<unsigned long long>(stats.objects_published),
+           static_cast<double>(stats.object_bytes) / (1 << 20),
+           static_cast<unsigned long long>(stats.objects_reused),
+           options.objects_dir.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,603 @@
+#include "release_packer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef DESKTOP_UPDATER_PACK_ZLIB
+#include <zlib.h>
+#endif
+
+#include "blake2b.h"
+#include "counting_allocator.h"
+#include "file_clone.h"
+#include "file_util.h"
+#include "manifest_index.h"
+
+namespace fs = std::filesystem;
+
+namespace desktop_updater {
+
+namespace {
+
+constexpr size_t kCopyBufferSize = 1 << 20;
+constexpr char kDsStoreName[] = ".DS_Store";
+
+bool IsManifestName(const std::string& name) {
+  if (name == kManifestIndexName) {
+    return true;
+  }
+  for (const std::string manifest : {kHashesJsonName, kHashesBinName}) {
+    if (name == manifest || name == manifest + kGzipSuffix) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true when |path| is |dir| or below it.
+bool IsWithin(const fs::path& dir, const fs::path& path) {
+  std::error_code ec;
+  const fs::path canonical_dir = fs::weakly_canonical(dir, ec);
+  const fs::path canonical_path = fs::weakly_canonical(path, ec);
+  const auto mismatch =
+      std::mismatch(canonical_dir.begin(), canonical_dir.end(),
+                    canonical_path.begin(), canonical_path.end());
+  return mismatch.first == canonical_dir.end();
+}
+
+/**
+ * Lists the regular files below |source| as '/'-separated relative paths,
+ * sorted. With a non-empty |output| the directories and symbolic links are
+ * recreated there on the way.
+ */
+bool ListTree(const fs::path& source,
+              const fs::path& output,
+              std::vector<std::string>* files,
+              PackStats* stats,
+              std::string* error) {
+  std::error_code ec;
+  fs::recursive_directory_iterator it(source, ec);
+  const fs::recursive_directory_iterator end;
+  for (; !ec && it != end; it.increment(ec)) {
+    const fs::path relative = it->path().lexically_relative(source);
+    const std::string name = it->path().filename().u8string();
+    if ((it.depth() == 0 &&
+         (IsManifestName(name) || name == kPatchDirName ||
+          name == kManifestShardDirName)) ||
+        name == kDsStoreName) {
+      it.disable_recursion_pending();
+      continue;
+    }
+    std::error_code status_ec;
+    const fs::file_status status = it->symlink_status(status_ec);
+    if (status_ec) {
+      *error = "Cannot stat " + it->path().u8string() + ": " +
+               status_ec.message();
+      return false;
+    }
+    if (fs::is_symlink(status)) {
+      if (!output.empty()) {
+        const fs::path link = output / relative;
+        fs::remove(link, status_ec);
+        fs::copy_symlink(it->path(), link, status_ec);
+        if (status_ec) {
+          *error = "Cannot create link " + link.u8string() + ": " +
+                   status_ec.message();
+          return false;
+        }
+      }
+      stats->symlinks++;
+    } else if (fs::is_directory(status)) {
+      if (!output.empty()) {
+        fs::create_directories(output / relative, status_ec);
+        if (status_ec) {
+          *error = "Cannot create directory " + (output / relative).u8string() +
+                   ": " + status_ec.message();
+          return false;
+        }
+      }
+    } else if (fs::is_regular_file(status)) {
+      files->push_back(relative.generic_u8string());
+    }
+  }
+  if (ec) {
+    *error = "Failed to scan " + source.u8string() + ": " + ec.message();
+    return false;
+  }
+  std::sort(files->begin(), files->end());
+  return true;
+}
+
+// Reads |from| once, hashing and writing every block to |to|.
+bool CopyAndHash(const std::string& from,
+                 const std::string& to,
+                 uint8_t* buffer,
+                 FileEntry* entry,
+                 std::string* error) {
+  FILE* in = OpenFile(from, "rb");
+  if (in == nullptr) {
+    *error = "Cannot open " + from;
+    return false;
+  }
+  FILE* out = OpenFile(to, "wb");
+  if (out == nullptr) {
+    fclose(in);
+    *error = "Cannot create " + to;
+    return false;
+  }
+  Blake2b hash;
+  uint64_t total = 0;
+  bool write_failed = false;
+  size_t read = 0;
+  while ((read = fread(buffer, 1, kCopyBufferSize, in)) > 0) {
+    hash.Update(buffer, read);
+    total += read;
+    if (fwrite(buffer, 1, read, out) != read) {
+      write_failed = true;
+      break;
+    }
+  }
+  const bool read_failed = ferror(in) != 0;
+  fclose(in);
+  if (fclose(out) != 0) {
+    write_failed = true;
+  }
+  if (read_failed || write_failed) {
+    *error = (read_failed ? "Failed to read " : "Failed to write ") +
+             (read_failed ? from : to);
+    return false;
+  }
+  hash.Final(entry->digest.data());
+  entry->length = total;
+
+  // Keeps the executable bits; File.copy in bin/archive.dart did too.
+  std::error_code ec;
+  const fs::file_status status = fs::status(PathFromUtf8(from), ec);
+  if (!ec) {
+    fs::permissions(PathFromUtf8(to), status.permissions(), ec);
+  }
+  return true;
+}
+
+struct StageCounters {
+  std::atomic<uint64_t> reflinked{0};
+  std::atomic<uint64_t> hard_linked{0};
+  std::atomic<uint64_t> copy_ranged{0};
+  std::atomic<uint64_t> copied{0};
+  std::atomic<uint64_t> verified_shared{0};
+};
+
+// Materializes |to| from |from| as |options.stage| allows and hashes it.
+bool StageFile(const std::string& from,
+               const std::string& to,
+               const PackOptions& options,
+               uint8_t* buffer,
+               FileEntry* entry,
+               StageCounters* counters,
+               std::string* error) {
+  // A hard link left by an earlier run must be replaced, not written
+  // through into its source.
+  std::error_code ec;
+  fs::remove(PathFromUtf8(to), ec);
+
+  const CloneMethod method =
+      options.stage == StageMode::kCopy
+          ? CloneMethod::kNone
+          : CloneFile(from, to, options.stage == StageMode::kHardLink);
+  switch (method) {
+    case CloneMethod::kNone:
+      counters->copied++;
+      return CopyAndHash(from, to, buffer, entry, error);
+    case CloneMethod::kReflink:
+      counters->reflinked++;
+      break;
+    case CloneMethod::kHardLink:
+      counters->hard_linked++;
+      break;
+    case CloneMethod::kCopyRange:
+      counters->copy_ranged++;
+      break;
+  }
+  if (method != CloneMethod::kCopyRange) {
+    const SharedStorage shared = CheckSharedStorage(from, to);
+    if (shared == SharedStorage::kShared) {
+      counters->verified_shared++;
+    } else if (shared == SharedStorage::kDistinct &&
+               method == CloneMethod::kHardLink) {
+      *error = to + " is not a link to " + from;
+      return false;
+    }
+  }
+  return !options.write_manifests ||
+         HashFile(from, &entry->digest, &entry->length, error);
+}
+
+struct ObjectCounters {
+  std::atomic<uint64_t> published{0};
+  std::atomic<uint64_t> reused{0};
+  std::atomic<uint64_t> bytes{0};
+};
+
+// Adds |file|, described by |entry|, to the object store in |objects_dir|
+// unless the store already holds its contents. |stage| decides how, as
+// for the release folder.
+bool PublishObject(const std::string& file,
+                   const std::string& objects_dir,
+                   size_t index,
+                   const FileEntry& entry,
+                   StageMode stage,
+                   ObjectCounters* counters,
+                   std::string* error) {
+  const std::string object = JoinPath(objects_dir, ObjectName(entry.digest));
+  const fs::path object_path = PathFromUtf8(object);
+  std::error_code ec;
+  if (fs::is_regular_file(object_path, ec) &&
+      fs::file_size(object_path, ec) == entry.length && !ec) {
+    counters->reused++;
+    return true;
+  }
+
+  // Renamed into place, so neither a server nor another worker publishing
+  // the same contents sees a partial object.
+  const std::string partial =
+      object + "." + std::to_string(index) + ".partial";
+  const fs::path partial_path = PathFromUtf8(partial);
+  fs::remove(partial_path, ec);
+  if (stage == StageMode::kCopy ||
+      CloneFile(file, partial, stage == StageMode::kHardLink) ==
+          CloneMethod::kNone) {
+    ec.clear();
+    fs::copy_file(PathFromUtf8(file), partial_path, ec);
+    if (ec) {
+      *error = "Cannot publish " + object + ": " + ec.message();
+      return false;
+    }
+  }
+  fs::rename(partial_path, object_path, ec);
+  if (ec) {
+    *error = "Cannot publish " + object + ": " + ec.message();
+    fs::remove(partial_path, ec);
+    return false;
+  }
+  counters->published++;
+  counters->bytes += entry.length;
+  return true;
+}
+
+#ifdef DESKTOP_UPDATER_PACK_ZLIB
+// Compresses |data| as gzip. zlib leaves the header's mtime at zero, so the
+// output only depends on the input.
+bool Gzip(const std::string& data, std::string* out, std::string* error) {
+  z_stream stream = {};
+  if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    *error = "Cannot initialize zlib";
+    return false;
+  }
+  out->resize(deflateBound(&stream, static_cast<uLong>(data.size())));
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+  stream.avail_out = static_cast<uInt>(out->size());
+  const int result = deflate(&stream, Z_FINISH);
+  out->resize(stream.total_out);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    *error = "Failed to compress manifest";
+    return false;
+  }
+  return true;
+}
+#endif
+
+bool WriteManifestFile(const std::string& output,
+                       const std::string& name,
+                       const std::string& data,
+                       bool gzip,
+                       std::string* error) {
+  const std::string path = JoinPath(output, name);
+  if (!WriteFileBytes(path, reinterpret_cast<const uint8_t*>(data.data()),
+                      data.size(), error)) {
+    return false;
+  }
+  const std::string gzip_path = path + kGzipSuffix;
+  if (!gzip) {
+    // A variant left from an earlier run would no longer match.
+    std::error_code ec;
+    fs::remove(PathFromUtf8(gzip_path), ec);
+    return true;
+  }
+#ifdef DESKTOP_UPDATER_PACK_ZLIB
+  std::string compressed;
+  return Gzip(data, &compressed, error) &&
+         WriteFileBytes(gzip_path,
+                        reinterpret_cast<const uint8_t*>(compressed.data()),
+                        compressed.size(), error);
+#else
+  *error = "Built without zlib; cannot write " + gzip_path;
+  return false;
+#endif
+}
+
+// Writes the shards of |manifest| and their hashes.index.json, or only
+// removes those of an earlier run when |depth| is 0.
+bool WriteShards(const std::string& output,
+                 const Manifest& manifest,
+                 int depth,
+                 uint64_t* count,
+                 std::string* error) {
+  std::error_code ec;
+  fs::remove_all(PathFromUtf8(JoinPath(output, kManifestShardDirName)), ec);
+  fs::remove(PathFromUtf8(JoinPath(output, kManifestIndexName)), ec);
+  if (depth <= 0) {
+    return true;
+  }
+
+  ManifestIndex index;
+  std::vector<Manifest> shards;
+  ShardManifest(manifest, depth, &index, &shards);
+  for (size_t i = 0; i < index.size(); i++) {
+    const std::string data = SerializeManifest(shards[i]);
+    ManifestShard& shard = index[i];
+    Blake2b hash;
+    hash.Update(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+    hash.Final(shard.digest.data());
+    // Named by contents, so caches never serve a shard of another release.
+    shard.path = std::string(kManifestShardDirName) + "/" +
+                 ObjectName(shard.digest).substr(0, 16) + ".json";
+    shard.length = data.size();
+    const std::string path = JoinPath(output, shard.path);
+    if (!CreateParentDirectories(path, error) ||
+        !WriteFileBytes(path, reinterpret_cast<const uint8_t*>(data.data()),
+                        data.size(), error)) {
+      return false;
+    }
+  }
+  const std::string data = SerializeManifestIndex(index);
+  *count = index.size();
+  return WriteFileBytes(JoinPath(output, kManifestIndexName),
+                        reinterpret_cast<const uint8_t*>(data.data()),
+                        data.size(), error);
+}
+
+}  // namespace
+
+std::string ObjectName(const Digest& digest) {
+  static const char kHex[] = "0123456789abcdef";
+  std::string name;
+  name.reserve(64);
+  for (size_t i = 0; i < 32; i++) {
+    name.push_back(kHex[digest[i] >> 4]);
+    name.push_back(kHex[digest[i] & 0x0F]);
+  }
+  return name;
+}
+
+bool PackerHasGzip() {
+#ifdef DESKTOP_UPDATER_PACK_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool PackRelease(const std::string& source,
+                 const std::string& output,
+                 const PackOptions& options,
+                 Manifest* manifest,
+                 PackStats* stats,
+                 std::string* error) {
+  const auto start = std::chrono::steady_clock::now();
+  *stats = PackStats();
+  if (options.gzip && !PackerHasGzip()) {
+    *error = "Built without zlib; --gzip is unavailable";
+    return false;
+  }
+
+  std::error_code ec;
+  const fs::path source_path = PathFromUtf8(source);
+  if (!fs::is_directory(source_path, ec)) {
+    *error = "Directory does not exist: " + source;
+    return false;
+  }
+  const fs::path output_path = PathFromUtf8(output);
+  const bool in_place = fs::equivalent(source_path, output_path, ec);
+  if (!in_place) {
+    // The copy would otherwise list itself while it grows.
+    if (IsWithin(source_path, output_path)) {
+      *error = "Output " + output + " is inside " + source;
+      return false;
+    }
+    fs::create_directories(output_path, ec);
+    if (ec) {
+      *error = "Cannot create directory " + output + ": " + ec.message();
+      return false;
+    }
+  }
+
+  std::string objects_url = options.objects_url;
+  if (options.objects_only && options.objects_dir.empty()) {
+    *error = "Objects only needs an object store";
+    return false;
+  }
+  if (!options.objects_dir.empty()) {
+    const fs::path objects_path = PathFromUtf8(options.objects_dir);
+    if (!options.write_manifests) {
+      *error = "Publishing objects needs the manifests";
+      return false;
+    }
+    if (options.objects_only && in_place) {
+      *error = "Objects only would remove the build in " + source;
+      return false;
+    }
+    if (IsWithin(source_path, objects_path) ||
+        IsWithin(output_path, objects_path)) {
+      *error = "Object store " + options.objects_dir +
+               " is inside the source or release folder";
+      return false;
+    }
+    fs::create_directories(objects_path, ec);
+    if (ec) {
+      *error = "Cannot create directory " + options.objects_dir + ": " +
+               ec.message();
+      return false;
+    }
+    if (objects_url.empty()) {
+      objects_url = fs::weakly_canonical(objects_path, ec)
+                        .lexically_relative(
+                            fs::weakly_canonical(output_path, ec))
+                        .generic_u8string();
+    }
+    while (!objects_url.empty() && objects_url.back() == '/') {
+      objects_url.pop_back();
+    }
+    if (objects_url.empty()) {
+      *error = "No URL for the object store " + options.objects_dir;
+      return false;
+    }
+  }
+
+  std::vector<std::string> files;
+  if (!ListTree(source_path, in_place ? fs::path() : output_path, &files,
+                stats, error)) {
+    return false;
+  }
+
+  // Objects outlive the build: one linked to a file the next build
+  // rewrites in place would no longer match its digest.
+  const StageMode object_stage =
+      in_place && options.stage == StageMode::kHardLink ? StageMode::kAuto
+                                                        : options.stage;
+
+  manifest->assign(files.size(), FileEntry());
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::atomic<uint64_t> bytes{0};
+  StageCounters counters;
+  ObjectCounters objects;
+  std::mutex error_mutex;
+
+  auto worker = [&]() {
+    ByteBuffer buffer(kCopyBufferSize);
+    std::string file_error;
+    while (!failed.load(std::memory_order_relaxed)) {
+      const size_t index = next.fetch_add(1, std::memory_order_relaxed);
+      if (index >= files.size()) {
+        return;
+      }
+      FileEntry& entry = (*manifest)[index];
+      const std::string from = JoinPath(source, files[index]);
+      const std::string to = JoinPath(output, files[index]);
+      bool ok =
+          in_place ? HashFile(from, &entry.digest, &entry.length, &file_error)
+                   : StageFile(from, to, options, buffer.data(), &entry,
+                               &counters, &file_error);
+      if (ok && !options.objects_dir.empty()) {
+        ok = PublishObject(to, options.objects_dir, index, entry,
+                           object_stage, &objects, &file_error);
+        entry.object = objects_url + "/" + ObjectName(entry.digest);
+      }
+      if (!ok) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!failed.exchange(true)) {
+          *error = file_error;
+        }
+        return;
+      }
+      entry.path = files[index];
+      if (options.separator != '/') {
+        std::replace(entry.path.begin(), entry.path.end(), '/',
+                     options.separator);
+      }
+      bytes.fetch_add(entry.length, std::memory_order_relaxed);
+    }
+  };
+
+  unsigned threads = options.threads;
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = static_cast<unsigned>(
+      std::min<size_t>(threads, std::max<size_t>(files.size(), 1)));
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (unsigned i = 1; i < threads; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : workers) {
+    thread.join();
+  }
+  if (failed.load()) {
+    return false;
+  }
+
+  if (!options.previous_releases.empty()) {
+    std::vector<PreviousRelease> previous(options.previous_releases.size());
+    for (size_t i = 0; i < previous.size(); i++) {
+      if (!LoadPreviousRelease(options.previous_releases[i], &previous[i],
+                               error)) {
+        *error = options.previous_releases[i] + ": " + *error;
+        return false;
+      }
+    }
+    DeltaFarmOptions delta = options.delta;
+    if (delta.threads == 0) {
+      delta.threads = options.threads;
+    }
+    if (!GeneratePatches(output, previous, delta, manifest, &stats->delta,
+                         error)) {
+      return false;
+    }
+  }
+
+  if (options.objects_only) {
+    // Patches were generated from the staged copies; the store has the rest.
+    for (const std::string& file : files) {
+      fs::remove(PathFromUtf8(JoinPath(output, file)), ec);
+      if (ec) {
+        *error = "Cannot remove " + JoinPath(output, file) + ": " +
+                 ec.message();
+        return false;
+      }
+    }
+  }
+
+  // The '/'-sorted order of |files| is kept, whatever the separator.
+  if (options.write_manifests &&
+      (!WriteManifestFile(output, kHashesJsonName,
+                          SerializeManifest(*manifest), options.gzip, error) ||
+       !WriteManifestFile(output, kHashesBinName,
+                          SerializeBinaryManifest(*manifest), options.gzip,
+                          error) ||
+       !WriteShards(output, *manifest, options.shard_depth, &stats->shards,
+                    error))) {
+    return false;
+  }
+
+  stats->files = files.size();
+  stats->bytes = bytes.load();
+  stats->reflinked = counters.reflinked.load();
+  stats->hard_linked = counters.hard_linked.load();
+  stats->copy_ranged = counters.copy_ranged.load();
+  stats->copied = counters.copied.load();
+  stats->verified_shared = counters.verified_shared.load();
+  stats->objects_published = objects.published.load();
+  stats->objects_reused = objects.reused.load();
+  stats->object_bytes = objects.bytes.load();
+  stats->elapsed_ms = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+  return true;
+}
+
+}  // namespace desktop_updater
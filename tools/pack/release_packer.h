@@ -0,0 +1,120 @@
+#ifndef DESKTOP_UPDATER_RELEASE_PACKER_H_
+#define DESKTOP_UPDATER_RELEASE_PACKER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "delta_farm.h"
+#include "file_hash.h"
+#include "manifest.h"
+
+namespace desktop_updater {
+
+// Manifests the packer writes at the top of the release folder. They are
+// never listed in the manifest themselves.
+constexpr char kHashesJsonName[] = "hashes.json";
+constexpr char kHashesBinName[] = "hashes.bin";
+// Suffix of the compressed variants written with PackOptions::gzip.
+constexpr char kGzipSuffix[] = ".gz";
+
+// How the packer materializes the files of the release folder.
+enum class StageMode {
+  // Reflinks where the filesystem supports them, then copy_file_range(),
+  // then a read/write copy. The copy never shares an inode with the source.
+  kAuto,
+  // Hard links, falling back like kAuto, e.g. across filesystems. Only for
+  // sources nothing rewrites in place afterwards, such as dist/ trees.
+  kHardLink,
+  // Always reads and writes the bytes.
+  kCopy,
+};
+
+struct PackOptions {
+  // Worker count; 0 uses the hardware concurrency.
+  unsigned threads = 0;
+  StageMode stage = StageMode::kAuto;
+  // Without manifests the packer only stages the tree, for
+  // bin/release.dart's copy of the build into dist/.
+  bool write_manifests = true;
+  // Also writes hashes.json.gz and hashes.bin.gz. Needs zlib.
+  bool gzip = false;
+  // Separator of the manifest paths, as written by bin/archive.dart on the
+  // platform the release is for.
+  char separator = kPathSeparator;
+  // Earlier release folders to generate patches from; see
+  // GeneratePatches().
+  std::vector<std::string> previous_releases;
+  DeltaFarmOptions delta;
+  // Content-addressed store, e.g. dist/objects, shared by every release
+  // folder. Each file is also published there as objects/<hex>, named by
+  // the first 32 bytes of its digest, and its manifest entry gets an
+  // "object" so clients fetch one URL per content whatever the release.
+  // Objects already in the store are reused. They are staged like the
+  // release folder, except never as hard links to a build packed in place.
+  std::string objects_dir;
+  // |objects_dir| as seen from the release folder on the server; defaults
+  // to the path from |output| to |objects_dir|, e.g. "../objects".
+  std::string objects_url;
+  // Leaves only the manifests and patches in the release folder. Clients
+  // that predate "object" cannot update from such a release.
+  bool objects_only = false;
+  // When positive, also splits the manifest by the first |shard_depth|
+  // directories of each path into shards/ and writes hashes.index.json,
+  // which native clients fetch instead of hashes.json.
+  int shard_depth = 0;
+};
+
+struct PackStats {
+  uint64_t files = 0;
+  uint64_t bytes = 0;
+  uint64_t symlinks = 0;
+  // Files by staging method.
+  uint64_t reflinked = 0;
+  uint64_t hard_linked = 0;
+  uint64_t copy_ranged = 0;
+  uint64_t copied = 0;
+  // Linked files confirmed to share storage with the source, by inode or
+  // by extents.
+  uint64_t verified_shared = 0;
+  DeltaFarmStats delta;
+  // Objects added to the store, and files whose object was already there.
+  uint64_t objects_published = 0;
+  uint64_t objects_reused = 0;
+  uint64_t object_bytes = 0;
+  uint64_t shards = 0;
+  uint64_t elapsed_ms = 0;
+};
+
+/**
+ * @brief Copies the build in |source| to the release folder |output| and
+ *        writes its hashes.json and hashes.bin.
+ *
+ * Every file is read once, hashed and staged by the same worker, on
+ * |options.threads| workers; see StageMode for how files reach |output|.
+ * Files already in |output| are replaced, never written through. Symbolic
+ * links are recreated rather than followed or listed, and .DS_Store files
+ * are skipped, like bin/archive.dart does. When |output| is |source| the
+ * files are only hashed. With |options.previous_releases| the manifests
+ * also list patches from those releases, and with |options.objects_dir|
+ * the files are published by digest as well.
+ *
+ * The manifests are sorted by path, so packing the same build twice gives
+ * byte-identical output.
+ */
+bool PackRelease(const std::string& source,
+                 const std::string& output,
+                 const PackOptions& options,
+                 Manifest* manifest,
+                 PackStats* stats,
+                 std::string* error);
+
+// Name of the object holding |digest| in PackOptions::objects_dir.
+std::string ObjectName(const Digest& digest);
+
+// Returns true when the packer was built with zlib, for PackOptions::gzip.
+bool PackerHasGzip();
+
+}  // namespace desktop_updater
+
+#endif  // DESKTOP_UPDATER_RELEASE_PACKER_H_
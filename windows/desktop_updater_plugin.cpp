@@ -24,6 +24,10 @@
 #include <string>
 #include <vector>
 
+// Update engine includes
+#include "batch_script.h"
+#include "file_util.h"
+
 namespace fs = std::filesystem;
 namespace desktop_updater
 {
@@ -50,10 +54,6 @@ namespace desktop_updater
     registrar->AddPlugin(std::move(plugin));
   }
 
-  DesktopUpdaterPlugin::DesktopUpdaterPlugin() {}
-
-  DesktopUpdaterPlugin::~DesktopUpdaterPlugin() {}
-
   /**
    * @brief Converts a wide string to UTF-8 string
    * @param wideStr The wide string to convert
@@ -73,156 +73,138 @@ namespace desktop_updater
   }
 
   /**
-   * @brief Extracts the executable name from a full path
-   * @param fullPath The full path to the executable
-   * @return The executable name without path
+   * @brief Reads a string value of the executable's version resource
+   * @param verData Buffer filled by GetFileVersionInfoW
+   * @param name Value name, e.g. L"ProductVersion"
+   * @param value Receives the UTF-8 value
+   * @return true if the value exists
    */
-  std::string ExtractExecutableName(const std::string &fullPath)
+  static bool QueryVersionString(const std::vector<BYTE> &verData, const wchar_t *name, std::string *value)
   {
-    size_t pos = fullPath.find_last_of("\\");
-    return (pos != std::string::npos) ? fullPath.substr(pos + 1) : fullPath;
+    // Retrieve translation information
+    struct LANGANDCODEPAGE
+    {
+      WORD wLanguage;
+      WORD wCodePage;
+    } *lpTranslate;
+
+    UINT cbTranslate = 0;
+    if (!VerQueryValueW(verData.data(), L"\\VarFileInfo\\Translation",
+                        (LPVOID *)&lpTranslate, &cbTranslate) ||
+        cbTranslate < sizeof(LANGANDCODEPAGE))
+    {
+      return false;
+    }
+
+    // Build the query string using the first translation
+    wchar_t subBlock[80];
+    swprintf(subBlock, 80, L"\\StringFileInfo\\%04x%04x\\%ls",
+             lpTranslate[0].wLanguage, lpTranslate[0].wCodePage, name);
+
+    LPVOID lpBuffer = NULL;
+    UINT size = 0;
+    if (!VerQueryValueW(verData.data(), subBlock, &lpBuffer, &size) || size == 0)
+    {
+      return false;
+    }
+    *value = WideStringToUtf8(static_cast<wchar_t *>(lpBuffer));
+    return true;
   }
 
   /**
-   * @brief Creates a robust batch script for handling application updates
+   * @brief Parses the ProductVersion resource ("1.0.0+2") of the running executable
+   * @param info Receives the parsed version
+   * @param error Receives a message on failure
+   * @return true on success
+   */
+  static bool ReadExecutableVersion(VersionInfo *info, std::string *error)
+  {
+    wchar_t exePath[MAX_PATH];
+    GetModuleFileNameW(NULL, exePath, MAX_PATH);
+
+    DWORD verHandle = 0;
+    DWORD verSize = GetFileVersionInfoSizeW(exePath, &verHandle);
+    if (verSize == 0)
+    {
+      *error = "Unable to get version size.";
+      return false;
+    }
+
+    std::vector<BYTE> verData(verSize);
+    if (!GetFileVersionInfoW(exePath, verHandle, verSize, verData.data()))
+    {
+      *error = "Unable to get version info.";
+      return false;
+    }
+
+    std::string productVersion;
+    if (!QueryVersionString(verData, L"ProductVersion", &productVersion))
+    {
+      *error = "Unable to query version value.";
+      return false;
+    }
+    if (!ParseVersionString(productVersion, info) || info->build_number.empty())
+    {
+      *error = "Invalid version format.";
+      return false;
+    }
+    QueryVersionString(verData, L"ProductName", &info->app_name);
+    return true;
+  }
+
+  DesktopUpdaterPlugin::DesktopUpdaterPlugin()
+  {
+    // The executable cannot change while it runs, so parse its version once.
+    version_ok_ = ReadExecutableVersion(&version_info_, &version_error_);
+  }
+
+  DesktopUpdaterPlugin::~DesktopUpdaterPlugin() {}
+
+  /**
+   * @brief Writes the update script for the update staged in updateDir
    *
-   * This function generates a comprehensive batch script that:
-   * 1. Waits for the application to close properly
-   * 2. Creates a complete backup of the current application
-   * 3. Copies new update files with retry logic
-   * 4. Restores backup if update fails
-   * 5. Cleans up temporary files and restarts the application
+   * The script is generated from the update plan (see batch_script.h): it
+   * waits for the application to close, moves only the changed and removed
+   * files into a backup, moves the staged files in with retries, restores
+   * the backup if that fails, then cleans up and restarts the application.
    *
    * @param updateDir Directory containing the update files
    * @param destDir Destination directory (usually current directory)
+   * @param removed Paths of the installed files the update removes
    * @param executable_path Full path to the application executable
+   * @param error Receives a message on failure
+   * @return true if the script was written
    */
-  void createBatFile(const std::wstring &updateDir, const std::wstring &destDir, const wchar_t *executable_path)
+  bool createBatFile(const std::wstring &updateDir, const std::wstring &destDir,
+                     const std::vector<std::string> &removed,
+                     const wchar_t *executable_path, std::string *error)
   {
     // Convert wide strings to UTF-8 for batch script generation
     std::string updateDirStr = WideStringToUtf8(updateDir);
     std::string destDirStr = WideStringToUtf8(destDir);
-    std::string exePathStr = WideStringToUtf8(executable_path);
-    std::string exeNameStr = ExtractExecutableName(exePathStr);
-
-    // Constants for the update process
-    const int MAX_WAIT_ATTEMPTS = 5;
-    const int MAX_RETRY_ATTEMPTS = 3;
-    const int RETRY_DELAY_SECONDS = 2;
-
-    const std::string batScript =
-        "@echo off\n"
-        "chcp 65001 > NUL\n"  // Enable UTF-8 support for non-ASCII paths
-        "echo.\n"
-        "echo ==========================================\n"
-        "echo        Application Update Process\n"
-        "echo ==========================================\n"
-        "echo.\n"
-
-        // STEP 1: Wait for application to close gracefully
-        "echo [STEP 1/5] Waiting for application to close...\n"
-        "set COUNT=0\n"
-        ":wait_loop\n"
-        "tasklist /FI \"IMAGENAME eq " + exeNameStr + "\" 2>NUL | find /I \"" + exeNameStr + "\" >NUL\n"
-        "if \"%ERRORLEVEL%\"==\"0\" (\n"
-        "    set /a COUNT+=1\n"
-        "    echo   Attempt %COUNT%/" + std::to_string(MAX_WAIT_ATTEMPTS) + " - Application still running...\n"
-        "    if %COUNT% GEQ " + std::to_string(MAX_WAIT_ATTEMPTS) + " (\n"
-        "        echo   Timeout reached - force closing application\n"
-        "        taskkill /F /IM \"" + exeNameStr + "\" >NUL 2>&1\n"
-        "        goto step2\n"
-        "    )\n"
-        "    timeout /t 1 /nobreak > NUL\n"
-        "    goto wait_loop\n"
-        ")\n"
-        "echo   Application closed successfully\n"
-        "echo.\n"
-
-        // STEP 2: Create complete backup
-        ":step2\n"
-        "echo [STEP 2/5] Creating backup restore point...\n"
-        "if exist backup (\n"
-        "    echo   Removing old backup...\n"
-        "    rmdir /s /q backup >NUL 2>&1\n"
-        ")\n"
-        "mkdir backup >NUL 2>&1\n"
-        "echo   Backing up application files...\n"
-
-        // Backup files (excluding backup folder and update script)
-        "for %%F in (*) do (\n"
-        "    if not \"%%F\"==\"backup\" (\n"
-        "        if not \"%%F\"==\"update_script.bat\" (\n"
-        "            copy \"%%F\" \"backup\\%%F\" >NUL 2>&1\n"
-        "        )\n"
-        "    )\n"
-        ")\n"
-
-        // Backup directories (excluding backup and update folders)
-        "for /D %%D in (*) do (\n"
-        "    if not \"%%D\"==\"backup\" (\n"
-        "        if not \"%%D\"==\"update\" (\n"
-        "            xcopy /E /H /C /I /Y \"%%D\" \"backup\\%%D\\\" >NUL 2>&1\n"
-        "        )\n"
-        "    )\n"
-        ")\n"
-        "echo   Backup completed successfully\n"
-        "echo.\n"
-
-        // STEP 3: Apply update with retry logic
-        "echo [STEP 3/5] Applying update...\n"
-        "set RETRY=0\n"
-        ":retry_copy\n"
-        "set /a RETRY+=1\n"
-        "echo   Update attempt %RETRY%/" + std::to_string(MAX_RETRY_ATTEMPTS) + "...\n"
-        "xcopy /E /I /Y \"" + updateDirStr + "\\*\" \"" + destDirStr + "\\\" >NUL 2>&1\n"
-        "if %ERRORLEVEL% EQU 0 (\n"
-        "    echo   Update applied successfully\n"
-        "    rmdir /s /q backup >NUL 2>&1\n"
-        "    goto cleanup\n"
-        ")\n"
-        "if %RETRY% LSS " + std::to_string(MAX_RETRY_ATTEMPTS) + " (\n"
-        "    echo   Update failed - retrying in " + std::to_string(RETRY_DELAY_SECONDS) + " seconds...\n"
-        "    timeout /t " + std::to_string(RETRY_DELAY_SECONDS) + " /nobreak > NUL\n"
-        "    goto retry_copy\n"
-        ")\n"
-        "echo   All update attempts failed\n"
-        "echo.\n"
-
-        // STEP 4: Restore backup if update failed
-        "echo [STEP 4/5] Restoring from backup...\n"
-        "echo   Update failed - restoring previous version\n"
-        "xcopy /E /H /C /I /Y backup\\*.* . >NUL 2>&1\n"
-        "if %ERRORLEVEL% EQU 0 (\n"
-        "    echo   Backup restored successfully\n"
-        ") else (\n"
-        "    echo   WARNING: Some files may not have been restored properly\n"
-        ")\n"
-        "rmdir /s /q backup >NUL 2>&1\n"
-        "echo.\n"
-
-        // STEP 5: Cleanup and restart
-        ":cleanup\n"
-        "echo [STEP 5/5] Cleanup and restart...\n"
-        "echo   Removing update files...\n"
-        "rmdir /S /Q \"" + updateDirStr + "\" >NUL 2>&1\n"
-        "echo   Starting application in foreground...\n"
-        "start /MAX \"\" \"" + exePathStr + "\"\n"
-        "timeout /t 1 /nobreak > NUL\n"
-        "echo   Cleaning up temporary files...\n"
-        "del update_script.bat >NUL 2>&1\n"
-        "echo.\n"
-        "echo Update process completed.\n"
-        "exit\n";
+
+    BatchPlan plan;
+    if (!PlanBatchUpdate(destDirStr, JoinPath(destDirStr, updateDirStr), removed, &plan, error))
+    {
+      return false;
+    }
+
+    BatchScriptOptions options;
+    options.executable_path = WideStringToUtf8(executable_path);
+    options.staging_dir = updateDirStr;
+    const std::string batScript = GenerateBatchScript(plan, options);
 
     // Write the batch script to file
-    std::ofstream batFile("update_script.bat");
+    std::ofstream batFile(kBatchScriptName);
     if (batFile.is_open()) {
       batFile << batScript;
       batFile.close();
-      std::cout << "Update batch script created successfully.\n";
-    } else {
-      std::cerr << "Error: Failed to create update batch script.\n";
+      std::cout << "Update batch script created for " << plan.changed.size() << " changed, "
+                << plan.added.size() << " added and " << plan.removed.size() << " removed files.\n";
+      return true;
     }
+    *error = "Failed to create update batch script.";
+    return false;
   }
 
   /**
@@ -262,7 +244,7 @@ namespace desktop_updater
     }
   }
 
-  void RestartApp()
+  bool RestartApp(const std::vector<std::string> &removed, std::string *error)
   {
     printf("Restarting the application...\n");
     // Get the current executable file path
@@ -279,14 +261,17 @@ namespace desktop_updater
     std::wstring updateDir = L"update";
     std::wstring destDir = L".";
 
-    // Update createBatFile call with parameters
-    createBatFile(updateDir, destDir, executable_path);
+    if (!createBatFile(updateDir, destDir, removed, executable_path, error))
+    {
+      return false;
+    }
 
     // 3. .bat dosyasını çalıştır
     runBatFile();
 
     // Exit the current process
     ExitProcess(0);
+    return true;
   }
 
   void DesktopUpdaterPlugin::HandleMethodCall(
@@ -313,7 +298,32 @@ namespace desktop_updater
     }
     else if (method_call.method_name().compare("restartApp") == 0)
     {
-      RestartApp();
+      // Paths of the installed files the new release no longer has.
+      std::vector<std::string> removed;
+      const auto *arguments = std::get_if<flutter::EncodableMap>(method_call.arguments());
+      if (arguments != nullptr)
+      {
+        auto it = arguments->find(flutter::EncodableValue("removedFiles"));
+        if (it != arguments->end())
+        {
+          if (const auto *list = std::get_if<flutter::EncodableList>(&it->second))
+          {
+            for (const flutter::EncodableValue &path : *list)
+            {
+              if (const auto *value = std::get_if<std::string>(&path))
+              {
+                removed.push_back(*value);
+              }
+            }
+          }
+        }
+      }
+      std::string error;
+      if (!RestartApp(removed, &error))
+      {
+        result->Error("RestartError", error);
+        return;
+      }
       result->Success();
     }
     else if (method_call.method_name().compare("getExecutablePath") == 0)
@@ -330,74 +340,31 @@ namespace desktop_updater
     }
     else if (method_call.method_name().compare("getCurrentVersion") == 0)
     {
-      // Get only bundle version, Product version 1.0.0+2, should return 2
-      wchar_t exePath[MAX_PATH];
-      GetModuleFileNameW(NULL, exePath, MAX_PATH);
-
-      DWORD verHandle = 0;
-      UINT size = 0;
-      LPBYTE lpBuffer = NULL;
-      DWORD verSize = GetFileVersionInfoSizeW(exePath, &verHandle);
-      if (verSize == NULL)
-      {
-        result->Error("VersionError", "Unable to get version size.");
-        return;
-      }
-
-      std::vector<BYTE> verData(verSize);
-      if (!GetFileVersionInfoW(exePath, verHandle, verSize, verData.data()))
+      // Only the build number: Product version 1.0.0+2 returns 2
+      if (!version_ok_)
       {
-        result->Error("VersionError", "Unable to get version info.");
+        result->Error("VersionError", version_error_);
         return;
       }
-
-      // Retrieve translation information
-      struct LANGANDCODEPAGE
-      {
-        WORD wLanguage;
-        WORD wCodePage;
-      } *lpTranslate;
-
-      UINT cbTranslate = 0;
-      if (!VerQueryValueW(verData.data(), L"\\VarFileInfo\\Translation",
-                          (LPVOID *)&lpTranslate, &cbTranslate) ||
-          cbTranslate < sizeof(LANGANDCODEPAGE))
-      {
-        result->Error("VersionError", "Unable to get translation info.");
-        return;
-      }
-
-      // Build the query string using the first translation
-      wchar_t subBlock[50];
-      swprintf(subBlock, 50, L"\\StringFileInfo\\%04x%04x\\ProductVersion",
-               lpTranslate[0].wLanguage, lpTranslate[0].wCodePage);
-
-      if (!VerQueryValueW(verData.data(), subBlock, (LPVOID *)&lpBuffer, &size))
+      result->Success(flutter::EncodableValue(version_info_.build_number));
+    }
+    else if (method_call.method_name().compare("getVersionInfo") == 0)
+    {
+      if (!version_ok_)
       {
-        result->Error("VersionError", "Unable to query version value.");
+        result->Error("VersionError", version_error_);
         return;
       }
-
-      std::wstring productVersion((wchar_t *)lpBuffer);
-      size_t plusPos = productVersion.find(L'+');
-      if (plusPos != std::wstring::npos && plusPos + 1 < productVersion.length())
-      {
-        std::wstring buildNumber = productVersion.substr(plusPos + 1);
-
-        // Trim any trailing spaces
-        buildNumber.erase(buildNumber.find_last_not_of(L' ') + 1);
-
-        // Convert wchar_t to std::string (UTF-8)
-        int size_needed = WideCharToMultiByte(CP_UTF8, 0, buildNumber.c_str(), -1, NULL, 0, NULL, NULL);
-        std::string buildNumberStr(size_needed - 1, 0); // Exclude null terminator
-        WideCharToMultiByte(CP_UTF8, 0, buildNumber.c_str(), -1, &buildNumberStr[0], size_needed - 1, NULL, NULL);
-
-        result->Success(flutter::EncodableValue(buildNumberStr));
-      }
-      else
-      {
-        result->Error("VersionError", "Invalid version format.");
-      }
+      flutter::EncodableMap info = {
+          {flutter::EncodableValue("version"), flutter::EncodableValue(version_info_.version)},
+          {flutter::EncodableValue("major"), flutter::EncodableValue(version_info_.major)},
+          {flutter::EncodableValue("minor"), flutter::EncodableValue(version_info_.minor)},
+          {flutter::EncodableValue("patch"), flutter::EncodableValue(version_info_.patch)},
+          {flutter::EncodableValue("preRelease"), flutter::EncodableValue(version_info_.pre_release)},
+          {flutter::EncodableValue("buildNumber"), flutter::EncodableValue(version_info_.build_number)},
+          {flutter::EncodableValue("appName"), flutter::EncodableValue(version_info_.app_name)},
+      };
+      result->Success(flutter::EncodableValue(info));
     }
     else
     {
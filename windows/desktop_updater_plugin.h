@@ -5,6 +5,9 @@
 #include <flutter/plugin_registrar_windows.h>
 
 #include <memory>
+#include <string>
+
+#include "version_info.h"
 
 namespace desktop_updater {
 
@@ -24,6 +27,13 @@ class DesktopUpdaterPlugin : public flutter::Plugin {
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue> &method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
+ private:
+  // Build metadata from the executable's version resource, read once when
+  // the plugin is registered.
+  VersionInfo version_info_;
+  bool version_ok_ = false;
+  std::string version_error_;
 };
 
 }  // namespace desktop_updater